@@ -0,0 +1,101 @@
+
+#include "bench.hxx"
+#include "config.hxx"
+#include "fmu.hxx"
+#include "bfs.hxx"
+#include "navigation.hxx"
+#include "datalogger.hxx"
+#include "control-laws.hxx"
+#include "telemetry.hxx"
+#include "loop-stats.hxx"
+#include "pipeline.hxx"
+#include "alloc-trace.hxx"
+#include "global-defs.hxx"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+/* Writes the whole buffer to a socket. */
+static void WriteAll(int FileDesc,const uint8_t *Bytes,size_t Size) {
+  while (Size > 0) {
+    ssize_t Written = write(FileDesc,Bytes,Size);
+    if (Written <= 0) {
+      return;
+    }
+    Bytes += Written;
+    Size -= Written;
+  }
+}
+
+/* Runs the flight loop, all three stages, on a datalog played back over a socket
+pair as fast as it is read, then fails if any stage allocated after startup. The
+datalog is written out again in the current directory, as the SOC would. */
+int AllocBenchmark(int argc, char* argv[]) {
+  if (argc < 2) {
+    std::cerr << "Usage: output alloc <config> <datalog> [frames]" << std::endl;
+    return -1;
+  }
+  size_t Frames = (argc > 2) ? strtoul(argv[2],NULL,10) : 0;
+  int Link[2];
+  if (socketpair(AF_UNIX,SOCK_STREAM,0,Link) < 0) {
+    std::cerr << "ERROR: Could not create a socket pair." << std::endl;
+    return -1;
+  }
+  Fmu Sensors(Link[0]);
+  AircraftConfig Config = {0};
+  FmuData Data;
+  FmuDataLayout Layout;
+  LoadConfigFile(argv[0],Sensors,&Config,&Data,&Layout);
+  Sensors.SetDataLayout(Layout);
+  Sensors.SetReceiveTimeout(-1);
+  BfsMessage DataMessage = (Layout.Encoding == kRawEncoding) ? kData : kDataPacked;
+
+  FILE *LogFile = fopen(argv[1],"rb");
+  if (LogFile == NULL) {
+    std::cerr << "ERROR: Could not open " << argv[1] << std::endl;
+    return -1;
+  }
+  std::vector<uint8_t> Payload(Layout.PayloadSize);
+  std::vector<uint8_t> Stream;
+  uint8_t Message[BfsCodec::MaxMessageSize];
+  while (((Frames == 0)||(Stream.size() < Frames*(Layout.PayloadSize + BfsCodec::Overhead)))&&(fread(Payload.data(),Layout.PayloadSize,1,LogFile) == 1)) {
+    size_t MessageSize = BfsCodec::BuildMessage(DataMessage,Layout.PayloadSize,Payload.data(),Message);
+    Stream.insert(Stream.end(),Message,Message + MessageSize);
+  }
+  fclose(LogFile);
+
+  Navigation NavFilter;
+  NavFilter.Configure(Config.Navigation);
+  ControlLaws Laws;
+  if (!Config.ControlLaws.empty()) {
+    Laws.Compile(Config.ControlLaws,Data,Config.NumberEffectors);
+  }
+  Telemetry Downlink;
+  if (Config.Telemetry.Enabled) {
+    Downlink.Open(Config.Telemetry,Data);
+  }
+  Datalogger Log;
+  LoopStats Stats;
+  FlightPipeline Pipeline(Sensors,NavFilter,Laws,Downlink,Log,Stats,Data,Layout,Config.Tasks);
+
+  std::thread Player([&]() {
+    WriteAll(Link[1],Stream.data(),Stream.size());
+    shutdown(Link[1],SHUT_WR);
+  });
+  Pipeline.Run("alloc-stats.txt");
+  Player.join();
+  close(Link[1]);
+
+  std::cout << "Played " << Stream.size()/(Layout.PayloadSize + BfsCodec::Overhead) << " frames, " << Pipeline.GetFrames() << " received, first " << AllocationTracer::StartupFrames << " of each stage are startup" << std::endl;
+  Pipeline.Print(stdout);
+  if (!Pipeline.AllocationFree()) {
+    std::cout << "FAIL: the flight loop allocated after startup" << std::endl;
+    return 1;
+  }
+  std::cout << "PASS: no allocations after startup" << std::endl;
+  return 0;
+}
@@ -0,0 +1,72 @@
+/*
+bench.hxx
+Brian R Taylor
+brian.taylor@bolderflight.com
+2017-04-18
+Copyright (c) 2017 Bolder Flight Systems
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING 
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef BENCH_HXX_
+#define BENCH_HXX_
+
+#include <stdint.h>
+#include <time.h>
+
+/* Monotonic wall clock time, ns */
+inline uint64_t WallTime_ns() {
+  struct timespec Time;
+  clock_gettime(CLOCK_MONOTONIC,&Time);
+  return (uint64_t)Time.tv_sec*1000000000ULL + Time.tv_nsec;
+}
+
+/* CPU time consumed by this process, ns */
+inline uint64_t CpuTime_ns() {
+  struct timespec Time;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID,&Time);
+  return (uint64_t)Time.tv_sec*1000000000ULL + Time.tv_nsec;
+}
+
+/* Small deterministic generator so runs are repeatable */
+class XorShift {
+  public:
+    XorShift(uint32_t Seed) : State_(Seed ? Seed : 1) {}
+    uint32_t Next() {
+      State_ ^= State_ << 13;
+      State_ ^= State_ >> 17;
+      State_ ^= State_ << 5;
+      return State_;
+    }
+    /* Uniform between Min and Max */
+    double Uniform(double Min, double Max) {
+      return Min + (Max - Min)*(Next()/4294967295.0);
+    }
+  private:
+    uint32_t State_;
+};
+
+/* Benchmarks, each takes the arguments following the benchmark name */
+int RxBenchmark(int argc, char* argv[]);
+int CodecBenchmark(int argc, char* argv[]);
+int FuzzBenchmark(int argc, char* argv[]);
+int WireBenchmark(int argc, char* argv[]);
+int TxBenchmark(int argc, char* argv[]);
+int JitterBenchmark(int argc, char* argv[]);
+int ControlBenchmark(int argc, char* argv[]);
+int AllocBenchmark(int argc, char* argv[]);
+int SchedBenchmark(int argc, char* argv[]);
+int EkfBenchmark(int argc, char* argv[]);
+int ImuBenchmark(int argc, char* argv[]);
+
+#endif
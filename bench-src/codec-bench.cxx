@@ -0,0 +1,241 @@
+
+#include "bench.hxx"
+#include "bfs.hxx"
+#include "legacy-parser.hxx"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+/* Location of one message in a generated stream */
+struct StreamFrame {
+  size_t Start;
+  size_t End;
+};
+
+/* Builds a stream of kData messages. Each payload starts with its sequence number so
+parsed messages can be matched back to the stream. Sizes vary from 16 bytes to MaxSize. */
+static std::vector<uint8_t> BuildStream(size_t Frames, size_t MaxSize, XorShift *Random, std::vector<StreamFrame> *FramesPtr) {
+  std::vector<uint8_t> Stream;
+  std::vector<uint8_t> Payload(BfsCodec::MaxPayloadSize);
+  std::vector<uint8_t> Message(BfsCodec::MaxMessageSize);
+  for (uint32_t i=0; i < Frames; i++) {
+    size_t Size = 16 + Random->Next() % (MaxSize - 15);
+    memcpy(Payload.data(),&i,sizeof(i));
+    for (size_t j=sizeof(i); j < Size; j++) {
+      Payload[j] = (uint8_t) Random->Next();
+    }
+    size_t MessageSize = BfsCodec::BuildMessage(kData,Size,Payload.data(),Message.data());
+    StreamFrame Frame = {Stream.size(),Stream.size() + MessageSize};
+    FramesPtr->push_back(Frame);
+    Stream.insert(Stream.end(),Message.begin(),Message.begin()+MessageSize);
+  }
+  return Stream;
+}
+
+/* Returns true if a parsed payload is exactly the one sent with its sequence number. */
+static bool MatchesStream(const std::vector<uint8_t> &Stream, const std::vector<StreamFrame> &Frames, const uint8_t *Payload, size_t PayloadSize, uint32_t *Sequence) {
+  if (PayloadSize < sizeof(uint32_t)) {
+    return false;
+  }
+  memcpy(Sequence,Payload,sizeof(uint32_t));
+  if (*Sequence >= Frames.size()) {
+    return false;
+  }
+  const StreamFrame &Frame = Frames[*Sequence];
+  if (Frame.End - Frame.Start - BfsCodec::Overhead != PayloadSize) {
+    return false;
+  }
+  return memcmp(&Stream[Frame.Start + BfsCodec::HeaderSize],Payload,PayloadSize) == 0;
+}
+
+int CodecBenchmark(int argc, char* argv[]) {
+  size_t Frames = (argc > 0) ? strtoul(argv[0],NULL,10) : 100000;
+  size_t MaxSize = (argc > 1) ? strtoul(argv[1],NULL,10) : 512;
+  const size_t ReadSize = 4096;
+  XorShift Random(1);
+  std::vector<StreamFrame> Index;
+  std::vector<uint8_t> Stream = BuildStream(Frames,std::min(MaxSize,BfsCodec::MaxPayloadSize),&Random,&Index);
+  std::cout << "Stream: " << Frames << " messages, " << Stream.size() << " bytes" << std::endl;
+
+  size_t Parsed = 0;
+  uint64_t Start = CpuTime_ns();
+  LegacyBfsParser Legacy;
+  for (size_t i=0; i < Stream.size(); i++) {
+    Parsed += Legacy.Parse(Stream[i]);
+  }
+  uint64_t LegacyTime = CpuTime_ns() - Start;
+  size_t LegacyParsed = Parsed;
+
+  Parsed = 0;
+  Start = CpuTime_ns();
+  BfsCodec ByteCodec;
+  for (size_t i=0; i < Stream.size(); i++) {
+    Parsed += ByteCodec.Parse(Stream[i]);
+  }
+  uint64_t ByteTime = CpuTime_ns() - Start;
+  size_t ByteParsed = Parsed;
+
+  // hand the codec read sized blocks, as Fmu does with its receive buffer
+  Parsed = 0;
+  Start = CpuTime_ns();
+  BfsCodec BlockCodec;
+  for (size_t i=0; i < Stream.size(); i += ReadSize) {
+    size_t Count = std::min(ReadSize,Stream.size() - i);
+    size_t Offset = 0;
+    while (Offset < Count) {
+      size_t Consumed;
+      Parsed += BlockCodec.Parse(&Stream[i+Offset],Count-Offset,&Consumed);
+      Offset += Consumed;
+    }
+  }
+  uint64_t BlockTime = CpuTime_ns() - Start;
+  size_t BlockParsed = Parsed;
+
+  const char *Names[3] = {"legacy byte","codec byte","codec block"};
+  uint64_t Times[3] = {LegacyTime,ByteTime,BlockTime};
+  size_t Counts[3] = {LegacyParsed,ByteParsed,BlockParsed};
+  for (size_t i=0; i < 3; i++) {
+    double Seconds = Times[i]/1e9;
+    printf("%-12s messages: %8zu  %8.1f MB/s  %10.0f messages/s  %7.1f ns/message\n",
+      Names[i],Counts[i],Stream.size()/Seconds/1e6,Counts[i]/Seconds,Times[i]/(double)Counts[i]);
+  }
+  return 0;
+}
+
+/* Kinds of damage applied to the stream */
+enum Corruption {
+  kBitFlip,
+  kDropByte,
+  kInsertByte,
+  kGarbageBurst
+};
+
+struct CorruptionEvent {
+  size_t Offset;
+  Corruption Type;
+};
+
+struct FuzzResult {
+  size_t Valid;                             // messages matching the stream
+  size_t IntactRecovered;                   // untouched messages that were parsed
+  size_t FalseAccepts;                      // messages passing the checksum that were never sent
+};
+
+/* Feeds the damaged stream to a parser in read sized blocks and scores the result. */
+template <typename ParseBlock>
+static FuzzResult ScoreParser(const std::vector<uint8_t> &Damaged, const std::vector<uint8_t> &Stream, const std::vector<StreamFrame> &Frames, const std::vector<bool> &Intact, ParseBlock Parse) {
+  FuzzResult Result = {0,0,0};
+  std::vector<bool> Seen(Frames.size(),false);
+  Parse(Damaged,[&](const uint8_t *Payload, size_t PayloadSize) {
+    uint32_t Sequence;
+    if (MatchesStream(Stream,Frames,Payload,PayloadSize,&Sequence)) {
+      Result.Valid++;
+      if (Intact[Sequence] && !Seen[Sequence]) {
+        Result.IntactRecovered++;
+      }
+      Seen[Sequence] = true;
+    } else {
+      Result.FalseAccepts++;
+    }
+  });
+  return Result;
+}
+
+int FuzzBenchmark(int argc, char* argv[]) {
+  size_t Frames = (argc > 0) ? strtoul(argv[0],NULL,10) : 100000;
+  size_t Events = (argc > 1) ? strtoul(argv[1],NULL,10) : 1000;
+  uint32_t Seed = (argc > 2) ? strtoul(argv[2],NULL,10) : 1;
+  XorShift Random(Seed);
+  std::vector<StreamFrame> Index;
+  std::vector<uint8_t> Stream = BuildStream(Frames,512,&Random,&Index);
+
+  // pick the damage, then mark the messages it touches
+  std::vector<CorruptionEvent> Damage(Events);
+  for (size_t i=0; i < Events; i++) {
+    Damage[i].Offset = Random.Next() % Stream.size();
+    Damage[i].Type = (Corruption) (Random.Next() % 4);
+  }
+  std::sort(Damage.begin(),Damage.end(),[](const CorruptionEvent &A, const CorruptionEvent &B) {
+    return A.Offset < B.Offset;
+  });
+  std::vector<bool> Intact(Index.size(),true);
+  size_t Frame = 0;
+  for (size_t i=0; i < Events; i++) {
+    while ((Frame < Index.size())&&(Index[Frame].End <= Damage[i].Offset)) {
+      Frame++;
+    }
+    bool Inserted = (Damage[i].Type == kInsertByte)||(Damage[i].Type == kGarbageBurst);
+    if ((Frame < Index.size())&&(!Inserted || Damage[i].Offset > Index[Frame].Start)) {
+      Intact[Frame] = false;
+    }
+  }
+  size_t IntactFrames = std::count(Intact.begin(),Intact.end(),true);
+
+  std::vector<uint8_t> Damaged;
+  Damaged.reserve(Stream.size() + 64*Events);
+  size_t Next = 0;
+  for (size_t i=0; i < Stream.size(); i++) {
+    bool Keep = true;
+    uint8_t Byte = Stream[i];
+    while ((Next < Events)&&(Damage[Next].Offset == i)) {
+      switch (Damage[Next].Type) {
+        case kBitFlip:
+          Byte ^= (uint8_t) (1 << (Random.Next() % 8));
+          break;
+        case kDropByte:
+          Keep = false;
+          break;
+        case kInsertByte:
+          Damaged.push_back((uint8_t) Random.Next());
+          break;
+        case kGarbageBurst:
+          for (size_t j=0; j < 32; j++) {
+            Damaged.push_back((uint8_t) Random.Next());
+          }
+          break;
+      }
+      Next++;
+    }
+    if (Keep) {
+      Damaged.push_back(Byte);
+    }
+  }
+
+  FuzzResult Legacy = ScoreParser(Damaged,Stream,Index,Intact,[](const std::vector<uint8_t> &Input, std::function<void(const uint8_t*,size_t)> Deliver) {
+    LegacyBfsParser Parser;
+    for (size_t i=0; i < Input.size(); i++) {
+      if (Parser.Parse(Input[i])) {
+        Deliver(Parser.GetPayload(),Parser.GetPayloadSize());
+      }
+    }
+  });
+  BfsParserStats Stats;
+  FuzzResult Codec = ScoreParser(Damaged,Stream,Index,Intact,[&](const std::vector<uint8_t> &Input, std::function<void(const uint8_t*,size_t)> Deliver) {
+    BfsCodec Parser;
+    size_t Offset = 0;
+    while (Offset < Input.size()) {
+      size_t Consumed;
+      if (Parser.Parse(&Input[Offset],Input.size()-Offset,&Consumed)) {
+        Deliver(Parser.GetPayload(),Parser.GetPayloadSize());
+      }
+      Offset += Consumed;
+    }
+    Stats = Parser.GetStats();
+  });
+
+  std::cout << "Stream: " << Frames << " messages, " << Events << " corruptions, " << IntactFrames << " messages untouched" << std::endl;
+  const char *Names[2] = {"legacy","codec"};
+  FuzzResult Results[2] = {Legacy,Codec};
+  for (size_t i=0; i < 2; i++) {
+    size_t Lost = IntactFrames - Results[i].IntactRecovered;
+    printf("%-8s valid: %8zu  untouched lost: %6zu  lost/corruption: %5.3f  false accepts: %zu\n",
+      Names[i],Results[i].Valid,Lost,Lost/(double)Events,Results[i].FalseAccepts);
+  }
+  printf("codec    checksum errors: %llu  length errors: %llu  discarded bytes: %llu\n",
+    (unsigned long long)Stats.ChecksumErrors,(unsigned long long)Stats.LengthErrors,(unsigned long long)Stats.DiscardedBytes);
+  return 0;
+}
@@ -0,0 +1,109 @@
+
+#include "bench.hxx"
+#include "control-laws.hxx"
+#include "loop-stats.hxx"
+#include "global-defs.hxx"
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/* Manual flight: each effector is its inceptor scaled to a deflection */
+static const char *ManualBlocks =
+  "{\"Type\":\"Gain\",\"Input\":\"SbusRx/0/Inceptors/0\",\"Output\":\"Aileron\",\"Gain\":0.35},"
+  "{\"Type\":\"Gain\",\"Input\":\"SbusRx/0/Inceptors/1\",\"Output\":\"Elevator\",\"Gain\":0.35},"
+  "{\"Type\":\"Gain\",\"Input\":\"SbusRx/0/Inceptors/2\",\"Output\":\"Rudder\",\"Gain\":0.35}";
+
+/* Roll and pitch attitude hold over PID rate loops on filtered gyros, a yaw damper,
+and a switch to manual on SbusRx AutoEnabled, with names ending in Suffix */
+static std::string AttitudeBlocks(const std::string &Suffix) {
+  std::string Blocks;
+  Blocks += "{\"Type\":\"Constant\",\"Output\":\"One" + Suffix + "\",\"Value\":1},";
+  Blocks += "{\"Type\":\"Sum\",\"Inputs\":[\"One" + Suffix + "\",\"SbusRx/0/AutoEnabled\"],\"Signs\":[1,-1],\"Output\":\"Manual" + Suffix + "\"},";
+  const char *Axes[2] = {"Roll","Pitch"};
+  const char *Surfaces[2] = {"Aileron","Elevator"};
+  for (size_t i=0; i < 2; i++) {
+    std::string Axis = Axes[i] + Suffix;
+    std::string Index = std::to_string(i);
+    Blocks += "{\"Type\":\"Gain\",\"Input\":\"SbusRx/0/Inceptors/" + Index + "\",\"Output\":\"" + Axis + "Manual\",\"Gain\":0.35},";
+    Blocks += "{\"Type\":\"Gain\",\"Input\":\"SbusRx/0/Inceptors/" + Index + "\",\"Output\":\"" + Axis + "AngleCmd\",\"Gain\":0.7},";
+    Blocks += "{\"Type\":\"Sum\",\"Inputs\":[\"" + Axis + "AngleCmd\",\"Nav/Euler_rad/" + Index + "\"],\"Signs\":[1,-1],\"Output\":\"" + Axis + "AngleError\"},";
+    Blocks += "{\"Type\":\"Pid\",\"Input\":\"" + Axis + "AngleError\",\"Output\":\"" + Axis + "RateCmd\",\"Kp\":2.0,\"Ki\":0.2,\"Min\":-1.5,\"Max\":1.5,\"Reset\":\"Manual" + Suffix + "\"},";
+    Blocks += "{\"Type\":\"Filter\",\"Input\":\"Mpu9250/Gyro_rads/" + Index + "\",\"Output\":\"" + Axis + "Rate\",\"Num\":[0.01336,0.02672,0.01336],\"Den\":[1,-1.64744,0.70089]},";
+    Blocks += "{\"Type\":\"Sum\",\"Inputs\":[\"" + Axis + "RateCmd\",\"" + Axis + "Rate\"],\"Signs\":[1,-1],\"Output\":\"" + Axis + "RateError\"},";
+    Blocks += "{\"Type\":\"Pid\",\"Input\":\"" + Axis + "RateError\",\"Output\":\"" + Axis + "Auto\",\"Kp\":0.1,\"Ki\":0.05,\"Kd\":0.002,\"Tf\":0.01,\"Min\":-0.35,\"Max\":0.35,\"Reset\":\"Manual" + Suffix + "\"},";
+    Blocks += "{\"Type\":\"Switch\",\"Condition\":\"SbusRx/0/AutoEnabled\",\"On\":\"" + Axis + "Auto\",\"Off\":\"" + Axis + "Manual\",\"Output\":\"" + Surfaces[i] + Suffix + "\"},";
+  }
+  Blocks += "{\"Type\":\"Filter\",\"Input\":\"Mpu9250/Gyro_rads/2\",\"Output\":\"YawWashout" + Suffix + "\",\"Num\":[1,-1],\"Den\":[1,-0.99]},";
+  Blocks += "{\"Type\":\"Gain\",\"Input\":\"SbusRx/0/Inceptors/2\",\"Output\":\"YawManual" + Suffix + "\",\"Gain\":0.35},";
+  Blocks += "{\"Type\":\"Sum\",\"Inputs\":[\"YawManual" + Suffix + "\",\"YawWashout" + Suffix + "\"],\"Signs\":[1,-0.2],\"Output\":\"YawDamped" + Suffix + "\"},";
+  Blocks += "{\"Type\":\"Limit\",\"Input\":\"YawDamped" + Suffix + "\",\"Output\":\"Rudder" + Suffix + "\",\"Min\":-0.35,\"Max\":0.35}";
+  return Blocks;
+}
+
+/* Steps the laws Steps times over changing inputs: once untimed for the mean, once
+timing every step for the distribution, which includes one clock read. */
+static void RunControl(const char *Name,const std::string &Json,size_t Steps) {
+  FmuData Data;
+  Data.SbusRx.resize(1);
+  Data.Time_us = 0;
+  NavigationData Nav;
+  memset(&Nav,0,sizeof(Nav));
+  ControlLaws Laws;
+  Laws.Compile(Json,Data,3);
+  XorShift Random(1);
+  std::vector<float> Inputs(4096);
+  for (size_t i=0; i < Inputs.size(); i++) {
+    Inputs[i] = Random.Uniform(-1.0,1.0);
+  }
+  float Checksum = 0.0f;
+  LatencyHistogram Step_ns;
+  uint64_t Elapsed_ns = 0;
+  for (size_t Pass=0; Pass < 2; Pass++) {
+    Laws.Reset();
+    uint64_t Start_ns = WallTime_ns();
+    for (size_t i=0; i < Steps; i++) {
+      Data.Time_us += 2000;
+      Data.SbusRx[0].AutoEnabled = (i/5000) % 2;
+      Data.SbusRx[0].Inceptors(0) = Inputs[i & 4095];
+      Data.SbusRx[0].Inceptors(1) = Inputs[(i+1) & 4095];
+      Data.Mpu9250.Gyro_rads(0) = Inputs[(i+2) & 4095];
+      Data.Mpu9250.Gyro_rads(1) = Inputs[(i+3) & 4095];
+      Nav.Euler_rad[0] = Inputs[(i+4) & 4095];
+      if (Pass == 0) {
+        Laws.Step(Data,Nav,NULL);
+      } else {
+        uint64_t StepStart_ns = WallTime_ns();
+        Laws.Step(Data,Nav,NULL);
+        Step_ns.Record(WallTime_ns() - StepStart_ns);
+      }
+      Checksum += Laws.GetCommands()[0];
+    }
+    if (Pass == 0) {
+      Elapsed_ns = WallTime_ns() - Start_ns;
+    }
+  }
+  printf("%-12s %6zu %6zu %6zu %10.1f %8llu %8llu %8llu   (%g)\n",Name,Laws.GetBlocks(),Laws.GetInstructions(),Laws.GetSignals(),
+    (double)Elapsed_ns/Steps,(unsigned long long)Step_ns.GetPercentile(50),(unsigned long long)Step_ns.GetPercentile(99),
+    (unsigned long long)Step_ns.GetMax(),Checksum);
+}
+
+int ControlBenchmark(int argc, char* argv[]) {
+  size_t Steps = (argc > 0) ? strtoul(argv[0],NULL,10) : 1000000;
+  std::string Effectors = "\"Effectors\":[\"Aileron\",\"Elevator\",\"Rudder\"]";
+  std::string Attitude8 = AttitudeBlocks("");
+  for (size_t i=1; i < 8; i++) {
+    Attitude8 += "," + AttitudeBlocks(std::to_string(i));
+  }
+  uint64_t Start_ns = WallTime_ns();
+  for (size_t i=0; i < Steps; i++) {
+    WallTime_ns();
+  }
+  printf("Steps: %zu, clock read %.1f ns\n",Steps,(double)(WallTime_ns() - Start_ns)/Steps);
+  printf("%-12s %6s %6s %6s %10s %8s %8s %8s\n","laws","blocks","instr","signals","ns/step","p50","p99","max");
+  RunControl("manual","{\"Blocks\":[" + std::string(ManualBlocks) + "]," + Effectors + "}",Steps);
+  RunControl("attitude","{\"Blocks\":[" + AttitudeBlocks("") + "]," + Effectors + "}",Steps);
+  RunControl("attitude x8","{\"Blocks\":[" + Attitude8 + "]," + Effectors + "}",Steps);
+  return 0;
+}
@@ -0,0 +1,320 @@
+
+#include "bench.hxx"
+#include "EKF_15state.hxx"
+#include "config.hxx"
+#include "fmu.hxx"
+#include "data-layout.hxx"
+#include "global-defs.hxx"
+#include <stdio.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+/* One step of generated flight: IMU every step, GPS every GpsDivisor steps */
+struct EkfInput {
+  IMUdata Imu;
+  GPSdata Gps;
+};
+
+/* Generates a gentle S-turn at 20 m/s with sensor noise, Dt_s apart, starting
+level near Boulder, so both filters see the same coupled attitude, velocity and
+position errors as in flight. */
+static std::vector<EkfInput> BuildFlight(size_t Steps,double Dt_s,size_t GpsDivisor) {
+  XorShift Random(7);
+  std::vector<EkfInput> Flight(Steps);
+  double Lat = 40.0*M_PI/180.0, Lon = -105.0*M_PI/180.0, Alt = 1600.0;
+  double Heading = 0.0;
+  for (size_t i=0; i < Steps; i++) {
+    double Time = i*Dt_s;
+    double YawRate = 0.2*sin(0.1*Time);
+    double Roll = atan(20.0*YawRate/9.814);
+    Heading += YawRate*Dt_s;
+    double Vn = 20.0*cos(Heading), Ve = 20.0*sin(Heading);
+    Lat += Vn*Dt_s/6378137.0;
+    Lon += Ve*Dt_s/(6378137.0*cos(Lat));
+    IMUdata &Imu = Flight[i].Imu;
+    memset(&Imu,0,sizeof(Imu));
+    Imu.time = Time;
+    Imu.p = 0.002 + Random.Uniform(-0.003,0.003);
+    Imu.q = YawRate*sin(Roll) - 0.001 + Random.Uniform(-0.003,0.003);
+    Imu.r = YawRate*cos(Roll) + Random.Uniform(-0.003,0.003);
+    Imu.ax = Random.Uniform(-0.1,0.1);
+    Imu.ay = Random.Uniform(-0.1,0.1) + 0.05;
+    Imu.az = -9.814/cos(Roll) + Random.Uniform(-0.1,0.1);
+    Imu.hx = 0.2*cos(Heading);
+    Imu.hy = -0.2*sin(Heading);
+    Imu.hz = 0.4;
+    GPSdata &Gps = Flight[i].Gps;
+    memset(&Gps,0,sizeof(Gps));
+    Gps.time = Time;
+    Gps.lat = Lat + Random.Uniform(-3.0,3.0)/6378137.0;
+    Gps.lon = Lon + Random.Uniform(-3.0,3.0)/6378137.0;
+    Gps.alt = Alt + Random.Uniform(-3.0,3.0);
+    Gps.vn = Vn + Random.Uniform(-0.2,0.2);
+    Gps.ve = Ve + Random.Uniform(-0.2,0.2);
+    Gps.vd = Random.Uniform(-0.2,0.2);
+    Gps.sats = 10;
+    Gps.newData = (i % GpsDivisor) == 0;
+  }
+  return Flight;
+}
+
+/* Reads a recorded flight from a datalog, one step a record from the first with a
+GPS fix. The records carry no update flags, so a new GPS epoch is one whose time of
+week differs from the last. */
+static std::vector<EkfInput> ReadFlight(const char *ConfigFileName,const char *LogFileName) {
+  Fmu Null(open("/dev/null",O_RDWR));
+  AircraftConfig Config = {0};
+  FmuData Data;
+  FmuDataLayout Layout;
+  LoadConfigFile(ConfigFileName,Null,&Config,&Data,&Layout);
+  std::vector<EkfInput> Flight;
+  FILE *LogFile = fopen(LogFileName,"rb");
+  if (LogFile == NULL) {
+    std::cerr << "ERROR: Could not open " << LogFileName << std::endl;
+    return Flight;
+  }
+  std::vector<uint8_t> Payload(Layout.PayloadSize);
+  uint32_t LastTow = 0;
+  while (fread(Payload.data(),Layout.PayloadSize,1,LogFile) == 1) {
+    FmuDataView(Layout,Payload.data()).Decode(&Data);
+    if ((Data.Gps.size() == 0)||(Flight.empty() && !Data.Gps[0].Fix)) {
+      continue;
+    }
+    EkfInput Input;
+    memset(&Input,0,sizeof(Input));
+    Input.Imu.time = Data.Time_us/1000000.0L;
+    Input.Imu.p = Data.Mpu9250.Gyro_rads[0];
+    Input.Imu.q = Data.Mpu9250.Gyro_rads[1];
+    Input.Imu.r = Data.Mpu9250.Gyro_rads[2];
+    Input.Imu.ax = Data.Mpu9250.Accel_mss[0];
+    Input.Imu.ay = Data.Mpu9250.Accel_mss[1];
+    Input.Imu.az = Data.Mpu9250.Accel_mss[2];
+    Input.Imu.hx = Data.Mpu9250.Mag_uT[0]*0.01f;
+    Input.Imu.hy = Data.Mpu9250.Mag_uT[1]*0.01f;
+    Input.Imu.hz = Data.Mpu9250.Mag_uT[2]*0.01f;
+    Input.Gps.time = Data.Gps[0].Sec;
+    Input.Gps.lat = Data.Gps[0].LLA[0];
+    Input.Gps.lon = Data.Gps[0].LLA[1];
+    Input.Gps.alt = Data.Gps[0].LLA[2];
+    Input.Gps.vn = Data.Gps[0].NEDVelocity_ms[0];
+    Input.Gps.ve = Data.Gps[0].NEDVelocity_ms[1];
+    Input.Gps.vd = Data.Gps[0].NEDVelocity_ms[2];
+    Input.Gps.sats = Data.Gps[0].NumberSatellites;
+    Input.Gps.newData = Data.Gps[0].Fix && (Flight.empty() || (Data.Gps[0].TOW != LastTow));
+    LastTow = Data.Gps[0].TOW;
+    Flight.push_back(Input);
+  }
+  fclose(LogFile);
+  return Flight;
+}
+
+/* Runs the filter over the flight, returns ns per update. With TimeUpdateOnly the
+GPS is left out so only the time update is timed, with GpsEveryStep it is used on
+every step so the measurement update can be timed too. */
+template <typename Filter>
+static double RunFilter(Filter *Ekf,const std::vector<EkfInput> &Flight,bool TimeUpdateOnly,bool GpsEveryStep,std::vector<NAVdata> *NavPtr) {
+  Ekf->init(Flight[0].Imu,Flight[0].Gps);
+  uint64_t Start = CpuTime_ns();
+  for (size_t i=1; i < Flight.size(); i++) {
+    GPSdata Gps = Flight[i].Gps;
+    if (TimeUpdateOnly) {
+      Gps.newData = 0;
+    } else if (GpsEveryStep) {
+      Gps.newData = 1;
+    }
+    NAVdata Nav = Ekf->update(Flight[i].Imu,Gps);
+    if (NavPtr != NULL) {
+      NavPtr->push_back(Nav);
+    }
+  }
+  return (double)(CpuTime_ns() - Start)/(Flight.size() - 1);
+}
+
+/* Largest difference relative to the reference, with Floor keeping small values from dominating */
+static double RelativeDifference(double Value,double Reference,double Floor) {
+  return fabs(Value - Reference)/std::max(fabs(Reference),Floor);
+}
+
+/* Largest errors of a navigation solution against a reference, per state */
+struct StateErrors {
+  double Position_m[3];                     // north, east, down
+  double Velocity_ms[3];
+  double Attitude_rad[3];                   // roll, pitch, yaw
+  double AccelBias_mss[3];
+  double GyroBias_rads[3];
+  double Covariance;                        // largest of the diagonal, relative
+  double Sigmas[5];                         // largest of each state against the reference standard deviation
+};
+
+/* Runs both filters over the flight and returns the largest differences between them.
+With CovarianceAtGps the covariance is compared only after GPS updates, where a
+decimated time update has brought it up to date. */
+template <typename TestFilter,typename ReferenceFilter>
+static StateErrors CompareFilters(TestFilter *Test,ReferenceFilter *Reference,const std::vector<EkfInput> &Flight,bool CovarianceAtGps = false) {
+  std::vector<NAVdata> ReferenceNav, TestNav;
+  RunFilter(Reference,Flight,false,false,&ReferenceNav);
+  RunFilter(Test,Flight,false,false,&TestNav);
+  StateErrors Errors;
+  memset(&Errors,0,sizeof(Errors));
+  for (size_t i=0; i < ReferenceNav.size(); i++) {
+    const NAVdata &D = ReferenceNav[i];
+    const NAVdata &S = TestNav[i];
+    const double Dp[15] = {D.Pp0,D.Pp1,D.Pp2,D.Pv0,D.Pv1,D.Pv2,D.Pa0,D.Pa1,D.Pa2,D.Pabx,D.Paby,D.Pabz,D.Pgbx,D.Pgby,D.Pgbz};
+    const double Sp[15] = {S.Pp0,S.Pp1,S.Pp2,S.Pv0,S.Pv1,S.Pv2,S.Pa0,S.Pa1,S.Pa2,S.Pabx,S.Paby,S.Pabz,S.Pgbx,S.Pgby,S.Pgbz};
+    for (size_t j=0; (j < 15)&&(!CovarianceAtGps || Flight[i+1].Gps.newData); j++) {
+      Errors.Covariance = std::max(Errors.Covariance,RelativeDifference(Sp[j],Dp[j],1e-12));
+    }
+    const double Differences[5][3] = {
+      {(S.lat - D.lat)*6378137.0,(S.lon - D.lon)*6378137.0*cos(D.lat),D.alt - S.alt},
+      {S.vn - D.vn,S.ve - D.ve,S.vd - D.vd},
+      {S.phi - D.phi,S.the - D.the,remainder(S.psi - D.psi,2.0*M_PI)},
+      {S.abx - D.abx,S.aby - D.aby,S.abz - D.abz},
+      {S.gbx - D.gbx,S.gby - D.gby,S.gbz - D.gbz}};
+    double *Largest[5] = {Errors.Position_m,Errors.Velocity_ms,Errors.Attitude_rad,Errors.AccelBias_mss,Errors.GyroBias_rads};
+    for (size_t j=0; j < 5; j++) {
+      for (size_t k=0; k < 3; k++) {
+        Largest[j][k] = std::max(Largest[j][k],fabs(Differences[j][k]));
+        Errors.Sigmas[j] = std::max(Errors.Sigmas[j],fabs(Differences[j][k])/sqrt(Dp[3*j+k]));
+      }
+    }
+  }
+  return Errors;
+}
+
+/* Prints the largest covariance, position and attitude differences on one line. */
+static void PrintAgreement(const char *Name,const StateErrors &Errors) {
+  double Position_m = std::max(Errors.Position_m[0],std::max(Errors.Position_m[1],Errors.Position_m[2]));
+  double Attitude_rad = std::max(Errors.Attitude_rad[0],std::max(Errors.Attitude_rad[1],Errors.Attitude_rad[2]));
+  printf("%s: covariance diagonal %.2e relative, position %.2e m, attitude %.2e rad, largest over the flight\n",
+    Name,Errors.Covariance,Position_m,Attitude_rad);
+}
+
+/* Prints the largest error of each state, and the largest against the reference
+filter's own standard deviation for that state. */
+static void PrintStateErrors(const StateErrors &Errors) {
+  printf("%-24s %12s %12s %12s %12s\n","largest error","x / north","y / east","z / down","of sigma");
+  const char *Names[5] = {"position, m","velocity, m/s","roll pitch yaw, rad","accel bias, m/s/s","gyro bias, rad/s"};
+  const double *Values[5] = {Errors.Position_m,Errors.Velocity_ms,Errors.Attitude_rad,Errors.AccelBias_mss,Errors.GyroBias_rads};
+  for (size_t i=0; i < 5; i++) {
+    printf("%-24s %12.2e %12.2e %12.2e %12.2e\n",Names[i],Values[i][0],Values[i][1],Values[i][2],Errors.Sigmas[i]);
+  }
+  printf("%-24s %12.2e\n","covariance diag, rel",Errors.Covariance);
+}
+
+/* Best of three runs of a filter, ns per update */
+template <typename Filter>
+static double TimeFilter(bool StructuredTu,bool SequentialMu,const std::vector<EkfInput> &Flight,bool TimeUpdateOnly,bool GpsEveryStep,int Decimation = 1) {
+  Filter *Ekf = new Filter();
+  Ekf->set_structured_tu(StructuredTu);
+  Ekf->set_sequential_mu(SequentialMu);
+  Ekf->set_tu_decimation(Decimation);
+  double Time = 1e30;
+  for (size_t Run=0; Run < 3; Run++) {
+    Time = std::min(Time,RunFilter(Ekf,Flight,TimeUpdateOnly,GpsEveryStep,NULL));
+  }
+  delete Ekf;
+  return Time;
+}
+
+/* Compares the structured covariance time update and the sequential GPS update with
+the dense and batch references, and the single precision filter with the double one,
+on a generated flight or on a recorded one given as a configuration and a datalog,
+then times each. */
+int EkfBenchmark(int argc, char* argv[]) {
+  std::vector<EkfInput> Flight;
+  if (argc > 1) {
+    Flight = ReadFlight(argv[0],argv[1]);
+    if (Flight.size() < 2) {
+      std::cerr << "ERROR: No GPS fix in " << argv[1] << std::endl;
+      return -1;
+    }
+    size_t GpsUpdates = 0;
+    for (size_t i=0; i < Flight.size(); i++) {
+      GpsUpdates += Flight[i].Gps.newData;
+    }
+    std::cout << "EKF15: " << Flight.size() << " records of " << argv[1] << ", " << GpsUpdates << " GPS epochs" << std::endl;
+  } else {
+    size_t Steps = (argc > 0) ? strtoul(argv[0],NULL,10) : 50000;
+    const double Dt_s = 0.002;
+    const size_t GpsDivisor = 50;
+    Flight = BuildFlight(Steps,Dt_s,GpsDivisor);
+    std::cout << "EKF15: " << Steps << " steps at " << 1.0/Dt_s << " Hz, GPS at " << 1.0/(Dt_s*GpsDivisor) << " Hz" << std::endl;
+  }
+
+  // agreement with the references over the whole flight, one change at a time
+  EKF15 *Reference = new EKF15();
+  EKF15 *Structured = new EKF15();
+  EKF15 *Sequential = new EKF15();
+  Structured->set_structured_tu(true);
+  Sequential->set_sequential_mu(true);
+  PrintAgreement("structured vs dense time update",CompareFilters(Structured,Reference,Flight));
+  PrintAgreement("sequential vs batch GPS update",CompareFilters(Sequential,Reference,Flight));
+  delete Reference;
+  delete Structured;
+  delete Sequential;
+
+  // single precision against double, both structured and sequential
+  EKF15 *Double = new EKF15();
+  EKF15f *Single = new EKF15f();
+  Double->set_structured_tu(true);
+  Double->set_sequential_mu(true);
+  Single->set_structured_tu(true);
+  Single->set_sequential_mu(true);
+  printf("float vs double filter:\n");
+  PrintStateErrors(CompareFilters(Single,Double,Flight));
+  delete Double;
+  delete Single;
+
+  // time per update, and per GPS update from a run with GPS on every step
+  printf("%-12s %16s %16s %16s\n","time update","ns/update","with GPS, ns","working set, B");
+  // dense: F, PHI, P, Qw and Q, G and Rw; structured: P packed and its next copy,
+  // a block row of M = PHI*P, seven 3x3 transition and noise blocks and the four
+  // diagonal blocks of Rw read
+  size_t DenseBytes = 5*sizeof(Matrix15d) + sizeof(Matrix15x12d) + sizeof(Matrix12d);
+  size_t StructuredBytes = 2*120*sizeof(double) + (5 + 7)*sizeof(Matrix3d) + 4*9*sizeof(double);
+  for (size_t Mode=0; Mode < 2; Mode++) {
+    printf("%-12s %16.0f %16.0f %16zu\n",(Mode == 0) ? "dense" : "structured",TimeFilter<EKF15>(Mode == 1,true,Flight,true,false),
+      TimeFilter<EKF15>(Mode == 1,true,Flight,false,false),(Mode == 0) ? DenseBytes : StructuredBytes);
+  }
+  printf("%-12s %16s %16s\n","GPS update","ns/GPS update","ns/update");
+  double TimeUpdate_ns = TimeFilter<EKF15>(true,true,Flight,true,false);
+  for (size_t Mode=0; Mode < 2; Mode++) {
+    printf("%-12s %16.0f %16.0f\n",(Mode == 0) ? "batch" : "sequential",TimeFilter<EKF15>(true,Mode == 1,Flight,false,true) - TimeUpdate_ns,
+      TimeFilter<EKF15>(true,Mode == 1,Flight,false,false));
+  }
+  printf("%-12s %16s %16s %16s\n","precision","ns/update","with GPS, ns","speedup");
+  double Double_ns[2] = {TimeFilter<EKF15>(true,true,Flight,true,false),TimeFilter<EKF15>(true,true,Flight,false,false)};
+  double Single_ns[2] = {TimeFilter<EKF15f>(true,true,Flight,true,false),TimeFilter<EKF15f>(true,true,Flight,false,false)};
+  printf("%-12s %16.0f %16.0f\n","double",Double_ns[0],Double_ns[1]);
+  printf("%-12s %16.0f %16.0f %15.2fx\n","float",Single_ns[0],Single_ns[1],Double_ns[1]/Single_ns[1]);
+
+  // decimated covariance time update: CPU saved against the error it costs, the
+  // covariance compared after each GPS update
+  printf("%-12s %16s %16s %16s %16s %16s\n","decimation","with GPS, ns","CPU saved","covariance, rel","position, m","attitude, rad");
+  const int Decimations[] = {1,2,5,10,25,50};
+  double EveryFrame_ns = 0.0;
+  for (size_t i=0; i < sizeof(Decimations)/sizeof(Decimations[0]); i++) {
+    EKF15 *EveryFrame = new EKF15();
+    EKF15 *Decimated = new EKF15();
+    EveryFrame->set_structured_tu(true);
+    Decimated->set_structured_tu(true);
+    Decimated->set_tu_decimation(Decimations[i]);
+    StateErrors Errors = CompareFilters(Decimated,EveryFrame,Flight,true);
+    delete EveryFrame;
+    delete Decimated;
+    double Time_ns = TimeFilter<EKF15>(true,true,Flight,false,false,Decimations[i]);
+    if (i == 0) {
+      EveryFrame_ns = Time_ns;
+    }
+    double Position_m = std::max(Errors.Position_m[0],std::max(Errors.Position_m[1],Errors.Position_m[2]));
+    double Attitude_rad = std::max(Errors.Attitude_rad[0],std::max(Errors.Attitude_rad[1],Errors.Attitude_rad[2]));
+    printf("%-12d %16.0f %15.0f%% %16.2e %16.2e %16.2e\n",Decimations[i],Time_ns,100.0*(1.0 - Time_ns/EveryFrame_ns),
+      Errors.Covariance,Position_m,Attitude_rad);
+  }
+  return 0;
+}
@@ -0,0 +1,175 @@
+#include "bench.hxx"
+#include "imu-integrator.hxx"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <Eigen/StdVector>
+
+/* One IMU sample of generated motion, with the true attitude and velocity at its time */
+struct ImuSample {
+  uint64_t Time_us;
+  Eigen::Vector3d Gyro_rads;
+  Eigen::Vector3d Accel_mss;
+  Eigen::Quaterniond Attitude;              // body to nav
+  Eigen::Vector3d Velocity_ms;              // nav
+};
+typedef std::vector<ImuSample,Eigen::aligned_allocator<ImuSample> > ImuSamples;
+
+static const double ConeRate_rads = 2.0*M_PI*5.0;
+static const double ConeAmplitude_rads = 1.0;
+static const double YawRate_rads = 0.3;
+static const double ScullRate_rads = 2.0*M_PI*5.0;
+static const double ScullAmplitude_mss = 10.0;
+
+/* Body rates of a coning motion, the rate vector sweeping a circle in the x-y
+plane, plus a steady turn */
+static Eigen::Vector3d ConingRate(double Time_s) {
+  return Eigen::Vector3d(ConeAmplitude_rads*cos(ConeRate_rads*Time_s),ConeAmplitude_rads*sin(ConeRate_rads*Time_s),YawRate_rads);
+}
+
+/* Nav frame acceleration, rotating in the horizontal plane so that with the coning
+it gives a sculling specific force */
+static Eigen::Vector3d NavAccel(double Time_s) {
+  return Eigen::Vector3d(ScullAmplitude_mss*sin(ScullRate_rads*Time_s),ScullAmplitude_mss*cos(ScullRate_rads*Time_s),1.0);
+}
+
+/* The velocity that acceleration gives, from rest */
+static Eigen::Vector3d NavVelocity(double Time_s) {
+  double Scale = ScullAmplitude_mss/ScullRate_rads;
+  return Eigen::Vector3d(Scale*(1.0 - cos(ScullRate_rads*Time_s)),Scale*sin(ScullRate_rads*Time_s),Time_s);
+}
+
+/* Rotation by the rotation vector Phi */
+static Eigen::Quaterniond RotationVector(const Eigen::Vector3d &Phi) {
+  double Angle = Phi.norm();
+  if (Angle < 1e-12) {
+    return Eigen::Quaterniond(1.0,0.5*Phi(0),0.5*Phi(1),0.5*Phi(2)).normalized();
+  }
+  return Eigen::Quaterniond(Eigen::AngleAxisd(Angle,Phi/Angle));
+}
+
+/* Samples the motion at ImuRate_hz for Duration_s, the attitude integrated
+alongside at 100 kHz by the midpoint rule so it is exact to well below the errors
+being measured. */
+static ImuSamples BuildMotion(double ImuRate_hz,double Duration_s) {
+  const size_t TruthSteps = (size_t)(100000.0/ImuRate_hz + 0.5);
+  const double Dt_s = 1.0/(ImuRate_hz*TruthSteps);
+  ImuSamples Motion((size_t)(Duration_s*ImuRate_hz) + 1);
+  Eigen::Quaterniond Attitude = Eigen::Quaterniond::Identity();
+  for (size_t i=0; i < Motion.size(); i++) {
+    double Time_s = i/ImuRate_hz;
+    if (i > 0) {
+      for (size_t j=0; j < TruthSteps; j++) {
+        Attitude = (Attitude*RotationVector(ConingRate(Time_s - 1.0/ImuRate_hz + (j + 0.5)*Dt_s)*Dt_s)).normalized();
+      }
+    }
+    Motion[i].Time_us = (uint64_t)(Time_s*1e6 + 0.5);
+    Motion[i].Gyro_rads = ConingRate(Time_s);
+    Motion[i].Accel_mss = Attitude.conjugate()*NavAccel(Time_s);
+    Motion[i].Attitude = Attitude;
+    Motion[i].Velocity_ms = NavVelocity(Time_s);
+  }
+  return Motion;
+}
+
+/* Largest and final attitude and velocity errors of a strapdown run */
+struct StrapdownErrors {
+  double MaxAttitude_rad;
+  double FinalAttitude_rad;
+  double MaxVelocity_ms;
+  double FinalVelocity_ms;
+  size_t Steps;
+};
+
+/* Charges the error against the truth at Sample to Errors. */
+static void AddError(const ImuSample &Sample,const Eigen::Quaterniond &Attitude,const Eigen::Vector3d &Velocity_ms,StrapdownErrors *ErrorsPtr) {
+  Eigen::Quaterniond Error = Sample.Attitude.conjugate()*Attitude;
+  double Attitude_rad = 2.0*asin(std::min(1.0,Error.vec().norm()));
+  double VelocityError_ms = (Velocity_ms - Sample.Velocity_ms).norm();
+  ErrorsPtr->MaxAttitude_rad = std::max(ErrorsPtr->MaxAttitude_rad,Attitude_rad);
+  ErrorsPtr->MaxVelocity_ms = std::max(ErrorsPtr->MaxVelocity_ms,VelocityError_ms);
+  ErrorsPtr->FinalAttitude_rad = Attitude_rad;
+  ErrorsPtr->FinalVelocity_ms = VelocityError_ms;
+  ErrorsPtr->Steps++;
+}
+
+/* Runs the strapdown at the filter rate on the motion, every Divisor samples, with
+DropFraction of the samples lost at random. Pre-integrated, the filter takes the
+increments of every sample it got since it last ran, otherwise it takes only the
+latest sample and holds it over the interval, as the navigation filter used to. */
+static StrapdownErrors RunStrapdown(const ImuSamples &Motion,size_t Divisor,double DropFraction,bool Preintegrated) {
+  XorShift Random(11);
+  StrapdownErrors Errors = {0.0,0.0,0.0,0.0,0};
+  ImuIntegrator Integrator;
+  ImuIncrement Increment;
+  Eigen::Quaterniond Attitude = Motion[0].Attitude;
+  Eigen::Vector3d Velocity_ms = Motion[0].Velocity_ms;
+  Integrator.AddSample(Motion[0].Time_us,Motion[0].Gyro_rads,Motion[0].Accel_mss);
+  size_t Last = 0;
+  for (size_t i=1; i < Motion.size(); i++) {
+    if (Random.Uniform(0.0,1.0) < DropFraction) {
+      continue;
+    }
+    Integrator.AddSample(Motion[i].Time_us,Motion[i].Gyro_rads,Motion[i].Accel_mss);
+    if ((i/Divisor) == (Last/Divisor)) {
+      continue;
+    }
+    if (Preintegrated) {
+      Integrator.GetIncrement(&Increment);
+      Velocity_ms += Attitude*Increment.DeltaVelocity_ms;
+      Attitude = (Attitude*RotationVector(Increment.DeltaAngle_rad)).normalized();
+    } else {
+      double Dt_s = (Motion[i].Time_us - Motion[Last].Time_us)*1e-6;
+      Velocity_ms += Attitude*Motion[i].Accel_mss*Dt_s;
+      Attitude = (Attitude*RotationVector(Motion[i].Gyro_rads*Dt_s)).normalized();
+    }
+    AddError(Motion[i],Attitude,Velocity_ms,&Errors);
+    Last = i;
+  }
+  return Errors;
+}
+
+/* Generates coning and sculling motion sampled at the IMU rate and runs a strapdown
+on it at the filter rate, holding one sample over each interval against taking the
+pre-integrated increments, with and without dropped samples; then times adding a
+sample to the integrator. */
+int ImuBenchmark(int argc, char* argv[]) {
+  double ImuRate_hz = (argc > 0) ? atof(argv[0]) : 1000.0;
+  double FilterRate_hz = (argc > 1) ? atof(argv[1]) : 100.0;
+  const double Duration_s = 60.0;
+  size_t Divisor = (size_t)(ImuRate_hz/FilterRate_hz + 0.5);
+  if ((ImuRate_hz <= 0.0)||(ImuRate_hz > 100000.0)||(Divisor < 1)) {
+    std::cerr << "Usage: output imu [imu_hz] [filter_hz], the IMU rate up to 100 kHz and at least the filter rate" << std::endl;
+    return -1;
+  }
+  ImuSamples Motion = BuildMotion(ImuRate_hz,Duration_s);
+  printf("%.0f Hz IMU, filter every %zu samples, %.0f s of coning at %.1f rad/s and sculling at %.1f m/s/s\n",
+    ImuRate_hz,Divisor,Duration_s,ConeAmplitude_rads,ScullAmplitude_mss);
+  printf("%-24s %16s %16s %16s %16s\n","","attitude, rad","final, rad","velocity, m/s","final, m/s");
+  const char *Names[] = {"latest sample","pre-integrated"};
+  const double Drops[] = {0.0,0.1};
+  for (size_t Drop=0; Drop < 2; Drop++) {
+    for (size_t Mode=0; Mode < 2; Mode++) {
+      StrapdownErrors Errors = RunStrapdown(Motion,Divisor,Drops[Drop],Mode == 1);
+      char Name[64];
+      snprintf(Name,sizeof(Name),"%s%s",Names[Mode],(Drop == 0) ? "" : ", 10% lost");
+      printf("%-24s %16.2e %16.2e %16.2e %16.2e\n",Name,Errors.MaxAttitude_rad,Errors.FinalAttitude_rad,Errors.MaxVelocity_ms,Errors.FinalVelocity_ms);
+    }
+  }
+
+  ImuIntegrator Integrator;
+  ImuIncrement Increment;
+  uint64_t Start_ns = CpuTime_ns();
+  for (size_t i=0; i < Motion.size(); i++) {
+    Integrator.AddSample(Motion[i].Time_us,Motion[i].Gyro_rads,Motion[i].Accel_mss);
+    if ((i % Divisor) == 0) {
+      Integrator.GetIncrement(&Increment);
+    }
+  }
+  double Sample_ns = (double)(CpuTime_ns() - Start_ns)/Motion.size();
+  printf("%-24s %16.0f\n","ns/sample",Sample_ns);
+  return 0;
+}
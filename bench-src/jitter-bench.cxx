@@ -0,0 +1,129 @@
+
+#include "bench.hxx"
+#include "loop-stats.hxx"
+#include "realtime.hxx"
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <iostream>
+#include <vector>
+
+/* Scratch each frame allocates and fills, over the default mmap threshold, so it
+stands in for the loop growing the heap and faulting the pages in */
+static const size_t FrameScratch = 256*1024;
+
+/* Forks Processes that compete with the loop for the CPU, each spinning and
+faulting in fresh memory. They run time-shared whatever the loop runs under, a
+fork inherits SCHED_FIFO and would otherwise starve the loop it is loading. */
+static std::vector<pid_t> StartLoad(size_t Processes) {
+  std::vector<pid_t> Pids;
+  for (size_t i=0; i < Processes; i++) {
+    pid_t Pid = fork();
+    if (Pid == 0) {
+      struct sched_param Param;
+      memset(&Param,0,sizeof(Param));
+      sched_setscheduler(0,SCHED_OTHER,&Param);
+      while (true) {
+        std::vector<uint8_t> Churn(4*1024*1024);
+        for (size_t j=0; j < Churn.size(); j+=4096) {
+          Churn[j] = (uint8_t)j;
+        }
+      }
+    }
+    Pids.push_back(Pid);
+  }
+  return Pids;
+}
+
+/* Stops the load processes. */
+static void StopLoad(const std::vector<pid_t> &Pids) {
+  for (size_t i=0; i < Pids.size(); i++) {
+    kill(Pids[i],SIGKILL);
+    waitpid(Pids[i],NULL,0);
+  }
+}
+
+/* Prints one histogram, us. */
+static void PrintHistogram(const char *Name, const LatencyHistogram &Histogram) {
+  printf("  %-14s p50: %7llu  p99: %7llu  p99.9: %7llu  max: %7llu us\n",Name,
+    (unsigned long long)Histogram.GetPercentile(50.0),(unsigned long long)Histogram.GetPercentile(99.0),
+    (unsigned long long)Histogram.GetPercentile(99.9),(unsigned long long)Histogram.GetMax());
+}
+
+/* Runs a periodic loop at Rate_hz for Frames frames, sleeping to an absolute deadline
+each frame as the flight loop waits on the FMU, and records how late it woke, how far
+each period strayed from nominal and how long the frame's work took. */
+static void RunJitter(size_t Frames, double Rate_hz, size_t LoadProcesses) {
+  LatencyHistogram Wake;
+  LatencyHistogram Jitter;
+  LatencyHistogram Work;
+  uint64_t Overruns = 0;
+  std::vector<pid_t> Load = StartLoad(LoadProcesses);
+  uint64_t Period_ns = (uint64_t)(1e9/Rate_hz);
+  uint64_t Next_ns = WallTime_ns() + Period_ns;
+  uint64_t LastWake_ns = 0;
+  for (size_t i=0; i < Frames; i++) {
+    struct timespec Deadline = {(time_t)(Next_ns/1000000000ULL),(long)(Next_ns%1000000000ULL)};
+    while (clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&Deadline,NULL) == EINTR) {}
+    uint64_t Wake_ns = WallTime_ns();
+    Wake.Record((Wake_ns - Next_ns)/1000);
+    if (LastWake_ns > 0) {
+      uint64_t Period = Wake_ns - LastWake_ns;
+      Jitter.Record(((Period > Period_ns) ? Period - Period_ns : Period_ns - Period)/1000);
+    }
+    LastWake_ns = Wake_ns;
+    {
+      std::vector<uint8_t> Scratch(FrameScratch);
+      for (size_t j=0; j < Scratch.size(); j+=64) {
+        Scratch[j] = (uint8_t)i;
+      }
+    }
+    uint64_t Done_ns = WallTime_ns();
+    Work.Record((Done_ns - Wake_ns)/1000);
+    Next_ns += Period_ns;
+    if (Done_ns > Next_ns) {
+      // a frame late, skip to the next deadline still ahead as the FMU would
+      Overruns++;
+      Next_ns += ((Done_ns - Next_ns)/Period_ns + 1)*Period_ns;
+    }
+  }
+  StopLoad(Load);
+  PrintHistogram("wake latency",Wake);
+  PrintHistogram("period jitter",Jitter);
+  PrintHistogram("frame work",Work);
+  printf("  overruns: %llu of %zu frames\n",(unsigned long long)Overruns,Frames);
+  fflush(stdout);
+}
+
+int JitterBenchmark(int argc, char* argv[]) {
+  size_t Frames = (argc > 0) ? strtoul(argv[0],NULL,10) : 5000;
+  double Rate_hz = (argc > 1) ? atof(argv[1]) : 500.0;
+  size_t LoadProcesses = (argc > 2) ? strtoul(argv[2],NULL,10) : 2;
+  RealTimeConfig RealTime = {true,80,0,256,8192};
+  if (argc > 3) {
+    RealTime.Priority = atoi(argv[3]);
+  }
+  if (argc > 4) {
+    RealTime.Cpu = atoi(argv[4]);
+  }
+  if (Rate_hz <= 1.0) {
+    std::cerr << "ERROR: The rate must be over 1 Hz." << std::endl;
+    return -1;
+  }
+  printf("Frames: %zu at %.1f Hz, %zu load processes, %zu kB scratch per frame\n",Frames,Rate_hz,LoadProcesses,FrameScratch/1024);
+  printf("time-shared\n");
+  fflush(stdout);
+  RunJitter(Frames,Rate_hz,LoadProcesses);
+  printf("real-time mode, SCHED_FIFO priority %d, CPU %d\n",RealTime.Priority,RealTime.Cpu);
+  fflush(stdout);
+  try {
+    EnterRealTime(RealTime);
+  } catch (std::exception &Error) {
+    printf("  skipped, %s\n",Error.what());
+    return 0;
+  }
+  RunJitter(Frames,Rate_hz,LoadProcesses);
+  return 0;
+}
@@ -0,0 +1,73 @@
+
+#ifndef LEGACY_PARSER_HXX_
+#define LEGACY_PARSER_HXX_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* The BFS Bus parser as it was before BfsCodec, kept as a baseline for the
+benchmarks: one byte per call, and everything since the header is dropped when
+a message fails. */
+class LegacyBfsParser {
+  public:
+    bool Parse(uint8_t Byte) {
+      if (State_ < 2) {
+        if (Byte == ((State_ == 0) ? 0x42 : 0x46)) {
+          Checksum_[0] += Byte;
+          Checksum_[1] += Checksum_[0];
+          State_++;
+        } else {
+          Reset();
+        }
+      } else if (State_ < 5) {
+        if (State_ == 3) {
+          Size_ = Byte;
+        } else if (State_ == 4) {
+          Size_ |= (size_t)Byte << 8;
+          if (Size_ > sizeof(Buffer_)) {
+            Reset();
+            return false;
+          }
+        }
+        Checksum_[0] += Byte;
+        Checksum_[1] += Checksum_[0];
+        State_++;
+      } else if (State_ < Size_ + 5) {
+        Buffer_[State_-5] = Byte;
+        Checksum_[0] += Byte;
+        Checksum_[1] += Checksum_[0];
+        State_++;
+      } else if (State_ == Size_ + 5) {
+        if (Byte == Checksum_[0]) {
+          State_++;
+        } else {
+          Reset();
+        }
+      } else {
+        bool Valid = (Byte == Checksum_[1]);
+        PayloadSize_ = Size_;
+        Reset();
+        return Valid;
+      }
+      return false;
+    }
+    const uint8_t *GetPayload() {
+      return Buffer_;
+    }
+    size_t GetPayloadSize() {
+      return PayloadSize_;
+    }
+  private:
+    size_t State_ = 0;
+    size_t Size_ = 0;
+    size_t PayloadSize_ = 0;
+    uint8_t Checksum_[2] = {0,0};
+    uint8_t Buffer_[4096];
+    void Reset() {
+      State_ = 0;
+      Checksum_[0] = 0;
+      Checksum_[1] = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,80 @@
+/*
+main.cxx
+Brian R Taylor
+brian.taylor@bolderflight.com
+2017-04-18
+Copyright (c) 2017 Bolder Flight Systems
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING 
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "bench.hxx"
+#include <iostream>
+#include <string>
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    std::cerr << "ERROR: Incorrect number of input arguments." << std::endl;
+    std::cerr << "Usage: output <benchmark> [arguments]" << std::endl;
+    std::cerr << "  rx [frames] [rate_hz]    FMU receive path, byte loop vs bulk read vs poll" << std::endl;
+    std::cerr << "  codec [frames] [max_size] BFS parser throughput" << std::endl;
+    std::cerr << "  fuzz [frames] [corruptions] [seed]  BFS parser resync over a corrupted stream" << std::endl;
+    std::cerr << "  wire <config> [baud]     data frame size and maximum frame rate for each encoding" << std::endl;
+    std::cerr << "  tx [frames] [bulk_bytes] [bulk_messages] [rate_hz] [baud]  effector command latency behind bulk traffic" << std::endl;
+    std::cerr << "  jitter [frames] [rate_hz] [load] [priority] [cpu]  frame period jitter, time-shared vs real-time mode" << std::endl;
+    std::cerr << "  control [steps]          compiled control law step time for representative laws" << std::endl;
+    std::cerr << "  alloc <config> <datalog> [frames]  fails if the flight loop allocates after startup" << std::endl;
+    std::cerr << "  sched <config> <datalog> [repeat]  fails if tasks stall when the FMU time starts over" << std::endl;
+    std::cerr << "  ekf [steps]              EKF15 accuracy and update time: structured vs dense time update, sequential vs batch GPS update, float vs double, decimated time update" << std::endl;
+    std::cerr << "  ekf <config> <datalog>   the same on a recorded flight" << std::endl;
+    std::cerr << "  imu [imu_hz] [filter_hz] strapdown error with and without IMU pre-integration under coning and sculling" << std::endl;
+    return -1;
+  }
+  std::string Benchmark = argv[1];
+  if (Benchmark == "rx") {
+    return RxBenchmark(argc-2,argv+2);
+  }
+  if (Benchmark == "codec") {
+    return CodecBenchmark(argc-2,argv+2);
+  }
+  if (Benchmark == "fuzz") {
+    return FuzzBenchmark(argc-2,argv+2);
+  }
+  if (Benchmark == "wire") {
+    return WireBenchmark(argc-2,argv+2);
+  }
+  if (Benchmark == "tx") {
+    return TxBenchmark(argc-2,argv+2);
+  }
+  if (Benchmark == "jitter") {
+    return JitterBenchmark(argc-2,argv+2);
+  }
+  if (Benchmark == "control") {
+    return ControlBenchmark(argc-2,argv+2);
+  }
+  if (Benchmark == "alloc") {
+    return AllocBenchmark(argc-2,argv+2);
+  }
+  if (Benchmark == "sched") {
+    return SchedBenchmark(argc-2,argv+2);
+  }
+  if (Benchmark == "ekf") {
+    return EkfBenchmark(argc-2,argv+2);
+  }
+  if (Benchmark == "imu") {
+    return ImuBenchmark(argc-2,argv+2);
+  }
+  std::cerr << "ERROR: Unknown benchmark " << Benchmark << std::endl;
+  return -1;
+}
@@ -0,0 +1,164 @@
+
+#include "bench.hxx"
+#include "fmu.hxx"
+#include "legacy-parser.hxx"
+#include "global-defs.hxx"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <iostream>
+#include <vector>
+
+/* Size of a kData payload for an FMU with one GPS, one SBUS receiver, a pitot and both voltages */
+static const size_t RxPayloadSize = sizeof(uint64_t)+2*sizeof(Voltage)+sizeof(Mpu9250Data)+sizeof(Bme280Data)+sizeof(SbusRxData)+sizeof(GpsData)+sizeof(PitotData)+2*sizeof(Voltage);
+
+/* Builds a kData frame with a fixed payload. */
+static std::vector<uint8_t> BuildFrame(size_t PayloadSize) {
+  std::vector<uint8_t> Payload(PayloadSize);
+  for (size_t i=0; i < PayloadSize; i++) {
+    Payload[i] = (uint8_t) (i*7);
+  }
+  std::vector<uint8_t> Frame(PayloadSize + BfsCodec::Overhead);
+  BfsCodec::BuildMessage(kData,PayloadSize,Payload.data(),Frame.data());
+  return Frame;
+}
+
+/* Forks a process that writes frames into the pipe, paced at Rate_hz or as fast as possible when 0. */
+static pid_t StartWriter(int FileDesc, const std::vector<uint8_t> &Frame, size_t Frames, double Rate_hz) {
+  pid_t Pid = fork();
+  if (Pid != 0) {
+    return Pid;
+  }
+  struct timespec Next;
+  clock_gettime(CLOCK_MONOTONIC,&Next);
+  long Period_ns = (Rate_hz > 0) ? (long)(1e9/Rate_hz) : 0;
+  for (size_t i=0; i < Frames; i++) {
+    size_t Written = 0;
+    while (Written < Frame.size()) {
+      ssize_t count = write(FileDesc,Frame.data()+Written,Frame.size()-Written);
+      if (count > 0) {
+        Written += count;
+      }
+    }
+    if (Period_ns > 0) {
+      Next.tv_nsec += Period_ns;
+      while (Next.tv_nsec >= 1000000000L) {
+        Next.tv_nsec -= 1000000000L;
+        Next.tv_sec++;
+      }
+      clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&Next,NULL);
+    }
+  }
+  close(FileDesc);
+  _exit(0);
+}
+
+/* The original receive loop: one read per byte, one byte per parser call. */
+class ByteLoopReader {
+  public:
+    ByteLoopReader(int FileDesc) : FileDesc_(FileDesc) {}
+    bool ReadMessage() {
+      uint8_t Byte;
+      ReadCalls++;
+      if (read(FileDesc_,&Byte,1) > 0) {
+        return Parser_.Parse(Byte);
+      }
+      return false;
+    }
+    uint64_t ReadCalls = 0;
+  private:
+    int FileDesc_;
+    LegacyBfsParser Parser_;
+};
+
+struct RxResult {
+  uint64_t Frames;
+  uint64_t ReadCalls;
+  uint64_t Cpu_ns;
+  uint64_t Wall_ns;
+};
+
+/* Runs one receive method over a fresh pipe until all frames arrive or the link goes quiet. */
+template <typename Receive>
+static RxResult RunReceiver(const std::vector<uint8_t> &Frame, size_t Frames, double Rate_hz, Receive Method) {
+  int Pipe[2];
+  if (pipe(Pipe) < 0) {
+    throw std::runtime_error("Pipe failed to open.");
+  }
+  pid_t Writer = StartWriter(Pipe[1],Frame,Frames,Rate_hz);
+  close(Pipe[1]);
+  RxResult Result = {0,0,0,0};
+  Method(Pipe[0],Frames,&Result);
+  waitpid(Writer,NULL,0);
+  close(Pipe[0]);
+  return Result;
+}
+
+/* Receives through Fmu, spinning when Timeout_ms is 0 and sleeping in poll otherwise. */
+static void BulkReceive(int FileDesc, size_t Expected, int Timeout_ms, RxResult *ResultPtr) {
+  const uint64_t Quiet_ns = 1000000000ULL;
+  Fmu Link(FileDesc);
+  Link.SetReceiveTimeout(Timeout_ms);
+  BfsMessage MessageId;
+  uint16_t PayloadSize;
+  static uint8_t Payload[4096];
+  uint64_t Cpu0 = CpuTime_ns(), Wall0 = WallTime_ns(), LastFrame = Wall0;
+  while ((ResultPtr->Frames < Expected)&&(WallTime_ns() - LastFrame < Quiet_ns)) {
+    if (Link.ReadMessage(&MessageId,&PayloadSize,Payload)) {
+      ResultPtr->Frames++;
+      LastFrame = WallTime_ns();
+    }
+  }
+  ResultPtr->Cpu_ns = CpuTime_ns() - Cpu0;
+  ResultPtr->Wall_ns = LastFrame - Wall0;
+  ResultPtr->ReadCalls = Link.GetLinkStats().ReadCalls;
+}
+
+static void PrintResult(const char *Name, const RxResult &Result, size_t FrameSize) {
+  double Frames = (Result.Frames > 0) ? (double)Result.Frames : 1.0;
+  printf("%-12s frames: %8llu  reads/frame: %9.2f  cpu: %8.2f us/frame  wall: %7.3f s  %7.2f MB/s\n",
+    Name,(unsigned long long)Result.Frames,Result.ReadCalls/Frames,Result.Cpu_ns/Frames/1e3,Result.Wall_ns/1e9,
+    Result.Frames*FrameSize/(Result.Wall_ns/1e9)/1e6);
+}
+
+int RxBenchmark(int argc, char* argv[]) {
+  size_t Frames = (argc > 0) ? strtoul(argv[0],NULL,10) : 20000;
+  double Rate_hz = (argc > 1) ? atof(argv[1]) : 0.0;
+  const uint64_t Quiet_ns = 1000000000ULL;
+  std::vector<uint8_t> Frame = BuildFrame(RxPayloadSize);
+
+  std::cout << "Frame size: " << Frame.size() << " bytes, frames: " << Frames << ", rate: ";
+  if (Rate_hz > 0) {
+    std::cout << Rate_hz << " Hz" << std::endl;
+  } else {
+    std::cout << "unpaced" << std::endl;
+  }
+
+  RxResult ByteLoop = RunReceiver(Frame,Frames,Rate_hz,[&](int FileDesc, size_t Expected, RxResult *ResultPtr) {
+    fcntl(FileDesc,F_SETFL,O_NONBLOCK);
+    ByteLoopReader Reader(FileDesc);
+    uint64_t Cpu0 = CpuTime_ns(), Wall0 = WallTime_ns(), LastFrame = Wall0;
+    while ((ResultPtr->Frames < Expected)&&(WallTime_ns() - LastFrame < Quiet_ns)) {
+      if (Reader.ReadMessage()) {
+        ResultPtr->Frames++;
+        LastFrame = WallTime_ns();
+      }
+    }
+    ResultPtr->Cpu_ns = CpuTime_ns() - Cpu0;
+    ResultPtr->Wall_ns = LastFrame - Wall0;
+    ResultPtr->ReadCalls = Reader.ReadCalls;
+  });
+
+  RxResult BulkRead = RunReceiver(Frame,Frames,Rate_hz,[&](int FileDesc, size_t Expected, RxResult *ResultPtr) {
+    BulkReceive(FileDesc,Expected,0,ResultPtr);
+  });
+
+  RxResult BulkPoll = RunReceiver(Frame,Frames,Rate_hz,[&](int FileDesc, size_t Expected, RxResult *ResultPtr) {
+    BulkReceive(FileDesc,Expected,(int)(Quiet_ns/1000000),ResultPtr);
+  });
+
+  PrintResult("byte loop",ByteLoop,Frame.size());
+  PrintResult("bulk read",BulkRead,Frame.size());
+  PrintResult("bulk+poll",BulkPoll,Frame.size());
+  return 0;
+}
@@ -0,0 +1,90 @@
+#include "bench.hxx"
+#include "config.hxx"
+#include "fmu.hxx"
+#include "data-layout.hxx"
+#include "scheduler.hxx"
+#include "global-defs.hxx"
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <iostream>
+#include <vector>
+
+/* Releases each configured task gets over Passes plays of the FMU times, the FMU
+time starting over at the beginning of each play as it does after an FMU reset or
+an fmu-sim replay repeated. Deadlines are dropped, so nothing depends on how long
+the tasks take. */
+static std::vector<TaskStats> ReleaseTasks(const std::vector<TaskConfig> &TasksRef,const std::vector<uint64_t> &TimesRef,size_t Passes) {
+  FrameScheduler Scheduler;
+  for (size_t i=0; i < TasksRef.size(); i++) {
+    TaskConfig Task = TasksRef[i];
+    Task.Deadline_us = 0;
+    Scheduler.AddTask(Task,[]() {});
+  }
+  for (size_t Pass=0; Pass < Passes; Pass++) {
+    for (size_t i=0; i < TimesRef.size(); i++) {
+      Scheduler.RunTasks(TimesRef[i],0);
+      Scheduler.RunSlackTasks();
+    }
+  }
+  std::vector<TaskStats> Stats;
+  Scheduler.GetStats(&Stats);
+  return Stats;
+}
+
+/* Plays the FMU times of a datalog through the frame scheduler once, and then
+Repeat times over with the time going back to the start of the log each time, and
+fails unless every task is released Repeat times as often: a task waiting for FMU
+time to pass where it was before the restart would stall for the whole log. */
+int SchedBenchmark(int argc, char* argv[]) {
+  if (argc < 2) {
+    std::cerr << "Usage: output sched <config> <datalog> [repeat]" << std::endl;
+    return -1;
+  }
+  size_t Repeat = (argc > 2) ? strtoul(argv[2],NULL,10) : 3;
+  Repeat = (Repeat > 1) ? Repeat : 2;
+  int NullDesc = open("/dev/null",O_RDWR);
+  if (NullDesc < 0) {
+    std::cerr << "ERROR: Could not open /dev/null." << std::endl;
+    return -1;
+  }
+  Fmu Null(NullDesc);
+  AircraftConfig Config = {0};
+  FmuData Data;
+  FmuDataLayout Layout;
+  LoadConfigFile(argv[0],Null,&Config,&Data,&Layout);
+
+  FILE *LogFile = fopen(argv[1],"rb");
+  if (LogFile == NULL) {
+    std::cerr << "ERROR: Could not open " << argv[1] << std::endl;
+    return -1;
+  }
+  std::vector<uint8_t> Payload(Layout.PayloadSize);
+  std::vector<uint64_t> Times;
+  while (fread(Payload.data(),Layout.PayloadSize,1,LogFile) == 1) {
+    Times.push_back(FmuDataView(Layout,Payload.data()).Time_us());
+  }
+  fclose(LogFile);
+  if (Times.empty()) {
+    std::cerr << "ERROR: " << argv[1] << " holds no complete records." << std::endl;
+    return -1;
+  }
+
+  std::vector<TaskStats> Once = ReleaseTasks(Config.Tasks,Times,1);
+  std::vector<TaskStats> Repeated = ReleaseTasks(Config.Tasks,Times,Repeat);
+  std::cout << Times.size() << " frames, " << (Times.back() - Times.front())/1e6 << " s of FMU time, played once and " << Repeat << " times" << std::endl;
+  printf("%-12s %10s %10s %10s\n","task","once","repeated","expected");
+  bool Pass = true;
+  for (size_t i=0; i < Config.Tasks.size(); i++) {
+    uint64_t Expected = Repeat*Once[i].Releases;
+    printf("%-12s %10llu %10llu %10llu\n",Config.Tasks[i].Name.c_str(),(unsigned long long)Once[i].Releases,
+      (unsigned long long)Repeated[i].Releases,(unsigned long long)Expected);
+    Pass = Pass && (Repeated[i].Releases == Expected);
+  }
+  if (!Pass) {
+    std::cout << "FAIL: tasks stalled when the FMU time started over" << std::endl;
+    return 1;
+  }
+  std::cout << "PASS: every task released as often on each play" << std::endl;
+  return 0;
+}
@@ -0,0 +1,162 @@
+
+#include "bench.hxx"
+#include "fmu.hxx"
+#include "global-defs.hxx"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+/* Kernel buffering between the SOC and the wire, about what the tty layer holds */
+static const int TxSocketBuffer = 4096;
+
+/* Forks a process standing in for the FMU end of a UART at Baud: it takes bytes off
+the socket no faster than the wire would carry them and, for every effector command,
+prints how long after it was issued its last byte crossed the wire. The command time
+is carried in its payload. */
+static pid_t StartWire(int FileDesc, int OtherDesc, double Baud) {
+  pid_t Pid = fork();
+  if (Pid != 0) {
+    return Pid;
+  }
+  close(OtherDesc);
+  fcntl(FileDesc,F_SETFL,O_NONBLOCK);
+  const double Byte_ns = 10.0*1e9/Baud;
+  BfsCodec Parser;
+  std::vector<uint64_t> Latency_ns;
+  uint64_t Messages = 0;
+  double Wire_ns = WallTime_ns();
+  uint8_t Buffer[16];
+  while (true) {
+    ssize_t count = read(FileDesc,Buffer,sizeof(Buffer));
+    if ((count < 0)&&(errno == EAGAIN)) {
+      // the wire has gone idle, it restarts when the next byte arrives
+      struct pollfd Fds = {FileDesc,POLLIN,0};
+      poll(&Fds,1,-1);
+      Wire_ns = std::max(Wire_ns,(double)WallTime_ns());
+      continue;
+    }
+    if (count <= 0) {
+      break;
+    }
+    for (ssize_t i=0; i < count; i++) {
+      Wire_ns += Byte_ns;
+      if (Parser.Parse(Buffer[i])) {
+        Messages++;
+        if (Parser.GetMessageId() == kEffectorAngleCmd) {
+          uint64_t Issued_ns;
+          memcpy(&Issued_ns,Parser.GetPayload(),sizeof(Issued_ns));
+          Latency_ns.push_back((uint64_t)Wire_ns - Issued_ns);
+        }
+      }
+    }
+    struct timespec Next;
+    Next.tv_sec = (time_t)(Wire_ns/1e9);
+    Next.tv_nsec = (long)(Wire_ns - Next.tv_sec*1e9);
+    clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&Next,NULL);
+  }
+  std::sort(Latency_ns.begin(),Latency_ns.end());
+  double Sum_ns = 0;
+  for (size_t i=0; i < Latency_ns.size(); i++) {
+    Sum_ns += Latency_ns[i];
+  }
+  size_t Count = Latency_ns.size() > 0 ? Latency_ns.size() : 1;
+  printf("  wire: messages: %6llu  checksum errors: %llu  commands: %6zu  latency mean: %8.2f ms  p99: %8.2f ms  max: %8.2f ms\n",
+    (unsigned long long)Messages,(unsigned long long)Parser.GetStats().ChecksumErrors,Latency_ns.size(),
+    Sum_ns/Count/1e6,Latency_ns.size() > 0 ? Latency_ns[(Latency_ns.size()-1)*99/100]/1e6 : 0.0,
+    Latency_ns.size() > 0 ? Latency_ns.back()/1e6 : 0.0);
+  fflush(stdout);
+  _exit(0);
+}
+
+/* Runs the frame loop: each period issues a burst of bulk messages and then an effector
+command, either with blocking writes in call order or through the transmit queue. */
+static void RunTx(bool Queued, size_t BulkLimit, size_t Frames, size_t BulkSize, size_t BulkMessages, double Rate_hz, double Baud) {
+  int Pair[2];
+  if (socketpair(AF_UNIX,SOCK_STREAM,0,Pair) < 0) {
+    throw std::runtime_error("Socket pair failed to open.");
+  }
+  setsockopt(Pair[0],SOL_SOCKET,SO_SNDBUF,&TxSocketBuffer,sizeof(TxSocketBuffer));
+  setsockopt(Pair[1],SOL_SOCKET,SO_RCVBUF,&TxSocketBuffer,sizeof(TxSocketBuffer));
+  pid_t Wire = StartWire(Pair[1],Pair[0],Baud);
+  close(Pair[1]);
+  {
+    Fmu Link(Pair[0]);
+    Link.SetTxBulkLimit(BulkLimit);
+    std::vector<uint8_t> Bulk(BulkSize,0x55);
+    std::vector<uint8_t> Command(8*sizeof(float),0);
+    uint64_t Period_ns = (uint64_t)(1e9/Rate_hz);
+    uint64_t Next_ns = WallTime_ns();
+    uint64_t Dropped = 0;
+    BfsMessage MessageId;
+    uint16_t PayloadSize;
+    static uint8_t Payload[BfsCodec::MaxPayloadSize];
+    for (size_t i=0; i < Frames; i++) {
+      uint64_t Issued_ns = WallTime_ns();
+      memcpy(Command.data(),&Issued_ns,sizeof(Issued_ns));
+      if (Queued) {
+        for (size_t j=0; j < BulkMessages; j++) {
+          Dropped += Link.QueueMessage(kConfig,Bulk.size(),Bulk.data()) ? 0 : 1;
+        }
+        Link.QueueMessage(kEffectorAngleCmd,Command.size(),Command.data());
+        // wait out the period for the FMU, which writes out the queue as the link drains
+        Next_ns += Period_ns;
+        uint64_t Now_ns;
+        while ((Now_ns=WallTime_ns()) < Next_ns) {
+          Link.SetReceiveTimeout((int)((Next_ns - Now_ns + 999999)/1000000));
+          Link.ReadMessage(&MessageId,&PayloadSize,Payload);
+        }
+      } else {
+        for (size_t j=0; j < BulkMessages; j++) {
+          Link.WriteMessage(kConfig,Bulk.size(),Bulk.data());
+        }
+        Link.WriteMessage(kEffectorAngleCmd,Command.size(),Command.data());
+        Next_ns += Period_ns;
+        uint64_t Now_ns = WallTime_ns();
+        if (Now_ns < Next_ns) {
+          struct timespec Sleep = {0,(long)(Next_ns - Now_ns)};
+          nanosleep(&Sleep,NULL);
+        }
+      }
+    }
+    while (!Link.FlushTx()) {
+      Link.SetReceiveTimeout(100);
+      Link.ReadMessage(&MessageId,&PayloadSize,Payload);
+    }
+    TxQueueStats Stats = Link.GetTxStats();
+    printf("  soc:  frames: %6llu  writes: %6llu  partial: %5llu  coalesced: %5llu  bulk dropped: %5llu  queue to kernel mean: %8.2f ms  max: %8.2f ms\n",
+      (unsigned long long)Stats.Frames,(unsigned long long)Stats.WriteCalls,(unsigned long long)Stats.PartialWrites,
+      (unsigned long long)Stats.Coalesced,(unsigned long long)Dropped,
+      Stats.Commands > 0 ? Stats.CommandLatencySum_us/1e3/Stats.Commands : 0.0,Stats.CommandLatencyMax_us/1e3);
+    fflush(stdout);
+  }
+  waitpid(Wire,NULL,0);
+}
+
+int TxBenchmark(int argc, char* argv[]) {
+  size_t Frames = (argc > 0) ? strtoul(argv[0],NULL,10) : 500;
+  size_t BulkSize = (argc > 1) ? strtoul(argv[1],NULL,10) : 256;
+  size_t BulkMessages = (argc > 2) ? strtoul(argv[2],NULL,10) : 8;
+  double Rate_hz = (argc > 3) ? atof(argv[3]) : 50.0;
+  double Baud = (argc > 4) ? atof(argv[4]) : 1500000.0;
+  if ((BulkSize > BfsCodec::MaxPayloadSize)||(BulkMessages > TxQueue::BulkDepth)||(Rate_hz <= 1.0)) {
+    std::cerr << "ERROR: Bulk messages are limited to " << BfsCodec::MaxPayloadSize << " bytes, " << TxQueue::BulkDepth
+      << " per frame, and the rate must be over 1 Hz." << std::endl;
+    return -1;
+  }
+  printf("Frames: %zu, bulk: %zu x %zu bytes at %.1f Hz (%.0f%% of a %.0f baud link)\n",Frames,BulkMessages,BulkSize,Rate_hz,
+    100.0*BulkMessages*(BulkSize + BfsCodec::Overhead)*Rate_hz*10.0/Baud,Baud);
+  printf("blocking writes, in call order\n");
+  fflush(stdout);
+  RunTx(false,0,Frames,BulkSize,BulkMessages,Rate_hz,Baud);
+  printf("transmit queue, commands first, no bulk limit\n");
+  fflush(stdout);
+  RunTx(true,0,Frames,BulkSize,BulkMessages,Rate_hz,Baud);
+  printf("transmit queue, commands first, bulk limit %zu bytes\n",TxQueue::DefaultBulkLimit);
+  fflush(stdout);
+  RunTx(true,TxQueue::DefaultBulkLimit,Frames,BulkSize,BulkMessages,Rate_hz,Baud);
+  return 0;
+}
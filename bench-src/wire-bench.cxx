@@ -0,0 +1,252 @@
+
+#include "bench.hxx"
+#include "config.hxx"
+#include "data-layout.hxx"
+#include "global-defs.hxx"
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <math.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+/* Fills every sensor with values spread over its measurement range. */
+static void FillFmuData(XorShift *Random, FmuData *FmuDataPtr) {
+  FmuDataPtr->Time_us = Random->Next();
+  FmuDataPtr->InputVoltage.Voltage_V = Random->Uniform(4,16);
+  FmuDataPtr->RegulatedVoltage.Voltage_V = Random->Uniform(4.8,5.2);
+  std::vector<Mpu9250Data*> Mpu9250(1,&FmuDataPtr->Mpu9250);
+  for (size_t i=0; i < FmuDataPtr->Mpu9250Ext.size(); i++) {
+    Mpu9250.push_back(&FmuDataPtr->Mpu9250Ext[i]);
+  }
+  for (size_t i=0; i < Mpu9250.size(); i++) {
+    for (size_t j=0; j < 3; j++) {
+      Mpu9250[i]->Accel_mss(j,0) = Random->Uniform(-156,156);
+      Mpu9250[i]->Gyro_rads(j,0) = Random->Uniform(-34,34);
+      Mpu9250[i]->Mag_uT(j,0) = Random->Uniform(-4900,4900);
+    }
+    Mpu9250[i]->Temp_C = Random->Uniform(-40,85);
+  }
+  std::vector<Bme280Data*> Bme280(1,&FmuDataPtr->Bme280);
+  for (size_t i=0; i < FmuDataPtr->Bme280Ext.size(); i++) {
+    Bme280.push_back(&FmuDataPtr->Bme280Ext[i]);
+  }
+  for (size_t i=0; i < Bme280.size(); i++) {
+    Bme280[i]->Pressure_Pa = Random->Uniform(30000,110000);
+    Bme280[i]->Temp_C = Random->Uniform(-40,85);
+    Bme280[i]->Humidity_RH = Random->Uniform(0,100);
+  }
+  for (size_t i=0; i < FmuDataPtr->SbusRx.size(); i++) {
+    SbusRxData &Sbus = FmuDataPtr->SbusRx[i];
+    Sbus.Failsafe = Random->Next() & 1;
+    Sbus.LostFrames = Random->Next();
+    Sbus.AutoEnabled = Random->Next() & 1;
+    Sbus.ThrottleEnabled = Random->Next() & 1;
+    Sbus.RSSI = Random->Uniform(0,1);
+    for (size_t j=0; j < 5; j++) {
+      Sbus.Inceptors(j,0) = Random->Uniform(-1,1);
+      Sbus.AuxInputs(j,0) = Random->Uniform(-1,1);
+    }
+  }
+  for (size_t i=0; i < FmuDataPtr->Gps.size(); i++) {
+    GpsData &Gps = FmuDataPtr->Gps[i];
+    Gps.Fix = Random->Next() & 1;
+    Gps.NumberSatellites = Random->Next() % 32;
+    Gps.TOW = Random->Next();
+    Gps.Year = 2017;
+    Gps.Month = 1 + Random->Next() % 12;
+    Gps.Day = 1 + Random->Next() % 28;
+    Gps.Hour = Random->Next() % 24;
+    Gps.Min = Random->Next() % 60;
+    Gps.Sec = Random->Next() % 60;
+    Gps.LLA(0,0) = Random->Uniform(-M_PI/2,M_PI/2);
+    Gps.LLA(1,0) = Random->Uniform(-M_PI,M_PI);
+    Gps.LLA(2,0) = Random->Uniform(-100,10000);
+    for (size_t j=0; j < 3; j++) {
+      Gps.NEDVelocity_ms(j,0) = Random->Uniform(-100,100);
+      Gps.Accuracy(j,0) = Random->Uniform(0,50);
+    }
+    Gps.pDOP = Random->Uniform(0,20);
+  }
+  for (size_t i=0; i < FmuDataPtr->Pitot.size(); i++) {
+    FmuDataPtr->Pitot[i].Static.Pressure_Pa = Random->Uniform(30000,110000);
+    FmuDataPtr->Pitot[i].Static.Temp_C = Random->Uniform(-40,85);
+    FmuDataPtr->Pitot[i].Diff.Pressure_Pa = Random->Uniform(-500,7000);
+    FmuDataPtr->Pitot[i].Diff.Temp_C = Random->Uniform(-40,85);
+  }
+  for (size_t i=0; i < FmuDataPtr->PressureTransducer.size(); i++) {
+    FmuDataPtr->PressureTransducer[i].Pressure_Pa = Random->Uniform(30000,110000);
+    FmuDataPtr->PressureTransducer[i].Temp_C = Random->Uniform(-40,85);
+  }
+  for (size_t i=0; i < FmuDataPtr->Analog.size(); i++) {
+    FmuDataPtr->Analog[i].Voltage_V = Random->Uniform(0,3.3);
+    FmuDataPtr->Analog[i].CalValue = Random->Uniform(-1000,1000);
+  }
+  for (size_t i=0; i < FmuDataPtr->SbusVoltage.size(); i++) {
+    FmuDataPtr->SbusVoltage[i].Voltage_V = Random->Uniform(4,8.4);
+  }
+  for (size_t i=0; i < FmuDataPtr->PwmVoltage.size(); i++) {
+    FmuDataPtr->PwmVoltage[i].Voltage_V = Random->Uniform(4,8.4);
+  }
+}
+
+/* Largest difference between the IMU measurements sent and those decoded */
+struct ImuError {
+  double Accel_mss;
+  double Gyro_rads;
+  double Mag_uT;
+};
+
+/* Widens Error to cover the differences between two MPU-9250 records. */
+static void AddImuError(const Mpu9250Data &Sent,const Mpu9250Data &Decoded,ImuError *ErrorPtr) {
+  for (size_t i=0; i < 3; i++) {
+    ErrorPtr->Accel_mss = std::max(ErrorPtr->Accel_mss,(double)fabs(Decoded.Accel_mss(i,0) - Sent.Accel_mss(i,0)));
+    ErrorPtr->Gyro_rads = std::max(ErrorPtr->Gyro_rads,(double)fabs(Decoded.Gyro_rads(i,0) - Sent.Gyro_rads(i,0)));
+    ErrorPtr->Mag_uT = std::max(ErrorPtr->Mag_uT,(double)fabs(Decoded.Mag_uT(i,0) - Sent.Mag_uT(i,0)));
+  }
+}
+
+/* Reports the data frame size and the highest frame rate the UART can carry for each
+encoding of the sensors in an aircraft configuration. Decoding is checked by encoding the
+decoded data again, which must reproduce the payload exactly. The IMU error each encoding
+makes is given against one LSB at the narrowest ranges, 2g and 250 deg/s, and of the
+16 bit magnetometer. */
+int WireBenchmark(int argc, char* argv[]) {
+  if (argc < 1) {
+    std::cerr << "ERROR: wire needs an aircraft configuration file." << std::endl;
+    return -1;
+  }
+  double Baud = (argc > 1) ? strtod(argv[1],NULL) : 1500000;
+  const size_t Frames = 10000;
+
+  // the configuration is only read, so the link goes nowhere
+  Fmu Null(open("/dev/null",O_RDWR));
+  AircraftConfig Config = {0};
+  FmuData Data;
+  FmuDataLayout ConfiguredLayout;
+  LoadConfigFile(argv[0],Null,&Config,&Data,&ConfiguredLayout);
+
+  std::cout << "Sensors: " << 1+Data.Mpu9250Ext.size() << " Mpu9250, " << 1+Data.Bme280Ext.size() << " Bme280, "
+    << Data.SbusRx.size() << " SbusRx, " << Data.Gps.size() << " Gps, " << Data.Pitot.size() << " Pitot, "
+    << Data.PressureTransducer.size() << " PressureTransducer, " << Data.Analog.size() << " Analog" << std::endl;
+  std::cout << "Configured encoding: " << GetDataEncodingName(ConfiguredLayout.Encoding) << ", " << Baud << " baud, 8N1" << std::endl;
+
+  XorShift Random(1);
+  std::vector<FmuData> Samples(Frames,Data);
+  for (size_t i=0; i < Frames; i++) {
+    FillFmuData(&Random,&Samples[i]);
+  }
+
+  DataEncoding Encodings[3] = {kRawEncoding,kPackedEncoding,kQuantizedEncoding};
+  for (size_t i=0; i < 3; i++) {
+    FmuDataLayout Layout = BuildDataLayout(Data,Encodings[i]);
+    std::vector<uint8_t> Payload(Layout.PayloadSize);
+    std::vector<uint8_t> Check(Layout.PayloadSize);
+    FmuData Decoded = Data;
+
+    uint64_t Start = CpuTime_ns();
+    for (size_t j=0; j < Frames; j++) {
+      EncodeFmuData(Samples[j],Layout,Payload.data());
+    }
+    uint64_t EncodeTime = CpuTime_ns() - Start;
+
+    uint64_t DecodeTime = 0;
+    size_t Mismatches = 0;
+    ImuError Error = {0.0,0.0,0.0};
+    for (size_t j=0; j < Frames; j++) {
+      EncodeFmuData(Samples[j],Layout,Payload.data());
+      Start = CpuTime_ns();
+      FmuDataView(Layout,Payload.data()).Decode(&Decoded);
+      DecodeTime += CpuTime_ns() - Start;
+      AddImuError(Samples[j].Mpu9250,Decoded.Mpu9250,&Error);
+      for (size_t k=0; k < Decoded.Mpu9250Ext.size(); k++) {
+        AddImuError(Samples[j].Mpu9250Ext[k],Decoded.Mpu9250Ext[k],&Error);
+      }
+      EncodeFmuData(Decoded,Layout,Check.data());
+      Mismatches += memcmp(Payload.data(),Check.data(),Payload.size()) != 0;
+    }
+
+    size_t FrameSize = Layout.PayloadSize + BfsCodec::Overhead;
+    double MaxRate_Hz = Baud/10.0/FrameSize;
+    printf("%-10s payload: %5zu bytes  frame: %5zu bytes  max rate: %7.1f Hz  encode: %6.1f ns  decode: %6.1f ns  round trip mismatches: %zu\n",
+      GetDataEncodingName(Encodings[i]),Layout.PayloadSize,FrameSize,MaxRate_Hz,
+      EncodeTime/(double)Frames,DecodeTime/(double)Frames,Mismatches);
+    printf("%-10s IMU error: accel %.2e m/s/s (%.2f LSB at 2g)  gyro %.2e rad/s (%.2f LSB at 250 deg/s)  mag %.2e uT (%.2f LSB)\n","",
+      Error.Accel_mss,Error.Accel_mss/(2.0*9.80665/32768.0),Error.Gyro_rads,Error.Gyro_rads/(250.0/32768.0*M_PI/180.0),
+      Error.Mag_uT,Error.Mag_uT/0.15);
+  }
+
+  // sparse frames in the configured encoding, with only the fast sensors updated
+  FmuDataLayout Layout = BuildDataLayout(Data,ConfiguredLayout.Encoding);
+  std::vector<uint8_t> Sparse(GetSparsePayloadSize(Layout));
+  std::vector<uint8_t> Merged(Layout.PayloadSize,0);
+  FmuDataLayout CheckLayout = BuildDataLayout(Data,(Layout.Encoding == kRawEncoding) ? kPackedEncoding : Layout.Encoding);
+  std::vector<uint8_t> Expected(CheckLayout.PayloadSize);
+  std::vector<uint8_t> Check(CheckLayout.PayloadSize);
+  std::vector<uint8_t> UpdateMask(Layout.UpdateMaskSize);
+  FmuData Decoded = Data;
+  size_t Mismatches = 0;
+  size_t SparseBytes = 0;
+  EncodeFmuData(Samples[0],Layout,Merged.data());
+  for (size_t j=1; j < Frames; j++) {
+    // the IMUs, voltages and SBUS every frame, everything else every 20th
+    FmuData &Sample = Samples[j];
+    bool Slow = (j % 20) == 0;
+    Sample.Updated.InputVoltage = true;
+    Sample.Updated.RegulatedVoltage = true;
+    Sample.Updated.Mpu9250 = true;
+    Sample.Updated.Bme280 = Slow;
+    Sample.Updated.Mpu9250Ext.assign(Sample.Mpu9250Ext.size(),true);
+    Sample.Updated.Bme280Ext.assign(Sample.Bme280Ext.size(),Slow);
+    Sample.Updated.SbusRx.assign(Sample.SbusRx.size(),true);
+    Sample.Updated.Gps.assign(Sample.Gps.size(),Slow);
+    Sample.Updated.Pitot.assign(Sample.Pitot.size(),true);
+    Sample.Updated.PressureTransducer.assign(Sample.PressureTransducer.size(),Slow);
+    Sample.Updated.Analog.assign(Sample.Analog.size(),Slow);
+    Sample.Updated.SbusVoltage.assign(Sample.SbusVoltage.size(),Slow);
+    Sample.Updated.PwmVoltage.assign(Sample.PwmVoltage.size(),Slow);
+    size_t Size = EncodeSparseFmuData(Sample,Layout,Sparse.data());
+    SparseBytes += Size + BfsCodec::Overhead;
+    if (!MergeSparseDataPayload(Layout,Sparse.data(),Size,Merged.data(),UpdateMask.data())) {
+      Mismatches++;
+      continue;
+    }
+    // records that were left out keep the value from the frame before
+    FmuDataView(Layout,Merged.data(),UpdateMask.data()).Decode(&Decoded);
+    if (Decoded.Updated.Gps.size() > 0) {
+      Mismatches += Decoded.Updated.Gps[0] != Slow;
+    }
+    for (size_t k=0; k < Sample.Gps.size(); k++) {
+      if (!Slow) {
+        Sample.Gps[k] = Samples[j-1].Gps[k];
+      }
+    }
+    if (!Slow) {
+      Sample.Bme280 = Samples[j-1].Bme280;
+      for (size_t k=0; k < Sample.Bme280Ext.size(); k++) {
+        Sample.Bme280Ext[k] = Samples[j-1].Bme280Ext[k];
+      }
+      for (size_t k=0; k < Sample.PressureTransducer.size(); k++) {
+        Sample.PressureTransducer[k] = Samples[j-1].PressureTransducer[k];
+      }
+      for (size_t k=0; k < Sample.Analog.size(); k++) {
+        Sample.Analog[k] = Samples[j-1].Analog[k];
+      }
+      for (size_t k=0; k < Sample.SbusVoltage.size(); k++) {
+        Sample.SbusVoltage[k] = Samples[j-1].SbusVoltage[k];
+      }
+      for (size_t k=0; k < Sample.PwmVoltage.size(); k++) {
+        Sample.PwmVoltage[k] = Samples[j-1].PwmVoltage[k];
+      }
+    }
+    // compared without struct padding, which a raw payload carries as it was
+    EncodeFmuData(Sample,CheckLayout,Expected.data());
+    EncodeFmuData(Decoded,CheckLayout,Check.data());
+    Mismatches += memcmp(Check.data(),Expected.data(),Expected.size()) != 0;
+  }
+  double FrameSize = SparseBytes/(double)(Frames-1);
+  printf("%-10s sparse, slow sensors every 20th frame: %6.1f bytes/frame  max rate: %7.1f Hz  merge mismatches: %zu\n",
+    GetDataEncodingName(Layout.Encoding),FrameSize,Baud/10.0/FrameSize,Mismatches);
+  return 0;
+}
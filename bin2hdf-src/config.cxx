@@ -1,7 +1,7 @@
 
 #include "config.hxx"
 
-void LoadConfigFile(std::string ConfigFileName, FmuData *FmuDataPtr, FmuConfig *FmuConfigPtr) {
+void LoadConfigFile(std::string ConfigFileName, FmuData *FmuDataPtr, FmuConfig *FmuConfigPtr, FmuDataLayout *FmuDataLayoutPtr) {
   // Load config file
   std::ifstream ConfigFile(ConfigFileName);
   std::string ConfigBuffer((std::istreambuf_iterator<char>(ConfigFile)),std::istreambuf_iterator<char>());
@@ -139,4 +139,11 @@ void LoadConfigFile(std::string ConfigFileName, FmuData *FmuDataPtr, FmuConfig *
 
   FmuDataPtr->SbusVoltage.resize(SbusVoltageSensors);
   FmuDataPtr->PwmVoltage.resize(PwmVoltageSensors);
+
+  // Fix where each sensor sits in a datalog record, the FMU sends raw structs unless told otherwise
+  DataEncoding Encoding = kRawEncoding;
+  if (ConfigDom.HasMember("DataEncoding")) {
+    Encoding = GetDataEncoding(ConfigDom["DataEncoding"].GetString());
+  }
+  *FmuDataLayoutPtr = BuildDataLayout(*FmuDataPtr,Encoding);
 }
@@ -3,6 +3,7 @@
 #define CONFIG_HXX_
 
 #include "global-defs.hxx"
+#include "data-layout.hxx"
 
 #include "../bin2hdf-includes/rapidjson/document.h"
 
@@ -15,7 +16,19 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <string>
+#include <vector>
 
-void LoadConfigFile(std::string ConfigFileName, FmuData *FmuDataPtr, FmuConfig *FmuConfigPtr);
+/* Names of the sensors in the log, the datasets they are written to */
+struct FmuConfig {
+  std::vector<std::string> Mpu9250Names;
+  std::vector<std::string> Bme280Names;
+  std::vector<std::string> SbusRxNames;
+  std::vector<std::string> GpsNames;
+  std::vector<std::string> PitotNames;
+  std::vector<std::string> PressureTransducerNames;
+  std::vector<std::string> AnalogNames;
+};
+
+void LoadConfigFile(std::string ConfigFileName, FmuData *FmuDataPtr, FmuConfig *FmuConfigPtr, FmuDataLayout *FmuDataLayoutPtr);
 
 #endif
@@ -21,6 +21,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "hdf5class.hxx"
 #include "config.hxx"
 #include "global-defs.hxx"
+#include "data-layout.hxx"
 #include <H5Cpp.h>
 #include <iostream>
 #include <string>
@@ -38,9 +39,10 @@ int main(int argc, char* argv[]) {
   /* initialize structures */
   FmuData Data;
   FmuConfig Config;
+  FmuDataLayout Layout;
 
   /* load configuration file */
-  LoadConfigFile(argv[1],&Data,&Config);
+  LoadConfigFile(argv[1],&Data,&Config,&Layout);
 
   /* load the flight data file*/
   FILE *BinaryFile = fopen(argv[2],"rb");
@@ -49,7 +51,7 @@ int main(int argc, char* argv[]) {
   fseek(BinaryFile,0,SEEK_END);
   size_t size = ftell(BinaryFile);
   rewind(BinaryFile);
-  size_t bytes = sizeof(Data.Time_us)+2*sizeof(Voltage)+sizeof(Mpu9250Data)+sizeof(Bme280Data)+Data.Mpu9250Ext.size()*sizeof(Mpu9250Data)+Data.Bme280Ext.size()*sizeof(Bme280Data)+Data.SbusRx.size()*sizeof(SbusRxData)+Data.Gps.size()*sizeof(GpsData)+Data.Pitot.size()*sizeof(PitotData)+Data.PressureTransducer.size()*sizeof(PressureData)+Data.Analog.size()*sizeof(AnalogData)+Data.SbusVoltage.size()*sizeof(Voltage)+Data.PwmVoltage.size()*sizeof(Voltage);
+  size_t bytes = Layout.PayloadSize;
   size_t NumberRecords = size/bytes;
 
   cout << "File size: " << size << " bytes"<< endl;
@@ -115,51 +117,38 @@ int main(int argc, char* argv[]) {
   }
 
   for (size_t i=0; i < NumberRecords; i++) {
-    memcpy(&Time_us[i],FileBuffer[i],sizeof(Time_us[i]));
-    memcpy(&InputVoltage[i],FileBuffer[i]+sizeof(Time_us[i]),sizeof(InputVoltage[i]));
-    memcpy(&RegulatedVoltage[i],FileBuffer[i]+sizeof(Time_us[i])+sizeof(InputVoltage[i]),sizeof(RegulatedVoltage[i]));
-    memcpy(&Mpu9250[i],FileBuffer[i]+sizeof(Time_us[i])+sizeof(InputVoltage[i])+sizeof(RegulatedVoltage[i]),sizeof(Mpu9250[i]));
-    memcpy(&Bme280[i],FileBuffer[i]+sizeof(Time_us[i])+sizeof(InputVoltage[i])+sizeof(RegulatedVoltage[i])+sizeof(Mpu9250[i]),sizeof(Bme280[i]));
+    FmuDataView View(Layout,FileBuffer[i]);
+    Time_us[i] = View.Time_us();
+    InputVoltage[i] = View.InputVoltage();
+    RegulatedVoltage[i] = View.RegulatedVoltage();
+    Mpu9250[i] = View.Mpu9250();
+    Bme280[i] = View.Bme280();
     for (size_t j=0; j < Data.Mpu9250Ext.size(); j++) {
-      memcpy(&Mpu9250Ext[j][i],FileBuffer[i]+sizeof(Time_us[i])+sizeof(InputVoltage[i])+sizeof(RegulatedVoltage[i])+sizeof(Mpu9250[i])+sizeof(Bme280[i])+j*sizeof(Mpu9250Ext[j][i]),sizeof(Mpu9250Ext[j][i]));
+      Mpu9250Ext[j][i] = View.Mpu9250Ext()[j];
     }
     for (size_t j=0; j < Data.Bme280Ext.size(); j++) {
-      memcpy(&Bme280Ext[j][i],FileBuffer[i]+sizeof(Time_us[i])+sizeof(InputVoltage[i])+sizeof(RegulatedVoltage[i])+sizeof(Mpu9250[i])+sizeof(Bme280[i])+
-        Data.Mpu9250Ext.size()*sizeof(Mpu9250Data)+j*sizeof(Bme280Ext[j][i]),sizeof(Bme280Ext[j][i]));
+      Bme280Ext[j][i] = View.Bme280Ext()[j];
     }
     for (size_t j=0; j < Data.SbusRx.size(); j++) {
-      memcpy(&SbusRx[j][i],FileBuffer[i]+sizeof(Time_us[i])+sizeof(InputVoltage[i])+sizeof(RegulatedVoltage[i])+sizeof(Mpu9250[i])+sizeof(Bme280[i])+
-        Data.Mpu9250Ext.size()*sizeof(Mpu9250Data)+Data.Bme280Ext.size()*sizeof(Bme280Data)+j*sizeof(SbusRx[j][i]),sizeof(SbusRx[j][i]));
+      SbusRx[j][i] = View.SbusRx()[j];
     }
     for (size_t j=0; j < Data.Gps.size(); j++) {
-      memcpy(&Gps[j][i],FileBuffer[i]+sizeof(Time_us[i])+sizeof(InputVoltage[i])+sizeof(RegulatedVoltage[i])+sizeof(Mpu9250[i])+sizeof(Bme280[i])+
-        Data.Mpu9250Ext.size()*sizeof(Mpu9250Data)+Data.Bme280Ext.size()*sizeof(Bme280Data)+Data.SbusRx.size()*sizeof(SbusRxData)+j*sizeof(Gps[j][i]),sizeof(Gps[j][i]));
+      Gps[j][i] = View.Gps()[j];
     }
     for (size_t j=0; j < Data.Pitot.size(); j++) {
-      memcpy(&Pitot[j][i],FileBuffer[i]+sizeof(Time_us[i])+sizeof(InputVoltage[i])+sizeof(RegulatedVoltage[i])+sizeof(Mpu9250[i])+sizeof(Bme280[i])+
-        Data.Mpu9250Ext.size()*sizeof(Mpu9250Data)+Data.Bme280Ext.size()*sizeof(Bme280Data)+Data.SbusRx.size()*sizeof(SbusRxData)+Data.Gps.size()*sizeof(GpsData)+
-        j*sizeof(Pitot[j][i]),sizeof(Pitot[j][i]));
+      Pitot[j][i] = View.Pitot()[j];
     }
     for (size_t j=0; j < Data.PressureTransducer.size(); j++) {
-      memcpy(&PressureTransducer[j][i],FileBuffer[i]+sizeof(Time_us[i])+sizeof(InputVoltage[i])+sizeof(RegulatedVoltage[i])+sizeof(Mpu9250[i])+sizeof(Bme280[i])+
-        Data.Mpu9250Ext.size()*sizeof(Mpu9250Data)+Data.Bme280Ext.size()*sizeof(Bme280Data)+Data.SbusRx.size()*sizeof(SbusRxData)+Data.Gps.size()*sizeof(GpsData)+
-        Data.Pitot.size()*sizeof(PitotData)+j*sizeof(PressureTransducer[j][i]),sizeof(PressureTransducer[j][i]));
+      PressureTransducer[j][i] = View.PressureTransducer()[j];
     }
     for (size_t j=0; j < Data.Analog.size(); j++) {
-      memcpy(&Analog[j][i],FileBuffer[i]+sizeof(Time_us[i])+sizeof(InputVoltage[i])+sizeof(RegulatedVoltage[i])+sizeof(Mpu9250[i])+sizeof(Bme280[i])+
-        Data.Mpu9250Ext.size()*sizeof(Mpu9250Data)+Data.Bme280Ext.size()*sizeof(Bme280Data)+Data.SbusRx.size()*sizeof(SbusRxData)+Data.Gps.size()*sizeof(GpsData)+
-        Data.Pitot.size()*sizeof(PitotData)+Data.PressureTransducer.size()*sizeof(PressureData)+j*sizeof(Analog[j][i]),sizeof(Analog[j][i]));
+      Analog[j][i] = View.Analog()[j];
     }
     for (size_t j=0; j < Data.SbusVoltage.size(); j++) {
-      memcpy(&SbusVoltage[j][i],FileBuffer[i]+sizeof(Time_us[i])+sizeof(InputVoltage[i])+sizeof(RegulatedVoltage[i])+sizeof(Mpu9250[i])+sizeof(Bme280[i])+
-        Data.Mpu9250Ext.size()*sizeof(Mpu9250Data)+Data.Bme280Ext.size()*sizeof(Bme280Data)+Data.SbusRx.size()*sizeof(SbusRxData)+Data.Gps.size()*sizeof(GpsData)+
-        Data.Pitot.size()*sizeof(PitotData)+Data.PressureTransducer.size()*sizeof(PressureData)+Data.Analog.size()*sizeof(AnalogData)+j*sizeof(SbusVoltage[j][i]),sizeof(SbusVoltage[j][i]));
+      SbusVoltage[j][i] = View.SbusVoltage()[j];
     }
     for (size_t j=0; j < Data.PwmVoltage.size(); j++) {
-      memcpy(&PwmVoltage[j][i],FileBuffer[i]+sizeof(Time_us[i])+sizeof(InputVoltage[i])+sizeof(RegulatedVoltage[i])+sizeof(Mpu9250[i])+sizeof(Bme280[i])+
-        Data.Mpu9250Ext.size()*sizeof(Mpu9250Data)+Data.Bme280Ext.size()*sizeof(Bme280Data)+Data.SbusRx.size()*sizeof(SbusRxData)+Data.Gps.size()*sizeof(GpsData)+
-        Data.Pitot.size()*sizeof(PitotData)+Data.PressureTransducer.size()*sizeof(PressureData)+Data.Analog.size()*sizeof(AnalogData)+Data.SbusVoltage.size()*sizeof(Voltage)+
-        j*sizeof(PwmVoltage[j][i]),sizeof(PwmVoltage[j][i]));
+      PwmVoltage[j][i] = View.PwmVoltage()[j];
     }
   }
 
@@ -0,0 +1,104 @@
+
+#include "config-batch.hxx"
+
+ConfigItem::ConfigItem(int BfsAddr,const std::string &Key,const std::string &Value) : BfsAddr(BfsAddr), Key(Key), Value(Value) {}
+
+/* Returns true if the items go in an array under their key, as sensors and effectors do. */
+static bool IsArrayKey(const std::string &Key) {
+  return (Key == "Sensors")||(Key == "Effectors");
+}
+
+/* Builds one kConfig JSON message from a run of items. Items for the same node in a
+row share a node entry, and within it items with the same key share an array, so
+nodes, sensors and effectors keep the order they were given in. */
+static std::string ComposeMessage(const std::vector<ConfigItem> &ConfigItems,size_t Begin,size_t End) {
+  std::string Nodes;
+  std::string Settings;
+  size_t i = Begin;
+  while (i < End) {
+    if (ConfigItems[i].BfsAddr < 0) {
+      Settings += ",\"" + ConfigItems[i].Key + "\":" + ConfigItems[i].Value;
+      i++;
+      continue;
+    }
+    Nodes += (Nodes.size() > 0) ? ",{" : "{";
+    Nodes += "\"BfsAddr\":" + std::to_string(ConfigItems[i].BfsAddr);
+    int BfsAddr = ConfigItems[i].BfsAddr;
+    while ((i < End)&&(ConfigItems[i].BfsAddr == BfsAddr)) {
+      const std::string &Key = ConfigItems[i].Key;
+      Nodes += ",\"" + Key + "\":";
+      if (IsArrayKey(Key)) {
+        Nodes += "[" + ConfigItems[i].Value;
+        i++;
+        while ((i < End)&&(ConfigItems[i].BfsAddr == BfsAddr)&&(ConfigItems[i].Key == Key)) {
+          Nodes += "," + ConfigItems[i].Value;
+          i++;
+        }
+        Nodes += "]";
+      } else {
+        Nodes += ConfigItems[i].Value;
+        i++;
+      }
+    }
+    Nodes += "}";
+  }
+  std::string Message;
+  if (Nodes.size() > 0) {
+    Message = "{\"Nodes\":[" + Nodes + "]" + Settings + "}";
+  } else {
+    Message = "{" + Settings.substr(1) + "}";
+  }
+  return Message;
+}
+
+/* Returns the kConfig message for this item on its own. */
+std::string ConfigItem::GetMessage() const {
+  std::vector<ConfigItem> Item(1,*this);
+  return ComposeMessage(Item,0,1);
+}
+
+/* Returns the batching given its name in the configuration: Item, Node or Aircraft. */
+ConfigBatching GetConfigBatching(const std::string &Name) {
+  if (Name == "Item") {
+    return kItemBatching;
+  }
+  if (Name == "Node") {
+    return kNodeBatching;
+  }
+  if (Name == "Aircraft") {
+    return kAircraftBatching;
+  }
+  throw std::runtime_error("Unknown config batching " + Name + ".");
+}
+
+/* Groups the items, in order, into as few kConfig messages of at most MaxMessageSize
+bytes as the batching allows. A message holds either node items or top level
+settings: a message composes its settings after its nodes, so a switch between the
+two starts a new message, and the FMU sees every item in the order given. */
+void BuildConfigMessages(const std::vector<ConfigItem> &ConfigItems,ConfigBatching Batching,size_t MaxMessageSize,std::vector<std::string> *MessagesPtr) {
+  MessagesPtr->clear();
+  size_t Begin = 0;
+  std::string Message;
+  for (size_t i=0; i < ConfigItems.size(); i++) {
+    if (i > Begin) {
+      bool SameNode = ConfigItems[i].BfsAddr == ConfigItems[i-1].BfsAddr;
+      bool SameKind = (ConfigItems[i].BfsAddr < 0) == (ConfigItems[i-1].BfsAddr < 0);
+      if (((Batching == kAircraftBatching)&&SameKind)||((Batching == kNodeBatching)&&SameNode)) {
+        std::string Longer = ComposeMessage(ConfigItems,Begin,i+1);
+        if (Longer.size() <= MaxMessageSize) {
+          Message = Longer;
+          continue;
+        }
+      }
+      MessagesPtr->push_back(Message);
+      Begin = i;
+    }
+    Message = ComposeMessage(ConfigItems,i,i+1);
+    if (Message.size() > MaxMessageSize) {
+      throw std::runtime_error("Config item is too large for a kConfig message: " + Message);
+    }
+  }
+  if (ConfigItems.size() > Begin) {
+    MessagesPtr->push_back(Message);
+  }
+}
@@ -0,0 +1,31 @@
+
+#ifndef CONFIG_BATCH_HXX_
+#define CONFIG_BATCH_HXX_
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <exception>
+#include <stdexcept>
+
+/* How config items are grouped into kConfig messages */
+enum ConfigBatching {
+  kItemBatching,                            // one item per message, what older FMU firmware expects
+  kNodeBatching,                            // all the items of one node per message
+  kAircraftBatching                         // as many items as fit per message
+};
+
+/* One rotation, sensor, effector or top level setting. Key is the member it goes
+under, Value its JSON. BfsAddr is the node, or -1 for a top level setting. */
+struct ConfigItem {
+  int BfsAddr;
+  std::string Key;
+  std::string Value;
+  ConfigItem(int BfsAddr,const std::string &Key,const std::string &Value);
+  std::string GetMessage() const;
+};
+
+ConfigBatching GetConfigBatching(const std::string &Name);
+void BuildConfigMessages(const std::vector<ConfigItem> &ConfigItems,ConfigBatching Batching,size_t MaxMessageSize,std::vector<std::string> *MessagesPtr);
+
+#endif
@@ -0,0 +1,108 @@
+
+#include "config-hash.hxx"
+
+static const uint64_t FnvOffset = 14695981039346656037ULL;
+static const uint64_t FnvPrime = 1099511628211ULL;
+
+/* 64 bit FNV-1a over a byte array, continuing from Hash. */
+static uint64_t Fnv1a(const uint8_t *Data,size_t DataSize,uint64_t Hash) {
+  for (size_t i=0; i < DataSize; i++) {
+    Hash ^= Data[i];
+    Hash *= FnvPrime;
+  }
+  return Hash;
+}
+
+static bool MemberNameLess(const rapidjson::Value::ConstMemberIterator &A,const rapidjson::Value::ConstMemberIterator &B) {
+  return strcmp(A->name.GetString(),B->name.GetString()) < 0;
+}
+
+/* Writes a JSON value with the members of every object in name order, so the same
+settings written in a different order or layout give the same text. */
+static void WriteCanonical(const rapidjson::Value &Value,rapidjson::Writer<rapidjson::StringBuffer> *WriterPtr) {
+  if (Value.IsObject()) {
+    std::vector<rapidjson::Value::ConstMemberIterator> Members;
+    for (rapidjson::Value::ConstMemberIterator Member=Value.MemberBegin(); Member != Value.MemberEnd(); ++Member) {
+      Members.push_back(Member);
+    }
+    std::sort(Members.begin(),Members.end(),MemberNameLess);
+    WriterPtr->StartObject();
+    for (size_t i=0; i < Members.size(); i++) {
+      WriterPtr->Key(Members[i]->name.GetString(),Members[i]->name.GetStringLength());
+      WriteCanonical(Members[i]->value,WriterPtr);
+    }
+    WriterPtr->EndObject();
+  } else if (Value.IsArray()) {
+    WriterPtr->StartArray();
+    for (rapidjson::SizeType i=0; i < Value.Size(); i++) {
+      WriteCanonical(Value[i],WriterPtr);
+    }
+    WriterPtr->EndArray();
+  } else {
+    Value.Accept(*WriterPtr);
+  }
+}
+
+/* Hashes the canonical form of a config item's JSON. */
+uint64_t HashConfigItem(const std::string &ConfigString) {
+  rapidjson::Document ItemDom;
+  ItemDom.Parse(ConfigString.c_str());
+  rapidjson::StringBuffer StringBuf;
+  rapidjson::Writer<rapidjson::StringBuffer> Writer(StringBuf);
+  WriteCanonical(ItemDom,&Writer);
+  return Fnv1a((const uint8_t *)StringBuf.GetString(),StringBuf.GetSize(),FnvOffset);
+}
+
+/* Hashes every config item, and the list of item hashes as a whole. */
+void BuildConfigFingerprint(const std::vector<std::string> &ConfigItems,ConfigFingerprint *ConfigFingerprintPtr) {
+  ConfigFingerprintPtr->ItemHashes.resize(ConfigItems.size());
+  uint64_t Hash = FnvOffset;
+  for (size_t i=0; i < ConfigItems.size(); i++) {
+    ConfigFingerprintPtr->ItemHashes[i] = HashConfigItem(ConfigItems[i]);
+    uint8_t Bytes[8];
+    for (size_t j=0; j < 8; j++) {
+      Bytes[j] = (uint8_t)(ConfigFingerprintPtr->ItemHashes[i] >> (8*j));
+    }
+    Hash = Fnv1a(Bytes,sizeof(Bytes),Hash);
+  }
+  ConfigFingerprintPtr->ConfigHash = Hash;
+}
+
+/* Packs a kConfigHash payload, little endian. */
+void PackConfigFingerprint(const ConfigFingerprint &ConfigFingerprintRef,std::vector<uint8_t> *PayloadPtr) {
+  size_t Items = ConfigFingerprintRef.ItemHashes.size();
+  PayloadPtr->resize(8 + 2 + 8*Items);
+  uint8_t *Payload = PayloadPtr->data();
+  for (size_t j=0; j < 8; j++) {
+    Payload[j] = (uint8_t)(ConfigFingerprintRef.ConfigHash >> (8*j));
+  }
+  Payload[8] = Items & 0xff;
+  Payload[9] = Items >> 8;
+  for (size_t i=0; i < Items; i++) {
+    for (size_t j=0; j < 8; j++) {
+      Payload[10 + 8*i + j] = (uint8_t)(ConfigFingerprintRef.ItemHashes[i] >> (8*j));
+    }
+  }
+}
+
+/* Unpacks a kConfigHash payload, returns false if it is malformed. */
+bool UnpackConfigFingerprint(const uint8_t *Payload,size_t PayloadSize,ConfigFingerprint *ConfigFingerprintPtr) {
+  if (PayloadSize < 10) {
+    return false;
+  }
+  size_t Items = Payload[8] | ((size_t)Payload[9] << 8);
+  if (PayloadSize != 10 + 8*Items) {
+    return false;
+  }
+  ConfigFingerprintPtr->ConfigHash = 0;
+  for (size_t j=0; j < 8; j++) {
+    ConfigFingerprintPtr->ConfigHash |= (uint64_t)Payload[j] << (8*j);
+  }
+  ConfigFingerprintPtr->ItemHashes.assign(Items,0);
+  for (size_t i=0; i < Items; i++) {
+    for (size_t j=0; j < 8; j++) {
+      ConfigFingerprintPtr->ItemHashes[i] |= (uint64_t)Payload[10 + 8*i + j] << (8*j);
+    }
+  }
+  return true;
+}
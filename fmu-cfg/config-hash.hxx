@@ -0,0 +1,30 @@
+
+#ifndef CONFIG_HASH_HXX_
+#define CONFIG_HASH_HXX_
+
+#include "../soc-includes/rapidjson/document.h"
+#include "../soc-includes/rapidjson/stringbuffer.h"
+#include "../soc-includes/rapidjson/writer.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+static const size_t MaxConfigItems = 510;    // that fit in a kConfigHash payload
+
+/* Fingerprint of a configuration: one hash per config item, each the kConfig JSON
+for one rotation, sensor, effector or setting, and a hash over all of them in
+order. The FMU keeps the fingerprint of the configuration it was last given. */
+struct ConfigFingerprint {
+  uint64_t ConfigHash;
+  std::vector<uint64_t> ItemHashes;
+};
+
+uint64_t HashConfigItem(const std::string &ConfigString);
+void BuildConfigFingerprint(const std::vector<std::string> &ConfigItems,ConfigFingerprint *ConfigFingerprintPtr);
+void PackConfigFingerprint(const ConfigFingerprint &ConfigFingerprintRef,std::vector<uint8_t> *PayloadPtr);
+bool UnpackConfigFingerprint(const uint8_t *Payload,size_t PayloadSize,ConfigFingerprint *ConfigFingerprintPtr);
+
+#endif
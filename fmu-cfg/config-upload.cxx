@@ -0,0 +1,130 @@
+
+#include "config-upload.hxx"
+
+const size_t ConfigUpload::Window;
+const int ConfigUpload::FirstAckTimeout_ms;
+const int ConfigUpload::AckTimeout_ms;
+const unsigned int ConfigUpload::LegacyPeriod_s;
+const int ConfigUpload::QueryTimeout_ms;
+
+ConfigUpload::ConfigUpload(Fmu &FmuRef) : Fmu_(FmuRef) {}
+
+/* Asks the FMU for the fingerprint of the configuration it holds, returns false if
+it does not answer, as firmware without fingerprints does not. */
+bool ConfigUpload::QueryFingerprint(ConfigFingerprint *ConfigFingerprintPtr) {
+  if (Start_us_ == 0) {
+    Start_us_ = GetTime_us();
+  }
+  Fmu_.WriteMessage(kConfigQuery,0,NULL);
+  uint64_t Deadline_us = GetTime_us() + QueryTimeout_ms*1000ULL;
+  BfsMessage MessageId;
+  uint16_t PayloadSize;
+  uint8_t Payload[BfsCodec::MaxPayloadSize];
+  uint64_t Time_us;
+  while ((Time_us=GetTime_us()) < Deadline_us) {
+    Fmu_.SetReceiveTimeout((Deadline_us - Time_us + 999)/1000);
+    if (Fmu_.ReadMessage(&MessageId,&PayloadSize,Payload)&&(MessageId == kConfigHash)) {
+      return UnpackConfigFingerprint(Payload,PayloadSize,ConfigFingerprintPtr);
+    }
+  }
+  return false;
+}
+
+/* Sends a message with a text payload, such as a kConfig JSON string. */
+void ConfigUpload::Send(BfsMessage MessageId,const std::string &Payload) {
+  Send(MessageId,Payload.size(),(const uint8_t *)Payload.c_str());
+}
+
+/* Sends a message once there is room in the window. Until the FMU has acknowledged
+something only one message is sent at a time, an FMU that never acknowledges could
+lose messages sent while it is still applying the first. */
+void ConfigUpload::Send(BfsMessage MessageId,uint16_t PayloadSize,const uint8_t *Payload) {
+  if (Start_us_ == 0) {
+    Start_us_ = GetTime_us();
+  }
+  size_t Limit = (Acks_ > 0) ? Window : 1;
+  while (!Legacy_ && (InFlight_.size() >= Limit)) {
+    WaitForAck();
+  }
+  uint8_t Frame[BfsCodec::MaxMessageSize];
+  size_t FrameSize = BfsCodec::BuildMessage(MessageId,PayloadSize,Payload,Frame);
+  Fmu_.WriteMessage(MessageId,PayloadSize,(uint8_t *)Payload);
+  Stats_.Messages++;
+  Stats_.Bytes += FrameSize;
+  if (Legacy_) {
+    sleep(LegacyPeriod_s);
+    return;
+  }
+  PendingMessage Pending;
+  Pending.MessageId = MessageId;
+  Pending.Checksum[0] = Frame[FrameSize-2];
+  Pending.Checksum[1] = Frame[FrameSize-1];
+  if (MessageId == kMode) {
+    Pending.Description = "mode " + std::to_string(Payload[0]);
+  } else {
+    Pending.Description = std::string((const char *)Payload,PayloadSize);
+  }
+  InFlight_.push_back(Pending);
+  if (InFlight_.size() > Stats_.MaxInFlight) {
+    Stats_.MaxInFlight = InFlight_.size();
+  }
+}
+
+/* Waits until every message sent has been acknowledged. */
+void ConfigUpload::Finish() {
+  while (!Legacy_ && !InFlight_.empty()) {
+    WaitForAck();
+  }
+  Stats_.Elapsed_s = (GetTime_us() - Start_us_)/1e6;
+  Stats_.Acknowledged = !Legacy_;
+}
+
+/* Returns the upload counters, complete once Finish has returned. */
+ConfigUploadStats ConfigUpload::GetStats() {
+  return Stats_;
+}
+
+/* Reads from the FMU until the oldest message in flight is acknowledged, skipping
+anything else it sends such as data frames. */
+void ConfigUpload::WaitForAck() {
+  int Timeout_ms = (Acks_ > 0) ? AckTimeout_ms : FirstAckTimeout_ms;
+  uint64_t Deadline_us = GetTime_us() + Timeout_ms*1000ULL;
+  BfsMessage MessageId;
+  uint16_t PayloadSize;
+  uint8_t Payload[BfsCodec::MaxPayloadSize];
+  uint64_t Time_us;
+  while ((Time_us=GetTime_us()) < Deadline_us) {
+    Fmu_.SetReceiveTimeout((Deadline_us - Time_us + 999)/1000);
+    if (!Fmu_.ReadMessage(&MessageId,&PayloadSize,Payload)) {
+      continue;
+    }
+    if ((MessageId != kConfigAck)||(PayloadSize < 4)) {
+      continue;
+    }
+    const PendingMessage &Pending = InFlight_.front();
+    if ((Payload[0] != Pending.MessageId)||(Payload[1] != Pending.Checksum[0])||(Payload[2] != Pending.Checksum[1])) {
+      throw std::runtime_error("FMU acknowledged a message other than the one expected, " + Pending.Description);
+    }
+    if (Payload[3] != 0) {
+      throw std::runtime_error("FMU rejected configuration message " + Pending.Description);
+    }
+    InFlight_.pop_front();
+    Acks_++;
+    return;
+  }
+  if (Acks_ == 0) {
+    // the first message has had the time the old one message a second pacing gave it
+    std::cout << "FMU does not acknowledge configuration, sending one message a second" << std::endl;
+    InFlight_.clear();
+    Legacy_ = true;
+    return;
+  }
+  throw std::runtime_error("FMU did not acknowledge configuration message " + InFlight_.front().Description);
+}
+
+/* Returns the monotonic time, us. */
+uint64_t ConfigUpload::GetTime_us() {
+  struct timespec Time;
+  clock_gettime(CLOCK_MONOTONIC,&Time);
+  return (uint64_t)Time.tv_sec*1000000 + Time.tv_nsec/1000;
+}
@@ -0,0 +1,65 @@
+
+#ifndef CONFIG_UPLOAD_HXX_
+#define CONFIG_UPLOAD_HXX_
+
+#include "global-defs.hxx"
+#include "fmu.hxx"
+#include "bfs.hxx"
+#include "config-hash.hxx"
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <deque>
+#include <string>
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+
+/* Counters from a configuration upload */
+struct ConfigUploadStats {
+  uint64_t Messages;                        // Number of kMode and kConfig messages sent
+  uint64_t Bytes;                           // Number of bytes sent, framing included
+  size_t MaxInFlight;                       // Most messages waiting on an acknowledgement at once
+  double Elapsed_s;                         // Time from the first message, or the fingerprint query, to the last acknowledgement, s
+  bool Acknowledged;                        // False if the FMU never acknowledged and messages were paced instead
+  size_t Items;                             // Number of config items in the configuration
+  size_t ItemsSent;                         // Number of config items sent, the rest the FMU already held
+};
+
+/* Sends kMode and kConfig messages to the FMU, which answers each with a kConfigAck
+once it has applied it. Up to Window messages are kept in flight so the upload runs
+at the speed of the link and the FMU rather than a fixed pace. The FMU applies and
+acknowledges messages in order, so every acknowledgement must match the oldest one
+waiting. Nothing is resent: a rejected message, a mismatched acknowledgement or a
+missing one ends the upload with an error. An FMU that does not acknowledge at all
+is found on the first message, and the rest are then sent one a second as before. */
+class ConfigUpload {
+  public:
+    static const size_t Window = 4;
+    static const int FirstAckTimeout_ms = 2000;
+    static const int AckTimeout_ms = 5000;
+    static const unsigned int LegacyPeriod_s = 1;
+    static const int QueryTimeout_ms = 500;
+    ConfigUpload(Fmu &FmuRef);
+    bool QueryFingerprint(ConfigFingerprint *ConfigFingerprintPtr);
+    void Send(BfsMessage MessageId,const std::string &Payload);
+    void Send(BfsMessage MessageId,uint16_t PayloadSize,const uint8_t *Payload);
+    void Finish();
+    ConfigUploadStats GetStats();
+  private:
+    struct PendingMessage {
+      uint8_t MessageId;
+      uint8_t Checksum[2];
+      std::string Description;
+    };
+    Fmu &Fmu_;
+    std::deque<PendingMessage> InFlight_;
+    bool Legacy_ = false;
+    uint64_t Acks_ = 0;
+    uint64_t Start_us_ = 0;
+    ConfigUploadStats Stats_ = {0,0,0,0.0,true,0,0};
+    void WaitForAck();
+    static uint64_t GetTime_us();
+};
+
+#endif
@@ -1,7 +1,7 @@
 
 #include "config.hxx"
 
-void LoadConfigFile(std::string ConfigFileName, Fmu FmuRef, AircraftConfig *AircraftConfigPtr, FmuData *FmuDataPtr) {
+void LoadConfigFile(std::string ConfigFileName, Fmu &FmuRef, AircraftConfig *AircraftConfigPtr, FmuData *FmuDataPtr, ConfigUploadStats *ConfigUploadStatsPtr) {
   // Load config file
   std::ifstream ConfigFile(ConfigFileName);
   std::string ConfigBuffer((std::istreambuf_iterator<char>(ConfigFile)),std::istreambuf_iterator<char>());
@@ -12,11 +12,8 @@ void LoadConfigFile(std::string ConfigFileName, Fmu FmuRef, AircraftConfig *Airc
   ConfigDom.ParseStream(jsonConfig);
   assert(ConfigDom.IsObject());
 
-  // Switch FMU to standby mode
-  uint8_t StandbyPayload[1];
-  StandbyPayload[0] = (uint8_t) kStandby;
-  FmuRef.WriteMessage(kMode,sizeof(StandbyPayload),StandbyPayload);
-  sleep(1);
+  // Every rotation, sensor, effector and setting is one config item
+  std::vector<ConfigItem> ConfigItems;
 
   // Loop through all nodes
   size_t SbusVoltageSensors = 0;
@@ -32,10 +29,7 @@ void LoadConfigFile(std::string ConfigFileName, Fmu FmuRef, AircraftConfig *Airc
       rapidjson::Writer<rapidjson::StringBuffer> writer(StringBuf);
       Rotation.Accept(writer);
       std::string OutputString = StringBuf.GetString();
-      std::string ConfigString;
-      ConfigString = "{\"Nodes\":[{\"BfsAddr\":" + std::to_string(Node["BfsAddr"].GetInt()) + ",\"Rotation\":" +  OutputString + "}]}";
-      FmuRef.WriteMessage(kConfig,ConfigString.size(),(uint8_t *)ConfigString.c_str());
-      sleep(1);
+      ConfigItems.push_back(ConfigItem(Node["BfsAddr"].GetInt(),"Rotation",OutputString));
     } 
     if (Node.HasMember("Sensors")) {
       const rapidjson::Value& Sensors = Node["Sensors"];
@@ -50,10 +44,7 @@ void LoadConfigFile(std::string ConfigFileName, Fmu FmuRef, AircraftConfig *Airc
             rapidjson::Writer<rapidjson::StringBuffer> writer(StringBuf);
             Sensor.Accept(writer);
             std::string OutputString = StringBuf.GetString();
-            std::string ConfigString;
-            ConfigString = "{\"Nodes\":[{\"BfsAddr\":" + std::to_string(Node["BfsAddr"].GetInt()) + ",\"Sensors\":[" +  OutputString + "]}]}";
-            FmuRef.WriteMessage(kConfig,ConfigString.size(),(uint8_t *)ConfigString.c_str());
-            sleep(1);
+            ConfigItems.push_back(ConfigItem(Node["BfsAddr"].GetInt(),"Sensors",OutputString));
           }
           if (Sensor["Type"] == "Bme280") {
             FmuDataPtr->Bme280Ext.resize(FmuDataPtr->Bme280Ext.size() + 1);
@@ -61,10 +52,7 @@ void LoadConfigFile(std::string ConfigFileName, Fmu FmuRef, AircraftConfig *Airc
             rapidjson::Writer<rapidjson::StringBuffer> writer(StringBuf);
             Sensor.Accept(writer);
             std::string OutputString = StringBuf.GetString();
-            std::string ConfigString;
-            ConfigString = "{\"Nodes\":[{\"BfsAddr\":" + std::to_string(Node["BfsAddr"].GetInt()) + ",\"Sensors\":[" +  OutputString + "]}]}";
-            FmuRef.WriteMessage(kConfig,ConfigString.size(),(uint8_t *)ConfigString.c_str());
-            sleep(1);
+            ConfigItems.push_back(ConfigItem(Node["BfsAddr"].GetInt(),"Sensors",OutputString));
           }
           if (Sensor["Type"] == "SbusRx") {
             FmuDataPtr->SbusRx.resize(FmuDataPtr->SbusRx.size() + 1);
@@ -72,10 +60,7 @@ void LoadConfigFile(std::string ConfigFileName, Fmu FmuRef, AircraftConfig *Airc
             rapidjson::Writer<rapidjson::StringBuffer> writer(StringBuf);
             Sensor.Accept(writer);
             std::string OutputString = StringBuf.GetString();
-            std::string ConfigString;
-            ConfigString = "{\"Nodes\":[{\"BfsAddr\":" + std::to_string(Node["BfsAddr"].GetInt()) + ",\"Sensors\":[" +  OutputString + "]}]}";
-            FmuRef.WriteMessage(kConfig,ConfigString.size(),(uint8_t *)ConfigString.c_str());
-            sleep(1);
+            ConfigItems.push_back(ConfigItem(Node["BfsAddr"].GetInt(),"Sensors",OutputString));
           }
           if (Sensor["Type"] == "Gps") {
             FmuDataPtr->Gps.resize(FmuDataPtr->Gps.size() + 1);
@@ -83,10 +68,7 @@ void LoadConfigFile(std::string ConfigFileName, Fmu FmuRef, AircraftConfig *Airc
             rapidjson::Writer<rapidjson::StringBuffer> writer(StringBuf);
             Sensor.Accept(writer);
             std::string OutputString = StringBuf.GetString();
-            std::string ConfigString;
-            ConfigString = "{\"Nodes\":[{\"BfsAddr\":" + std::to_string(Node["BfsAddr"].GetInt()) + ",\"Sensors\":[" +  OutputString + "]}]}";
-            FmuRef.WriteMessage(kConfig,ConfigString.size(),(uint8_t *)ConfigString.c_str());
-            sleep(1);
+            ConfigItems.push_back(ConfigItem(Node["BfsAddr"].GetInt(),"Sensors",OutputString));
           }
           if (Sensor["Type"] == "Pitot") {
             FmuDataPtr->Pitot.resize(FmuDataPtr->Pitot.size() + 1);
@@ -94,10 +76,7 @@ void LoadConfigFile(std::string ConfigFileName, Fmu FmuRef, AircraftConfig *Airc
             rapidjson::Writer<rapidjson::StringBuffer> writer(StringBuf);
             Sensor.Accept(writer);
             std::string OutputString = StringBuf.GetString();
-            std::string ConfigString;
-            ConfigString = "{\"Nodes\":[{\"BfsAddr\":" + std::to_string(Node["BfsAddr"].GetInt()) + ",\"Sensors\":[" +  OutputString + "]}]}";
-            FmuRef.WriteMessage(kConfig,ConfigString.size(),(uint8_t *)ConfigString.c_str());
-            sleep(1);
+            ConfigItems.push_back(ConfigItem(Node["BfsAddr"].GetInt(),"Sensors",OutputString));
           }
           if (Sensor["Type"] == "PressureSensor") {
             FmuDataPtr->PressureTransducer.resize(FmuDataPtr->PressureTransducer.size() + 1);
@@ -105,10 +84,7 @@ void LoadConfigFile(std::string ConfigFileName, Fmu FmuRef, AircraftConfig *Airc
             rapidjson::Writer<rapidjson::StringBuffer> writer(StringBuf);
             Sensor.Accept(writer);
             std::string OutputString = StringBuf.GetString();
-            std::string ConfigString;
-            ConfigString = "{\"Nodes\":[{\"BfsAddr\":" + std::to_string(Node["BfsAddr"].GetInt()) + ",\"Sensors\":[" +  OutputString + "]}]}";
-            FmuRef.WriteMessage(kConfig,ConfigString.size(),(uint8_t *)ConfigString.c_str());
-            sleep(1);
+            ConfigItems.push_back(ConfigItem(Node["BfsAddr"].GetInt(),"Sensors",OutputString));
           }
           if (Sensor["Type"] == "Analog") {
             FmuDataPtr->Analog.resize(FmuDataPtr->Analog.size() + 1);
@@ -116,10 +92,7 @@ void LoadConfigFile(std::string ConfigFileName, Fmu FmuRef, AircraftConfig *Airc
             rapidjson::Writer<rapidjson::StringBuffer> writer(StringBuf);
             Sensor.Accept(writer);
             std::string OutputString = StringBuf.GetString();
-            std::string ConfigString;
-            ConfigString = "{\"Nodes\":[{\"BfsAddr\":" + std::to_string(Node["BfsAddr"].GetInt()) + ",\"Sensors\":[" +  OutputString + "]}]}";
-            FmuRef.WriteMessage(kConfig,ConfigString.size(),(uint8_t *)ConfigString.c_str());
-            sleep(1);
+            ConfigItems.push_back(ConfigItem(Node["BfsAddr"].GetInt(),"Sensors",OutputString));
           }
         } else {
           // error
@@ -151,10 +124,7 @@ void LoadConfigFile(std::string ConfigFileName, Fmu FmuRef, AircraftConfig *Airc
         rapidjson::Writer<rapidjson::StringBuffer> writer(StringBuf);
         Effector.Accept(writer);
         std::string OutputString = StringBuf.GetString();
-        std::string ConfigString;
-        ConfigString = "{\"Nodes\":[{\"BfsAddr\":" + std::to_string(Node["BfsAddr"].GetInt()) + ",\"Effectors\":[" +  OutputString + "]}]}";
-        FmuRef.WriteMessage(kConfig,ConfigString.size(),(uint8_t *)ConfigString.c_str());
-        sleep(1);
+        ConfigItems.push_back(ConfigItem(Node["BfsAddr"].GetInt(),"Effectors",OutputString));
       }
     SbusVoltageSensors += SbusVoltageOnNode;
     PwmVoltageSensors += PwmVoltageOnNode;
@@ -164,8 +134,79 @@ void LoadConfigFile(std::string ConfigFileName, Fmu FmuRef, AircraftConfig *Airc
   FmuDataPtr->SbusVoltage.resize(SbusVoltageSensors);
   FmuDataPtr->PwmVoltage.resize(PwmVoltageSensors);
 
+  // Select the data encoding, the FMU sends raw structs in kData if this is not set
+  if (ConfigDom.HasMember("DataEncoding")) {
+    GetDataEncoding(ConfigDom["DataEncoding"].GetString());   // throws on an unknown name
+    ConfigItems.push_back(ConfigItem(-1,"DataEncoding","\"" + std::string(ConfigDom["DataEncoding"].GetString()) + "\""));
+  }
+
+  // Let the FMU leave out records that have not changed, in kDataSparse frames
+  if (ConfigDom.HasMember("SparseData")) {
+    ConfigItems.push_back(ConfigItem(-1,"SparseData",ConfigDom["SparseData"].GetBool() ? "true" : "false"));
+  }
+
+  // Items are sent one per kConfig message unless batching is asked for
+  ConfigBatching Batching = kItemBatching;
+  if (ConfigDom.HasMember("ConfigBatching")) {
+    Batching = GetConfigBatching(ConfigDom["ConfigBatching"].GetString());
+  }
+
+  // Only send what the FMU does not already hold
+  UploadConfigItems(FmuRef,ConfigItems,Batching,ConfigUploadStatsPtr);
+}
+
+/* Uploads the config items to the FMU. Each message is acknowledged by the FMU and
+several are kept in flight. The FMU is first asked for the fingerprint of the
+configuration it holds: if it matches nothing is sent, if only some items changed,
+with the same number of items, just those are replaced with kConfigItem, otherwise
+all of them are sent, batched into as few kConfig messages as Batching allows.
+Firmware that does not answer is always sent everything. */
+void UploadConfigItems(Fmu &FmuRef, const std::vector<ConfigItem> &ConfigItems, ConfigBatching Batching, ConfigUploadStats *ConfigUploadStatsPtr) {
+  ConfigUpload Upload(FmuRef);
+  ConfigFingerprint Fingerprint;
+  ConfigFingerprint Stored;
+  std::vector<std::string> ItemMessages(ConfigItems.size());
+  for (size_t i=0; i < ConfigItems.size(); i++) {
+    ItemMessages[i] = ConfigItems[i].GetMessage();
+  }
+  BuildConfigFingerprint(ItemMessages,&Fingerprint);
+  bool Fingerprinted = (ConfigItems.size() <= MaxConfigItems)&&Upload.QueryFingerprint(&Stored);
+  uint8_t ModePayload[1];
+  size_t ItemsSent = 0;
+  if (!Fingerprinted || (Stored.ConfigHash != Fingerprint.ConfigHash)||(Stored.ItemHashes != Fingerprint.ItemHashes)) {
+    // Switch FMU to standby mode
+    ModePayload[0] = (uint8_t) kStandby;
+    Upload.Send(kMode,sizeof(ModePayload),ModePayload);
+    if (Fingerprinted && (Stored.ItemHashes.size() == ConfigItems.size())) {
+      for (size_t i=0; i < ConfigItems.size(); i++) {
+        if (Stored.ItemHashes[i] != Fingerprint.ItemHashes[i]) {
+          std::string ItemPayload(2,'\0');
+          ItemPayload[0] = i & 0xff;
+          ItemPayload[1] = i >> 8;
+          Upload.Send(kConfigItem,ItemPayload + ItemMessages[i]);
+          ItemsSent++;
+        }
+      }
+    } else {
+      std::vector<std::string> Messages;
+      BuildConfigMessages(ConfigItems,Batching,BfsCodec::MaxPayloadSize,&Messages);
+      for (size_t i=0; i < Messages.size(); i++) {
+        Upload.Send(kConfig,Messages[i]);
+      }
+      ItemsSent = ConfigItems.size();
+    }
+    if (Fingerprinted) {
+      std::vector<uint8_t> HashPayload;
+      PackConfigFingerprint(Fingerprint,&HashPayload);
+      Upload.Send(kConfigHash,HashPayload.size(),HashPayload.data());
+    }
+  }
+
   // Switch FMU to run mode
-  StandbyPayload[0] = (uint8_t) kRun;
-  FmuRef.WriteMessage(kMode,sizeof(StandbyPayload),StandbyPayload);
-  sleep(1);
+  ModePayload[0] = (uint8_t) kRun;
+  Upload.Send(kMode,sizeof(ModePayload),ModePayload);
+  Upload.Finish();
+  *ConfigUploadStatsPtr = Upload.GetStats();
+  ConfigUploadStatsPtr->Items = ConfigItems.size();
+  ConfigUploadStatsPtr->ItemsSent = ItemsSent;
 }
@@ -4,6 +4,9 @@
 
 #include "global-defs.hxx"
 #include "fmu.hxx"
+#include "config-upload.hxx"
+#include "config-hash.hxx"
+#include "config-batch.hxx"
 
 #include "../soc-includes/rapidjson/document.h"
 #include "../soc-includes/rapidjson/stringbuffer.h"
@@ -15,9 +18,12 @@
 #include <stdio.h>
 #include <exception>
 #include <stdexcept>
+#include <string>
+#include <vector>
 #include <fcntl.h>
 #include <unistd.h>
 
-void LoadConfigFile(std::string ConfigFileName, Fmu FmuRef, AircraftConfig *AircraftConfigPtr, FmuData *FmuDataPtr);
+void LoadConfigFile(std::string ConfigFileName, Fmu &FmuRef, AircraftConfig *AircraftConfigPtr, FmuData *FmuDataPtr, ConfigUploadStats *ConfigUploadStatsPtr);
+void UploadConfigItems(Fmu &FmuRef, const std::vector<ConfigItem> &ConfigItems, ConfigBatching Batching, ConfigUploadStats *ConfigUploadStatsPtr);
 
 #endif
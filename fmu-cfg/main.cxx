@@ -25,20 +25,28 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include <iostream>
 
 int main(int argc, char* argv[]) {
-  if (argc!=2) {
+  if ((argc!=2)&&(argc!=3)) {
     std::cerr << "ERROR: Incorrect number of input arguments." << std::endl;
+    std::cerr << "Usage: output <config> [transport]" << std::endl;
     return -1;
   }
 
-  /* initialize classes */
-  Fmu Sensors;
+  /* initialize classes, the FMU link is the UART unless a transport is given */
+  Fmu Sensors((argc == 3) ? argv[2] : FmuPort);
 
   /* initialize structures */
   AircraftConfig Config;
   FmuData Data;
+  ConfigUploadStats UploadStats;
 
-  /* load configuration file */
-  LoadConfigFile(argv[1],Sensors,&Config,&Data);
+  /* load configuration file and upload it to the FMU */
+  LoadConfigFile(argv[1],Sensors,&Config,&Data,&UploadStats);
+  std::cout << "Configuration uploaded: " << UploadStats.ItemsSent << " of " << UploadStats.Items << " items changed, "
+    << UploadStats.Messages << " messages, " << UploadStats.Bytes << " bytes in " << UploadStats.Elapsed_s << " s";
+  if (UploadStats.Acknowledged) {
+    std::cout << ", up to " << UploadStats.MaxInFlight << " in flight";
+  }
+  std::cout << std::endl;
 
 	return 0;
 }
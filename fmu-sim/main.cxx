@@ -0,0 +1,180 @@
+/*
+main.cxx
+Brian R Taylor
+brian.taylor@bolderflight.com
+2017-04-18
+Copyright (c) 2017 Bolder Flight Systems
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING 
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "config.hxx"
+#include "fmu.hxx"
+#include "data-layout.hxx"
+#include "global-defs.hxx"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/* Monotonic clock, ns */
+static uint64_t Now_ns() {
+  struct timespec Time;
+  clock_gettime(CLOCK_MONOTONIC,&Time);
+  return (uint64_t)Time.tv_sec*1000000000ULL + Time.tv_nsec;
+}
+
+/* Sleeps until the given monotonic time, ns */
+static void SleepUntil_ns(uint64_t Time_ns) {
+  struct timespec Time;
+  Time.tv_sec = Time_ns/1000000000ULL;
+  Time.tv_nsec = Time_ns%1000000000ULL;
+  while (clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&Time,NULL) != 0) {}
+}
+
+/* Acknowledges a configuration message the way the FMU does once it has applied it. */
+static void AckMessage(Fmu &LinkRef, BfsMessage MessageId, uint16_t PayloadSize, const uint8_t *Payload) {
+  uint8_t Frame[BfsCodec::MaxMessageSize];
+  size_t FrameSize = BfsCodec::BuildMessage(MessageId,PayloadSize,Payload,Frame);
+  uint8_t Ack[4];
+  Ack[0] = (uint8_t) MessageId;
+  Ack[1] = Frame[FrameSize-2];
+  Ack[2] = Frame[FrameSize-1];
+  Ack[3] = 0;
+  LinkRef.WriteMessage(kConfigAck,sizeof(Ack),Ack);
+}
+
+/* Where the stand-in keeps the kConfigHash it was last given, as the FMU keeps it in flash */
+static const char ConfigHashFile[] = "fmu-sim-config.bin";
+
+/* Answers the configuration messages from fmu-cfg the way the FMU does. */
+static void HandleConfigMessage(Fmu &LinkRef, BfsMessage MessageId, uint16_t PayloadSize, const uint8_t *Payload) {
+  if (MessageId == kConfigQuery) {
+    uint8_t Stored[BfsCodec::MaxPayloadSize];
+    size_t StoredSize = 0;
+    FILE *File = fopen(ConfigHashFile,"rb");
+    if (File != NULL) {
+      StoredSize = fread(Stored,1,sizeof(Stored),File);
+      fclose(File);
+    }
+    if (StoredSize == 0) {
+      // nothing configured yet: no items and a hash nothing matches
+      memset(Stored,0,10);
+      StoredSize = 10;
+    }
+    LinkRef.WriteMessage(kConfigHash,StoredSize,Stored);
+    return;
+  }
+  if (MessageId == kConfigHash) {
+    FILE *File = fopen(ConfigHashFile,"wb");
+    if (File != NULL) {
+      fwrite(Payload,1,PayloadSize,File);
+      fclose(File);
+    }
+  }
+  if ((MessageId == kMode)||(MessageId == kConfig)||(MessageId == kConfigItem)||(MessageId == kConfigHash)) {
+    AckMessage(LinkRef,MessageId,PayloadSize,Payload);
+  }
+}
+
+/* Stands in for the FMU: replays a datalog to the SOC as data frames, at the pace the
+frames were recorded, a multiple of it, or as fast as the link takes them. Messages
+from the SOC are read and counted so its writes never stall, configuration messages
+are answered so fmu-cfg can upload to it. */
+int main(int argc, char* argv[]) {
+  if ((argc < 4)||(argc > 6)) {
+    std::cerr << "ERROR: Incorrect number of input arguments." << std::endl;
+    std::cerr << "Usage: output <config> <datalog> <transport> [speed] [repeat]" << std::endl;
+    std::cerr << "  transport is the FMU side of the link, uart:PORT for a pseudo-terminal made by the SOC," << std::endl;
+    std::cerr << "  or unix:PATH / unix-listen:PATH" << std::endl;
+    std::cerr << "  speed is a multiple of the recorded rate, or max, default 1" << std::endl;
+    std::cerr << "  repeat is the number of times to play the log, default 1" << std::endl;
+    return -1;
+  }
+  std::string Speed = (argc > 4) ? argv[4] : "1";
+  double Multiple = (Speed == "max") ? 0 : strtod(Speed.c_str(),NULL);
+  size_t Repeat = (argc > 5) ? strtoul(argv[5],NULL,10) : 1;
+
+  /* initialize classes */
+  Fmu Link(argv[3]);
+  Link.SetTxBulkLimit(0);   // nothing is sent the other way that needs to get ahead of the data
+
+  /* initialize structures, the configuration gives the datalog record layout */
+  AircraftConfig Config = {0};
+  FmuData Data;
+  FmuDataLayout Layout;
+  LoadConfigFile(argv[1],Link,&Config,&Data,&Layout);
+  BfsMessage DataMessage = (Layout.Encoding == kRawEncoding) ? kData : kDataPacked;
+
+  /* load the datalog */
+  FILE *LogFile = fopen(argv[2],"rb");
+  if (LogFile == NULL) {
+    std::cerr << "ERROR: Could not open " << argv[2] << std::endl;
+    return -1;
+  }
+  fseek(LogFile,0,SEEK_END);
+  size_t Records = ftell(LogFile)/Layout.PayloadSize;
+  rewind(LogFile);
+  std::vector<uint8_t> Log(Records*Layout.PayloadSize);
+  if (fread(Log.data(),Layout.PayloadSize,Records,LogFile) != Records) {
+    std::cerr << "ERROR: Could not read " << argv[2] << std::endl;
+    return -1;
+  }
+  fclose(LogFile);
+  if (Records == 0) {
+    std::cerr << "ERROR: " << argv[2] << " holds no records for this configuration" << std::endl;
+    return -1;
+  }
+  std::cout << "Replaying " << Records << " records of " << Layout.PayloadSize << " bytes, " << GetDataEncodingName(Layout.Encoding) << " encoding" << std::endl;
+
+  // each repeat follows on one mean frame period after the last record
+  uint64_t FirstTime_us = FmuDataView(Layout,Log.data()).Time_us();
+  uint64_t LastTime_us = FmuDataView(Layout,Log.data()+(Records-1)*Layout.PayloadSize).Time_us();
+  uint64_t Span_us = LastTime_us - FirstTime_us;
+  if (Records > 1) {
+    Span_us += Span_us/(Records-1);
+  }
+
+  /* main loop */
+  uint8_t Payload[BfsCodec::MaxPayloadSize];
+  BfsMessage MessageId;
+  uint16_t PayloadSize;
+  size_t Received = 0;
+  size_t Sent = 0;
+  uint64_t Start_ns = Now_ns();
+  for (size_t i=0; i < Repeat; i++) {
+    for (size_t j=0; j < Records; j++) {
+      uint8_t *Record = Log.data() + j*Layout.PayloadSize;
+      if (Multiple > 0) {
+        uint64_t Time_us = FmuDataView(Layout,Record).Time_us() - FirstTime_us + i*Span_us;
+        SleepUntil_ns(Start_ns + (uint64_t)(Time_us*1000.0/Multiple));
+      }
+      while (Link.ReadMessage(&MessageId,&PayloadSize,Payload)) {
+        HandleConfigMessage(Link,MessageId,PayloadSize,Payload);
+        Received++;
+      }
+      Link.WriteMessage(DataMessage,Layout.PayloadSize,Record);
+      Sent++;
+    }
+  }
+  double Elapsed_s = (Now_ns() - Start_ns)/1e9;
+  std::cout << "Sent " << Sent << " frames in " << Elapsed_s << " s, " << Sent/Elapsed_s << " frames/s, "
+    << Sent*(Layout.PayloadSize + BfsCodec::Overhead)/Elapsed_s/1e6 << " MB/s" << std::endl;
+  std::cout << "Received " << Received << " messages from the SOC" << std::endl;
+
+	return 0;
+}
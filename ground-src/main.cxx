@@ -0,0 +1,218 @@
+/*
+main.cxx
+Brian R Taylor
+brian.taylor@bolderflight.com
+2017-04-18
+Copyright (c) 2017 Bolder Flight Systems
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING 
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "telemetry-codec.hxx"
+#include "global-defs.hxx"
+#include "../soc-includes/rapidjson/document.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/* Monotonic clock, us */
+static uint64_t Now_us() {
+  struct timespec Time;
+  clock_gettime(CLOCK_MONOTONIC,&Time);
+  return (uint64_t)Time.tv_sec*1000000ULL + Time.tv_nsec/1000;
+}
+
+/* Command sent to the aircraft and waiting on its acknowledgement */
+struct PendingCommand {
+  UplinkCommand Command;
+  uint64_t SentTime_us;
+  bool Acknowledged;
+};
+
+/* A stand-in for the ground station: receives the telemetry the SOC sends, counts
+what arrives and what is lost, and sends it commands, a ping every second and any
+values given on the command line, resending each until it is acknowledged. */
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    std::cerr << "ERROR: Incorrect number of input arguments." << std::endl;
+    std::cerr << "Usage: output <config> [seconds] [aircraft] [index=value ...]" << std::endl;
+    std::cerr << "  seconds to listen for, default 10" << std::endl;
+    std::cerr << "  aircraft is the IPv4 address of the SOC, default 127.0.0.1" << std::endl;
+    std::cerr << "  index=value sets Uplink/index on the aircraft to value" << std::endl;
+    return -1;
+  }
+  double Duration_s = (argc > 2) ? strtod(argv[2],NULL) : 10.0;
+  std::string AircraftAddress = (argc > 3) ? argv[3] : "127.0.0.1";
+
+  /* telemetry settings from the aircraft configuration, the channels give the packet layout */
+  std::ifstream ConfigFile(argv[1]);
+  std::string ConfigBuffer((std::istreambuf_iterator<char>(ConfigFile)),std::istreambuf_iterator<char>());
+  rapidjson::Document ConfigDom;
+  ConfigDom.Parse(ConfigBuffer.c_str());
+  if (!ConfigDom.IsObject()||!ConfigDom.HasMember("Telemetry")) {
+    std::cerr << "ERROR: " << argv[1] << " has no Telemetry configuration." << std::endl;
+    return -1;
+  }
+  TelemetryConfig Config = {false,"127.0.0.1",5600,5601,std::vector<TelemetryChannel>()};
+  ParseTelemetryConfig(ConfigDom["Telemetry"],&Config);
+
+  /* commands from the command line */
+  std::vector<PendingCommand> Commands;
+  for (int i=4; i < argc; i++) {
+    const char *Equals = strchr(argv[i],'=');
+    if (Equals == NULL) {
+      std::cerr << "ERROR: " << argv[i] << " is not index=value." << std::endl;
+      return -1;
+    }
+    PendingCommand Pending = {{kUplinkSetValue,(uint16_t)Commands.size(),(uint8_t)atoi(argv[i]),(float)atof(Equals+1)},0,false};
+    Commands.push_back(Pending);
+  }
+
+  /* socket on the ground port, commands go to the aircraft's port */
+  int Socket = socket(AF_INET,SOCK_DGRAM,0);
+  struct sockaddr_in Local;
+  memset(&Local,0,sizeof(Local));
+  Local.sin_family = AF_INET;
+  Local.sin_addr.s_addr = htonl(INADDR_ANY);
+  Local.sin_port = htons(Config.GroundPort);
+  if ((Socket < 0)||(bind(Socket,(struct sockaddr *)&Local,sizeof(Local)) < 0)) {
+    std::cerr << "ERROR: Could not bind port " << Config.GroundPort << ", " << strerror(errno) << std::endl;
+    return -1;
+  }
+  struct sockaddr_in Aircraft;
+  memset(&Aircraft,0,sizeof(Aircraft));
+  Aircraft.sin_family = AF_INET;
+  Aircraft.sin_port = htons(Config.Port);
+  if (inet_pton(AF_INET,AircraftAddress.c_str(),&Aircraft.sin_addr) != 1) {
+    std::cerr << "ERROR: " << AircraftAddress << " is not an IPv4 address." << std::endl;
+    return -1;
+  }
+  std::cout << "Listening on port " << Config.GroundPort << " for " << Config.Channels.size() << " channels, commands to " << AircraftAddress << ":" << Config.Port << std::endl;
+
+  uint64_t Samples = 0, Bytes = 0, Lost = 0, Invalid = 0, NavSamples = 0;
+  uint64_t Acks = 0, Rejected = 0, RoundTripSum_us = 0, RoundTripMax_us = 0;
+  uint64_t IntervalSamples = 0;
+  uint16_t PingSequence = 0x8000;
+  bool Started = false;
+  TelemetrySample Sample;
+  memset(&Sample,0,sizeof(Sample));
+  uint16_t NextSequence = 0;
+  uint64_t Start_us = Now_us();
+  uint64_t End_us = Start_us + (uint64_t)(Duration_s*1e6);
+  uint64_t NextReport_us = Start_us + 1000000;
+  uint64_t NextSend_us = Start_us;
+  while (Now_us() < End_us) {
+    // ping once a second, and resend every command not yet acknowledged
+    if (Now_us() >= NextSend_us) {
+      PendingCommand Ping = {{kUplinkPing,PingSequence++,0,0.0f},0,false};
+      if (PingSequence == 0) {
+        PingSequence = 0x8000;
+      }
+      Commands.push_back(Ping);
+      for (size_t i=0; i < Commands.size(); i++) {
+        if (!Commands[i].Acknowledged&&((Commands[i].Command.Type == kUplinkSetValue)||(i == Commands.size()-1))) {
+          uint8_t Packet[UplinkCommandSize];
+          EncodeUplinkCommand(Commands[i].Command,Packet);
+          Commands[i].SentTime_us = Now_us();
+          sendto(Socket,Packet,sizeof(Packet),0,(struct sockaddr *)&Aircraft,sizeof(Aircraft));
+        }
+      }
+      NextSend_us += 1000000;
+    }
+    struct pollfd Poll = {Socket,POLLIN,0};
+    if (poll(&Poll,1,100) <= 0) {
+      continue;
+    }
+    uint8_t Packet[MaxTelemetryPacketSize];
+    ssize_t PacketSize = recv(Socket,Packet,sizeof(Packet),0);
+    if (PacketSize <= 0) {
+      continue;
+    }
+    TelemetryAck Ack;
+    if (DecodeTelemetryAck(Packet,PacketSize,&Ack)) {
+      for (size_t i=0; i < Commands.size(); i++) {
+        if ((Commands[i].Command.Sequence == Ack.Sequence)&&!Commands[i].Acknowledged) {
+          Commands[i].Acknowledged = true;
+          uint64_t RoundTrip_us = Now_us() - Commands[i].SentTime_us;
+          RoundTripSum_us += RoundTrip_us;
+          RoundTripMax_us = std::max(RoundTripMax_us,RoundTrip_us);
+          if (Ack.Status == 0) {
+            Acks++;
+          } else {
+            Rejected++;
+          }
+        }
+      }
+      continue;
+    }
+    if (!DecodeTelemetrySample(Packet,PacketSize,Config.Channels,&Sample)) {
+      Invalid++;
+      continue;
+    }
+    if (Started&&(Sample.Sequence != NextSequence)) {
+      Lost += (uint16_t)(Sample.Sequence - NextSequence);
+    }
+    NextSequence = Sample.Sequence + 1;
+    Started = true;
+    Samples++;
+    IntervalSamples++;
+    Bytes += PacketSize;
+    if (Sample.NavValid) {
+      NavSamples++;
+    }
+    if (Now_us() >= NextReport_us) {
+      printf("t %.3f s: %llu samples/s, %zd bytes",Sample.Time_ms*1e-3,(unsigned long long)IntervalSamples,PacketSize);
+      if (Sample.NavValid) {
+        printf(", lat %.7f lon %.7f alt %.1f m, vel %.2f %.2f %.2f m/s, euler %.4f %.4f %.4f rad",
+          Sample.LLA[0]*180.0/M_PI,Sample.LLA[1]*180.0/M_PI,Sample.LLA[2],
+          Sample.NEDVelocity_ms[0],Sample.NEDVelocity_ms[1],Sample.NEDVelocity_ms[2],
+          Sample.Euler_rad[0],Sample.Euler_rad[1],Sample.Euler_rad[2]);
+      }
+      for (size_t i=0; i < Sample.NumberChannels; i++) {
+        printf(", %s %g",Config.Channels[i].Name.c_str(),Sample.Channels[i]);
+      }
+      printf("\n");
+      IntervalSamples = 0;
+      NextReport_us += 1000000;
+    }
+  }
+  close(Socket);
+
+  printf("Telemetry: %llu samples, %llu with navigation, %llu lost, %llu invalid",
+    (unsigned long long)Samples,(unsigned long long)NavSamples,(unsigned long long)Lost,(unsigned long long)Invalid);
+  if (Samples > 0) {
+    printf(", %.1f bytes a sample",(double)Bytes/Samples);
+  }
+  printf("\n");
+  size_t Unanswered = 0;
+  for (size_t i=0; i < Commands.size(); i++) {
+    Unanswered += Commands[i].Acknowledged ? 0 : 1;
+  }
+  printf("Uplink: %zu commands, %llu acknowledged, %llu rejected, %zu unanswered",Commands.size(),(unsigned long long)Acks,(unsigned long long)Rejected,Unanswered);
+  if (Acks + Rejected > 0) {
+    printf(", round trip %llu us mean, %llu us max",(unsigned long long)(RoundTripSum_us/(Acks + Rejected)),(unsigned long long)RoundTripMax_us);
+  }
+  printf("\n");
+	return 0;
+}
@@ -0,0 +1,509 @@
+
+#include "ekf-batch.hxx"
+
+const size_t EKF15Batch::Lanes;
+const size_t EKF15Batch::States;
+const size_t EKF15Batch::PackedSize;
+
+/* One 3x3 block of a matrix in every lane, row major */
+typedef double LaneBlock[9][EKF15Batch::Lanes];
+
+/* Index of P(i,j), i <= j, in the packed upper triangle */
+static inline size_t PackedIndex(size_t i,size_t j) {
+  return i*15 - i*(i-1)/2 + (j-i);
+}
+
+/* Block (bi,bj) of the packed symmetric matrix, blocks are position, velocity,
+attitude, accel bias and gyro bias */
+static void GetBlock(const double (*Packed)[EKF15Batch::Lanes],size_t bi,size_t bj,LaneBlock Block) {
+  for (size_t r=0; r < 3; r++) {
+    for (size_t c=0; c < 3; c++) {
+      size_t i = 3*bi + r, j = 3*bj + c;
+      const double *Entry = Packed[(i <= j) ? PackedIndex(i,j) : PackedIndex(j,i)];
+      for (size_t l=0; l < EKF15Batch::Lanes; l++) {
+        Block[3*r+c][l] = Entry[l];
+      }
+    }
+  }
+}
+
+/* Stores the upper triangle part of block (bi,bj), bi <= bj, of the packed matrix */
+static void SetBlock(double (*Packed)[EKF15Batch::Lanes],size_t bi,size_t bj,const LaneBlock Block) {
+  for (size_t r=0; r < 3; r++) {
+    for (size_t c=(bi == bj) ? r : 0; c < 3; c++) {
+      double *Entry = Packed[PackedIndex(3*bi + r,3*bj + c)];
+      for (size_t l=0; l < EKF15Batch::Lanes; l++) {
+        Entry[l] = Block[3*r+c][l];
+      }
+    }
+  }
+}
+
+/* Y = a*X */
+static inline void Scale(double a,const LaneBlock X,LaneBlock Y) {
+  for (size_t e=0; e < 9; e++) {
+    for (size_t l=0; l < EKF15Batch::Lanes; l++) {
+      Y[e][l] = a*X[e][l];
+    }
+  }
+}
+
+/* Y = a*X, a per lane */
+static inline void Scale(const double *a,const LaneBlock X,LaneBlock Y) {
+  for (size_t e=0; e < 9; e++) {
+    for (size_t l=0; l < EKF15Batch::Lanes; l++) {
+      Y[e][l] = a[l]*X[e][l];
+    }
+  }
+}
+
+/* Y += a*X */
+static inline void AddScaled(double a,const LaneBlock X,LaneBlock Y) {
+  for (size_t e=0; e < 9; e++) {
+    for (size_t l=0; l < EKF15Batch::Lanes; l++) {
+      Y[e][l] += a*X[e][l];
+    }
+  }
+}
+
+/* Z += X*Y */
+static inline void MulAdd(const LaneBlock X,const LaneBlock Y,LaneBlock Z) {
+  for (size_t r=0; r < 3; r++) {
+    for (size_t c=0; c < 3; c++) {
+      for (size_t k=0; k < 3; k++) {
+        for (size_t l=0; l < EKF15Batch::Lanes; l++) {
+          Z[3*r+c][l] += X[3*r+k][l]*Y[3*k+c][l];
+        }
+      }
+    }
+  }
+}
+
+/* Z += X*Y' */
+static inline void MulTransposeAdd(const LaneBlock X,const LaneBlock Y,LaneBlock Z) {
+  for (size_t r=0; r < 3; r++) {
+    for (size_t c=0; c < 3; c++) {
+      for (size_t k=0; k < 3; k++) {
+        for (size_t l=0; l < EKF15Batch::Lanes; l++) {
+          Z[3*r+c][l] += X[3*r+k][l]*Y[3*c+k][l];
+        }
+      }
+    }
+  }
+}
+
+/* Sk = sk(w), the skew symmetric matrix of w */
+static inline void Skew(const double (*w)[EKF15Batch::Lanes],LaneBlock Sk) {
+  for (size_t l=0; l < EKF15Batch::Lanes; l++) {
+    Sk[0][l] = 0.0;      Sk[1][l] = -w[2][l]; Sk[2][l] = w[1][l];
+    Sk[3][l] = w[2][l];  Sk[4][l] = 0.0;      Sk[5][l] = -w[0][l];
+    Sk[6][l] = -w[1][l]; Sk[7][l] = w[0][l];  Sk[8][l] = 0.0;
+  }
+}
+
+EKF15Batch::EKF15Batch() {
+  EKF15 Scalar;
+  for (size_t l=0; l < Lanes; l++) {
+    SetConfig(l,Scalar.get_config());
+  }
+  memset(Score_,0,sizeof(Score_));
+}
+
+/* Sets the config of one lane, before Initialize. */
+void EKF15Batch::SetConfig(size_t Lane,const NAVconfig &Config) {
+  Ra_[0][Lane] = Config.sig_w_ax*Config.sig_w_ax;
+  Ra_[1][Lane] = Config.sig_w_ay*Config.sig_w_ay;
+  Ra_[2][Lane] = Config.sig_w_az*Config.sig_w_az;
+  Rg_[0][Lane] = Config.sig_w_gx*Config.sig_w_gx;
+  Rg_[1][Lane] = Config.sig_w_gy*Config.sig_w_gy;
+  Rg_[2][Lane] = Config.sig_w_gz*Config.sig_w_gz;
+  Rab_[Lane] = 2*Config.sig_a_d*Config.sig_a_d/Config.tau_a;
+  Rgb_[Lane] = 2*Config.sig_g_d*Config.sig_g_d/Config.tau_g;
+  TauA_[Lane] = Config.tau_a;
+  TauG_[Lane] = Config.tau_g;
+  Rgps_[0][Lane] = Rgps_[1][Lane] = Config.sig_gps_p_ne*Config.sig_gps_p_ne;
+  Rgps_[2][Lane] = Config.sig_gps_p_d*Config.sig_gps_p_d;
+  Rgps_[3][Lane] = Rgps_[4][Lane] = Config.sig_gps_v_ne*Config.sig_gps_v_ne;
+  Rgps_[5][Lane] = Config.sig_gps_v_d*Config.sig_gps_v_d;
+}
+
+/* Starts every lane from the same solution, as EKF15::init returns it: its
+covariance is the diagonal given there. Clears the scores. */
+void EKF15Batch::Initialize(const NAVdata &NavDataRef) {
+  const double Diagonal[States] = {NavDataRef.Pp0,NavDataRef.Pp1,NavDataRef.Pp2,NavDataRef.Pv0,NavDataRef.Pv1,NavDataRef.Pv2,
+    NavDataRef.Pa0,NavDataRef.Pa1,NavDataRef.Pa2,NavDataRef.Pabx,NavDataRef.Paby,NavDataRef.Pabz,NavDataRef.Pgbx,NavDataRef.Pgby,NavDataRef.Pgbz};
+  Time_ = NavDataRef.time;
+  memset(P_,0,sizeof(P_));
+  for (size_t l=0; l < Lanes; l++) {
+    Lat_[l] = NavDataRef.lat;
+    Lon_[l] = NavDataRef.lon;
+    Alt_[l] = NavDataRef.alt;
+    Vel_[0][l] = NavDataRef.vn;
+    Vel_[1][l] = NavDataRef.ve;
+    Vel_[2][l] = NavDataRef.vd;
+    Quat_[0][l] = NavDataRef.qw;
+    Quat_[1][l] = NavDataRef.qx;
+    Quat_[2][l] = NavDataRef.qy;
+    Quat_[3][l] = NavDataRef.qz;
+    AccelBias_[0][l] = NavDataRef.abx;
+    AccelBias_[1][l] = NavDataRef.aby;
+    AccelBias_[2][l] = NavDataRef.abz;
+    GyroBias_[0][l] = NavDataRef.gbx;
+    GyroBias_[1][l] = NavDataRef.gby;
+    GyroBias_[2][l] = NavDataRef.gbz;
+    for (size_t i=0; i < States; i++) {
+      P_[PackedIndex(i,i)][l] = Diagonal[i];
+    }
+  }
+  memset(Score_,0,sizeof(Score_));
+}
+
+/* Advances every lane over one interval of IMU increments, then takes the GPS fix
+if it is new. */
+void EKF15Batch::Update(const IMUincrement &ImuRef,const GPSdata &GpsRef) {
+  Time_ = ImuRef.time;
+  Strapdown(ImuRef);
+  CovarianceUpdate(ImuRef.dt);
+  if (GpsRef.newData) {
+    GpsUpdate(GpsRef);
+  }
+}
+
+/* Returns the solution of one lane, as EKF15::update would. */
+NAVdata EKF15Batch::GetNavData(size_t Lane) {
+  NAVdata Nav;
+  memset(&Nav,0,sizeof(Nav));
+  Nav.time = Time_;
+  Nav.lat = Lat_[Lane];
+  Nav.lon = Lon_[Lane];
+  Nav.alt = Alt_[Lane];
+  Nav.vn = Vel_[0][Lane];
+  Nav.ve = Vel_[1][Lane];
+  Nav.vd = Vel_[2][Lane];
+  Quaterniond Quat(Quat_[0][Lane],Quat_[1][Lane],Quat_[2][Lane],Quat_[3][Lane]);
+  Vector3d Euler = quat2eul(Quat);
+  Nav.phi = Euler(0);
+  Nav.the = Euler(1);
+  Nav.psi = Euler(2);
+  Nav.qw = Quat.w();
+  Nav.qx = Quat.x();
+  Nav.qy = Quat.y();
+  Nav.qz = Quat.z();
+  Nav.abx = AccelBias_[0][Lane];
+  Nav.aby = AccelBias_[1][Lane];
+  Nav.abz = AccelBias_[2][Lane];
+  Nav.gbx = GyroBias_[0][Lane];
+  Nav.gby = GyroBias_[1][Lane];
+  Nav.gbz = GyroBias_[2][Lane];
+  Nav.Pp0 = P_[PackedIndex(0,0)][Lane];    Nav.Pp1 = P_[PackedIndex(1,1)][Lane];    Nav.Pp2 = P_[PackedIndex(2,2)][Lane];
+  Nav.Pv0 = P_[PackedIndex(3,3)][Lane];    Nav.Pv1 = P_[PackedIndex(4,4)][Lane];    Nav.Pv2 = P_[PackedIndex(5,5)][Lane];
+  Nav.Pa0 = P_[PackedIndex(6,6)][Lane];    Nav.Pa1 = P_[PackedIndex(7,7)][Lane];    Nav.Pa2 = P_[PackedIndex(8,8)][Lane];
+  Nav.Pabx = P_[PackedIndex(9,9)][Lane];   Nav.Paby = P_[PackedIndex(10,10)][Lane]; Nav.Pabz = P_[PackedIndex(11,11)][Lane];
+  Nav.Pgbx = P_[PackedIndex(12,12)][Lane]; Nav.Pgby = P_[PackedIndex(13,13)][Lane]; Nav.Pgbz = P_[PackedIndex(14,14)][Lane];
+  Nav.err_type = data_valid;
+  return Nav;
+}
+
+/* Returns the GPS innovation statistics of one lane since Initialize. */
+InnovationScore EKF15Batch::GetScore(size_t Lane) {
+  return Score_[Lane];
+}
+
+/* Attitude, velocity and position over the interval, from the mean specific force
+and rate less each lane's biases, as EKF15::update on increments and its time
+update. Leaves the body to nav DCM from before the attitude update, the specific
+force and the rate for the covariance update. */
+void EKF15Batch::Strapdown(const IMUincrement &ImuRef) {
+  const double Dt_s = ImuRef.dt;
+  for (size_t l=0; l < Lanes; l++) {
+    double Rotation[3];
+    for (size_t k=0; k < 3; k++) {
+      F_[k][l] = ImuRef.dvel[k]/Dt_s - AccelBias_[k][l];
+      Om_[k][l] = ImuRef.dtheta[k]/Dt_s - GyroBias_[k][l];
+      Rotation[k] = Om_[k][l]*Dt_s;
+    }
+    // attitude increment, the rotation vector taken exactly
+    double Angle = sqrt(Rotation[0]*Rotation[0] + Rotation[1]*Rotation[1] + Rotation[2]*Rotation[2]);
+    double dq[4];
+    if (Angle > 1e-12) {
+      double Half = 0.5*Angle;
+      double Sine = sin(Half)/Angle;
+      dq[0] = cos(Half);
+      dq[1] = Sine*Rotation[0];
+      dq[2] = Sine*Rotation[1];
+      dq[3] = Sine*Rotation[2];
+    } else {
+      dq[0] = 1.0;
+      dq[1] = 0.5*Rotation[0];
+      dq[2] = 0.5*Rotation[1];
+      dq[3] = 0.5*Rotation[2];
+    }
+    // body to nav DCM, the transpose of quat2dcm
+    double q0 = Quat_[0][l], q1 = Quat_[1][l], q2 = Quat_[2][l], q3 = Quat_[3][l];
+    C_[0][l] = 2*(q0*q0 + q1*q1) - 1;
+    C_[4][l] = 2*(q0*q0 + q2*q2) - 1;
+    C_[8][l] = 2*(q0*q0 + q3*q3) - 1;
+    C_[3][l] = 2*(q1*q2 + q0*q3);
+    C_[6][l] = 2*(q1*q3 - q0*q2);
+    C_[1][l] = 2*(q1*q2 - q0*q3);
+    C_[7][l] = 2*(q2*q3 + q0*q1);
+    C_[2][l] = 2*(q1*q3 + q0*q2);
+    C_[5][l] = 2*(q2*q3 - q0*q1);
+    // quat = (quat*dq).normalized(), kept in the positive w half
+    double w = q0*dq[0] - q1*dq[1] - q2*dq[2] - q3*dq[3];
+    double x = q0*dq[1] + q1*dq[0] + q2*dq[3] - q3*dq[2];
+    double y = q0*dq[2] + q2*dq[0] + q3*dq[1] - q1*dq[3];
+    double z = q0*dq[3] + q3*dq[0] + q1*dq[2] - q2*dq[1];
+    double Norm = sqrt(w*w + x*x + y*y + z*z);
+    double Sign = (w < 0) ? -1.0 : 1.0;
+    Quat_[0][l] = Sign*w/Norm;
+    Quat_[1][l] = Sign*x/Norm;
+    Quat_[2][l] = Sign*y/Norm;
+    Quat_[3][l] = Sign*z/Norm;
+    // position from the velocity at the start of the interval
+    double Vn = Vel_[0][l], Ve = Vel_[1][l], Vd = Vel_[2][l];
+    double Lat = Lat_[l], Alt = Alt_[l];
+    double Denom = fabs(1.0 - (ECC2*sin(Lat)*sin(Lat)));
+    double SqrtDenom = sqrt(Denom);
+    double Rew = EARTH_RADIUS/SqrtDenom;
+    double Rns = EARTH_RADIUS*(1-ECC2)/(Denom*SqrtDenom);
+    for (size_t r=0; r < 3; r++) {
+      double Accel = C_[3*r][l]*F_[0][l] + C_[3*r+1][l]*F_[1][l] + C_[3*r+2][l]*F_[2][l];
+      if (r == 2) {
+        Accel += g;
+      }
+      Vel_[r][l] += Dt_s*Accel;
+    }
+    Lat_[l] += Dt_s*(Vn/(Rns + Alt));
+    Lon_[l] += Dt_s*(Ve/((Rew + Alt)*cos(Lat)));
+    Alt_[l] += Dt_s*(-Vd);
+  }
+}
+
+/* P = PHI*P*PHI' + Q on the packed blocks, EKF15's structured time update in every
+lane: see time_update_structured for the block pattern of PHI. */
+void EKF15Batch::CovarianceUpdate(double Dt_s) {
+  LaneBlock A, B, D, Sk, Qv, Qa;
+  double ka[Lanes], kg[Lanes];
+  const double c = -2.0*g/EARTH_RADIUS*Dt_s;
+  const double h = -0.5*Dt_s;
+  // A = -2*dt*C*sk(f), B = -dt*C, D = I - dt*sk(om)
+  Skew(F_,Sk);
+  memset(A,0,sizeof(A));
+  MulAdd(C_,Sk,A);
+  Scale(-2.0*Dt_s,A,A);
+  Scale(-Dt_s,C_,B);
+  Skew(Om_,Sk);
+  Scale(-Dt_s,Sk,D);
+  for (size_t l=0; l < Lanes; l++) {
+    D[0][l] += 1.0;
+    D[4][l] += 1.0;
+    D[8][l] += 1.0;
+    ka[l] = 1.0 - Dt_s/TauA_[l];
+    kg[l] = 1.0 - Dt_s/TauG_[l];
+  }
+  // blocks of Qw: velocity dt*C*Ra*C', attitude diagonal, the biases scaled identities
+  for (size_t r=0; r < 3; r++) {
+    for (size_t s=0; s < 3; s++) {
+      for (size_t l=0; l < Lanes; l++) {
+        Qv[3*r+s][l] = Dt_s*(C_[3*r][l]*Ra_[0][l]*C_[3*s][l] + C_[3*r+1][l]*Ra_[1][l]*C_[3*s+1][l] + C_[3*r+2][l]*Ra_[2][l]*C_[3*s+2][l]);
+        Qa[3*r+s][l] = (r == s) ? 0.25*Dt_s*Rg_[r][l] : 0.0;
+      }
+    }
+  }
+
+  LaneBlock M[5], Pk, Block;
+  for (size_t i=0; i < 5; i++) {
+    // M row i = PHI row i * P, only the columns the blocks at and right of the diagonal use
+    for (size_t k=(i < 2) ? 0 : i; k < 5; k++) {
+      switch (i) {
+        case 0:
+          GetBlock(P_,0,k,M[k]);
+          GetBlock(P_,1,k,Pk);
+          AddScaled(Dt_s,Pk,M[k]);
+          break;
+        case 1:
+          GetBlock(P_,1,k,M[k]);
+          GetBlock(P_,2,k,Pk);
+          MulAdd(A,Pk,M[k]);
+          GetBlock(P_,3,k,Pk);
+          MulAdd(B,Pk,M[k]);
+          GetBlock(P_,0,k,Pk);
+          for (size_t e=6; e < 9; e++) {
+            for (size_t l=0; l < Lanes; l++) {
+              M[k][e][l] += c*Pk[e][l];
+            }
+          }
+          break;
+        case 2:
+          memset(M[k],0,sizeof(LaneBlock));
+          GetBlock(P_,2,k,Pk);
+          MulAdd(D,Pk,M[k]);
+          GetBlock(P_,4,k,Pk);
+          AddScaled(h,Pk,M[k]);
+          break;
+        case 3:
+          GetBlock(P_,3,k,Pk);
+          Scale(ka,Pk,M[k]);
+          break;
+        case 4:
+          GetBlock(P_,4,k,Pk);
+          Scale(kg,Pk,M[k]);
+          break;
+      }
+    }
+    // P row i = M row i * PHI', plus Q = 0.5*(PHI*Qw + Qw*PHI')
+    for (size_t j=i; j < 5; j++) {
+      switch (j) {
+        case 0:
+          memcpy(Block,M[0],sizeof(LaneBlock));
+          AddScaled(Dt_s,M[1],Block);
+          break;
+        case 1:
+          memcpy(Block,M[1],sizeof(LaneBlock));
+          MulTransposeAdd(M[2],A,Block);
+          MulTransposeAdd(M[3],B,Block);
+          for (size_t r=0; r < 3; r++) {
+            for (size_t l=0; l < Lanes; l++) {
+              Block[3*r+2][l] += c*M[0][3*r+2][l];
+            }
+          }
+          break;
+        case 2:
+          memset(Block,0,sizeof(LaneBlock));
+          MulTransposeAdd(M[2],D,Block);
+          AddScaled(h,M[4],Block);
+          break;
+        case 3:
+          Scale(ka,M[3],Block);
+          break;
+        case 4:
+          Scale(kg,M[4],Block);
+          break;
+      }
+      if ((i == 0)&&(j == 1)) {
+        AddScaled(0.5*Dt_s,Qv,Block);
+      } else if ((i == 1)&&(j == 1)) {
+        AddScaled(1.0,Qv,Block);
+      } else if ((i == 1)&&(j == 2)) {
+        for (size_t e=0; e < 9; e++) {
+          for (size_t l=0; l < Lanes; l++) {
+            Block[e][l] += 0.5*A[e][l]*Qa[4*(e%3)][l];
+          }
+        }
+      } else if ((i == 1)&&(j == 3)) {
+        for (size_t e=0; e < 9; e++) {
+          for (size_t l=0; l < Lanes; l++) {
+            Block[e][l] += 0.5*B[e][l]*Dt_s*Rab_[l];
+          }
+        }
+      } else if ((i == 2)&&(j == 2)) {
+        for (size_t r=0; r < 3; r++) {
+          for (size_t s=0; s < 3; s++) {
+            for (size_t l=0; l < Lanes; l++) {
+              Block[3*r+s][l] += 0.5*(D[3*r+s][l]*Qa[4*s][l] + Qa[4*r][l]*D[3*s+r][l]);
+            }
+          }
+        }
+      } else if ((i == 2)&&(j == 4)) {
+        for (size_t r=0; r < 3; r++) {
+          for (size_t l=0; l < Lanes; l++) {
+            Block[4*r][l] += 0.5*h*Dt_s*Rgb_[l];
+          }
+        }
+      } else if ((i == 3)&&(j == 3)) {
+        for (size_t r=0; r < 3; r++) {
+          for (size_t l=0; l < Lanes; l++) {
+            Block[4*r][l] += ka[l]*Dt_s*Rab_[l];
+          }
+        }
+      } else if ((i == 4)&&(j == 4)) {
+        for (size_t r=0; r < 3; r++) {
+          for (size_t l=0; l < Lanes; l++) {
+            Block[4*r][l] += kg[l]*Dt_s*Rgb_[l];
+          }
+        }
+      }
+      SetBlock(PNext_,i,j,Block);
+    }
+  }
+  memcpy(P_,PNext_,sizeof(P_));
+}
+
+/* EKF15's sequential GPS update in every lane: the position and velocity
+innovations, six scalar updates on the packed covariance, then the correction
+of the solution. Each scalar innovation and its variance go into the lane's score. */
+void EKF15Batch::GpsUpdate(const GPSdata &GpsRef) {
+  Vector3d GpsEcef = lla2ecef(Vector3d(GpsRef.lat,GpsRef.lon,GpsRef.alt));
+  const double GpsVel[3] = {GpsRef.vn,GpsRef.ve,GpsRef.vd};
+  double y[6][Lanes], x[States][Lanes], p[States][Lanes], k[States][Lanes], s[Lanes], Innovation[Lanes];
+  for (size_t l=0; l < Lanes; l++) {
+    Vector3d Position(Lat_[l],Lon_[l],Alt_[l]);
+    Vector3d Reference(Lat_[l],Lon_[l],0.0);
+    Vector3d InsNed = ecef2ned(lla2ecef(Position),Reference);
+    Vector3d GpsNed = ecef2ned(GpsEcef,Reference);
+    for (size_t m=0; m < 3; m++) {
+      y[m][l] = GpsNed(m) - InsNed(m);
+      y[m+3][l] = GpsVel[m] - Vel_[m][l];
+      Score_[l].Position_m2 += y[m][l]*y[m][l];
+      Score_[l].Velocity_m2s2 += y[m+3][l]*y[m+3][l];
+    }
+    Score_[l].Epochs++;
+  }
+  memset(x,0,sizeof(x));
+  for (size_t m=0; m < 6; m++) {
+    for (size_t i=0; i < States; i++) {
+      const double *Entry = P_[(i <= m) ? PackedIndex(i,m) : PackedIndex(m,i)];
+      for (size_t l=0; l < Lanes; l++) {
+        p[i][l] = Entry[l];
+      }
+    }
+    for (size_t l=0; l < Lanes; l++) {
+      s[l] = p[m][l] + Rgps_[m][l];
+      Innovation[l] = y[m][l] - x[m][l];
+      Score_[l].NegLogLikelihood += 0.5*(log(s[l]) + Innovation[l]*Innovation[l]/s[l]);
+      Score_[l].Nis += Innovation[l]*Innovation[l]/s[l];
+    }
+    for (size_t i=0; i < States; i++) {
+      for (size_t l=0; l < Lanes; l++) {
+        k[i][l] = p[i][l]/s[l];
+        x[i][l] += k[i][l]*Innovation[l];
+      }
+    }
+    size_t Index = 0;
+    for (size_t i=0; i < States; i++) {
+      for (size_t j=i; j < States; j++) {
+        for (size_t l=0; l < Lanes; l++) {
+          P_[Index][l] += s[l]*k[i][l]*k[j][l] - k[i][l]*p[j][l] - p[i][l]*k[j][l];
+        }
+        Index++;
+      }
+    }
+  }
+  for (size_t l=0; l < Lanes; l++) {
+    double Denom = (1.0 - (ECC2*sin(Lat_[l])*sin(Lat_[l])));
+    Denom = sqrt(Denom*Denom);
+    double Re = EARTH_RADIUS/sqrt(Denom);
+    double Rn = EARTH_RADIUS*(1-ECC2)/Denom*sqrt(Denom);
+    Alt_[l] = Alt_[l] - x[2][l];
+    Lat_[l] = Lat_[l] + x[0][l]/(Re + Alt_[l]);
+    Lon_[l] = Lon_[l] + x[1][l]/(Rn + Alt_[l])/cos(Lat_[l]);
+    for (size_t m=0; m < 3; m++) {
+      Vel_[m][l] += x[m+3][l];
+      AccelBias_[m][l] += x[m+9][l];
+      GyroBias_[m][l] += x[m+12][l];
+    }
+    // attitude correction, quat = (quat*[1 x6 x7 x8]).normalized()
+    double q0 = Quat_[0][l], q1 = Quat_[1][l], q2 = Quat_[2][l], q3 = Quat_[3][l];
+    double d1 = x[6][l], d2 = x[7][l], d3 = x[8][l];
+    double w = q0 - q1*d1 - q2*d2 - q3*d3;
+    double qx = q0*d1 + q1 + q2*d3 - q3*d2;
+    double qy = q0*d2 + q2 + q3*d1 - q1*d3;
+    double qz = q0*d3 + q3 + q1*d2 - q2*d1;
+    double Norm = sqrt(w*w + qx*qx + qy*qy + qz*qz);
+    Quat_[0][l] = w/Norm;
+    Quat_[1][l] = qx/Norm;
+    Quat_[2][l] = qy/Norm;
+    Quat_[3][l] = qz/Norm;
+  }
+}
@@ -0,0 +1,67 @@
+
+#ifndef EKF_BATCH_HXX_
+#define EKF_BATCH_HXX_
+
+#include "EKF_15state.hxx"
+#include "nav_functions.hxx"
+#include "structs.hxx"
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+/* GPS innovation statistics of one filter over a run, from the scalar innovations
+of the sequential update, whose variances factor the innovation covariance S */
+struct InnovationScore {
+  uint64_t Epochs;                          // GPS updates
+  double NegLogLikelihood;                  // sum of 0.5*(log det S + y'*inv(S)*y), less the constant
+  double Nis;                               // sum of y'*inv(S)*y, 6 an epoch on average if consistent
+  double Position_m2;                       // sum of squared position innovations
+  double Velocity_m2s2;                     // sum of squared velocity innovations
+};
+
+/* Lanes copies of EKF15, each with its own NAVconfig, run in lockstep on the same
+IMU increments and GPS fixes. Every state is stored structure of arrays, one entry
+per lane, the covariance as the packed upper triangle with the lanes of each entry
+together, and every step loops over the lanes innermost so the compiler spreads
+them across the vector unit. The arithmetic is EKF15's update on increments with
+its structured time update and sequential GPS update, so each lane follows a
+scalar EKF15 with the same config to rounding. Lanes share nothing but the inputs,
+and a lane given the same config as another gives the same result. */
+class EKF15Batch {
+  public:
+    static const size_t Lanes = 8;
+    EKF15Batch();
+    void SetConfig(size_t Lane,const NAVconfig &Config);
+    void Initialize(const NAVdata &NavDataRef);
+    void Update(const IMUincrement &ImuRef,const GPSdata &GpsRef);
+    NAVdata GetNavData(size_t Lane);
+    InnovationScore GetScore(size_t Lane);
+  private:
+    static const size_t States = 15;
+    static const size_t PackedSize = 120;
+    // navigation solution
+    double Time_;
+    double Lat_[Lanes], Lon_[Lanes], Alt_[Lanes];
+    double Vel_[3][Lanes];
+    double Quat_[4][Lanes];                 // w, x, y, z
+    double AccelBias_[3][Lanes];
+    double GyroBias_[3][Lanes];
+    // covariance, packed upper triangle, and the next one being formed
+    double P_[PackedSize][Lanes];
+    double PNext_[PackedSize][Lanes];
+    // config: noise power of the accels and gyros, the bias Markov processes, GPS
+    double Ra_[3][Lanes], Rg_[3][Lanes];
+    double Rab_[Lanes], Rgb_[Lanes];
+    double TauA_[Lanes], TauG_[Lanes];
+    double Rgps_[6][Lanes];
+    // this step: body to nav DCM before the attitude update, specific force and rate
+    double C_[9][Lanes];
+    double F_[3][Lanes], Om_[3][Lanes];
+    InnovationScore Score_[Lanes];
+    void Strapdown(const IMUincrement &ImuRef);
+    void CovarianceUpdate(double Dt_s);
+    void GpsUpdate(const GPSdata &GpsRef);
+};
+
+#endif
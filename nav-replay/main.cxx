@@ -1,5 +1,5 @@
 /*
-hardware-defs.hxx
+main.cxx
 Brian R Taylor
 brian.taylor@bolderflight.com
 2017-04-18
@@ -18,12 +18,22 @@ DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
-#ifndef HARDWARE_DEFS_HXX_
-#define HARDWARE_DEFS_HXX_
 
-#include <termios.h>
 
-const char FmuPort[] = "/dev/ttyO4";
-const speed_t FmuBaud = B1500000;
+#include "nav-replay.hxx"
+#include <iostream>
+#include <string>
 
-#endif
+int main(int argc, char* argv[]) {
+  if ((argc > 1)&&(std::string(argv[1]) == "tune")) {
+    return TuneNavigation(argc-2,argv+2);
+  }
+  if (argc < 4) {
+    std::cerr << "Usage: output <config> <datalog> <output directory> [nav_hz]" << std::endl;
+    std::cerr << "         replays the datalog through the navigation filter, writing its solution as columns" << std::endl;
+    std::cerr << "       output tune <config> <datalog> <sweep> [threads] [nav_hz]" << std::endl;
+    std::cerr << "         scores every NAVconfig of the sweep on the datalog, many filters at once" << std::endl;
+    return -1;
+  }
+  return ReplayNavigation(argc-1,argv+1);
+}
@@ -0,0 +1,34 @@
+
+#ifndef NAV_REPLAY_HXX_
+#define NAV_REPLAY_HXX_
+
+#include "global-defs.hxx"
+#include "navigation.hxx"
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <functional>
+#include <string>
+
+/* CPU time consumed by this process, ns */
+inline uint64_t CpuTime_ns() {
+  struct timespec Time;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID,&Time);
+  return (uint64_t)Time.tv_sec*1000000000ULL + Time.tv_nsec;
+}
+
+/* A datalog replayed through the flight loop's navigation path */
+struct ReplayStats {
+  size_t Records;
+  double Flight_s;                          // FMU time from the first record to the last
+  double Cpu_s;                             // CPU time the replay took
+};
+
+ReplayStats ReplayLog(const std::string &ConfigFileName,const std::string &LogFileName,double NavRate_hz,
+  Navigation &NavigationRef,const std::function<void(const FmuData &)> &NavigationTask,AircraftConfig *AircraftConfigPtr);
+
+/* Commands, each takes the arguments following the command name */
+int ReplayNavigation(int argc, char* argv[]);
+int TuneNavigation(int argc, char* argv[]);
+
+#endif
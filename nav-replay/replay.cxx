@@ -0,0 +1,198 @@
+
+#include "nav-replay.hxx"
+#include "config.hxx"
+#include "fmu.hxx"
+#include "data-layout.hxx"
+#include "scheduler.hxx"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/* Replays a datalog through navigation as the flight loop runs it. The log is
+mapped rather than read. Each record is merged over the last as the FMU link does,
+so navigation sees the same update flags it did in flight, its IMU sample is added,
+and the Navigation task is released on FMU time by the flight loop's scheduler at
+the configured rate, or NavRate_hz if that is not negative. The task's deadline is
+dropped, so nothing depends on the wall clock. The config loaded is returned in
+AircraftConfigPtr. */
+ReplayStats ReplayLog(const std::string &ConfigFileName,const std::string &LogFileName,double NavRate_hz,
+  Navigation &NavigationRef,const std::function<void(const FmuData &)> &NavigationTask,AircraftConfig *AircraftConfigPtr) {
+  int NullDesc = open("/dev/null",O_RDWR);
+  if (NullDesc < 0) {
+    throw std::runtime_error(std::string("Could not open /dev/null, ") + strerror(errno) + ".");
+  }
+  Fmu Null(NullDesc);
+  AircraftConfig &Config = *AircraftConfigPtr;
+  FmuData Data;
+  FmuDataLayout Layout;
+  LoadConfigFile(ConfigFileName,Null,&Config,&Data,&Layout);
+  NavigationRef.Configure(Config.Navigation);
+
+  int LogDesc = open(LogFileName.c_str(),O_RDONLY);
+  if (LogDesc < 0) {
+    throw std::runtime_error("Could not open " + LogFileName + ".");
+  }
+  struct stat LogStat;
+  if (fstat(LogDesc,&LogStat) < 0) {
+    close(LogDesc);
+    throw std::runtime_error("Could not open " + LogFileName + ".");
+  }
+  ReplayStats Stats = {(size_t)(LogStat.st_size/Layout.PayloadSize),0.0,0.0};
+  if (Stats.Records == 0) {
+    close(LogDesc);
+    throw std::runtime_error(LogFileName + " holds no complete records.");
+  }
+  const uint8_t *Log = (const uint8_t *)mmap(NULL,LogStat.st_size,PROT_READ,MAP_PRIVATE,LogDesc,0);
+  if (Log == MAP_FAILED) {
+    std::string Reason = strerror(errno);
+    close(LogDesc);
+    throw std::runtime_error("Could not map " + LogFileName + ", " + Reason + ".");
+  }
+  madvise((void *)Log,LogStat.st_size,MADV_SEQUENTIAL);
+
+  TaskConfig NavTask = Config.Tasks[0];
+  for (size_t i=0; i < Config.Tasks.size(); i++) {
+    if (Config.Tasks[i].Name == "Navigation") {
+      NavTask = Config.Tasks[i];
+    }
+  }
+  if (NavRate_hz >= 0.0) {
+    NavTask.Rate_hz = NavRate_hz;
+  }
+  NavTask.Deadline_us = 0;
+  NavTask.Slack = false;
+  FrameScheduler Scheduler;
+  Scheduler.AddTask(NavTask,[&]() {
+    NavigationTask(Data);
+  });
+
+  std::vector<uint8_t> Payload(Layout.PayloadSize,0);
+  std::vector<uint8_t> UpdateMask(Layout.UpdateMaskSize,0);
+  uint64_t Start_ns = CpuTime_ns();
+  for (size_t i=0; i < Stats.Records; i++) {
+    MergeDataPayload(Layout,Log + i*Layout.PayloadSize,Payload.data(),UpdateMask.data());
+    FmuDataView(Layout,Payload.data(),UpdateMask.data()).Decode(&Data);
+    NavigationRef.AddImuSample(Data);
+    Scheduler.RunTasks(Data.Time_us,0);
+  }
+  Stats.Cpu_s = (CpuTime_ns() - Start_ns)/1e9;
+  Stats.Flight_s = (Data.Time_us - FmuDataView(Layout,Log).Time_us())/1e6;
+  munmap((void *)Log,LogStat.st_size);
+  close(LogDesc);
+  return Stats;
+}
+
+/* One output column, Columns values per row, stored as it will be written */
+struct NavColumn {
+  std::string Name;
+  std::string Description;
+  size_t Columns;
+  std::vector<double> Values;
+};
+
+/* The columns written for every run of the filter, in NavigationData order */
+static std::vector<NavColumn> GetNavColumns() {
+  NavColumn Columns[] = {
+    {"Time_s","Time of the navigation solution, s",1},
+    {"LLA","Latitude, rad, longitude, rad, altitude, m",3},
+    {"NEDVelocity_ms","North, east, down velocity, m/s",3},
+    {"Euler_rad","Roll, pitch, yaw, rad",3},
+    {"AccelBias_mss","X, Y, Z accelerometer bias, m/s/s",3},
+    {"GyroBias_rads","X, Y, Z gyro bias, rad/s",3},
+    {"Pp","Position covariance",3},
+    {"Pv","Velocity covariance",3},
+    {"Pa","Attitude covariance",3},
+    {"Pab","Accelerometer bias covariance",3},
+    {"Pgb","Gyro bias covariance",3},
+    {"Quaternion","Attitude quaternion, w, x, y, z",4}
+  };
+  return std::vector<NavColumn>(Columns,Columns + sizeof(Columns)/sizeof(Columns[0]));
+}
+
+/* Appends one navigation solution as a row of every column. */
+static void AppendNavRow(const NavigationData &NavDataRef,std::vector<NavColumn> *ColumnsPtr) {
+  const double *Fields[] = {&NavDataRef.Time_s,NavDataRef.LLA,NavDataRef.NEDVelocity_ms,NavDataRef.Euler_rad,
+    NavDataRef.AccelBias_mss,NavDataRef.GyroBias_rads,NavDataRef.Pp,NavDataRef.Pv,NavDataRef.Pa,NavDataRef.Pab,
+    NavDataRef.Pgb,NavDataRef.Quaternion};
+  for (size_t i=0; i < ColumnsPtr->size(); i++) {
+    NavColumn &Column = (*ColumnsPtr)[i];
+    Column.Values.insert(Column.Values.end(),Fields[i],Fields[i] + Column.Columns);
+  }
+}
+
+/* Folds bytes into a 64 bit FNV-1a hash. */
+static uint64_t HashBytes(uint64_t Hash,const void *Bytes,size_t Size) {
+  const uint8_t *Byte = (const uint8_t *)Bytes;
+  for (size_t i=0; i < Size; i++) {
+    Hash = (Hash ^ Byte[i])*1099511628211ULL;
+  }
+  return Hash;
+}
+
+/* Writes each column to <Name>.bin in the directory, rows one after another as
+little-endian float64, and an index.txt giving name, type, rows, columns and
+description of each, one per line. Returns the hash of everything written. */
+static uint64_t WriteNavColumns(const std::string &Directory,const std::vector<NavColumn> &Columns) {
+  if ((mkdir(Directory.c_str(),0755) < 0)&&(errno != EEXIST)) {
+    throw std::runtime_error("Could not create " + Directory + ", " + strerror(errno) + ".");
+  }
+  FILE *Index = fopen((Directory + "/index.txt").c_str(),"w");
+  if (Index == NULL) {
+    throw std::runtime_error("Could not write " + Directory + "/index.txt.");
+  }
+  uint64_t Hash = 14695981039346656037ULL;
+  for (size_t i=0; i < Columns.size(); i++) {
+    const NavColumn &Column = Columns[i];
+    FILE *File = fopen((Directory + "/" + Column.Name + ".bin").c_str(),"wb");
+    if ((File == NULL)||(fwrite(Column.Values.data(),sizeof(double),Column.Values.size(),File) != Column.Values.size())) {
+      throw std::runtime_error("Could not write " + Directory + "/" + Column.Name + ".bin.");
+    }
+    fclose(File);
+    fprintf(Index,"%s float64 %zu %zu %s\n",Column.Name.c_str(),Column.Values.size()/Column.Columns,Column.Columns,Column.Description.c_str());
+    Hash = HashBytes(Hash,Column.Values.data(),Column.Values.size()*sizeof(double));
+  }
+  fclose(Index);
+  return Hash;
+}
+
+/* Replays a datalog through the navigation filter as fast as it runs and writes its
+solution as columns, a row each time the filter runs. The same log, config and
+build always give the same bits; the hash printed at the end says whether two runs
+agree. */
+int ReplayNavigation(int argc, char* argv[]) {
+  if ((argc < 3)||(argc > 4)) {
+    std::cerr << "Usage: output <config> <datalog> <output directory> [nav_hz]" << std::endl;
+    return -1;
+  }
+  double NavRate_hz = (argc > 3) ? atof(argv[3]) : -1.0;
+  Navigation NavFilter;
+  NavigationData NavData;
+  memset(&NavData,0,sizeof(NavData));
+  std::vector<NavColumn> Columns = GetNavColumns();
+  AircraftConfig Config = {0};
+  ReplayStats Stats = ReplayLog(argv[0],argv[1],NavRate_hz,NavFilter,[&](const FmuData &FmuDataRef) {
+    if (FmuDataRef.Gps.size() == 0) {
+      return;
+    }
+    if (!NavFilter.Initialized) {
+      NavFilter.InitializeNavigation(FmuDataRef);
+    } else {
+      NavFilter.RunNavigation(FmuDataRef,&NavData);
+      AppendNavRow(NavData,&Columns);
+    }
+  },&Config);
+
+  uint64_t Hash = WriteNavColumns(argv[2],Columns);
+  std::cout << "Replayed " << Stats.Records << " records, " << Stats.Flight_s << " s of flight, in " << Stats.Cpu_s << " s CPU, "
+    << ((Stats.Cpu_s > 0.0) ? Stats.Flight_s/Stats.Cpu_s : 0.0) << " times real time" << std::endl;
+  std::cout << Columns[0].Values.size() << " navigation solutions written to " << argv[2] << ", hash " << std::hex << Hash << std::dec << std::endl;
+  return 0;
+}
@@ -0,0 +1,294 @@
+
+#include "nav-replay.hxx"
+#include "ekf-batch.hxx"
+#include "rapidjson/document.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* One step of the filter inputs, as navigation gives them to the filter */
+struct FilterInput {
+  IMUincrement Imu;
+  GPSdata Gps;
+};
+
+/* A NAVconfig member the sweep can vary, or all three axes of one */
+struct SweepParameter {
+  const char *Name;
+  double NAVconfig::*Members[3];
+};
+
+static const SweepParameter SweepParameters[] = {
+  {"sig_w_a",{&NAVconfig::sig_w_ax,&NAVconfig::sig_w_ay,&NAVconfig::sig_w_az}},
+  {"sig_w_ax",{&NAVconfig::sig_w_ax,NULL,NULL}},
+  {"sig_w_ay",{&NAVconfig::sig_w_ay,NULL,NULL}},
+  {"sig_w_az",{&NAVconfig::sig_w_az,NULL,NULL}},
+  {"sig_w_g",{&NAVconfig::sig_w_gx,&NAVconfig::sig_w_gy,&NAVconfig::sig_w_gz}},
+  {"sig_w_gx",{&NAVconfig::sig_w_gx,NULL,NULL}},
+  {"sig_w_gy",{&NAVconfig::sig_w_gy,NULL,NULL}},
+  {"sig_w_gz",{&NAVconfig::sig_w_gz,NULL,NULL}},
+  {"sig_a_d",{&NAVconfig::sig_a_d,NULL,NULL}},
+  {"tau_a",{&NAVconfig::tau_a,NULL,NULL}},
+  {"sig_g_d",{&NAVconfig::sig_g_d,NULL,NULL}},
+  {"tau_g",{&NAVconfig::tau_g,NULL,NULL}},
+  {"sig_gps_p_ne",{&NAVconfig::sig_gps_p_ne,NULL,NULL}},
+  {"sig_gps_p_d",{&NAVconfig::sig_gps_p_d,NULL,NULL}},
+  {"sig_gps_v_ne",{&NAVconfig::sig_gps_v_ne,NULL,NULL}},
+  {"sig_gps_v_d",{&NAVconfig::sig_gps_v_d,NULL,NULL}}
+};
+
+/* The values a sweep takes for one parameter */
+struct SweepAxis {
+  const SweepParameter *Parameter;
+  std::vector<double> Values;
+};
+
+/* Reads a sweep, a JSON object giving the values to try for each parameter, such
+as {"sig_w_a": [0.02, 0.05, 0.1], "tau_a": [50, 100, 200]}. */
+static std::vector<SweepAxis> LoadSweepFile(const std::string &FileName) {
+  std::ifstream File(FileName);
+  if (!File) {
+    throw std::runtime_error("Could not open " + FileName + ".");
+  }
+  std::string Buffer((std::istreambuf_iterator<char>(File)),std::istreambuf_iterator<char>());
+  rapidjson::Document Dom;
+  Dom.Parse(Buffer.c_str());
+  if (Dom.HasParseError()||!Dom.IsObject()) {
+    throw std::runtime_error(FileName + " is not a JSON object of parameters.");
+  }
+  std::vector<SweepAxis> Axes;
+  for (rapidjson::Value::ConstMemberIterator Member = Dom.MemberBegin(); Member != Dom.MemberEnd(); ++Member) {
+    std::string Name = Member->name.GetString();
+    SweepAxis Axis = {NULL,std::vector<double>()};
+    for (size_t i=0; i < sizeof(SweepParameters)/sizeof(SweepParameters[0]); i++) {
+      if (Name == SweepParameters[i].Name) {
+        Axis.Parameter = &SweepParameters[i];
+      }
+    }
+    if (Axis.Parameter == NULL) {
+      throw std::runtime_error("Unknown sweep parameter " + Name + ".");
+    }
+    if (!Member->value.IsArray()||(Member->value.Size() == 0)) {
+      throw std::runtime_error("Sweep parameter " + Name + " needs an array of values.");
+    }
+    for (size_t i=0; i < Member->value.Size(); i++) {
+      Axis.Values.push_back(Member->value[i].GetDouble());
+    }
+    Axes.push_back(Axis);
+  }
+  return Axes;
+}
+
+/* Every combination of the sweep's values on top of Base, the first parameter
+varying slowest. */
+static std::vector<NAVconfig> ExpandSweep(const std::vector<SweepAxis> &Axes,const NAVconfig &Base) {
+  std::vector<NAVconfig> Configs(1,Base);
+  for (size_t a=0; a < Axes.size(); a++) {
+    std::vector<NAVconfig> Expanded;
+    for (size_t c=0; c < Configs.size(); c++) {
+      for (size_t v=0; v < Axes[a].Values.size(); v++) {
+        NAVconfig Config = Configs[c];
+        for (size_t m=0; m < 3; m++) {
+          if (Axes[a].Parameter->Members[m] != NULL) {
+            Config.*(Axes[a].Parameter->Members[m]) = Axes[a].Values[v];
+          }
+        }
+        Expanded.push_back(Config);
+      }
+    }
+    Configs.swap(Expanded);
+  }
+  return Configs;
+}
+
+/* Runs the configs EKF15Batch::Lanes at a time on Threads threads, each taking the
+next block of lanes until none are left, and returns each config's score. A block
+short of configs is filled out with its last one. */
+static std::vector<InnovationScore> RunBatches(const std::vector<NAVconfig> &Configs,const NAVdata &Start,
+  const std::vector<FilterInput> &Inputs,size_t Threads) {
+  const size_t Lanes = EKF15Batch::Lanes;
+  size_t Blocks = (Configs.size() + Lanes - 1)/Lanes;
+  std::vector<InnovationScore> Scores(Configs.size());
+  std::atomic<size_t> NextBlock(0);
+  std::vector<std::thread> Workers;
+  for (size_t t=0; t < Threads; t++) {
+    Workers.push_back(std::thread([&]() {
+      EKF15Batch Batch;
+      for (size_t Block = NextBlock++; Block < Blocks; Block = NextBlock++) {
+        for (size_t l=0; l < Lanes; l++) {
+          Batch.SetConfig(l,Configs[std::min(Block*Lanes + l,Configs.size() - 1)]);
+        }
+        Batch.Initialize(Start);
+        for (size_t i=0; i < Inputs.size(); i++) {
+          Batch.Update(Inputs[i].Imu,Inputs[i].Gps);
+        }
+        for (size_t l=0; (l < Lanes)&&(Block*Lanes + l < Configs.size()); l++) {
+          Scores[Block*Lanes + l] = Batch.GetScore(l);
+        }
+      }
+    }));
+  }
+  for (size_t t=0; t < Workers.size(); t++) {
+    Workers[t].join();
+  }
+  return Scores;
+}
+
+/* Returns false, saying why, if the aircraft config has navigation decimate the
+time update: EKF15Batch propagates the covariance every step, so its scores would
+be for a different filter than the one that flies. Warns if navigation flies the
+dense time update or batch GPS update, which EKF15Batch's structured and
+sequential ones agree with to rounding. */
+static bool CheckNavigationConfig(const NavigationConfig &ConfigRef) {
+  if (ConfigRef.TuDecimation != 1) {
+    std::cerr << "ERROR: Navigation TuDecimation is " << ConfigRef.TuDecimation << ", the batched filters only score a time update every step." << std::endl;
+    return false;
+  }
+  if (!ConfigRef.StructuredTu||!ConfigRef.SequentialMu) {
+    std::cerr << "WARNING: Navigation flies the " << (ConfigRef.StructuredTu ? "structured" : "dense") << " time update and the "
+      << (ConfigRef.SequentialMu ? "sequential" : "batch") << " GPS update, the batched filters score the structured and sequential ones, equal to rounding." << std::endl;
+  }
+  return true;
+}
+
+/* Sets the options navigation flies with on a scalar filter. */
+static void ConfigureFilter(const NavigationConfig &ConfigRef,EKF15 *EkfPtr) {
+  EkfPtr->set_structured_tu(ConfigRef.StructuredTu);
+  EkfPtr->set_sequential_mu(ConfigRef.SequentialMu);
+  EkfPtr->set_tu_decimation(ConfigRef.TuDecimation);
+}
+
+/* Scores every NAVconfig of a sweep on a datalog. Navigation's filter inputs are
+taken once from the log, as nav-replay runs it, then the configs run on them in
+lockstep blocks of EKF15Batch::Lanes filters spread over the threads. A config is
+scored by its GPS innovations: the negative log likelihood of the innovations
+given the covariance the filter predicted for them, averaged over the GPS updates,
+is lower the better the filter both predicts the next fix and knows how well it
+does. The normalized innovation squared over its expected value, near 1 for a
+consistent filter, and the RMS innovations are printed with it. The first block
+is also run as scalar EKF15s, to time them against the batch and check that they
+agree. */
+int TuneNavigation(int argc, char* argv[]) {
+  if ((argc < 3)||(argc > 5)) {
+    std::cerr << "Usage: output tune <config> <datalog> <sweep> [threads] [nav_hz]" << std::endl;
+    return -1;
+  }
+  size_t Threads = (argc > 3) ? strtoul(argv[3],NULL,10) : std::thread::hardware_concurrency();
+  Threads = (Threads > 0) ? Threads : 1;
+  double NavRate_hz = (argc > 4) ? atof(argv[4]) : -1.0;
+  std::vector<SweepAxis> Axes = LoadSweepFile(argv[2]);
+
+  // the filter inputs, taken once
+  Navigation NavFilter;
+  IMUdata StartImu;
+  GPSdata StartGps;
+  std::vector<FilterInput> Inputs;
+  AircraftConfig Config = {0};
+  ReplayStats Stats = ReplayLog(argv[0],argv[1],NavRate_hz,NavFilter,[&](const FmuData &FmuDataRef) {
+    if (FmuDataRef.Gps.size() == 0) {
+      return;
+    }
+    if (!NavFilter.Initialized) {
+      NavFilter.GlobalDefsToImu(FmuDataRef,&StartImu);
+      NavFilter.GlobalDefsToGps(FmuDataRef,&StartGps);
+      NavFilter.InitializeNavigation(FmuDataRef);
+    } else {
+      FilterInput Input;
+      if (NavFilter.GetFilterInputs(FmuDataRef,&Input.Imu,&Input.Gps)) {
+        Inputs.push_back(Input);
+      }
+    }
+  },&Config);
+  if (Inputs.empty()) {
+    std::cerr << "ERROR: No GPS fix in " << argv[1] << std::endl;
+    return -1;
+  }
+  if (!CheckNavigationConfig(Config.Navigation)) {
+    return -1;
+  }
+  size_t GpsUpdates = 0;
+  for (size_t i=0; i < Inputs.size(); i++) {
+    GpsUpdates += Inputs[i].Gps.newData ? 1 : 0;
+  }
+  EKF15 Reference;
+  ConfigureFilter(Config.Navigation,&Reference);
+  std::vector<NAVconfig> Configs = ExpandSweep(Axes,Reference.get_config());
+  NAVdata Start = Reference.init(StartImu,StartGps);
+  std::cout << Stats.Flight_s << " s of flight, " << Inputs.size() << " filter steps, " << GpsUpdates << " GPS updates; "
+    << Configs.size() << " configs, " << EKF15Batch::Lanes << " lanes, " << Threads << " threads" << std::endl;
+
+  uint64_t Start_ns = CpuTime_ns();
+  std::vector<InnovationScore> Scores = RunBatches(Configs,Start,Inputs,Threads);
+  double Batch_s = (CpuTime_ns() - Start_ns)/1e9;
+
+  // the first block as scalar filters, for the time and agreement
+  size_t Checked = std::min(Configs.size(),EKF15Batch::Lanes);
+  EKF15Batch Batch;
+  for (size_t l=0; l < EKF15Batch::Lanes; l++) {
+    Batch.SetConfig(l,Configs[std::min(l,Configs.size() - 1)]);
+  }
+  Batch.Initialize(Start);
+  for (size_t i=0; i < Inputs.size(); i++) {
+    Batch.Update(Inputs[i].Imu,Inputs[i].Gps);
+  }
+  double Scalar_s = 0.0, Position_m = 0.0, Attitude_rad = 0.0, Covariance = 0.0;
+  for (size_t l=0; l < Checked; l++) {
+    EKF15 *Scalar = new EKF15();
+    ConfigureFilter(Config.Navigation,Scalar);
+    Scalar->set_config(Configs[l]);
+    NAVdata Nav = Scalar->init(StartImu,StartGps);
+    Start_ns = CpuTime_ns();
+    for (size_t i=0; i < Inputs.size(); i++) {
+      Nav = Scalar->update(Inputs[i].Imu,Inputs[i].Gps);
+    }
+    Scalar_s += (CpuTime_ns() - Start_ns)/1e9;
+    delete Scalar;
+    NAVdata Lane = Batch.GetNavData(l);
+    Position_m = std::max(Position_m,fabs(Nav.lat - Lane.lat)*EARTH_RADIUS);
+    Position_m = std::max(Position_m,fabs(Nav.lon - Lane.lon)*EARTH_RADIUS*cos(Nav.lat));
+    Position_m = std::max(Position_m,fabs(Nav.alt - Lane.alt));
+    Attitude_rad = std::max(Attitude_rad,Quaterniond(Nav.qw,Nav.qx,Nav.qy,Nav.qz).angularDistance(
+      Quaterniond(Lane.qw,Lane.qx,Lane.qy,Lane.qz)));
+    const double ScalarP[] = {Nav.Pp0,Nav.Pv0,Nav.Pa0,Nav.Pa2,Nav.Pabx,Nav.Pgbz};
+    const double LaneP[] = {Lane.Pp0,Lane.Pv0,Lane.Pa0,Lane.Pa2,Lane.Pabx,Lane.Pgbz};
+    for (size_t i=0; i < sizeof(ScalarP)/sizeof(ScalarP[0]); i++) {
+      Covariance = std::max(Covariance,fabs(ScalarP[i] - LaneP[i])/ScalarP[i]);
+    }
+  }
+  double ScalarFilter_s = Scalar_s/Checked;
+  double BatchFilter_s = Batch_s/Configs.size();
+  printf("%-24s %12.1f us/step, %9.2f s for every config\n","scalar EKF15",1e6*ScalarFilter_s/Inputs.size(),ScalarFilter_s*Configs.size());
+  printf("%-24s %12.1f us/step, %9.2f s for every config, %.2fx\n","batched, CPU",1e6*BatchFilter_s/Inputs.size(),Batch_s,ScalarFilter_s/BatchFilter_s);
+  printf("%-24s %12.2e m position, %.2e rad attitude, %.2e covariance, rel\n","batch vs scalar",Position_m,Attitude_rad,Covariance);
+
+  // the scores, best first marked
+  size_t Best = 0;
+  for (size_t i=0; i < Scores.size(); i++) {
+    if (Scores[i].NegLogLikelihood < Scores[Best].NegLogLikelihood) {
+      Best = i;
+    }
+  }
+  printf("%6s","config");
+  for (size_t a=0; a < Axes.size(); a++) {
+    printf(" %12s",Axes[a].Parameter->Name);
+  }
+  printf(" %12s %12s %12s %12s\n","score","NIS / 6","position, m","velocity, m/s");
+  for (size_t i=0; i < Configs.size(); i++) {
+    const InnovationScore &Score = Scores[i];
+    double Epochs = (Score.Epochs > 0) ? (double)Score.Epochs : 1.0;
+    printf("%5zu%s",i,(i == Best) ? "*" : " ");
+    for (size_t a=0; a < Axes.size(); a++) {
+      printf(" %12g",Configs[i].*(Axes[a].Parameter->Members[0]));
+    }
+    printf(" %12.4f %12.3f %12.3f %12.3f\n",Score.NegLogLikelihood/Epochs,Score.Nis/(6.0*Epochs),
+      sqrt(Score.Position_m2/(3.0*Epochs)),sqrt(Score.Velocity_m2s2/(3.0*Epochs)));
+  }
+  return 0;
+}
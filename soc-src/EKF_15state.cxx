@@ -18,6 +18,7 @@
 using std::cout;
 using std::endl;
 #include <stdio.h>
+#include <string.h>
 
 #include "nav_functions.hxx"
 #include "EKF_15state.hxx"
@@ -40,15 +41,18 @@ const double Rns = 6.386034030458164e+006; // earth radius
 // lot of these multi line equations with temp matrices can be
 // compressed.
 
-void EKF15::set_config(NAVconfig config) {
+template <typename T>
+void EKF15T<T>::set_config(NAVconfig config) {
     this->config = config;
 }
 
-NAVconfig EKF15::get_config() {
+template <typename T>
+NAVconfig EKF15T<T>::get_config() {
     return config;
 }
 
-void EKF15::default_config()
+template <typename T>
+void EKF15T<T>::default_config()
 {
     config.sig_w_ax = 0.05;     // Std dev of Accelerometer Wide Band Noise (m/s^2)
     config.sig_w_ay = 0.05;
@@ -67,7 +71,8 @@ void EKF15::default_config()
     config.sig_mag      = 0.3;  // Magnetometer measurement noise std dev (normalized -1 to 1)
 }
 
-NAVdata EKF15::init(IMUdata imu, GPSdata gps) {
+template <typename T>
+NAVdata EKF15T<T>::init(IMUdata imu, GPSdata gps) {
     I15.setIdentity();
     I3.setIdentity();
 
@@ -111,6 +116,11 @@ NAVdata EKF15::init(IMUdata imu, GPSdata gps) {
     nav.Pabx = P(9,9);	  nav.Paby = P(10,10);	nav.Pabz = P(11,11);
     nav.Pgbx = P(12,12);  nav.Pgby = P(13,13);  nav.Pgbz = P(14,14);
 	
+    if (structured_tu) {
+	pack_P();
+    }
+    reset_accumulated();
+
     // .. then initialize states with GPS Data
     nav.lat = gps.lat;
     nav.lon = gps.lon;
@@ -161,7 +171,8 @@ NAVdata EKF15::init(IMUdata imu, GPSdata gps) {
 }
 
 // Main get_nav filter function
-NAVdata EKF15::update(IMUdata imu, GPSdata gps) {
+template <typename T>
+NAVdata EKF15T<T>::update(IMUdata imu, GPSdata gps) {
     // compute time-elapsed 'dt'
     // This compute the navigation state at the DAQ's Time Stamp
     double tnow = imu.time;
@@ -170,6 +181,88 @@ NAVdata EKF15::update(IMUdata imu, GPSdata gps) {
 
     // ==================  Time Update  ===================
 
+    // Attitude increment, from the rates of the last sample
+    Quaterniond dq;
+    dq = Quaterniond(1.0, 0.5*om_ib(0)*imu_dt, 0.5*om_ib(1)*imu_dt, 0.5*om_ib(2)*imu_dt);
+    time_update(imu_dt, dq);
+
+    // ==================  DONE TU  ===================
+	
+    gps_update(gps);
+	
+    nav.qw = quat.w();
+    nav.qx = quat.x();
+    nav.qy = quat.y();
+    nav.qz = quat.z();
+	
+    // Remove current estimated biases from rate gyro and accels
+    imu.p -= nav.gbx;
+    imu.q -= nav.gby;
+    imu.r -= nav.gbz;
+    imu.ax -= nav.abx;
+    imu.ay -= nav.aby;
+    imu.az -= nav.abz;
+
+    // Get the new Specific forces and Rotation Rate,
+    // use in the next time update
+    f_b(0) = imu.ax;
+    f_b(1) = imu.ay;
+    f_b(2) = imu.az;
+
+    om_ib(0) = imu.p;
+    om_ib(1) = imu.q;
+    om_ib(2) = imu.r;
+
+    nav.time = imu.time;
+    
+    return nav;
+}
+
+// Filter update on IMU increments, pre-integrated over every sample since the
+// last update, in place of a single sample. The increments are for this update's
+// interval, so unlike update() there is no sample held over to the next one.
+template <typename T>
+NAVdata EKF15T<T>::update(IMUincrement imu, GPSdata gps) {
+    double imu_dt = imu.dt;
+    tprev = imu.time;
+
+    // Average specific force and rotation rate over the interval, less the
+    // current estimated biases, for the strapdown and covariance time update
+    f_b = Vector3d(imu.dvel[0], imu.dvel[1], imu.dvel[2]) / imu_dt;
+    f_b -= Vector3d(nav.abx, nav.aby, nav.abz);
+    om_ib = Vector3d(imu.dtheta[0], imu.dtheta[1], imu.dtheta[2]) / imu_dt;
+    om_ib -= Vector3d(nav.gbx, nav.gby, nav.gbz);
+
+    // ==================  Time Update  ===================
+
+    // Attitude increment, the rotation vector taken exactly
+    Vector3d rotation = om_ib * imu_dt;
+    double angle = rotation.norm();
+    Quaterniond dq;
+    if (angle > 1e-12) {
+	dq = Quaterniond(AngleAxisd(angle, rotation / angle));
+    } else {
+	dq = Quaterniond(1.0, 0.5*rotation(0), 0.5*rotation(1), 0.5*rotation(2));
+    }
+    time_update(imu_dt, dq);
+
+    // ==================  DONE TU  ===================
+
+    gps_update(gps);
+
+    nav.qw = quat.w();
+    nav.qx = quat.x();
+    nav.qy = quat.y();
+    nav.qz = quat.z();
+    nav.time = imu.time;
+    
+    return nav;
+}
+
+// Strapdown update of attitude, velocity and position over imu_dt, the attitude
+// by the increment dq, then the covariance time update
+template <typename T>
+void EKF15T<T>::time_update(double imu_dt, const Quaterniond &dq) {
     // AHRS Transformations
     C_N2B = quat2dcm(quat);
     C_B2N = C_N2B.transpose();
@@ -181,8 +274,6 @@ NAVdata EKF15::update(IMUdata imu, GPSdata gps) {
 	
     nr = navrate(vel_vec,pos_vec);  /* note: unused, llarate used instead */
 	
-    Quaterniond dq;
-    dq = Quaterniond(1.0, 0.5*om_ib(0)*imu_dt, 0.5*om_ib(1)*imu_dt, 0.5*om_ib(2)*imu_dt);
     quat = (quat * dq).normalized();
 
     if (quat.w() < 0) {
@@ -209,73 +300,28 @@ NAVdata EKF15::update(IMUdata imu, GPSdata gps) {
     nav.lon += imu_dt*dx(1);
     nav.alt += imu_dt*dx(2);
 	
-    // JACOBIAN
-    F.setZero();
-    // ... pos2gs
-    F(0,3) = 1.0; 	F(1,4) = 1.0; 	F(2,5) = 1.0;
-    // ... gs2pos
-    F(5,2) = -2 * g / EARTH_RADIUS;
-	
-    // ... gs2att
-    temp33 = C_B2N * sk(f_b);
-	
-    F(3,6) = -2.0*temp33(0,0);  F(3,7) = -2.0*temp33(0,1);  F(3,8) = -2.0*temp33(0,2);
-    F(4,6) = -2.0*temp33(1,0);  F(4,7) = -2.0*temp33(1,1);  F(4,8) = -2.0*temp33(1,2);
-    F(5,6) = -2.0*temp33(2,0);  F(5,7) = -2.0*temp33(2,1);  F(5,8) = -2.0*temp33(2,2);
-	
-    // ... gs2acc
-    F(3,9) = -C_B2N(0,0);  F(3,10) = -C_B2N(0,1);  F(3,11) = -C_B2N(0,2);
-    F(4,9) = -C_B2N(1,0);  F(4,10) = -C_B2N(1,1);  F(4,11) = -C_B2N(1,2);
-    F(5,9) = -C_B2N(2,0);  F(5,10) = -C_B2N(2,1);  F(5,11) = -C_B2N(2,2);
-	
-    // ... att2att
-    temp33 = sk(om_ib);
-    F(6,6) = -temp33(0,0);  F(6,7) = -temp33(0,1);  F(6,8) = -temp33(0,2);
-    F(7,6) = -temp33(1,0);  F(7,7) = -temp33(1,1);  F(7,8) = -temp33(1,2);
-    F(8,6) = -temp33(2,0);  F(8,7) = -temp33(2,1);  F(8,8) = -temp33(2,2);
-	
-    // ... att2gyr
-    F(6,12) = -0.5;
-    F(7,13) = -0.5;
-    F(8,14) = -0.5;
-	
-    // ... Accel Markov Bias
-    F(9,9) = -1.0/config.tau_a;    F(10,10) = -1.0/config.tau_a;  F(11,11) = -1.0/config.tau_a;
-    F(12,12) = -1.0/config.tau_g;  F(13,13) = -1.0/config.tau_g;  F(14,14) = -1.0/config.tau_g;
-	
-    // State Transition Matrix: PHI = I15 + F*dt;
-    PHI = I15 + F * imu_dt;
-	
-    // Process Noise
-    G.setZero();
-    G(3,0) = -C_B2N(0,0);   G(3,1) = -C_B2N(0,1);   G(3,2) = -C_B2N(0,2);
-    G(4,0) = -C_B2N(1,0);   G(4,1) = -C_B2N(1,1);   G(4,2) = -C_B2N(1,2);
-    G(5,0) = -C_B2N(2,0);   G(5,1) = -C_B2N(2,1);   G(5,2) = -C_B2N(2,2);
-	
-    G(6,3) = -0.5;
-    G(7,4) = -0.5;
-    G(8,5) = -0.5;
-	
-    G(9,6) = 1.0; 	    G(10,7) = 1.0; 	    G(11,8) = 1.0;
-    G(12,9) = 1.0; 	    G(13,10) = 1.0; 	    G(14,11) = 1.0;
-
-    // Discrete Process Noise
-    Qw = G * Rw * G.transpose() * imu_dt;		// Qw = dt*G*Rw*G'
-    Q = PHI * Qw;					// Q = (I+F*dt)*Qw
-    Q = (Q + Q.transpose()) * 0.5;			// Q = 0.5*(Q+Q')
-	
     // Covariance Time Update
-    P = PHI * P * PHI.transpose() + Q;			// P = PHI*P*PHI' + Q
-    P = (P + P.transpose()) * 0.5;			// P = 0.5*(P+P')
+    if (structured_tu && (tu_decimation > 1)) {
+	time_update_decimated(imu_dt);
+    } else if (structured_tu) {
+	time_update_structured(imu_dt);
+    } else {
+	time_update_dense(imu_dt);
+    }
 	
-    nav.Pp0 = P(0,0);     nav.Pp1 = P(1,1);     nav.Pp2 = P(2,2);
-    nav.Pv0 = P(3,3);     nav.Pv1 = P(4,4);     nav.Pv2 = P(5,5);
-    nav.Pa0 = P(6,6);     nav.Pa1 = P(7,7);     nav.Pa2 = P(8,8);
-    nav.Pabx = P(9,9);    nav.Paby = P(10,10);  nav.Pabz = P(11,11);
-    nav.Pgbx = P(12,12);  nav.Pgby = P(13,13);  nav.Pgbz = P(14,14);
+    nav.Pp0 = P_diag(0);     nav.Pp1 = P_diag(1);     nav.Pp2 = P_diag(2);
+    nav.Pv0 = P_diag(3);     nav.Pv1 = P_diag(4);     nav.Pv2 = P_diag(5);
+    nav.Pa0 = P_diag(6);     nav.Pa1 = P_diag(7);     nav.Pa2 = P_diag(8);
+    nav.Pabx = P_diag(9);    nav.Paby = P_diag(10);   nav.Pabz = P_diag(11);
+    nav.Pgbx = P_diag(12);   nav.Pgby = P_diag(13);   nav.Pgbz = P_diag(14);
+
+}
+
+// GPS measurement update, when gps holds a new measurement
+template <typename T>
+void EKF15T<T>::gps_update(GPSdata gps) {
+    Quaterniond dq;
 
-    // ==================  DONE TU  ===================
-	
     if ( gps.newData ) {
 	// ==================  GPS Update  ===================
 	gps.newData = 0; // Reset the flag
@@ -305,25 +351,35 @@ NAVdata EKF15::update(IMUdata imu, GPSdata gps) {
 	y(4) = gps.ve - nav.ve;
 	y(5) = gps.vd - nav.vd;
 		
-	// Kalman Gain
-	// K = P*H'*inv(H*P*H'+R)
-	K = P * H.transpose() * (H * P * H.transpose() + R).inverse();
-		
-	// Covariance Update
-	ImKH = I15 - K * H;	                // ImKH = I - K*H
-		
-	KRKt = K * R * K.transpose();		// KRKt = K*R*K'
-		
-	P = ImKH * P * ImKH.transpose() + KRKt;	// P = ImKH*P*ImKH' + KRKt
+	// Kalman Gain and Covariance Update, x is the state correction
+	if (tu_frames > 0) {
+	    propagate_accumulated();
+	}
+	if (sequential_mu) {
+	    if (!structured_tu) {
+		pack_P();
+	    }
+	    measurement_update_sequential();
+	    if (!structured_tu) {
+		unpack_P();
+	    }
+	} else {
+	    if (structured_tu) {
+		unpack_P();
+	    }
+	    measurement_update_batch();
+	    if (structured_tu) {
+		pack_P();
+	    }
+	}
 		
-	nav.Pp0 = P(0,0);     nav.Pp1 = P(1,1);     nav.Pp2 = P(2,2);
-	nav.Pv0 = P(3,3);     nav.Pv1 = P(4,4);     nav.Pv2 = P(5,5);
-	nav.Pa0 = P(6,6);     nav.Pa1 = P(7,7);     nav.Pa2 = P(8,8);
-	nav.Pabx = P(9,9);    nav.Paby = P(10,10);  nav.Pabz = P(11,11);
-	nav.Pgbx = P(12,12);  nav.Pgby = P(13,13);  nav.Pgbz = P(14,14);
+	nav.Pp0 = P_diag(0);     nav.Pp1 = P_diag(1);     nav.Pp2 = P_diag(2);
+	nav.Pv0 = P_diag(3);     nav.Pv1 = P_diag(4);     nav.Pv2 = P_diag(5);
+	nav.Pa0 = P_diag(6);     nav.Pa1 = P_diag(7);     nav.Pa2 = P_diag(8);
+	nav.Pabx = P_diag(9);    nav.Paby = P_diag(10);   nav.Pabz = P_diag(11);
+	nav.Pgbx = P_diag(12);   nav.Pgby = P_diag(13);   nav.Pgbz = P_diag(14);
 		
 	// State Update
-	x = K * y;
 	denom = (1.0 - (ECC2 * sin(nav.lat) * sin(nav.lat)));
 	denom = sqrt(denom*denom);
 
@@ -354,35 +410,426 @@ NAVdata EKF15::update(IMUdata imu, GPSdata gps) {
 	nav.gby += x(13);
 	nav.gbz += x(14);
     }
+}
+
+template <typename T>
+void EKF15T<T>::set_sequential_mu(bool sequential) {
+    sequential_mu = sequential;
+}
+
+template <typename T>
+void EKF15T<T>::set_tu_decimation(int frames) {
+    if (tu_frames > 0) {
+	propagate_accumulated();
+    }
+    tu_decimation = (frames > 1) ? frames : 1;
+}
+
+template <typename T>
+void EKF15T<T>::set_structured_tu(bool structured) {
+    if (tu_frames > 0) {
+	propagate_accumulated();
+    }
+    if (structured && !structured_tu) {
+	pack_P();
+    } else if (!structured && structured_tu) {
+	unpack_P();
+    }
+    structured_tu = structured;
+}
+
+// Dense reference time update: builds F, PHI and G in full and multiplies them out
+template <typename T>
+void EKF15T<T>::time_update_dense(T imu_dt) {
+    // JACOBIAN
+    F.setZero();
+    // ... pos2gs
+    F(0,3) = 1.0; 	F(1,4) = 1.0; 	F(2,5) = 1.0;
+    // ... gs2pos
+    F(5,2) = -2 * g / EARTH_RADIUS;
 	
-    nav.qw = quat.w();
-    nav.qx = quat.x();
-    nav.qy = quat.y();
-    nav.qz = quat.z();
+    // ... gs2att
+    temp33 = C_B2N * sk(f_b);
 	
-    // Remove current estimated biases from rate gyro and accels
-    imu.p -= nav.gbx;
-    imu.q -= nav.gby;
-    imu.r -= nav.gbz;
-    imu.ax -= nav.abx;
-    imu.ay -= nav.aby;
-    imu.az -= nav.abz;
+    F(3,6) = -2.0*temp33(0,0);  F(3,7) = -2.0*temp33(0,1);  F(3,8) = -2.0*temp33(0,2);
+    F(4,6) = -2.0*temp33(1,0);  F(4,7) = -2.0*temp33(1,1);  F(4,8) = -2.0*temp33(1,2);
+    F(5,6) = -2.0*temp33(2,0);  F(5,7) = -2.0*temp33(2,1);  F(5,8) = -2.0*temp33(2,2);
+	
+    // ... gs2acc
+    F(3,9) = -C_B2N(0,0);  F(3,10) = -C_B2N(0,1);  F(3,11) = -C_B2N(0,2);
+    F(4,9) = -C_B2N(1,0);  F(4,10) = -C_B2N(1,1);  F(4,11) = -C_B2N(1,2);
+    F(5,9) = -C_B2N(2,0);  F(5,10) = -C_B2N(2,1);  F(5,11) = -C_B2N(2,2);
+	
+    // ... att2att
+    temp33 = sk(om_ib);
+    F(6,6) = -temp33(0,0);  F(6,7) = -temp33(0,1);  F(6,8) = -temp33(0,2);
+    F(7,6) = -temp33(1,0);  F(7,7) = -temp33(1,1);  F(7,8) = -temp33(1,2);
+    F(8,6) = -temp33(2,0);  F(8,7) = -temp33(2,1);  F(8,8) = -temp33(2,2);
+	
+    // ... att2gyr
+    F(6,12) = -0.5;
+    F(7,13) = -0.5;
+    F(8,14) = -0.5;
+	
+    // ... Accel Markov Bias
+    F(9,9) = -1.0/config.tau_a;    F(10,10) = -1.0/config.tau_a;  F(11,11) = -1.0/config.tau_a;
+    F(12,12) = -1.0/config.tau_g;  F(13,13) = -1.0/config.tau_g;  F(14,14) = -1.0/config.tau_g;
+	
+    // State Transition Matrix: PHI = I15 + F*dt;
+    PHI = I15 + F * imu_dt;
+	
+    // Process Noise
+    G.setZero();
+    G(3,0) = -C_B2N(0,0);   G(3,1) = -C_B2N(0,1);   G(3,2) = -C_B2N(0,2);
+    G(4,0) = -C_B2N(1,0);   G(4,1) = -C_B2N(1,1);   G(4,2) = -C_B2N(1,2);
+    G(5,0) = -C_B2N(2,0);   G(5,1) = -C_B2N(2,1);   G(5,2) = -C_B2N(2,2);
+	
+    G(6,3) = -0.5;
+    G(7,4) = -0.5;
+    G(8,5) = -0.5;
+	
+    G(9,6) = 1.0; 	    G(10,7) = 1.0; 	    G(11,8) = 1.0;
+    G(12,9) = 1.0; 	    G(13,10) = 1.0; 	    G(14,11) = 1.0;
 
-    // Get the new Specific forces and Rotation Rate,
-    // use in the next time update
-    f_b(0) = imu.ax;
-    f_b(1) = imu.ay;
-    f_b(2) = imu.az;
+    // Discrete Process Noise
+    Qw = G * Rw * G.transpose() * imu_dt;		// Qw = dt*G*Rw*G'
+    Q = PHI * Qw;					// Q = (I+F*dt)*Qw
+    Q = (Q + Q.transpose()).eval() * T(0.5);		// Q = 0.5*(Q+Q'), evaluated first as Q' aliases Q
+	
+    // Covariance Time Update
+    P = PHI * P * PHI.transpose() + Q;			// P = PHI*P*PHI' + Q
+    P = (P + P.transpose()).eval() * T(0.5);		// P = 0.5*(P+P'), evaluated first as P' aliases P
+}
 
-    om_ib(0) = imu.p;
-    om_ib(1) = imu.q;
-    om_ib(2) = imu.r;
+// Index of P(i,j), i <= j, in the packed upper triangle
+static inline int packed_index(int i, int j) {
+    return i*15 - i*(i-1)/2 + (j-i);
+}
 
-    nav.time = imu.time;
-    
-    return nav;
+// Batch GPS update on the dense P: the gain through the 6x6 inverse and the
+// Joseph form through full 15x15 products
+template <typename T>
+void EKF15T<T>::measurement_update_batch() {
+    // K = P*H'*inv(H*P*H'+R)
+    K = P * H.transpose() * (H * P * H.transpose() + R).inverse();
+	
+    // Covariance Update
+    ImKH = I15 - K * H;	                // ImKH = I - K*H
+	
+    KRKt = K * R * K.transpose();		// KRKt = K*R*K'
+	
+    P = ImKH * P * ImKH.transpose() + KRKt;	// P = ImKH*P*ImKH' + KRKt
+
+    x = K * y;
+}
+
+// Sequential GPS update on the packed upper triangle of P. With H = [I6 0] and R
+// diagonal the six components can be taken one at a time as scalar updates,
+// giving the batch result: for component m the innovation variance is
+// s = P(m,m) + R(m,m), the gain k = P(:,m)/s and the Joseph form
+//
+//   P = (I - k*h)*P*(I - k*h)' + k*R(m,m)*k' = P - k*p' - p*k' + s*k*k'
+//
+// where h picks out state m and p = P(:,m), so there is no inverse and each
+// component costs one pass over the 120 stored entries.
+template <typename T>
+void EKF15T<T>::measurement_update_sequential() {
+    T p[15], k[15];
+    x.setZero();
+    for (int m = 0; m < 6; m++) {
+	for (int i = 0; i < 15; i++) {
+	    p[i] = (i <= m) ? P_packed[packed_index(i,m)] : P_packed[packed_index(m,i)];
+	}
+	T s = p[m] + R(m,m);
+	for (int i = 0; i < 15; i++) {
+	    k[i] = p[i] / s;
+	}
+	T innovation = y(m) - x(m);
+	for (int i = 0; i < 15; i++) {
+	    x(i) += k[i] * innovation;
+	}
+	int index = 0;
+	for (int i = 0; i < 15; i++) {
+	    for (int j = i; j < 15; j++) {
+		P_packed[index++] += s*k[i]*k[j] - k[i]*p[j] - p[i]*k[j];
+	    }
+	}
+    }
+}
+
+// 3x3 block (bi,bj) of P from the packed upper triangle, blocks are position,
+// velocity, attitude, accel bias and gyro bias
+template <typename T>
+typename EKF15T<T>::Matrix3 EKF15T<T>::P_block(int bi, int bj) {
+    Matrix3 block;
+    for (int r = 0; r < 3; r++) {
+	for (int c = 0; c < 3; c++) {
+	    int i = 3*bi + r;
+	    int j = 3*bj + c;
+	    block(r,c) = (i <= j) ? P_packed[packed_index(i,j)] : P_packed[packed_index(j,i)];
+	}
+    }
+    return block;
+}
+
+// Stores the upper triangle part of block (bi,bj), bi <= bj, of the next P
+template <typename T>
+void EKF15T<T>::set_P_next_block(int bi, int bj, const Matrix3 &block) {
+    for (int r = 0; r < 3; r++) {
+	for (int c = (bi == bj) ? r : 0; c < 3; c++) {
+	    P_next[packed_index(3*bi + r, 3*bj + c)] = block(r,c);
+	}
+    }
+}
+
+template <typename T>
+T EKF15T<T>::P_diag(int i) {
+    return structured_tu ? P_packed[packed_index(i,i)] : P(i,i);
+}
+
+// Packs P, averaging the two triangles as the dense update's symmetrizing does
+template <typename T>
+void EKF15T<T>::pack_P() {
+    for (int i = 0; i < 15; i++) {
+	for (int j = i; j < 15; j++) {
+	    P_packed[packed_index(i,j)] = 0.5*(P(i,j) + P(j,i));
+	}
+    }
+}
+
+template <typename T>
+void EKF15T<T>::unpack_P() {
+    for (int i = 0; i < 15; i++) {
+	for (int j = i; j < 15; j++) {
+	    P(i,j) = P(j,i) = P_packed[packed_index(i,j)];
+	}
+    }
+}
+
+// Structured time update, P = PHI*P*PHI' + Q on the packed upper triangle. In
+// 3x3 blocks PHI = I + F*dt is
+//
+//   [ I  dt*I  0  0      0      ]   rows and columns: position, velocity,
+//   [ c  I     A  B      0      ]   attitude, accel bias, gyro bias
+//   [ 0  0     D  0      h*I    ]
+//   [ 0  0     0  ka*I   0      ]   c is PHI(5,2) alone
+//   [ 0  0     0  0      kg*I   ]
+//
+// and Qw = G*Rw*G'*dt is block diagonal, so only the nonzero blocks are
+// multiplied out, and of P and Q only the upper triangle is formed. Each block
+// row of M = PHI*P is made from the blocks it needs and then gives the blocks of
+// that row of P on and above the diagonal.
+template <typename T>
+void EKF15T<T>::time_update_structured(T dt) {
+    const Matrix3 C = C_B2N.template cast<T>();
+    const Vector3 f = f_b.template cast<T>();
+    const Vector3 om = om_ib.template cast<T>();
+    const Matrix3 A = T(-2.0)*dt*C*sk(f);          // velocity from attitude
+    const Matrix3 B = -dt*C;                       // velocity from accel bias
+    const Matrix3 D = I3 - dt*sk(om);              // attitude from attitude
+    const T c = -2.0*g/EARTH_RADIUS*dt;            // down velocity from altitude
+    const T h = T(-0.5)*dt;                        // attitude from gyro bias
+    const T ka = 1.0 - dt/config.tau_a;
+    const T kg = 1.0 - dt/config.tau_g;
+
+    // blocks of Qw: velocity dt*C*Ra*C', the rest diagonal
+    const Matrix3 Qv = dt*C*Rw.template block<3,3>(0,0)*C.transpose();
+    const Matrix3 Qa = T(0.25)*dt*Rw.template block<3,3>(3,3);
+    const Matrix3 Qab = dt*Rw.template block<3,3>(6,6);
+    const Matrix3 Qgb = dt*Rw.template block<3,3>(9,9);
+
+    Matrix3 M[5];
+    for (int i = 0; i < 5; i++) {
+	// M row i, only the columns the blocks at and right of the diagonal use
+	for (int k = (i < 2) ? 0 : i; k < 5; k++) {
+	    switch (i) {
+		case 0:
+		    M[k] = P_block(0,k) + dt*P_block(1,k);
+		    break;
+		case 1:
+		    M[k] = P_block(1,k) + A*P_block(2,k) + B*P_block(3,k);
+		    M[k].row(2) += c*P_block(0,k).row(2);
+		    break;
+		case 2:
+		    M[k] = D*P_block(2,k) + h*P_block(4,k);
+		    break;
+		case 3:
+		    M[k] = ka*P_block(3,k);
+		    break;
+		case 4:
+		    M[k] = kg*P_block(4,k);
+		    break;
+	    }
+	}
+	// P row i = M row i * PHI', plus Q = 0.5*(PHI*Qw + Qw*PHI')
+	for (int j = i; j < 5; j++) {
+	    Matrix3 block;
+	    switch (j) {
+		case 0:
+		    block = M[0] + dt*M[1];
+		    break;
+		case 1:
+		    block = M[1] + M[2]*A.transpose() + M[3]*B.transpose();
+		    block.col(2) += c*M[0].col(2);
+		    break;
+		case 2:
+		    block = M[2]*D.transpose() + h*M[4];
+		    break;
+		case 3:
+		    block = ka*M[3];
+		    break;
+		case 4:
+		    block = kg*M[4];
+		    break;
+	    }
+	    if ((i == 0)&&(j == 1)) {
+		block += T(0.5)*dt*Qv;
+	    } else if ((i == 1)&&(j == 1)) {
+		block += Qv;
+	    } else if ((i == 1)&&(j == 2)) {
+		block += T(0.5)*A*Qa;
+	    } else if ((i == 1)&&(j == 3)) {
+		block += T(0.5)*B*Qab;
+	    } else if ((i == 2)&&(j == 2)) {
+		block += T(0.5)*(D*Qa + Qa*D.transpose());
+	    } else if ((i == 2)&&(j == 4)) {
+		block += T(0.5)*h*Qgb;
+	    } else if ((i == 3)&&(j == 3)) {
+		block += ka*Qab;
+	    } else if ((i == 4)&&(j == 4)) {
+		block += kg*Qgb;
+	    }
+	    set_P_next_block(i,j,block);
+	}
+    }
+    memcpy(P_packed,P_next,sizeof(P_packed));
+}
+
+// Decimated time update: accumulates this frame's transition into Phi_acc, and
+// propagates P every tu_decimation frames. PHI has the block pattern drawn above
+// time_update_structured, and products of such matrices keep the pattern
+//
+//   [ x  x  x  x  x ]
+//   [ x  x  x  x  x ]
+//   [ 0  0  x  0  x ]   the last two diagonal blocks scaled identities
+//   [ 0  0  0  x  0 ]
+//   [ 0  0  0  0  x ]
+//
+// so Phi_acc = PHI*Phi_acc takes five 3x3 products a frame, against the dozens of
+// a propagation. The process noise is summed over the frames, as Qw: the
+// velocity block dt*C*Ra*C' changes with attitude and is summed, the rest are
+// constant and only need the accumulated time.
+template <typename T>
+void EKF15T<T>::time_update_decimated(T dt) {
+    const Matrix3 C = C_B2N.template cast<T>();
+    const Vector3 f = f_b.template cast<T>();
+    const Vector3 om = om_ib.template cast<T>();
+    const Matrix3 A = T(-2.0)*dt*C*sk(f);
+    const Matrix3 B = -dt*C;
+    const Matrix3 D = I3 - dt*sk(om);
+    const T c = -2.0*g/EARTH_RADIUS*dt;
+    const T h = T(-0.5)*dt;
+    const T ka = 1.0 - dt/config.tau_a;
+    const T kg = 1.0 - dt/config.tau_g;
+
+    // velocity row, from the old position, attitude and accel bias rows
+    Matrix3 velocity_row[5];
+    for (int j = 0; j < 5; j++) {
+	velocity_row[j] = Phi_acc[1][j];
+	Phi_acc[1][j].row(2) += c*Phi_acc[0][j].row(2);
+    }
+    Phi_acc[1][2] += A*Phi_acc[2][2];
+    Phi_acc[1][3] += B*Phi_acc[3][3];
+    Phi_acc[1][4] += A*Phi_acc[2][4];
+    // position row, from the old velocity row
+    for (int j = 0; j < 5; j++) {
+	Phi_acc[0][j] += dt*velocity_row[j];
+    }
+    // attitude row, from the old gyro bias row, then the biases
+    Phi_acc[2][4] = D*Phi_acc[2][4] + h*Phi_acc[4][4];
+    Phi_acc[2][2] = D*Phi_acc[2][2];
+    Phi_acc[3][3] *= ka;
+    Phi_acc[4][4] *= kg;
+
+    Qv_acc += dt*C*Rw.template block<3,3>(0,0)*C.transpose();
+    dt_acc += dt;
+    if (++tu_frames >= tu_decimation) {
+	propagate_accumulated();
+    }
+}
+
+// Propagates P over the accumulated frames, P = Phi_acc*P*Phi_acc' + Q with
+// Q = 0.5*(Phi_acc*Qw + Qw*Phi_acc') from the summed Qw, as the single frame
+// update forms it; with one frame accumulated this is that update.
+template <typename T>
+void EKF15T<T>::propagate_accumulated() {
+    // nonzero blocks of each block row of Phi_acc
+    static const int row_first[5] = {0, 0, 2, 3, 4};
+    static const bool nonzero[5][5] = {
+	{true, true, true, true, true},
+	{true, true, true, true, true},
+	{false, false, true, false, true},
+	{false, false, false, true, false},
+	{false, false, false, false, true}};
+    Matrix3 Qw_blocks[5];
+    Qw_blocks[0].setZero();
+    Qw_blocks[1] = Qv_acc;
+    Qw_blocks[2] = T(0.25)*dt_acc*Rw.template block<3,3>(3,3);
+    Qw_blocks[3] = dt_acc*Rw.template block<3,3>(6,6);
+    Qw_blocks[4] = dt_acc*Rw.template block<3,3>(9,9);
+
+    Matrix3 Pb[5][5], M[5];
+    for (int i = 0; i < 5; i++) {
+	for (int j = 0; j < 5; j++) {
+	    Pb[i][j] = P_block(i,j);
+	}
+    }
+    for (int i = 0; i < 5; i++) {
+	// M row i = Phi_acc row i * P, only the columns the blocks at and right of
+	// the diagonal use
+	for (int k = (i < 2) ? 0 : i; k < 5; k++) {
+	    M[k].setZero();
+	    for (int l = row_first[i]; l < 5; l++) {
+		if (nonzero[i][l]) {
+		    M[k] += Phi_acc[i][l]*Pb[l][k];
+		}
+	    }
+	}
+	for (int j = i; j < 5; j++) {
+	    Matrix3 block = Matrix3::Zero();
+	    for (int l = row_first[j]; l < 5; l++) {
+		if (nonzero[j][l]) {
+		    block += M[l]*Phi_acc[j][l].transpose();
+		}
+	    }
+	    if (nonzero[i][j]) {
+		block += T(0.5)*Phi_acc[i][j]*Qw_blocks[j];
+	    }
+	    if (nonzero[j][i]) {
+		block += T(0.5)*Qw_blocks[i]*Phi_acc[j][i].transpose();
+	    }
+	    set_P_next_block(i,j,block);
+	}
+    }
+    memcpy(P_packed,P_next,sizeof(P_packed));
+    reset_accumulated();
+}
+
+// Starts a new accumulation, Phi_acc = I
+template <typename T>
+void EKF15T<T>::reset_accumulated() {
+    for (int i = 0; i < 5; i++) {
+	for (int j = 0; j < 5; j++) {
+	    Phi_acc[i][j] = (i == j) ? I3 : Matrix3::Zero();
+	}
+    }
+    Qv_acc.setZero();
+    dt_acc = 0.0;
+    tu_frames = 0;
 }
 
+template class EKF15T<double>;
+template class EKF15T<float>;
 
 #ifdef HAVE_BOOST_PYTHON
 
@@ -39,14 +39,23 @@ typedef Matrix<double,15,12> Matrix15x12d;
 typedef Matrix<double,6,1> Vector6d;
 typedef Matrix<double,15,1> Vector15d;
 
-class EKF15 {
+// Filter on scalar T, double or float. The navigation solution, position,
+// velocity and the attitude quaternion, is propagated in double, as is the GPS
+// innovation, so geodetic precision holds with T = float; the covariance, gains
+// and error state, where nearly all of the arithmetic is, are in T.
+template <typename T>
+class EKF15T {
 
 public:
 
-    EKF15() {
+    EKF15T() {
 	default_config();
+	structured_tu = false;
+	sequential_mu = false;
+	tu_decimation = 1;
+	tu_frames = 0;
     }
-    ~EKF15() {}
+    ~EKF15T() {}
 
     // set/get error characteristics of navigation sensors
     void set_config(NAVconfig config);
@@ -56,27 +65,88 @@ public:
     // main interface
     NAVdata init(IMUdata imu, GPSdata gps);
     NAVdata update(IMUdata imu, GPSdata gps);
+    // the same on increments pre-integrated over every IMU sample since the last
+    // update, both in the body frame at the start of the interval
+    NAVdata update(IMUincrement imu, GPSdata gps);
+
+    // covariance time update: structured, on the packed upper triangle of P using
+    // the block sparsity of PHI and Qw, or the dense reference (default)
+    void set_structured_tu(bool structured);
+
+    // GPS measurement update: six sequential scalar updates on the packed P, or
+    // the batch reference with the 6x6 inverse (default)
+    void set_sequential_mu(bool sequential);
+
+    // structured time update every frames IMU frames (1, the default, for every
+    // frame): in between, the transition and process noise are accumulated and P
+    // is propagated over all of them at once, sooner if a GPS measurement arrives.
+    // The strapdown solution is still updated every frame, the covariance in NAVdata
+    // only when P is propagated.
+    void set_tu_decimation(int frames);
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 private:
 
-    Matrix15d F, PHI, P, Qw, Q, ImKH, KRKt, I15 /* identity */;
-    Matrix15x12d G;
-    Matrix15x6d K;
-    Vector15d x;
-    Matrix12d Rw;
-    Matrix6x15d H;
-    Matrix6d R;
-    Vector6d y;
-    Matrix3d C_N2B, C_B2N, I3 /* identity */, temp33;
+    typedef Matrix<T,3,3> Matrix3;
+    typedef Matrix<T,6,6> Matrix6;
+    typedef Matrix<T,12,12> Matrix12;
+    typedef Matrix<T,15,15> Matrix15;
+    typedef Matrix<T,6,15> Matrix6x15;
+    typedef Matrix<T,15,6> Matrix15x6;
+    typedef Matrix<T,15,12> Matrix15x12;
+    typedef Matrix<T,3,1> Vector3;
+    typedef Matrix<T,6,1> Vector6;
+    typedef Matrix<T,15,1> Vector15;
+
+    void time_update(double imu_dt, const Quaterniond &dq);
+    void gps_update(GPSdata gps);
+    void time_update_dense(T dt);
+    void time_update_structured(T dt);
+    void time_update_decimated(T dt);
+    void propagate_accumulated();
+    void reset_accumulated();
+    void measurement_update_batch();
+    void measurement_update_sequential();
+    Matrix3 P_block(int bi, int bj);
+    void set_P_next_block(int bi, int bj, const Matrix3 &block);
+    T P_diag(int i);
+    void pack_P();
+    void unpack_P();
+
+    Matrix15 F, PHI, P, Qw, Q, ImKH, KRKt, I15 /* identity */;
+    Matrix15x12 G;
+    Matrix15x6 K;
+    Vector15 x;
+    Matrix12 Rw;
+    Matrix6x15 H;
+    Matrix6 R;
+    Vector6 y;
+    Matrix3 I3 /* identity */;
+    Matrix3d C_N2B, C_B2N, temp33;
     Vector3d grav, f_b, om_ib, nr, pos_ins_ecef, pos_ins_ned, pos_gps, pos_gps_ecef, pos_gps_ned, dx, mag_ned;
 
     Quaterniond quat;
     double denom, Re, Rn;
     double tprev;
 
+    // upper triangle of P, row by row, the master copy when structured_tu is set
+    T P_packed[120], P_next[120];
+    bool structured_tu;
+    bool sequential_mu;
+
+    // transition accumulated since P was last propagated, in 3x3 blocks, with
+    // the accumulated velocity process noise and time
+    Matrix3 Phi_acc[5][5], Qv_acc;
+    T dt_acc;
+    int tu_decimation, tu_frames;
+
     NAVconfig config;
     NAVdata nav;
 };
 
+// the flight filter, and its single precision variant, which only the ekf bench uses until
+// its error is within the double filter's sigma and a NEON speedup is measured on ARM
+typedef EKF15T<double> EKF15;
+typedef EKF15T<float> EKF15f;
+
 
 #endif // NAV_15STATE_HXX
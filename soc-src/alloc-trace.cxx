@@ -0,0 +1,85 @@
+
+#include "alloc-trace.hxx"
+
+const uint64_t AllocationTracer::StartupFrames;
+
+static __thread uint64_t ThreadAllocations = 0;
+static __thread uint64_t ThreadBytes = 0;
+
+/* Counts an allocation against the calling thread and makes it. */
+static void *Allocate(size_t Size) {
+  ThreadAllocations++;
+  ThreadBytes += Size;
+  return malloc((Size > 0) ? Size : 1);
+}
+
+void *operator new(size_t Size) {
+  void *Memory = Allocate(Size);
+  if (Memory == NULL) {
+    throw std::bad_alloc();
+  }
+  return Memory;
+}
+
+void *operator new[](size_t Size) {
+  void *Memory = Allocate(Size);
+  if (Memory == NULL) {
+    throw std::bad_alloc();
+  }
+  return Memory;
+}
+
+void *operator new(size_t Size,const std::nothrow_t &) noexcept {
+  return Allocate(Size);
+}
+
+void *operator new[](size_t Size,const std::nothrow_t &) noexcept {
+  return Allocate(Size);
+}
+
+void operator delete(void *Memory) noexcept {
+  free(Memory);
+}
+
+void operator delete[](void *Memory) noexcept {
+  free(Memory);
+}
+
+void operator delete(void *Memory,const std::nothrow_t &) noexcept {
+  free(Memory);
+}
+
+void operator delete[](void *Memory,const std::nothrow_t &) noexcept {
+  free(Memory);
+}
+
+/* Returns the allocations the calling thread has made since it started. */
+AllocationCount GetThreadAllocations() {
+  AllocationCount Count = {ThreadAllocations,ThreadBytes};
+  return Count;
+}
+
+/* Ends a frame, charging it the allocations made since the last one if startup is over. */
+void AllocationTracer::EndFrame() {
+  AllocationCount Count = GetThreadAllocations();
+  if (++Frames_ > StartupFrames) {
+    Stats_.Frames++;
+    if (Count.Allocations != Last_.Allocations) {
+      Stats_.AllocatingFrames++;
+      Stats_.Allocations += Count.Allocations - Last_.Allocations;
+      Stats_.Bytes += Count.Bytes - Last_.Bytes;
+    }
+  }
+  Last_ = Count;
+}
+
+/* Returns the allocations made after startup. */
+AllocationStats AllocationTracer::GetStats() {
+  return Stats_;
+}
+
+/* Prints one row of an allocation table. */
+void AllocationTracer::Print(FILE *File,const char *Name,const AllocationStats &Stats) {
+  fprintf(File,"%-12s %10llu %10llu %10llu %10llu\n",Name,(unsigned long long)Stats.Frames,
+    (unsigned long long)Stats.AllocatingFrames,(unsigned long long)Stats.Allocations,(unsigned long long)Stats.Bytes);
+}
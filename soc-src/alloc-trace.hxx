@@ -0,0 +1,46 @@
+
+#ifndef ALLOC_TRACE_HXX_
+#define ALLOC_TRACE_HXX_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <new>
+
+/* Heap allocations made by the calling thread, through operator new */
+struct AllocationCount {
+  uint64_t Allocations;
+  uint64_t Bytes;
+};
+
+/* Allocations a flight loop stage made per frame, after startup */
+struct AllocationStats {
+  uint64_t Frames;                          // frames after startup
+  uint64_t AllocatingFrames;                // of those, frames that allocated
+  uint64_t Allocations;
+  uint64_t Bytes;
+};
+
+AllocationCount GetThreadAllocations();
+
+/* Charges the heap allocations a thread makes to the frames it runs. Linking in
+alloc-trace.cxx replaces the global operator new, and with it the allocations of
+every container, string and std::function, with one that counts per thread before
+calling malloc; malloc called directly, as by stdio, is not seen. The first
+StartupFrames frames are startup and may allocate, say on first use of something;
+after them the flight loop should never allocate and every allocation is counted
+against the frame it happened in. One tracer per thread, EndFrame and GetStats from
+the thread it traces, or after it has finished. */
+class AllocationTracer {
+  public:
+    static const uint64_t StartupFrames = 100;
+    void EndFrame();
+    AllocationStats GetStats();
+    static void Print(FILE *File,const char *Name,const AllocationStats &Stats);
+  private:
+    uint64_t Frames_ = 0;
+    AllocationCount Last_ = {0,0};
+    AllocationStats Stats_ = {0,0,0,0};
+};
+
+#endif
@@ -0,0 +1,226 @@
+
+#include "bfs.hxx"
+
+const uint8_t BfsCodec::Header[2] = {0x42,0x46};
+const size_t BfsCodec::HeaderSize;
+const size_t BfsCodec::ChecksumSize;
+const size_t BfsCodec::Overhead;
+const size_t BfsCodec::MaxPayloadSize;
+const size_t BfsCodec::MaxMessageSize;
+
+BfsCodec::BfsCodec() {
+  Reset();
+  Stats_.Messages = 0;
+  Stats_.ChecksumErrors = 0;
+  Stats_.LengthErrors = 0;
+  Stats_.DiscardedBytes = 0;
+}
+
+/* Build a BFS Bus message to send, returns the message size. */
+size_t BfsCodec::BuildMessage(BfsMessage MessageId,uint16_t PayloadSize,const uint8_t *Payload,uint8_t *TxBuffer) {
+  BuildHeader(MessageId,PayloadSize,TxBuffer);
+  memcpy(TxBuffer+HeaderSize,Payload,PayloadSize);
+  CalcChecksum(PayloadSize+HeaderSize,TxBuffer,TxBuffer+HeaderSize+PayloadSize);
+  return PayloadSize + Overhead;
+}
+
+/* Build the 5 byte header of a BFS Bus message. */
+void BfsCodec::BuildHeader(BfsMessage MessageId,uint16_t PayloadSize,uint8_t *TxBuffer) {
+  TxBuffer[0] = Header[0];
+  TxBuffer[1] = Header[1];
+  TxBuffer[2] = (uint8_t) MessageId;
+  TxBuffer[3] = PayloadSize & 0xff;
+  TxBuffer[4] = PayloadSize >> 8;
+}
+
+/* Calculate a 2 byte checksum given a byte array. */
+void BfsCodec::CalcChecksum(size_t ArraySize,const uint8_t *ByteArray,uint8_t *Checksum) {
+  Checksum[0] = 0;
+  Checksum[1] = 0;
+  for (size_t i = 0; i < ArraySize; i++) {
+    ChecksumIteration(ByteArray[i],Checksum);
+  }
+}
+
+/* Iterates the checksum state. */
+void BfsCodec::ChecksumIteration(uint8_t Data,uint8_t *Checksum) {
+  Checksum[0] += Data;
+  Checksum[1] += Checksum[0];
+}
+
+/* Parse one byte, returns true when it completes a valid message. */
+bool BfsCodec::Parse(uint8_t Byte) {
+  if (ReplayHead_ == ReplayTail_) {
+    if (Step(Byte)) {
+      return true;
+    }
+    if (ReplayHead_ == ReplayTail_) {
+      return false;
+    }
+    return DrainReplay();
+  }
+  // bytes held back after a failed message are parsed ahead of the new byte
+  if (ReplayTail_ == MaxMessageSize) {
+    memmove(Replay_,Replay_+ReplayHead_,ReplayTail_-ReplayHead_);
+    ReplayTail_ -= ReplayHead_;
+    ReplayHead_ = 0;
+  }
+  Replay_[ReplayTail_++] = Byte;
+  return DrainReplay();
+}
+
+/* Parse a block of bytes, stopping after the first complete message. BytesConsumed is
+set to the number of bytes used, the rest should be passed in again once the message
+has been read. */
+bool BfsCodec::Parse(const uint8_t *Buffer,size_t BufferSize,size_t *BytesConsumed) {
+  size_t i = 0;
+  while (i < BufferSize) {
+    if (ReplayHead_ == ReplayTail_) {
+      if (Length_ == 0) {
+        // skip straight to the next possible header
+        const uint8_t *Next = (const uint8_t *) memchr(Buffer+i,Header[0],BufferSize-i);
+        size_t Skip = (Next != NULL) ? (size_t)(Next-(Buffer+i)) : BufferSize-i;
+        Stats_.DiscardedBytes += Skip;
+        i += Skip;
+        if (i == BufferSize) {
+          break;
+        }
+      } else if ((Length_ >= HeaderSize)&&(Length_ < HeaderSize + PayloadSize_)) {
+        // copy as much of the payload as is available in one go
+        size_t Count = HeaderSize + PayloadSize_ - Length_;
+        if (Count > BufferSize - i) {
+          Count = BufferSize - i;
+        }
+        memcpy(Message_+Length_,Buffer+i,Count);
+        uint8_t Sum0 = Checksum_[0];
+        uint8_t Sum1 = Checksum_[1];
+        for (size_t j=0; j < Count; j++) {
+          Sum0 += Buffer[i+j];
+          Sum1 += Sum0;
+        }
+        Checksum_[0] = Sum0;
+        Checksum_[1] = Sum1;
+        Length_ += Count;
+        i += Count;
+        continue;
+      }
+    }
+    if (Parse(Buffer[i++])) {
+      *BytesConsumed = i;
+      return true;
+    }
+  }
+  *BytesConsumed = i;
+  return false;
+}
+
+/* Returns the ID of the last message parsed. */
+BfsMessage BfsCodec::GetMessageId() {
+  return (BfsMessage) Message_[2];
+}
+
+/* Returns the payload size of the last message parsed. */
+uint16_t BfsCodec::GetPayloadSize() {
+  return ((uint16_t)Message_[4] << 8) | Message_[3];
+}
+
+/* Returns the payload of the last message parsed, valid until the next call to Parse. */
+const uint8_t *BfsCodec::GetPayload() {
+  return Message_ + HeaderSize;
+}
+
+/* Returns the parser counters. */
+BfsParserStats BfsCodec::GetStats() {
+  return Stats_;
+}
+
+/* Clears the parser state and any held back bytes, keeps the counters. */
+void BfsCodec::Reset() {
+  Length_ = 0;
+  PayloadSize_ = 0;
+  Checksum_[0] = 0;
+  Checksum_[1] = 0;
+  ReplayHead_ = 0;
+  ReplayTail_ = 0;
+}
+
+/* Advances the parser state by one byte, returns true when it completes a valid message. */
+bool BfsCodec::Step(uint8_t Byte) {
+  Message_[Length_++] = Byte;
+  if ((Length_ > HeaderSize)&&(Length_ <= HeaderSize + PayloadSize_)) { // payload
+    ChecksumIteration(Byte,Checksum_);
+  } else if (Length_ == 1) { // header
+    if (Byte != Header[0]) {
+      Length_ = 0;
+      Stats_.DiscardedBytes++;
+      return false;
+    }
+    ChecksumIteration(Byte,Checksum_);
+  } else if (Length_ == 2) { // header
+    if (Byte != Header[1]) {
+      Resync();
+      return false;
+    }
+    ChecksumIteration(Byte,Checksum_);
+  } else if (Length_ < HeaderSize) { // message ID and payload length
+    ChecksumIteration(Byte,Checksum_);
+  } else if (Length_ == HeaderSize) { // payload length
+    PayloadSize_ = ((size_t)Byte << 8) | Message_[3];
+    if (PayloadSize_ > MaxPayloadSize) {
+      Stats_.LengthErrors++;
+      Resync();
+      return false;
+    }
+    ChecksumIteration(Byte,Checksum_);
+  } else if (Length_ == HeaderSize + PayloadSize_ + 1) { // checksum
+    if (Byte != Checksum_[0]) {
+      Stats_.ChecksumErrors++;
+      Resync();
+    }
+  } else { // checksum
+    if (Byte != Checksum_[1]) {
+      Stats_.ChecksumErrors++;
+      Resync();
+      return false;
+    }
+    // the message stays in place until the next byte is parsed
+    Length_ = 0;
+    Checksum_[0] = 0;
+    Checksum_[1] = 0;
+    Stats_.Messages++;
+    return true;
+  }
+  return false;
+}
+
+/* Parses held back bytes until a message completes or none are left. */
+bool BfsCodec::DrainReplay() {
+  while (ReplayHead_ < ReplayTail_) {
+    if (Step(Replay_[ReplayHead_++])) {
+      return true;
+    }
+  }
+  ReplayHead_ = 0;
+  ReplayTail_ = 0;
+  return false;
+}
+
+/* Drops a failed message up to the next byte that could start a header. The remaining
+bytes may hold a valid message that a corrupted length swallowed, so they are queued
+ahead of any bytes still waiting to be parsed again. */
+void BfsCodec::Resync() {
+  size_t Start = 1;
+  while ((Start < Length_)&&(Message_[Start] != Header[0])) {
+    Start++;
+  }
+  Stats_.DiscardedBytes += Start;
+  size_t Held = Length_ - Start;
+  size_t Pending = ReplayTail_ - ReplayHead_;
+  memmove(Replay_+Held,Replay_+ReplayHead_,Pending);
+  memcpy(Replay_,Message_+Start,Held);
+  ReplayHead_ = 0;
+  ReplayTail_ = Held + Pending;
+  Length_ = 0;
+  Checksum_[0] = 0;
+  Checksum_[1] = 0;
+}
@@ -0,0 +1,55 @@
+
+#ifndef BFS_HXX_
+#define BFS_HXX_
+
+#include "global-defs.hxx"
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/* Counters kept by the BFS Bus parser */
+struct BfsParserStats {
+  uint64_t Messages;                        // Number of valid messages parsed
+  uint64_t ChecksumErrors;                  // Number of messages dropped for a bad checksum
+  uint64_t LengthErrors;                    // Number of headers with a payload length over MaxPayloadSize
+  uint64_t DiscardedBytes;                  // Number of bytes skipped while searching for a header
+};
+
+/* BFS Bus framing: 2 byte header, message ID, 2 byte payload length (little endian),
+payload, and a 2 byte checksum over everything before it. The parser keeps all of its
+state in the object and never allocates, so any number of links can be parsed at once. */
+class BfsCodec {
+  public:
+    static const uint8_t Header[2];
+    static const size_t HeaderSize = 5;
+    static const size_t ChecksumSize = 2;
+    static const size_t Overhead = HeaderSize + ChecksumSize;
+    static const size_t MaxPayloadSize = 4096;
+    static const size_t MaxMessageSize = MaxPayloadSize + Overhead;
+    BfsCodec();
+    static size_t BuildMessage(BfsMessage MessageId,uint16_t PayloadSize,const uint8_t *Payload,uint8_t *TxBuffer);
+    static void BuildHeader(BfsMessage MessageId,uint16_t PayloadSize,uint8_t *TxBuffer);
+    static void CalcChecksum(size_t ArraySize,const uint8_t *ByteArray,uint8_t *Checksum);
+    static void ChecksumIteration(uint8_t Data,uint8_t *Checksum);
+    bool Parse(uint8_t Byte);
+    bool Parse(const uint8_t *Buffer,size_t BufferSize,size_t *BytesConsumed);
+    BfsMessage GetMessageId();
+    uint16_t GetPayloadSize();
+    const uint8_t *GetPayload();
+    BfsParserStats GetStats();
+    void Reset();
+  private:
+    uint8_t Message_[MaxMessageSize];
+    size_t Length_;
+    size_t PayloadSize_;
+    uint8_t Checksum_[2];
+    uint8_t Replay_[MaxMessageSize];
+    size_t ReplayHead_;
+    size_t ReplayTail_;
+    BfsParserStats Stats_;
+    bool Step(uint8_t Byte);
+    bool DrainReplay();
+    void Resync();
+};
+
+#endif
@@ -1,7 +1,7 @@
 
 #include "config.hxx"
 
-void LoadConfigFile(std::string ConfigFileName, Fmu FmuRef, AircraftConfig *AircraftConfigPtr, FmuData *FmuDataPtr) {
+void LoadConfigFile(std::string ConfigFileName, Fmu &FmuRef, AircraftConfig *AircraftConfigPtr, FmuData *FmuDataPtr, FmuDataLayout *FmuDataLayoutPtr) {
   // Load config file
   std::ifstream ConfigFile(ConfigFileName);
   std::string ConfigBuffer((std::istreambuf_iterator<char>(ConfigFile)),std::istreambuf_iterator<char>());
@@ -13,6 +13,7 @@ void LoadConfigFile(std::string ConfigFileName, Fmu FmuRef, AircraftConfig *Airc
   assert(ConfigDom.IsObject());
 
   // Loop through all nodes
+  AircraftConfigPtr->NumberEffectors = 0;
   size_t SbusVoltageSensors = 0;
   size_t PwmVoltageSensors = 0;
   assert(ConfigDom.HasMember("Nodes"));
@@ -80,6 +81,108 @@ void LoadConfigFile(std::string ConfigFileName, Fmu FmuRef, AircraftConfig *Airc
     }
   }
 
+  // Real-time execution of the flight loop, off unless configured
+  RealTimeConfig RealTime = {false,80,-1,256,8192};
+  if (ConfigDom.HasMember("RealTime")) {
+    const rapidjson::Value& RealTimeNode = ConfigDom["RealTime"];
+    assert(RealTimeNode.IsObject());
+    RealTime.Enabled = true;
+    if (RealTimeNode.HasMember("Enable")) {
+      RealTime.Enabled = RealTimeNode["Enable"].GetBool();
+    }
+    if (RealTimeNode.HasMember("Priority")) {
+      RealTime.Priority = RealTimeNode["Priority"].GetInt();
+    }
+    if (RealTimeNode.HasMember("Cpu")) {
+      RealTime.Cpu = RealTimeNode["Cpu"].GetInt();
+    }
+    if (RealTimeNode.HasMember("PrefaultStack_kB")) {
+      RealTime.PrefaultStack_kB = RealTimeNode["PrefaultStack_kB"].GetUint();
+    }
+    if (RealTimeNode.HasMember("PrefaultHeap_kB")) {
+      RealTime.PrefaultHeap_kB = RealTimeNode["PrefaultHeap_kB"].GetUint();
+    }
+  }
+  AircraftConfigPtr->RealTime = RealTime;
+
+  // Tasks the frame scheduler runs, each one configured replaces the default of that name
+  std::vector<TaskConfig> Tasks = GetDefaultTasks();
+  if (ConfigDom.HasMember("Scheduler")) {
+    const rapidjson::Value& Scheduler = ConfigDom["Scheduler"];
+    assert(Scheduler.IsArray());
+    for (size_t i=0; i < Scheduler.Size(); i++) {
+      const rapidjson::Value& TaskNode = Scheduler[i];
+      assert(TaskNode.HasMember("Name"));
+      std::string Name = TaskNode["Name"].GetString();
+      size_t j = 0;
+      while ((j < Tasks.size())&&(Tasks[j].Name != Name)) {
+        j++;
+      }
+      if (j == Tasks.size()) {
+        throw std::runtime_error("Unknown scheduler task " + Name + ".");
+      }
+      if (TaskNode.HasMember("Rate_hz")) {
+        Tasks[j].Rate_hz = TaskNode["Rate_hz"].GetDouble();
+      }
+      if (TaskNode.HasMember("Deadline_us")) {
+        Tasks[j].Deadline_us = TaskNode["Deadline_us"].GetUint64();
+      }
+      if (TaskNode.HasMember("Overrun")) {
+        Tasks[j].Overrun = GetOverrunPolicy(TaskNode["Overrun"].GetString());
+      }
+      if (TaskNode.HasMember("Slack")) {
+        Tasks[j].Slack = TaskNode["Slack"].GetBool();
+      }
+    }
+  }
+  AircraftConfigPtr->Tasks = Tasks;
+
+  // Telemetry downlink and command uplink, off unless configured
+  TelemetryConfig Telemetry = {false,"127.0.0.1",5600,5601,std::vector<TelemetryChannel>()};
+  if (ConfigDom.HasMember("Telemetry")) {
+    ParseTelemetryConfig(ConfigDom["Telemetry"],&Telemetry);
+  }
+  AircraftConfigPtr->Telemetry = Telemetry;
+
+  // Navigation filter options, the filter's defaults, dense and batch, unless configured
+  NavigationConfig Navigation = {1,false,false};
+  if (ConfigDom.HasMember("Navigation")) {
+    const rapidjson::Value& NavigationNode = ConfigDom["Navigation"];
+    assert(NavigationNode.IsObject());
+    if (NavigationNode.HasMember("TuDecimation")) {
+      Navigation.TuDecimation = NavigationNode["TuDecimation"].GetInt();
+    }
+    if (NavigationNode.HasMember("SequentialMu")) {
+      Navigation.SequentialMu = NavigationNode["SequentialMu"].GetBool();
+    }
+    if (NavigationNode.HasMember("StructuredTu")) {
+      Navigation.StructuredTu = NavigationNode["StructuredTu"].GetBool();
+    }
+    if (Navigation.TuDecimation < 1) {
+      throw std::runtime_error("Navigation TuDecimation must be at least 1.");
+    }
+    if ((Navigation.TuDecimation > 1)&&!Navigation.StructuredTu) {
+      throw std::runtime_error("Navigation TuDecimation needs StructuredTu.");
+    }
+  }
+  AircraftConfigPtr->Navigation = Navigation;
+
+  // Control laws, compiled once the sensors they read are known
+  AircraftConfigPtr->ControlLaws.clear();
+  if (ConfigDom.HasMember("ControlLaws")) {
+    rapidjson::StringBuffer ControlLawsBuffer;
+    rapidjson::Writer<rapidjson::StringBuffer> ControlLawsWriter(ControlLawsBuffer);
+    ConfigDom["ControlLaws"].Accept(ControlLawsWriter);
+    AircraftConfigPtr->ControlLaws = ControlLawsBuffer.GetString();
+  }
+
   FmuDataPtr->SbusVoltage.resize(SbusVoltageSensors);
   FmuDataPtr->PwmVoltage.resize(PwmVoltageSensors);
+
+  // Fix where each sensor sits in the data payload, the FMU sends raw structs unless told otherwise
+  DataEncoding Encoding = kRawEncoding;
+  if (ConfigDom.HasMember("DataEncoding")) {
+    Encoding = GetDataEncoding(ConfigDom["DataEncoding"].GetString());
+  }
+  *FmuDataLayoutPtr = BuildDataLayout(*FmuDataPtr,Encoding);
 }
@@ -4,6 +4,9 @@
 
 #include "global-defs.hxx"
 #include "fmu.hxx"
+#include "data-layout.hxx"
+#include "scheduler.hxx"
+#include "telemetry-codec.hxx"
 
 #include "../soc-includes/rapidjson/document.h"
 #include "../soc-includes/rapidjson/stringbuffer.h"
@@ -18,6 +21,6 @@
 #include <fcntl.h>
 #include <unistd.h>
 
-void LoadConfigFile(std::string ConfigFileName, Fmu FmuRef, AircraftConfig *AircraftConfigPtr, FmuData *FmuDataPtr);
+void LoadConfigFile(std::string ConfigFileName, Fmu &FmuRef, AircraftConfig *AircraftConfigPtr, FmuData *FmuDataPtr, FmuDataLayout *FmuDataLayoutPtr);
 
 #endif
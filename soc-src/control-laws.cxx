@@ -0,0 +1,316 @@
+
+#include "control-laws.hxx"
+
+const uint16_t ControlLaws::NoSignal;
+const uint64_t ControlLaws::MaxStep_us;
+
+ControlLaws::ControlLaws() {}
+
+/* Returns the named member of a block, which must be there. */
+static const rapidjson::Value &GetMember(const rapidjson::Value &Block,const char *Name) {
+  if (!Block.HasMember(Name)) {
+    throw std::runtime_error(std::string("Control law block is missing ") + Name + ".");
+  }
+  return Block[Name];
+}
+
+/* Returns a number from a block, or Default if it is not given. */
+static float GetNumber(const rapidjson::Value &Block,const char *Name,float Default) {
+  return Block.HasMember(Name) ? (float)Block[Name].GetDouble() : Default;
+}
+
+/* Parses the control laws from their JSON and compiles them. */
+void ControlLaws::Compile(const std::string &ControlLawsJson,const FmuData &FmuDataRef,size_t NumberEffectors) {
+  rapidjson::Document ControlLawsDom;
+  ControlLawsDom.Parse(ControlLawsJson.c_str());
+  if (!ControlLawsDom.IsObject()) {
+    throw std::runtime_error("Control laws are not a JSON object.");
+  }
+  Compile(ControlLawsDom,FmuDataRef,NumberEffectors);
+}
+
+/* Compiles the control laws: each block in order becomes one or a few instructions
+over signals, parameters and state allocated here. Sources are checked against the
+sensors configured in FmuDataRef, and there must be a command for every effector. */
+void ControlLaws::Compile(const rapidjson::Value &ControlLawsRef,const FmuData &FmuDataRef,size_t NumberEffectors) {
+  Program_.clear();
+  Signals_.clear();
+  Params_.clear();
+  State_.clear();
+  SignalNames_.clear();
+  Blocks_ = 0;
+  const rapidjson::Value &Blocks = GetMember(ControlLawsRef,"Blocks");
+  assert(Blocks.IsArray());
+  for (size_t i=0; i < Blocks.Size(); i++) {
+    const rapidjson::Value &Block = Blocks[i];
+    std::string Type = GetMember(Block,"Type").GetString();
+    std::string Output = GetMember(Block,"Output").GetString();
+    if (SignalNames_.count(Output) > 0) {
+      throw std::runtime_error("Control law signal " + Output + " is the output of more than one block.");
+    }
+    if (Type == "Constant") {
+      uint32_t Param = AddParams(std::vector<float>(1,(float)GetMember(Block,"Value").GetDouble()));
+      AddInstruction(kConstantOp,AddSignal(Output),NoSignal,NoSignal,NoSignal,0,Param,0);
+    } else if (Type == "Gain") {
+      uint16_t Input = GetSignal(GetMember(Block,"Input").GetString(),FmuDataRef);
+      uint32_t Param = AddParams(std::vector<float>(1,(float)GetMember(Block,"Gain").GetDouble()));
+      AddInstruction(kScaleOp,AddSignal(Output),Input,NoSignal,NoSignal,0,Param,0);
+    } else if (Type == "Sum") {
+      const rapidjson::Value &Inputs = GetMember(Block,"Inputs");
+      assert(Inputs.IsArray()&&(Inputs.Size() > 0));
+      std::vector<uint16_t> InputSignals;
+      std::vector<float> Signs(Inputs.Size(),1.0f);
+      if (Block.HasMember("Signs")&&(!Block["Signs"].IsArray()||(Block["Signs"].Size() != Inputs.Size()))) {
+        throw std::runtime_error("Control law sum " + Output + " needs one sign for each of its " + std::to_string(Inputs.Size()) + " inputs.");
+      }
+      for (size_t j=0; j < Inputs.Size(); j++) {
+        InputSignals.push_back(GetSignal(Inputs[j].GetString(),FmuDataRef));
+        if (Block.HasMember("Signs")) {
+          if (!Block["Signs"][j].IsNumber()) {
+            throw std::runtime_error("Control law sum " + Output + " has a sign that is not a number.");
+          }
+          Signs[j] = (float)Block["Signs"][j].GetDouble();
+        }
+      }
+      uint32_t Param = AddParams(Signs);
+      uint16_t Out = AddSignal(Output);
+      AddInstruction(kScaleOp,Out,InputSignals[0],NoSignal,NoSignal,0,Param,0);
+      for (size_t j=1; j < InputSignals.size(); j++) {
+        AddInstruction(kAddScaledOp,Out,InputSignals[j],NoSignal,NoSignal,0,Param+j,0);
+      }
+    } else if (Type == "Pid") {
+      uint16_t Input = GetSignal(GetMember(Block,"Input").GetString(),FmuDataRef);
+      uint16_t Reset = Block.HasMember("Reset") ? GetSignal(Block["Reset"].GetString(),FmuDataRef) : NoSignal;
+      std::vector<float> Params;
+      Params.push_back(GetNumber(Block,"Kp",0.0f));
+      Params.push_back(GetNumber(Block,"Ki",0.0f));
+      Params.push_back(GetNumber(Block,"Kd",0.0f));
+      Params.push_back(GetNumber(Block,"Min",-1e30f));
+      Params.push_back(GetNumber(Block,"Max",1e30f));
+      Params.push_back(GetNumber(Block,"Tf",0.0f));
+      uint32_t Param = AddParams(Params);
+      AddInstruction(kPidOp,AddSignal(Output),Input,Reset,NoSignal,0,Param,AddState(3));
+    } else if (Type == "Filter") {
+      uint16_t Input = GetSignal(GetMember(Block,"Input").GetString(),FmuDataRef);
+      const rapidjson::Value &Num = GetMember(Block,"Num");
+      const rapidjson::Value &Den = GetMember(Block,"Den");
+      assert(Num.IsArray()&&Den.IsArray()&&(Num.Size() > 0)&&(Den.Size() > 0));
+      size_t Order = std::max(Num.Size(),Den.Size()) - 1;
+      float A0 = (float)Den[0].GetDouble();
+      if (A0 == 0.0f) {
+        throw std::runtime_error("Control law filter " + Output + " has a zero leading denominator coefficient.");
+      }
+      // b0..bn then a1..an, normalized so a0 is 1
+      std::vector<float> Params(2*Order+1,0.0f);
+      for (size_t j=0; j < Num.Size(); j++) {
+        Params[j] = (float)Num[j].GetDouble()/A0;
+      }
+      for (size_t j=1; j < Den.Size(); j++) {
+        Params[Order+j] = (float)Den[j].GetDouble()/A0;
+      }
+      uint32_t Param = AddParams(Params);
+      AddInstruction(kFilterOp,AddSignal(Output),Input,NoSignal,NoSignal,Order,Param,AddState(Order));
+    } else if (Type == "Limit") {
+      uint16_t Input = GetSignal(GetMember(Block,"Input").GetString(),FmuDataRef);
+      std::vector<float> Params;
+      Params.push_back((float)GetMember(Block,"Min").GetDouble());
+      Params.push_back((float)GetMember(Block,"Max").GetDouble());
+      uint32_t Param = AddParams(Params);
+      AddInstruction(kLimitOp,AddSignal(Output),Input,NoSignal,NoSignal,0,Param,0);
+    } else if (Type == "Switch") {
+      uint16_t Condition = GetSignal(GetMember(Block,"Condition").GetString(),FmuDataRef);
+      uint16_t On = GetSignal(GetMember(Block,"On").GetString(),FmuDataRef);
+      uint16_t Off = GetSignal(GetMember(Block,"Off").GetString(),FmuDataRef);
+      AddInstruction(kSwitchOp,AddSignal(Output),Condition,On,Off,0,0,0);
+    } else {
+      throw std::runtime_error("Unknown control law block type " + Type + ".");
+    }
+    Blocks_++;
+  }
+  const rapidjson::Value &Effectors = GetMember(ControlLawsRef,"Effectors");
+  assert(Effectors.IsArray());
+  if (Effectors.Size() != NumberEffectors) {
+    throw std::runtime_error("Control laws command " + std::to_string(Effectors.Size()) + " effectors, the aircraft has " + std::to_string(NumberEffectors) + ".");
+  }
+  for (size_t i=0; i < Effectors.Size(); i++) {
+    AddInstruction(kCommandOp,NoSignal,GetSignal(Effectors[i].GetString(),FmuDataRef),NoSignal,NoSignal,0,i,0);
+  }
+  Commands_.assign(Effectors.Size(),0.0f);
+  Reset();
+}
+
+/* Returns true once control laws have been compiled. */
+bool ControlLaws::Compiled() {
+  return Program_.size() > 0;
+}
+
+/* Runs the control laws once on a frame of data, the navigation solution and the
+values set by the ground station, which may be NULL. The time step for PIDs comes
+from the FMU time. The first step after a reset has none, and neither does a step
+where the FMU time went back, as it does when the FMU resets, or jumped ahead more
+than MaxStep_us, so the integrators never take a step that is not real. */
+void ControlLaws::Step(const FmuData &FmuDataRef,const NavigationData &NavigationDataRef,const float *Uplink) {
+  float Dt_s = 0.0f;
+  if (Started_&&(FmuDataRef.Time_us > LastTime_us_)&&(FmuDataRef.Time_us - LastTime_us_ <= MaxStep_us)) {
+    Dt_s = (FmuDataRef.Time_us - LastTime_us_)*1e-6f;
+  }
+  LastTime_us_ = FmuDataRef.Time_us;
+  Started_ = true;
+  float *Signals = Signals_.data();
+  const float *Params = Params_.data();
+  float *State = State_.data();
+  const ControlInstruction *End = Program_.data() + Program_.size();
+  for (const ControlInstruction *Instruction = Program_.data(); Instruction != End; Instruction++) {
+    const float *P = Params + Instruction->Param;
+    float *X = State + Instruction->State;
+    switch (Instruction->Op) {
+      case kLoadOp:
+        {
+          const SignalSource Source = {Instruction->In[0],Instruction->In[1],Instruction->In[2]};
+          Signals[Instruction->Out] = ReadSignalSource(Source,FmuDataRef,NavigationDataRef,Uplink);
+        }
+        break;
+      case kConstantOp:
+        Signals[Instruction->Out] = P[0];
+        break;
+      case kScaleOp:
+        Signals[Instruction->Out] = P[0]*Signals[Instruction->In[0]];
+        break;
+      case kAddScaledOp:
+        Signals[Instruction->Out] += P[0]*Signals[Instruction->In[0]];
+        break;
+      case kPidOp: {
+        // P is Kp, Ki, Kd, Min, Max, Tf; X is the integral, the last input and the filtered derivative
+        float Error = Signals[Instruction->In[0]];
+        float Dt = Dt_s;
+        if ((Instruction->In[1] != NoSignal)&&(Signals[Instruction->In[1]] > 0.5f)) {
+          X[0] = 0.0f;
+          X[2] = 0.0f;
+          Dt = 0.0f;
+        }
+        float Derivative = 0.0f;
+        if (Dt > 0.0f) {
+          Derivative = X[2] + Dt/(P[5] + Dt)*((Error - X[1])/Dt - X[2]);
+        }
+        X[1] = Error;
+        X[2] = Derivative;
+        float Integral = X[0] + P[1]*Error*Dt;
+        float Output = P[0]*Error + Integral + P[2]*Derivative;
+        // stop integrating further into saturation
+        if (Output > P[4]) {
+          Output = P[4];
+          Integral = std::min(Integral,X[0]);
+        } else if (Output < P[3]) {
+          Output = P[3];
+          Integral = std::max(Integral,X[0]);
+        }
+        X[0] = Integral;
+        Signals[Instruction->Out] = Output;
+        break;
+      }
+      case kFilterOp: {
+        // P is b0..bn then a1..an, X the n delays
+        size_t Order = Instruction->Count;
+        float Input = Signals[Instruction->In[0]];
+        float Output = P[0]*Input + ((Order > 0) ? X[0] : 0.0f);
+        for (size_t i=0; i < Order; i++) {
+          X[i] = P[i+1]*Input - P[Order+i+1]*Output + ((i+1 < Order) ? X[i+1] : 0.0f);
+        }
+        Signals[Instruction->Out] = Output;
+        break;
+      }
+      case kLimitOp:
+        Signals[Instruction->Out] = std::min(std::max(Signals[Instruction->In[0]],P[0]),P[1]);
+        break;
+      case kSwitchOp:
+        Signals[Instruction->Out] = (Signals[Instruction->In[0]] > 0.5f) ? Signals[Instruction->In[1]] : Signals[Instruction->In[2]];
+        break;
+      case kCommandOp:
+        Commands_[Instruction->Param] = Signals[Instruction->In[0]];
+        break;
+    }
+  }
+}
+
+/* Clears the block state and the time step, as before the first step. */
+void ControlLaws::Reset() {
+  std::fill(State_.begin(),State_.end(),0.0f);
+  std::fill(Signals_.begin(),Signals_.end(),0.0f);
+  Started_ = false;
+}
+
+/* Returns the effector commands from the last step, one per effector. */
+const std::vector<float> &ControlLaws::GetCommands() {
+  return Commands_;
+}
+
+/* Returns the number of blocks compiled. */
+size_t ControlLaws::GetBlocks() {
+  return Blocks_;
+}
+
+/* Returns the number of instructions a step runs. */
+size_t ControlLaws::GetInstructions() {
+  return Program_.size();
+}
+
+/* Returns the number of signals, block outputs and sources. */
+size_t ControlLaws::GetSignals() {
+  return Signals_.size();
+}
+
+/* Returns the signal called Name, adding a load for it if it is a source read for
+the first time. */
+uint16_t ControlLaws::GetSignal(const std::string &Name,const FmuData &FmuDataRef) {
+  std::map<std::string,uint16_t>::iterator Signal = SignalNames_.find(Name);
+  if (Signal != SignalNames_.end()) {
+    return Signal->second;
+  }
+  SignalSource Source;
+  bool Valid = ParseSignalSource(Name,FmuDataRef,&Source);
+  if (!Valid) {
+    throw std::runtime_error("Unknown control law signal " + Name + ", it is neither a configured source nor the output of an earlier block.");
+  }
+  uint16_t Out = AddSignal(Name);
+  AddInstruction(kLoadOp,Out,Source.Source,Source.Sensor,Source.Component,0,0,0);
+  return Out;
+}
+
+/* Adds a signal and returns its index. */
+uint16_t ControlLaws::AddSignal(const std::string &Name) {
+  if (Signals_.size() >= NoSignal) {
+    throw std::runtime_error("Control laws have too many signals.");
+  }
+  uint16_t Index = Signals_.size();
+  Signals_.push_back(0.0f);
+  SignalNames_[Name] = Index;
+  return Index;
+}
+
+/* Adds block parameters and returns the index of the first. */
+uint32_t ControlLaws::AddParams(const std::vector<float> &Params) {
+  uint32_t Index = Params_.size();
+  Params_.insert(Params_.end(),Params.begin(),Params.end());
+  return Index;
+}
+
+/* Adds Count state values and returns the index of the first. */
+uint32_t ControlLaws::AddState(size_t Count) {
+  uint32_t Index = State_.size();
+  State_.resize(State_.size() + Count,0.0f);
+  return Index;
+}
+
+/* Appends an instruction to the program. */
+void ControlLaws::AddInstruction(ControlOp Op,uint16_t Out,uint16_t In0,uint16_t In1,uint16_t In2,uint16_t Count,uint32_t Param,uint32_t State) {
+  ControlInstruction Instruction;
+  Instruction.Op = Op;
+  Instruction.Out = Out;
+  Instruction.In[0] = In0;
+  Instruction.In[1] = In1;
+  Instruction.In[2] = In2;
+  Instruction.Count = Count;
+  Instruction.Param = Param;
+  Instruction.State = State;
+  Program_.push_back(Instruction);
+}
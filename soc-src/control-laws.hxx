@@ -0,0 +1,82 @@
+
+#ifndef CONTROL_LAWS_HXX_
+#define CONTROL_LAWS_HXX_
+
+#include "global-defs.hxx"
+#include "signal-source.hxx"
+#include "../soc-includes/rapidjson/document.h"
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+/* Operations the compiled control laws are made of */
+enum ControlOp {
+  kLoadOp,                                  // signal source, In is source, sensor, component
+  kConstantOp,                              // parameter
+  kScaleOp,                                 // parameter times signal
+  kAddScaledOp,                             // adds parameter times signal
+  kPidOp,                                   // PID with derivative filter and anti-windup, optional reset signal
+  kFilterOp,                                // IIR filter of order Count, transposed direct form II
+  kLimitOp,                                 // signal clamped to two parameters
+  kSwitchOp,                                // one signal or another on a condition signal
+  kCommandOp                                // signal to an effector command
+};
+
+/* One step of compiled control laws. Out and In index signals, Param the first of
+the parameters, State the first of the state values. */
+struct ControlInstruction {
+  uint16_t Op;
+  uint16_t Out;
+  uint16_t In[3];
+  uint16_t Count;
+  uint32_t Param;
+  uint32_t State;
+};
+
+/* Control laws described as a list of blocks in the aircraft configuration, under
+"ControlLaws", compiled once into a flat array of instructions over preallocated
+signal, parameter and state arrays. A step runs the instructions in order with no
+allocation and no lookups, in the same time every frame. Each block names its
+output signal and reads signals named by earlier blocks, or sources such as
+"Mpu9250/Gyro_rads/0", "SbusRx/0/AutoEnabled", "Nav/Euler_rad/1" or "Uplink/0", so blocks run
+in the order given and feedback goes only through block state. "Effectors" lists
+the signal commanding each effector, in the order the FMU numbers them. */
+class ControlLaws {
+  public:
+    static const uint16_t NoSignal = 0xffff;
+    static const uint64_t MaxStep_us = 1000000;  // longer steps, and FMU time going back, are taken as none
+    ControlLaws();
+    void Compile(const std::string &ControlLawsJson,const FmuData &FmuDataRef,size_t NumberEffectors);
+    void Compile(const rapidjson::Value &ControlLawsRef,const FmuData &FmuDataRef,size_t NumberEffectors);
+    bool Compiled();
+    void Step(const FmuData &FmuDataRef,const NavigationData &NavigationDataRef,const float *Uplink);
+    void Reset();
+    const std::vector<float> &GetCommands();
+    size_t GetBlocks();
+    size_t GetInstructions();
+    size_t GetSignals();
+  private:
+    std::vector<ControlInstruction> Program_;
+    std::vector<float> Signals_;
+    std::vector<float> Params_;
+    std::vector<float> State_;
+    std::vector<float> Commands_;
+    std::map<std::string,uint16_t> SignalNames_;
+    size_t Blocks_ = 0;
+    uint64_t LastTime_us_ = 0;
+    bool Started_ = false;
+    uint16_t GetSignal(const std::string &Name,const FmuData &FmuDataRef);
+    uint16_t AddSignal(const std::string &Name);
+    uint32_t AddParams(const std::vector<float> &Params);
+    uint32_t AddState(size_t Count);
+    void AddInstruction(ControlOp Op,uint16_t Out,uint16_t In0,uint16_t In1,uint16_t In2,uint16_t Count,uint32_t Param,uint32_t State);
+};
+
+#endif
@@ -0,0 +1,405 @@
+
+#include "data-layout.hxx"
+
+/* Appends Count records of type T to the payload layout. */
+template <typename T>
+static SensorLayout AppendLayout(size_t Count, DataEncoding Encoding, size_t *PayloadSize) {
+  SensorLayout Layout;
+  Layout.Offset = *PayloadSize;
+  Layout.Count = Count;
+  Layout.Stride = PackedSize<T>(Encoding);
+  Layout.Encoding = Encoding;
+  *PayloadSize += Count*Layout.Stride;
+  return Layout;
+}
+
+/* Writes Count records of type T where the layout puts them. */
+template <typename T>
+static void EncodeRecords(const T *Records, const SensorLayout &Layout, uint8_t *Payload) {
+  for (size_t i=0; i < Layout.Count; i++) {
+    if (Layout.Encoding == kRawEncoding) {
+      memcpy(Payload+Layout.Offset+i*Layout.Stride,Records+i,sizeof(T));
+    } else {
+      PackRecord(Records[i],Layout.Encoding,Payload+Layout.Offset+i*Layout.Stride);
+    }
+  }
+}
+
+/* The sensors whose records carry an update bit, in the order they are sent. Time is in
+every frame so it has none. */
+static const size_t SensorTypes = 13;
+static void GetSensorLayouts(const FmuDataLayout &Layout, const SensorLayout *Sensors[SensorTypes]) {
+  Sensors[0] = &Layout.InputVoltage;
+  Sensors[1] = &Layout.RegulatedVoltage;
+  Sensors[2] = &Layout.Mpu9250;
+  Sensors[3] = &Layout.Bme280;
+  Sensors[4] = &Layout.Mpu9250Ext;
+  Sensors[5] = &Layout.Bme280Ext;
+  Sensors[6] = &Layout.SbusRx;
+  Sensors[7] = &Layout.Gps;
+  Sensors[8] = &Layout.Pitot;
+  Sensors[9] = &Layout.PressureTransducer;
+  Sensors[10] = &Layout.Analog;
+  Sensors[11] = &Layout.SbusVoltage;
+  Sensors[12] = &Layout.PwmVoltage;
+}
+
+/* Flags for single records and for sensors with any number of records */
+static bool IsUpdated(bool Updated, size_t) {
+  return Updated;
+}
+
+static bool IsUpdated(const std::vector<bool> &Updated, size_t Index) {
+  return (Index < Updated.size()) ? Updated[Index] : true;
+}
+
+/* Appends the updated records of one sensor to a sparse payload and sets their bits. */
+template <typename T, typename U>
+static void EncodeSparseRecords(const T *Records, const U &Updated, const SensorLayout &Layout, uint8_t *UpdateMask, size_t *Record, uint8_t **Cursor) {
+  for (size_t i=0; i < Layout.Count; i++) {
+    if (IsUpdated(Updated,i)) {
+      if (Layout.Encoding == kRawEncoding) {
+        memcpy(*Cursor,Records+i,sizeof(T));
+      } else {
+        PackRecord(Records[i],Layout.Encoding,*Cursor);
+      }
+      *Cursor += Layout.Stride;
+      UpdateMask[*Record/8] |= 1 << (*Record%8);
+    }
+    (*Record)++;
+  }
+}
+
+/* Computes the data payload layout from the sensor counts in FmuData, which are set
+when the configuration is loaded. Packed payloads start with a version header. */
+FmuDataLayout BuildDataLayout(const FmuData &FmuDataRef,DataEncoding Encoding) {
+  FmuDataLayout Layout;
+  size_t Size = (Encoding == kRawEncoding) ? 0 : PackedDataHeaderSize;
+  Layout.Encoding = Encoding;
+  Layout.Time = AppendLayout<uint64_t>(1,Encoding,&Size);
+  Layout.InputVoltage = AppendLayout<Voltage>(1,Encoding,&Size);
+  Layout.RegulatedVoltage = AppendLayout<Voltage>(1,Encoding,&Size);
+  Layout.Mpu9250 = AppendLayout<Mpu9250Data>(1,Encoding,&Size);
+  Layout.Bme280 = AppendLayout<Bme280Data>(1,Encoding,&Size);
+  Layout.Mpu9250Ext = AppendLayout<Mpu9250Data>(FmuDataRef.Mpu9250Ext.size(),Encoding,&Size);
+  Layout.Bme280Ext = AppendLayout<Bme280Data>(FmuDataRef.Bme280Ext.size(),Encoding,&Size);
+  Layout.SbusRx = AppendLayout<SbusRxData>(FmuDataRef.SbusRx.size(),Encoding,&Size);
+  Layout.Gps = AppendLayout<GpsData>(FmuDataRef.Gps.size(),Encoding,&Size);
+  Layout.Pitot = AppendLayout<PitotData>(FmuDataRef.Pitot.size(),Encoding,&Size);
+  Layout.PressureTransducer = AppendLayout<PressureData>(FmuDataRef.PressureTransducer.size(),Encoding,&Size);
+  Layout.Analog = AppendLayout<AnalogData>(FmuDataRef.Analog.size(),Encoding,&Size);
+  Layout.SbusVoltage = AppendLayout<Voltage>(FmuDataRef.SbusVoltage.size(),Encoding,&Size);
+  Layout.PwmVoltage = AppendLayout<Voltage>(FmuDataRef.PwmVoltage.size(),Encoding,&Size);
+  Layout.PayloadSize = Size;
+  const SensorLayout *Sensors[SensorTypes];
+  GetSensorLayouts(Layout,Sensors);
+  Layout.Records = 0;
+  for (size_t i=0; i < SensorTypes; i++) {
+    Layout.Records += Sensors[i]->Count;
+  }
+  Layout.UpdateMaskSize = (Layout.Records + 7)/8;
+  return Layout;
+}
+
+/* Encodes FmuData into a payload of Layout.PayloadSize bytes, as the FMU sends it. Returns
+the payload size. */
+size_t EncodeFmuData(const FmuData &FmuDataRef,const FmuDataLayout &Layout,uint8_t *Payload) {
+  if (Layout.Encoding != kRawEncoding) {
+    PackDataHeader(Layout.Encoding,Payload);
+  }
+  EncodeRecords(&FmuDataRef.Time_us,Layout.Time,Payload);
+  EncodeRecords(&FmuDataRef.InputVoltage,Layout.InputVoltage,Payload);
+  EncodeRecords(&FmuDataRef.RegulatedVoltage,Layout.RegulatedVoltage,Payload);
+  EncodeRecords(&FmuDataRef.Mpu9250,Layout.Mpu9250,Payload);
+  EncodeRecords(&FmuDataRef.Bme280,Layout.Bme280,Payload);
+  EncodeRecords(FmuDataRef.Mpu9250Ext.data(),Layout.Mpu9250Ext,Payload);
+  EncodeRecords(FmuDataRef.Bme280Ext.data(),Layout.Bme280Ext,Payload);
+  EncodeRecords(FmuDataRef.SbusRx.data(),Layout.SbusRx,Payload);
+  EncodeRecords(FmuDataRef.Gps.data(),Layout.Gps,Payload);
+  EncodeRecords(FmuDataRef.Pitot.data(),Layout.Pitot,Payload);
+  EncodeRecords(FmuDataRef.PressureTransducer.data(),Layout.PressureTransducer,Payload);
+  EncodeRecords(FmuDataRef.Analog.data(),Layout.Analog,Payload);
+  EncodeRecords(FmuDataRef.SbusVoltage.data(),Layout.SbusVoltage,Payload);
+  EncodeRecords(FmuDataRef.PwmVoltage.data(),Layout.PwmVoltage,Payload);
+  return Layout.PayloadSize;
+}
+
+/* Largest sparse payload: the packed header, the update mask and every record. */
+size_t GetSparsePayloadSize(const FmuDataLayout &Layout) {
+  size_t DenseHeaderSize = (Layout.Encoding == kRawEncoding) ? 0 : PackedDataHeaderSize;
+  return PackedDataHeaderSize + Layout.UpdateMaskSize + Layout.PayloadSize - DenseHeaderSize;
+}
+
+/* Encodes a kDataSparse payload: the packed header, a bit per record set for the records
+flagged in FmuDataRef.Updated, Time, then only the flagged records in the layout's encoding.
+Payload must hold GetSparsePayloadSize bytes, returns the bytes used. */
+size_t EncodeSparseFmuData(const FmuData &FmuDataRef,const FmuDataLayout &Layout,uint8_t *Payload) {
+  uint8_t *Cursor = Payload + PackDataHeader(Layout.Encoding,Payload);
+  uint8_t *UpdateMask = Cursor;
+  memset(UpdateMask,0,Layout.UpdateMaskSize);
+  Cursor += Layout.UpdateMaskSize;
+  if (Layout.Encoding == kRawEncoding) {
+    memcpy(Cursor,&FmuDataRef.Time_us,sizeof(FmuDataRef.Time_us));
+  } else {
+    PackRecord(FmuDataRef.Time_us,Layout.Encoding,Cursor);
+  }
+  Cursor += Layout.Time.Stride;
+  const FmuDataUpdated &Updated = FmuDataRef.Updated;
+  size_t Record = 0;
+  EncodeSparseRecords(&FmuDataRef.InputVoltage,Updated.InputVoltage,Layout.InputVoltage,UpdateMask,&Record,&Cursor);
+  EncodeSparseRecords(&FmuDataRef.RegulatedVoltage,Updated.RegulatedVoltage,Layout.RegulatedVoltage,UpdateMask,&Record,&Cursor);
+  EncodeSparseRecords(&FmuDataRef.Mpu9250,Updated.Mpu9250,Layout.Mpu9250,UpdateMask,&Record,&Cursor);
+  EncodeSparseRecords(&FmuDataRef.Bme280,Updated.Bme280,Layout.Bme280,UpdateMask,&Record,&Cursor);
+  EncodeSparseRecords(FmuDataRef.Mpu9250Ext.data(),Updated.Mpu9250Ext,Layout.Mpu9250Ext,UpdateMask,&Record,&Cursor);
+  EncodeSparseRecords(FmuDataRef.Bme280Ext.data(),Updated.Bme280Ext,Layout.Bme280Ext,UpdateMask,&Record,&Cursor);
+  EncodeSparseRecords(FmuDataRef.SbusRx.data(),Updated.SbusRx,Layout.SbusRx,UpdateMask,&Record,&Cursor);
+  EncodeSparseRecords(FmuDataRef.Gps.data(),Updated.Gps,Layout.Gps,UpdateMask,&Record,&Cursor);
+  EncodeSparseRecords(FmuDataRef.Pitot.data(),Updated.Pitot,Layout.Pitot,UpdateMask,&Record,&Cursor);
+  EncodeSparseRecords(FmuDataRef.PressureTransducer.data(),Updated.PressureTransducer,Layout.PressureTransducer,UpdateMask,&Record,&Cursor);
+  EncodeSparseRecords(FmuDataRef.Analog.data(),Updated.Analog,Layout.Analog,UpdateMask,&Record,&Cursor);
+  EncodeSparseRecords(FmuDataRef.SbusVoltage.data(),Updated.SbusVoltage,Layout.SbusVoltage,UpdateMask,&Record,&Cursor);
+  EncodeSparseRecords(FmuDataRef.PwmVoltage.data(),Updated.PwmVoltage,Layout.PwmVoltage,UpdateMask,&Record,&Cursor);
+  return Cursor - Payload;
+}
+
+/* Copies a full data payload over the last one. A record counts as updated when its bytes
+changed, which is how a slow sensor shows new data when every record is sent. */
+void MergeDataPayload(const FmuDataLayout &Layout,const uint8_t *Payload,uint8_t *DataPayload,uint8_t *UpdateMask) {
+  memset(UpdateMask,0,Layout.UpdateMaskSize);
+  memcpy(DataPayload,Payload,Layout.Time.Offset + Layout.Time.Stride);
+  const SensorLayout *Sensors[SensorTypes];
+  GetSensorLayouts(Layout,Sensors);
+  size_t Record = 0;
+  for (size_t i=0; i < SensorTypes; i++) {
+    for (size_t j=0; j < Sensors[i]->Count; j++) {
+      size_t Offset = Sensors[i]->Offset + j*Sensors[i]->Stride;
+      if (memcmp(DataPayload+Offset,Payload+Offset,Sensors[i]->Stride) != 0) {
+        memcpy(DataPayload+Offset,Payload+Offset,Sensors[i]->Stride);
+        UpdateMask[Record/8] |= 1 << (Record%8);
+      }
+      Record++;
+    }
+  }
+}
+
+/* Copies the records carried by a kDataSparse payload over the last full payload, the
+rest keep their last value. Returns false, leaving the payload untouched, if the header
+or size does not match the layout. */
+bool MergeSparseDataPayload(const FmuDataLayout &Layout,const uint8_t *Payload,size_t PayloadSize,uint8_t *DataPayload,uint8_t *UpdateMask) {
+  size_t HeaderSize = PackedDataHeaderSize + Layout.UpdateMaskSize + Layout.Time.Stride;
+  if ((PayloadSize < HeaderSize)||(!CheckPackedDataHeader(Layout.Encoding,Payload))) {
+    return false;
+  }
+  const uint8_t *Mask = Payload + PackedDataHeaderSize;
+  const SensorLayout *Sensors[SensorTypes];
+  GetSensorLayouts(Layout,Sensors);
+  size_t Expected = HeaderSize;
+  size_t Record = 0;
+  for (size_t i=0; i < SensorTypes; i++) {
+    for (size_t j=0; j < Sensors[i]->Count; j++) {
+      if (Mask[Record/8] & (1 << (Record%8))) {
+        Expected += Sensors[i]->Stride;
+      }
+      Record++;
+    }
+  }
+  if (Expected != PayloadSize) {
+    return false;
+  }
+  if (Layout.Encoding != kRawEncoding) {
+    PackDataHeader(Layout.Encoding,DataPayload);
+  }
+  memcpy(UpdateMask,Mask,Layout.UpdateMaskSize);
+  const uint8_t *Cursor = Mask + Layout.UpdateMaskSize;
+  memcpy(DataPayload+Layout.Time.Offset,Cursor,Layout.Time.Stride);
+  Cursor += Layout.Time.Stride;
+  Record = 0;
+  for (size_t i=0; i < SensorTypes; i++) {
+    for (size_t j=0; j < Sensors[i]->Count; j++) {
+      if (Mask[Record/8] & (1 << (Record%8))) {
+        memcpy(DataPayload+Sensors[i]->Offset+j*Sensors[i]->Stride,Cursor,Sensors[i]->Stride);
+        Cursor += Sensors[i]->Stride;
+      }
+      Record++;
+    }
+  }
+  return true;
+}
+
+FmuDataView::FmuDataView() : Layout_(NULL), Payload_(NULL), UpdateMask_(NULL) {}
+
+FmuDataView::FmuDataView(const FmuDataLayout &Layout,const uint8_t *Payload,const uint8_t *UpdateMask) : Layout_(&Layout), Payload_(Payload), UpdateMask_(UpdateMask) {}
+
+uint64_t FmuDataView::Time_us() const {
+  return SensorView<uint64_t>(Payload_,Layout_->Time)[0];
+}
+
+Voltage FmuDataView::InputVoltage() const {
+  return SensorView<Voltage>(Payload_,Layout_->InputVoltage)[0];
+}
+
+Voltage FmuDataView::RegulatedVoltage() const {
+  return SensorView<Voltage>(Payload_,Layout_->RegulatedVoltage)[0];
+}
+
+Mpu9250Data FmuDataView::Mpu9250() const {
+  return SensorView<Mpu9250Data>(Payload_,Layout_->Mpu9250)[0];
+}
+
+Bme280Data FmuDataView::Bme280() const {
+  return SensorView<Bme280Data>(Payload_,Layout_->Bme280)[0];
+}
+
+SensorView<Mpu9250Data> FmuDataView::Mpu9250Ext() const {
+  return SensorView<Mpu9250Data>(Payload_,Layout_->Mpu9250Ext);
+}
+
+SensorView<Bme280Data> FmuDataView::Bme280Ext() const {
+  return SensorView<Bme280Data>(Payload_,Layout_->Bme280Ext);
+}
+
+SensorView<SbusRxData> FmuDataView::SbusRx() const {
+  return SensorView<SbusRxData>(Payload_,Layout_->SbusRx);
+}
+
+SensorView<GpsData> FmuDataView::Gps() const {
+  return SensorView<GpsData>(Payload_,Layout_->Gps);
+}
+
+SensorView<PitotData> FmuDataView::Pitot() const {
+  return SensorView<PitotData>(Payload_,Layout_->Pitot);
+}
+
+SensorView<PressureData> FmuDataView::PressureTransducer() const {
+  return SensorView<PressureData>(Payload_,Layout_->PressureTransducer);
+}
+
+SensorView<AnalogData> FmuDataView::Analog() const {
+  return SensorView<AnalogData>(Payload_,Layout_->Analog);
+}
+
+SensorView<Voltage> FmuDataView::SbusVoltage() const {
+  return SensorView<Voltage>(Payload_,Layout_->SbusVoltage);
+}
+
+SensorView<Voltage> FmuDataView::PwmVoltage() const {
+  return SensorView<Voltage>(Payload_,Layout_->PwmVoltage);
+}
+
+const uint8_t *FmuDataView::Payload() const {
+  return Payload_;
+}
+
+size_t FmuDataView::PayloadSize() const {
+  return Layout_->PayloadSize;
+}
+
+/* Returns true if the payload header matches the layout, raw payloads have none. */
+bool FmuDataView::Valid() const {
+  if (Layout_->Encoding == kRawEncoding) {
+    return true;
+  }
+  return CheckPackedDataHeader(Layout_->Encoding,Payload_);
+}
+
+/* Returns true if the latest frame carried the record, counted in the order records
+are sent starting from InputVoltage. */
+bool FmuDataView::Updated(size_t Record) const {
+  if (UpdateMask_ == NULL) {
+    return true;
+  }
+  return UpdateMask_[Record/8] & (1 << (Record%8));
+}
+
+/* Returns true if the frame carried the Mpu9250 record, the third after the two voltages. */
+bool FmuDataView::Mpu9250Updated() const {
+  return Updated(2);
+}
+
+/* Sets the update flags of one sensor, sizing them to match its records. */
+void FmuDataView::DecodeUpdated(size_t Count, std::vector<bool> *UpdatedPtr, size_t *Record) const {
+  UpdatedPtr->resize(Count);
+  for (size_t i=0; i < Count; i++) {
+    (*UpdatedPtr)[i] = Updated((*Record)++);
+  }
+}
+
+/* Copies the payload into FmuData, whose sensor vectors must already be sized to
+match the layout, and sets the update flags. */
+void FmuDataView::Decode(FmuData *FmuDataPtr) const {
+  FmuDataPtr->Time_us = Time_us();
+  FmuDataPtr->InputVoltage = InputVoltage();
+  FmuDataPtr->RegulatedVoltage = RegulatedVoltage();
+  FmuDataPtr->Mpu9250 = Mpu9250();
+  FmuDataPtr->Bme280 = Bme280();
+  Mpu9250Ext().CopyTo(FmuDataPtr->Mpu9250Ext.data());
+  Bme280Ext().CopyTo(FmuDataPtr->Bme280Ext.data());
+  SbusRx().CopyTo(FmuDataPtr->SbusRx.data());
+  Gps().CopyTo(FmuDataPtr->Gps.data());
+  Pitot().CopyTo(FmuDataPtr->Pitot.data());
+  PressureTransducer().CopyTo(FmuDataPtr->PressureTransducer.data());
+  Analog().CopyTo(FmuDataPtr->Analog.data());
+  SbusVoltage().CopyTo(FmuDataPtr->SbusVoltage.data());
+  PwmVoltage().CopyTo(FmuDataPtr->PwmVoltage.data());
+  FmuDataUpdated &Flags = FmuDataPtr->Updated;
+  size_t Record = 0;
+  Flags.InputVoltage = Updated(Record++);
+  Flags.RegulatedVoltage = Updated(Record++);
+  Flags.Mpu9250 = Updated(Record++);
+  Flags.Bme280 = Updated(Record++);
+  DecodeUpdated(Layout_->Mpu9250Ext.Count,&Flags.Mpu9250Ext,&Record);
+  DecodeUpdated(Layout_->Bme280Ext.Count,&Flags.Bme280Ext,&Record);
+  DecodeUpdated(Layout_->SbusRx.Count,&Flags.SbusRx,&Record);
+  DecodeUpdated(Layout_->Gps.Count,&Flags.Gps,&Record);
+  DecodeUpdated(Layout_->Pitot.Count,&Flags.Pitot,&Record);
+  DecodeUpdated(Layout_->PressureTransducer.Count,&Flags.PressureTransducer,&Record);
+  DecodeUpdated(Layout_->Analog.Count,&Flags.Analog,&Record);
+  DecodeUpdated(Layout_->SbusVoltage.Count,&Flags.SbusVoltage,&Record);
+  DecodeUpdated(Layout_->PwmVoltage.Count,&Flags.PwmVoltage,&Record);
+}
+
+/* Sets the flags of the records this frame carried and leaves the rest, so the
+flags of several frames add up. The sensor flags must already be sized to match
+the layout. */
+void FmuDataView::AddUpdated(FmuDataUpdated *UpdatedPtr) const {
+  size_t Record = 0;
+  UpdatedPtr->InputVoltage = Updated(Record++) || UpdatedPtr->InputVoltage;
+  UpdatedPtr->RegulatedVoltage = Updated(Record++) || UpdatedPtr->RegulatedVoltage;
+  UpdatedPtr->Mpu9250 = Updated(Record++) || UpdatedPtr->Mpu9250;
+  UpdatedPtr->Bme280 = Updated(Record++) || UpdatedPtr->Bme280;
+  AddUpdated(Layout_->Mpu9250Ext.Count,&UpdatedPtr->Mpu9250Ext,&Record);
+  AddUpdated(Layout_->Bme280Ext.Count,&UpdatedPtr->Bme280Ext,&Record);
+  AddUpdated(Layout_->SbusRx.Count,&UpdatedPtr->SbusRx,&Record);
+  AddUpdated(Layout_->Gps.Count,&UpdatedPtr->Gps,&Record);
+  AddUpdated(Layout_->Pitot.Count,&UpdatedPtr->Pitot,&Record);
+  AddUpdated(Layout_->PressureTransducer.Count,&UpdatedPtr->PressureTransducer,&Record);
+  AddUpdated(Layout_->Analog.Count,&UpdatedPtr->Analog,&Record);
+  AddUpdated(Layout_->SbusVoltage.Count,&UpdatedPtr->SbusVoltage,&Record);
+  AddUpdated(Layout_->PwmVoltage.Count,&UpdatedPtr->PwmVoltage,&Record);
+}
+
+/* Sets the flags of one sensor's records this frame carried. */
+void FmuDataView::AddUpdated(size_t Count, std::vector<bool> *UpdatedPtr, size_t *Record) const {
+  for (size_t i=0; i < Count; i++) {
+    if (Updated((*Record)++)) {
+      (*UpdatedPtr)[i] = true;
+    }
+  }
+}
+
+/* Clears every update flag, sized to match the layout's records. */
+void ClearUpdated(const FmuDataLayout &Layout,FmuDataUpdated *UpdatedPtr) {
+  UpdatedPtr->InputVoltage = false;
+  UpdatedPtr->RegulatedVoltage = false;
+  UpdatedPtr->Mpu9250 = false;
+  UpdatedPtr->Bme280 = false;
+  UpdatedPtr->Mpu9250Ext.assign(Layout.Mpu9250Ext.Count,false);
+  UpdatedPtr->Bme280Ext.assign(Layout.Bme280Ext.Count,false);
+  UpdatedPtr->SbusRx.assign(Layout.SbusRx.Count,false);
+  UpdatedPtr->Gps.assign(Layout.Gps.Count,false);
+  UpdatedPtr->Pitot.assign(Layout.Pitot.Count,false);
+  UpdatedPtr->PressureTransducer.assign(Layout.PressureTransducer.Count,false);
+  UpdatedPtr->Analog.assign(Layout.Analog.Count,false);
+  UpdatedPtr->SbusVoltage.assign(Layout.SbusVoltage.Count,false);
+  UpdatedPtr->PwmVoltage.assign(Layout.PwmVoltage.Count,false);
+}
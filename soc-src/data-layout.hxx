@@ -0,0 +1,123 @@
+
+#ifndef DATA_LAYOUT_HXX_
+#define DATA_LAYOUT_HXX_
+
+#include "global-defs.hxx"
+#include "packed-data.hxx"
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+
+/* Where the records of one sensor type sit in a data payload */
+struct SensorLayout {
+  size_t Offset;                            // Byte offset of the first record
+  size_t Count;                             // Number of records
+  size_t Stride;                            // Bytes from one record to the next
+  DataEncoding Encoding;                    // How each record is encoded
+};
+
+/* Layout of the data payload, fixed once the aircraft configuration is loaded. The
+datalog records are the same bytes, so this also describes one datalog record. */
+struct FmuDataLayout {
+  DataEncoding Encoding;
+  SensorLayout Time;
+  SensorLayout InputVoltage;
+  SensorLayout RegulatedVoltage;
+  SensorLayout Mpu9250;
+  SensorLayout Bme280;
+  SensorLayout Mpu9250Ext;
+  SensorLayout Bme280Ext;
+  SensorLayout SbusRx;
+  SensorLayout Gps;
+  SensorLayout Pitot;
+  SensorLayout PressureTransducer;
+  SensorLayout Analog;
+  SensorLayout SbusVoltage;
+  SensorLayout PwmVoltage;
+  size_t PayloadSize;
+  size_t Records;                           // Records with an update bit, all but Time
+  size_t UpdateMaskSize;                    // Bytes in a mask with one bit per record
+};
+
+FmuDataLayout BuildDataLayout(const FmuData &FmuDataRef,DataEncoding Encoding);
+size_t EncodeFmuData(const FmuData &FmuDataRef,const FmuDataLayout &Layout,uint8_t *Payload);
+size_t GetSparsePayloadSize(const FmuDataLayout &Layout);
+size_t EncodeSparseFmuData(const FmuData &FmuDataRef,const FmuDataLayout &Layout,uint8_t *Payload);
+void MergeDataPayload(const FmuDataLayout &Layout,const uint8_t *Payload,uint8_t *DataPayload,uint8_t *UpdateMask);
+bool MergeSparseDataPayload(const FmuDataLayout &Layout,const uint8_t *Payload,size_t PayloadSize,uint8_t *DataPayload,uint8_t *UpdateMask);
+void ClearUpdated(const FmuDataLayout &Layout,FmuDataUpdated *UpdatedPtr);
+
+/* Typed, read only access to the records of one sensor type in a payload. Records are
+copied or unpacked as they are indexed, so the payload needs no particular alignment. */
+template <typename T>
+class SensorView {
+  public:
+    SensorView() : Records_(NULL), Count_(0), Stride_(sizeof(T)), Encoding_(kRawEncoding) {}
+    SensorView(const uint8_t *Payload,const SensorLayout &Layout) : Records_(Payload+Layout.Offset), Count_(Layout.Count), Stride_(Layout.Stride), Encoding_(Layout.Encoding) {}
+    size_t size() const {
+      return Count_;
+    }
+    T operator[](size_t Index) const {
+      T Record;
+      Read(Index,&Record);
+      return Record;
+    }
+    void CopyTo(T *Records) const {
+      for (size_t i=0; i < Count_; i++) {
+        Read(i,Records+i);
+      }
+    }
+  private:
+    const uint8_t *Records_;
+    size_t Count_;
+    size_t Stride_;
+    DataEncoding Encoding_;
+    void Read(size_t Index,T *RecordPtr) const {
+      if (Encoding_ == kRawEncoding) {
+        // raw records are the bytes of T as the FMU laid them out, Eigen members included
+        memcpy((void *)RecordPtr,Records_+Index*Stride_,sizeof(T));
+      } else {
+        UnpackRecord(Records_+Index*Stride_,Encoding_,RecordPtr);
+      }
+    }
+};
+
+/* A received data payload seen through its layout. The view does not own the payload,
+it is valid for as long as the bytes it points to are. The update mask has a bit per
+record, in the order they are sent, set when the latest frame carried that record. Without
+a mask every record counts as updated. */
+class FmuDataView {
+  public:
+    FmuDataView();
+    FmuDataView(const FmuDataLayout &Layout,const uint8_t *Payload,const uint8_t *UpdateMask = NULL);
+    uint64_t Time_us() const;
+    Voltage InputVoltage() const;
+    Voltage RegulatedVoltage() const;
+    Mpu9250Data Mpu9250() const;
+    Bme280Data Bme280() const;
+    SensorView<Mpu9250Data> Mpu9250Ext() const;
+    SensorView<Bme280Data> Bme280Ext() const;
+    SensorView<SbusRxData> SbusRx() const;
+    SensorView<GpsData> Gps() const;
+    SensorView<PitotData> Pitot() const;
+    SensorView<PressureData> PressureTransducer() const;
+    SensorView<AnalogData> Analog() const;
+    SensorView<Voltage> SbusVoltage() const;
+    SensorView<Voltage> PwmVoltage() const;
+    const uint8_t *Payload() const;
+    size_t PayloadSize() const;
+    bool Valid() const;
+    bool Updated(size_t Record) const;
+    bool Mpu9250Updated() const;
+    void Decode(FmuData *FmuDataPtr) const;
+    void AddUpdated(FmuDataUpdated *UpdatedPtr) const;
+  private:
+    const FmuDataLayout *Layout_;
+    const uint8_t *Payload_;
+    const uint8_t *UpdateMask_;
+    void DecodeUpdated(size_t Count, std::vector<bool> *UpdatedPtr, size_t *Record) const;
+    void AddUpdated(size_t Count, std::vector<bool> *UpdatedPtr, size_t *Record) const;
+};
+
+#endif
@@ -13,45 +13,15 @@ Datalogger::Datalogger() {
     DataLogName = DataLogBaseName + std::to_string(FileNameCounter) + DataLogType;
   }
 
-  if ((LogFile_ = fopen(DataLogName.c_str(),"wb"))<0) {
+  if ((LogFile_ = fopen(DataLogName.c_str(),"wb"))==NULL) {
     throw std::runtime_error("Datalog failed to open.");
   }
 }
 
-/* Logs the FMU data into the binary file that was created */
-void Datalogger::LogFmuData(FmuData FmuDataRef) {
-  fwrite(&FmuDataRef.Time_us,sizeof(FmuDataRef.Time_us),1,LogFile_);
-  fwrite(&FmuDataRef.InputVoltage,sizeof(Voltage),1,LogFile_);
-  fwrite(&FmuDataRef.RegulatedVoltage,sizeof(Voltage),1,LogFile_);
-  fwrite(&FmuDataRef.Mpu9250,sizeof(Mpu9250Data),1,LogFile_);
-  fwrite(&FmuDataRef.Bme280,sizeof(Bme280Data),1,LogFile_);
-  for (size_t i=0; i < FmuDataRef.Mpu9250Ext.size(); i++) {
-    fwrite(&FmuDataRef.Mpu9250Ext[i],sizeof(Mpu9250Data),1,LogFile_);
-  }
-  for (size_t i=0; i < FmuDataRef.Bme280Ext.size(); i++) {
-    fwrite(&FmuDataRef.Bme280Ext[i],sizeof(Bme280Data),1,LogFile_);
-  }
-  for (size_t i=0; i < FmuDataRef.SbusRx.size(); i++) {
-    fwrite(&FmuDataRef.SbusRx[i],sizeof(SbusRxData),1,LogFile_);
-  }
-  for (size_t i=0; i < FmuDataRef.Gps.size(); i++) {
-    fwrite(&FmuDataRef.Gps[i],sizeof(GpsData),1,LogFile_);
-  }
-  for (size_t i=0; i < FmuDataRef.Pitot.size(); i++) {
-    fwrite(&FmuDataRef.Pitot[i],sizeof(PitotData),1,LogFile_);
-  }  
-  for (size_t i=0; i < FmuDataRef.PressureTransducer.size(); i++) {
-    fwrite(&FmuDataRef.PressureTransducer[i],sizeof(PressureData),1,LogFile_);
-  }
-  for (size_t i=0; i < FmuDataRef.Analog.size(); i++) {
-    fwrite(&FmuDataRef.Analog[i],sizeof(AnalogData),1,LogFile_);
-  }
-  for (size_t i=0; i < FmuDataRef.SbusVoltage.size(); i++) {
-    fwrite(&FmuDataRef.SbusVoltage[i],sizeof(Voltage),1,LogFile_);
-  }
-  for (size_t i=0; i < FmuDataRef.PwmVoltage.size(); i++) {
-    fwrite(&FmuDataRef.PwmVoltage[i],sizeof(Voltage),1,LogFile_);
-  }
+/* Logs the FMU data into the binary file that was created. A datalog record is the data
+payload as received, so it is written in one piece. */
+void Datalogger::LogFmuData(const FmuDataView &FmuDataViewRef) {
+  fwrite(FmuDataViewRef.Payload(),FmuDataViewRef.PayloadSize(),1,LogFile_);
   fflush(LogFile_);
 }
 
@@ -3,6 +3,7 @@
 #define DATALOGGER_HXX_
 
 #include "global-defs.hxx"
+#include "data-layout.hxx"
 
 #include <stdio.h>
 #include <fcntl.h>
@@ -18,7 +19,7 @@
 class Datalogger {
   public:
     Datalogger();
-    void LogFmuData(FmuData FmuDataRef);
+    void LogFmuData(const FmuDataView &FmuDataViewRef);
   private:
     FILE *LogFile_;
     bool FileExists(const std::string &FileName);
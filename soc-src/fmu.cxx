@@ -2,214 +2,295 @@
 #include "fmu.hxx"
 
 Fmu::Fmu() {
-  OpenPort();
+  std::cout << "Opening UART port with FMU...";
+  Link_ = new UartTransport(FmuPort,FmuBaud);
+  std::cout << "done!" << std::endl;
 }
 
-/* Opens port to communicate with FMU. */
-void Fmu::OpenPort() {
-  std::cout << "Opening UART port with FMU...";
-  if ((FmuFileDesc_=open(FmuPort,O_RDWR|O_NOCTTY|O_NONBLOCK))<0) {
-    throw std::runtime_error("UART failed to open.");
+/* Opens the FMU link from a transport spec, see OpenFmuTransport. */
+Fmu::Fmu(const std::string &TransportSpec) {
+  std::cout << "Opening FMU link " << TransportSpec << "..." << std::endl;
+  Link_ = OpenFmuTransport(TransportSpec);
+}
+
+/* Uses an already open descriptor, such as a pipe or pseudo-terminal, instead of the UART. */
+Fmu::Fmu(int FileDesc) {
+  Link_ = new FmuTransport(FileDesc);
+}
+
+Fmu::~Fmu() {
+  delete Link_;
+}
+
+/* Sleeps until the link can take more data, or for a moment if the transmit queue
+is holding bulk frames back until the kernel has sent more of what it has. */
+void Fmu::WaitForWrite() {
+  struct pollfd Fds;
+  Fds.fd = Link_->GetFileDesc();
+  Fds.events = Tx_.Throttled() ? 0 : POLLOUT;
+  Fds.revents = 0;
+  while (poll(&Fds,1,Tx_.Throttled() ? TxRetry_ms_ : -1)<0) {
+    if (errno != EINTR) {
+      throw std::runtime_error("FMU link failed to poll.");
+    }
   }
-  struct termios Options;
-  tcgetattr(FmuFileDesc_,&Options);
-  Options.c_cflag = FmuBaud | CS8 | CREAD | CLOCAL;
-  Options.c_iflag = IGNPAR;
-  Options.c_oflag = 0;
-  Options.c_lflag = 0;
-  Options.c_cc[VTIME] = 0;
-  Options.c_cc[VMIN] = 0;
-  tcflush(FmuFileDesc_,TCIFLUSH);
-  tcsetattr(FmuFileDesc_,TCSANOW,&Options);
-  fcntl(FmuFileDesc_,F_SETFL,O_NONBLOCK);
-  std::cout << "done!" << std::endl;
 }
 
-/* Writes data to serial port. */
-void Fmu::WritePort(size_t BufferSize,uint8_t* Buffer) {
-  int count;
-  if ((count=write(FmuFileDesc_,Buffer,BufferSize))<0) {
-    throw std::runtime_error("UART failed to write.");
+/* Sets the data payload layout, built from the configuration when it is loaded. */
+void Fmu::SetDataLayout(const FmuDataLayout &Layout) {
+  DataLayout_ = Layout;
+  DataPayload_.assign(DataLayout_.PayloadSize,0);
+  DataUpdated_.assign(DataLayout_.UpdateMaskSize,0);
+}
+
+/* Get sensor data from FMU as a view over the latest payload, valid until the next
+message is read. Full frames and kDataSparse frames, which carry only the records that
+changed, are both merged into the latest payload so the view always holds every sensor. */
+bool Fmu::GetSensorData(FmuDataView *FmuDataViewPtr) {
+  if (ReceiveMessage()) {
+    BfsMessage DataMessage = (DataLayout_.Encoding == kRawEncoding) ? kData : kDataPacked;
+    if ((Parser_.GetMessageId()==DataMessage)&&(Parser_.GetPayloadSize()==DataLayout_.PayloadSize)) {
+      FmuDataView Received(DataLayout_,Parser_.GetPayload());
+      if (!Received.Valid()) {
+        return false;
+      }
+      MergeDataPayload(DataLayout_,Parser_.GetPayload(),DataPayload_.data(),DataUpdated_.data());
+    } else if (Parser_.GetMessageId()==kDataSparse) {
+      if (!MergeSparseDataPayload(DataLayout_,Parser_.GetPayload(),Parser_.GetPayloadSize(),DataPayload_.data(),DataUpdated_.data())) {
+        return false;
+      }
+    } else {
+      return false;
+    }
+    *FmuDataViewPtr = FmuDataView(DataLayout_,DataPayload_.data(),DataUpdated_.data());
+    return true;
   }
+  return false;
 }
 
 /* Get sensor data from FMU. */
 bool Fmu::GetSensorData(FmuData *FmuDataPtr) {
-  BfsMessage MessageId;
-  uint16_t PayloadSize;
-  size_t PayloadLocation = 0;
-  uint8_t Payload[sizeof(FmuDataPtr->Time_us)+2*sizeof(Voltage)+sizeof(Mpu9250Data)+sizeof(Bme280Data)+FmuDataPtr->Mpu9250Ext.size()*sizeof(Mpu9250Data)+FmuDataPtr->Bme280Ext.size()*sizeof(Bme280Data)+FmuDataPtr->SbusRx.size()*sizeof(SbusRxData)+FmuDataPtr->Gps.size()*sizeof(GpsData)+FmuDataPtr->Pitot.size()*sizeof(PitotData)+FmuDataPtr->PressureTransducer.size()*sizeof(PressureData)+FmuDataPtr->Analog.size()*sizeof(AnalogData)+FmuDataPtr->SbusVoltage.size()*sizeof(Voltage)+FmuDataPtr->PwmVoltage.size()*sizeof(Voltage)];
-  if (ReadMessage(&MessageId,&PayloadSize,Payload)) {
-    if ((MessageId==kData)&&(PayloadSize==sizeof(Payload))) {
-      memcpy(&FmuDataPtr->Time_us,Payload,sizeof(FmuDataPtr->Time_us));
-      PayloadLocation += sizeof(FmuDataPtr->Time_us);
-      memcpy(&FmuDataPtr->InputVoltage,Payload+PayloadLocation,sizeof(FmuDataPtr->InputVoltage));
-      PayloadLocation += sizeof(FmuDataPtr->InputVoltage);
-      memcpy(&FmuDataPtr->RegulatedVoltage,Payload+PayloadLocation,sizeof(FmuDataPtr->RegulatedVoltage));
-      PayloadLocation += sizeof(FmuDataPtr->RegulatedVoltage);
-      memcpy(&FmuDataPtr->Mpu9250,Payload+PayloadLocation,sizeof(Mpu9250Data));
-      PayloadLocation += sizeof(Mpu9250Data);
-      memcpy(&FmuDataPtr->Bme280,Payload+PayloadLocation,sizeof(Bme280Data));
-      PayloadLocation += sizeof(Bme280Data);
-      memcpy(&FmuDataPtr->Mpu9250Ext[0],Payload+PayloadLocation,FmuDataPtr->Mpu9250Ext.size()*sizeof(Mpu9250Data));
-      PayloadLocation += FmuDataPtr->Mpu9250Ext.size()*sizeof(Mpu9250Data);
-      memcpy(&FmuDataPtr->Bme280Ext[0],Payload+PayloadLocation,FmuDataPtr->Bme280Ext.size()*sizeof(Bme280Data));
-      PayloadLocation += FmuDataPtr->Bme280Ext.size()*sizeof(Bme280Data);
-      memcpy(&FmuDataPtr->SbusRx[0],Payload+PayloadLocation,FmuDataPtr->SbusRx.size()*sizeof(SbusRxData));
-      PayloadLocation += FmuDataPtr->SbusRx.size()*sizeof(SbusRxData);
-      memcpy(&FmuDataPtr->Gps[0],Payload+PayloadLocation,FmuDataPtr->Gps.size()*sizeof(GpsData));
-      PayloadLocation += FmuDataPtr->Gps.size()*sizeof(GpsData);
-      memcpy(&FmuDataPtr->Pitot[0],Payload+PayloadLocation,FmuDataPtr->Pitot.size()*sizeof(PitotData));
-      PayloadLocation += FmuDataPtr->Pitot.size()*sizeof(PitotData);
-      memcpy(&FmuDataPtr->PressureTransducer[0],Payload+PayloadLocation,FmuDataPtr->PressureTransducer.size()*sizeof(PressureData));
-      PayloadLocation += FmuDataPtr->PressureTransducer.size()*sizeof(PressureData);
-      memcpy(&FmuDataPtr->Analog[0],Payload+PayloadLocation,FmuDataPtr->Analog.size()*sizeof(AnalogData));
-      PayloadLocation += FmuDataPtr->Analog.size()*sizeof(AnalogData);
-      memcpy(&FmuDataPtr->SbusVoltage[0],Payload+PayloadLocation,FmuDataPtr->SbusVoltage.size()*sizeof(Voltage));
-      PayloadLocation += FmuDataPtr->SbusVoltage.size()*sizeof(Voltage);
-      memcpy(&FmuDataPtr->PwmVoltage[0],Payload+PayloadLocation,FmuDataPtr->PwmVoltage.size()*sizeof(Voltage));
-      PayloadLocation += FmuDataPtr->PwmVoltage.size()*sizeof(Voltage);
-      return true;
-    }
-  } else {
-    return false;
+  FmuDataView View;
+  if (GetSensorData(&View)) {
+    View.Decode(FmuDataPtr);
+    FmuDataPtr->ReceiveTime_us = RxTime_us_;
+    return true;
   }
   return false;
 }
 
-/* Writes a Bfs Bus message. */
+/* Writes a Bfs Bus message, returning once it and everything queued ahead of it
+has been handed to the link. */
 void Fmu::WriteMessage(BfsMessage MessageId,uint16_t PayloadSize,uint8_t *Payload) {
-  uint8_t Buffer[PayloadSize + BfsHeaderSize];
-  uint16_t BufferSize;
-  BuildBfsMessage(MessageId,PayloadSize,Payload,&BufferSize,Buffer);
-  WritePort(BufferSize,Buffer);
+  while (!Tx_.Push(MessageId,PayloadSize,Payload)) {
+    if (!Tx_.Flush(Link_)) {
+      WaitForWrite();
+    }
+  }
+  while (!Tx_.Flush(Link_)) {
+    WaitForWrite();
+  }
+}
+
+/* Queues a Bfs Bus message and writes what the link accepts without blocking, the
+rest goes out from FlushTx or while waiting for data. Effector commands go ahead of
+other messages and replace an older command of the same type still waiting. Returns
+false if the message was dropped because the queue is full. */
+bool Fmu::QueueMessage(BfsMessage MessageId,uint16_t PayloadSize,const uint8_t *Payload) {
+  bool Queued = Tx_.Push(MessageId,PayloadSize,Payload);
+  Tx_.Flush(Link_);
+  return Queued;
+}
+
+/* Writes queued messages without blocking, returns true once none are left. */
+bool Fmu::FlushTx() {
+  return Tx_.Flush(Link_);
 }
 
-/* Read BFS Bus messages. */
+/* Sets how many bytes may wait in the kernel to go out before bulk messages are held
+back, which bounds how long an effector command waits behind them. 0 for no limit. */
+void Fmu::SetTxBulkLimit(size_t BulkLimit) {
+  Tx_.SetBulkLimit(BulkLimit);
+}
+
+/* Read BFS Bus messages. Bytes left over from the previous read are parsed
+before going back to the kernel, and each read drains everything available. */
 bool Fmu::ReadMessage(BfsMessage *MessageId,uint16_t *PayloadSize,uint8_t *Payload) {
-  int count;
-  uint8_t buffer[1];
-  if ((count=read(FmuFileDesc_,buffer,sizeof(buffer)))>0) {
-    if (ParseBfsMessage(buffer[0],MessageId,PayloadSize,Payload)) {
-      return true;
-    }
+  if (ReceiveMessage()) {
+    *MessageId = Parser_.GetMessageId();
+    *PayloadSize = Parser_.GetPayloadSize();
+    memcpy(Payload,Parser_.GetPayload(),*PayloadSize);
+    return true;
   }
   return false;
 }
 
-/* Calculate a 2 byte checksum given a byte array. */
-void Fmu::CalcChecksum(size_t ArraySize, uint8_t *ByteArray, uint8_t *Checksum) {
-  Checksum[0] = 0;
-  Checksum[1] = 0;
-  for (size_t i = 0; i < ArraySize; i++) {
-    ChecksumIteration(ByteArray[i], Checksum);
+/* Receives the next message into the parser, where it stays until the next receive. */
+bool Fmu::ReceiveMessage() {
+  if (ParseRxBuffer()) {
+    return true;
   }
+  if (WaitForData() && (FillRxBuffer() > 0)) {
+    return ParseRxBuffer();
+  }
+  return false;
 }
 
-/* Iterates the checksum state. */
-void Fmu::ChecksumIteration(uint8_t Data, uint8_t *Checksum) {
-  Checksum[0] += Data;
-  Checksum[1] += Checksum[0];
+/* Sets how long ReadMessage sleeps waiting for the FMU when no complete message
+is buffered: 0 returns immediately, -1 waits indefinitely. */
+void Fmu::SetReceiveTimeout(int Timeout_ms) {
+  RxTimeout_ms_ = Timeout_ms;
 }
 
-/* Build a BFS Bus message to send. */
-void Fmu::BuildBfsMessage(BfsMessage MessageId,uint16_t PayloadSize,uint8_t *Payload,uint16_t *TxBufferSize,uint8_t *TxBuffer) {
-  uint8_t Checksum[2];
-  // header
-  for (size_t i=0; i < sizeof(BfsHeader); i++) {
-    TxBuffer[i] = BfsHeader[i];
-  }
-  // message ID
-  TxBuffer[2] = (uint8_t) MessageId;
-  // payload length
-  TxBuffer[3] = PayloadSize & 0xff;
-  TxBuffer[4] = PayloadSize >> 8;
-  // payload
-  for (size_t i=0; i < PayloadSize; i++) {
-    TxBuffer[5+i] = Payload[i];
+/* Makes ReadMessage and GetSensorData return early, with nothing read, whenever
+FileDesc becomes readable, so another thread can wake the one waiting on the FMU.
+The caller reads FileDesc to clear it, -1 turns waking off. */
+void Fmu::SetWakeDesc(int FileDesc) {
+  WakeDesc_ = FileDesc;
+}
+
+/* Returns the monotonic time, us, that the last message read arrived. */
+uint64_t Fmu::GetReceiveTime_us() {
+  return RxTime_us_;
+}
+
+/* Returns the receive side counters. */
+FmuLinkStats Fmu::GetLinkStats() {
+  return LinkStats_;
+}
+
+/* Returns the BFS Bus parser counters. */
+BfsParserStats Fmu::GetParserStats() {
+  return Parser_.GetStats();
+}
+
+/* Returns the transmit queue counters, including the effector command latency. */
+TxQueueStats Fmu::GetTxStats() {
+  return Tx_.GetStats();
+}
+
+/* Sleeps until the FMU has sent data, the receive timeout expires or the wake
+descriptor is readable, writing out queued messages whenever the link has room
+for them in the meantime. */
+bool Fmu::WaitForData() {
+  bool TxEmpty = Tx_.Flush(Link_);
+  if (RxTimeout_ms_ == 0) {
+    return true;
   }
-  // checksum
-  CalcChecksum(PayloadSize+5,TxBuffer,Checksum);
-  TxBuffer[PayloadSize+5] = Checksum[0];
-  TxBuffer[PayloadSize+6] = Checksum[1];
-  // transmit buffer size
-  *TxBufferSize = PayloadSize + 7;
-}
-
-/* Parse a BFS Bus message. */
-bool Fmu::ParseBfsMessage(uint8_t RxBuffer,BfsMessage *MessageId,uint16_t *PayloadSize,uint8_t *Payload) {
-  static uint16_t ParserState = 0;
-  static uint8_t Checksum[2] = {0,0};
-  static uint8_t PayloadSizeBuffer[2] = {0,0};
-  static uint16_t pSize = 0;
-  static BfsMessage Message = kConfig;
-  static uint8_t Buffer[4096] = {0};
-  if (ParserState < 2) { // header
-    if (RxBuffer == BfsHeader[ParserState]) {
-      ChecksumIteration(RxBuffer, Checksum);
-      ParserState++;
-    } else {
-      Checksum[0] = 0;
-      Checksum[1] = 0;
-      PayloadSizeBuffer[0] = 0;
-      PayloadSizeBuffer[1] = 0;
-      ParserState = 0;
+  int64_t Deadline_ms = GetTime_ms() + RxTimeout_ms_;
+  struct pollfd Fds[2];
+  Fds[0].fd = Link_->GetFileDesc();
+  Fds[1].fd = WakeDesc_;
+  Fds[1].events = POLLIN;
+  nfds_t Count = (WakeDesc_ >= 0) ? 2 : 1;
+  while (true) {
+    int Timeout_ms = RxTimeout_ms_;
+    if (RxTimeout_ms_ > 0) {
+      Timeout_ms = std::max(Deadline_ms - GetTime_ms(),(int64_t)0);
     }
-  } else if (ParserState == 2) { // message ID
-    Message = (BfsMessage)RxBuffer;
-    ChecksumIteration(RxBuffer, Checksum);
-    ParserState++;
-  } else if (ParserState == 3) { // payload length
-    PayloadSizeBuffer[0] = RxBuffer;
-    ChecksumIteration(RxBuffer, Checksum);
-    ParserState++;
-  } else if (ParserState == 4) { // payload length
-    PayloadSizeBuffer[1] = RxBuffer;
-    pSize = ((uint16_t)PayloadSizeBuffer[1] << 8) | PayloadSizeBuffer[0];
-    if (pSize > sizeof(Buffer)) {
-      Checksum[0] = 0;
-      Checksum[1] = 0;
-      PayloadSizeBuffer[0] = 0;
-      PayloadSizeBuffer[1] = 0;
-      ParserState = 0;
-      return false;      
+    Fds[0].events = POLLIN;
+    if (!TxEmpty) {
+      if (Tx_.Throttled()) {
+        if ((Timeout_ms < 0)||(Timeout_ms > TxRetry_ms_)) {
+          Timeout_ms = TxRetry_ms_;
+        }
+      } else {
+        Fds[0].events |= POLLOUT;
+      }
     }
-    ChecksumIteration(RxBuffer, Checksum);
-    ParserState++;
-  } else if ((ParserState>=5)&&(ParserState<(pSize+5))) { // payload
-    Buffer[ParserState-5] = RxBuffer;
-    ChecksumIteration(RxBuffer, Checksum);
-    ParserState++;
-  } else if (ParserState==(pSize+5)) {
-    if (RxBuffer == Checksum[0]) {
-      ParserState++;
-    } else {
-      Checksum[0] = 0;
-      Checksum[1] = 0;
-      PayloadSizeBuffer[0] = 0;
-      PayloadSizeBuffer[1] = 0;
-      ParserState = 0;
-      return false;
+    Fds[0].revents = 0;
+    Fds[1].revents = 0;
+    while (poll(Fds,Count,Timeout_ms)<0) {
+      if (errno != EINTR) {
+        throw std::runtime_error("FMU link failed to poll.");
+      }
     }
-  } else if (ParserState==(pSize+6)) {
-    if (RxBuffer == Checksum[1]) {
-      *MessageId = Message;
-      *PayloadSize = pSize;
-      memcpy(Payload,Buffer,pSize);
-      Checksum[0] = 0;
-      Checksum[1] = 0;
-      PayloadSizeBuffer[0] = 0;
-      PayloadSizeBuffer[1] = 0;
-      ParserState = 0;
+    if (Fds[0].revents & ~POLLOUT) {
       return true;
-    } else {
-      Checksum[0] = 0;
-      Checksum[1] = 0;
-      PayloadSizeBuffer[0] = 0;
-      PayloadSizeBuffer[1] = 0;
-      ParserState = 0;
+    }
+    if (Fds[1].revents) {
+      if (!TxEmpty) {
+        Tx_.Flush(Link_);
+      }
+      return false;
+    }
+    if (!TxEmpty) {
+      TxEmpty = Tx_.Flush(Link_);
+    }
+    if ((RxTimeout_ms_ > 0)&&(GetTime_ms() >= Deadline_ms)) {
       return false;
     }
   }
+}
+
+/* Returns the monotonic time, ms. */
+int64_t Fmu::GetTime_ms() {
+  struct timespec Time;
+  clock_gettime(CLOCK_MONOTONIC,&Time);
+  return (int64_t)Time.tv_sec*1000 + Time.tv_nsec/1000000;
+}
+
+/* Reads all available bytes into the free space of the receive ring buffer
+with a single system call, returns the number of bytes read. */
+size_t Fmu::FillRxBuffer() {
+  size_t Free = RxBufferSize_ - (RxTail_ - RxHead_);
+  if (Free == 0) {
+    return 0;
+  }
+  size_t Start = RxTail_ & (RxBufferSize_ - 1);
+  struct iovec Iov[2];
+  int IovCount = 1;
+  Iov[0].iov_base = RxBuffer_ + Start;
+  if (Start + Free > RxBufferSize_) {
+    // free space wraps around the end of the buffer
+    Iov[0].iov_len = RxBufferSize_ - Start;
+    Iov[1].iov_base = RxBuffer_;
+    Iov[1].iov_len = Free - Iov[0].iov_len;
+    IovCount = 2;
+  } else {
+    Iov[0].iov_len = Free;
+  }
+  LinkStats_.ReadCalls++;
+  ssize_t count;
+  if ((count=Link_->Read(Iov,IovCount))>0) {
+    // messages are only read once everything buffered is parsed, so any
+    // message completed from here on ends within this read
+    struct timespec Time;
+    clock_gettime(CLOCK_MONOTONIC,&Time);
+    RxTime_us_ = (uint64_t)Time.tv_sec*1000000 + Time.tv_nsec/1000;
+    RxTail_ += count;
+    LinkStats_.BytesRead += count;
+    return count;
+  }
+  if (count == 0) {
+    // only after poll said there was data, so the other end has closed
+    LinkClosed_ = true;
+  }
+  return 0;
+}
+
+/* Returns true once the other end of the link has closed, which only replay and
+socket transports do. */
+bool Fmu::LinkClosed() {
+  return LinkClosed_;
+}
+
+/* Parses buffered bytes until a complete message is found or the buffer is empty. */
+bool Fmu::ParseRxBuffer() {
+  while (RxHead_ != RxTail_) {
+    // hand the parser the contiguous run up to the end of the buffer
+    size_t Start = RxHead_ & (RxBufferSize_ - 1);
+    size_t Count = RxTail_ - RxHead_;
+    if (Start + Count > RxBufferSize_) {
+      Count = RxBufferSize_ - Start;
+    }
+    size_t Consumed;
+    bool MessageReady = Parser_.Parse(RxBuffer_+Start,Count,&Consumed);
+    RxHead_ += Consumed;
+    if (MessageReady) {
+      LinkStats_.Messages++;
+      return true;
+    }
+  }
   return false;
 }
@@ -5,31 +5,80 @@
 
 #include "global-defs.hxx"
 #include "hardware-defs.hxx"
+#include "bfs.hxx"
+#include "data-layout.hxx"
+#include "transport.hxx"
+#include "tx-queue.hxx"
 #include <stdio.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <termios.h>
 #include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+#include <string>
 #include <iostream>
 #include <exception>
 #include <stdexcept>
 
+/* Receive side counters, used to gauge the cost of the serial link */
+struct FmuLinkStats {
+  uint64_t ReadCalls;                       // Number of read system calls
+  uint64_t BytesRead;                       // Number of bytes received
+  uint64_t Messages;                        // Number of complete BFS messages parsed
+};
+
 class Fmu {
   public:
-    static const uint8_t BfsHeaderSize = 7;
-    const uint8_t BfsHeader[2]={0x42,0x46};
     Fmu();
+    Fmu(const std::string &TransportSpec);
+    Fmu(int FileDesc);
+    Fmu(const Fmu &) = delete;
+    Fmu &operator=(const Fmu &) = delete;
+    ~Fmu();
     void WriteMessage(BfsMessage MessageId,uint16_t PayloadSize,uint8_t *Payload);
+    bool QueueMessage(BfsMessage MessageId,uint16_t PayloadSize,const uint8_t *Payload);
+    bool FlushTx();
+    void SetTxBulkLimit(size_t BulkLimit);
     bool ReadMessage(BfsMessage *MessageId,uint16_t *PayloadSize,uint8_t *Payload);
+    void SetDataLayout(const FmuDataLayout &Layout);
+    bool GetSensorData(FmuDataView *FmuDataViewPtr);
     bool GetSensorData(FmuData *FmuDataPtr);
+    void SetReceiveTimeout(int Timeout_ms);
+    void SetWakeDesc(int FileDesc);
+    uint64_t GetReceiveTime_us();
+    FmuLinkStats GetLinkStats();
+    BfsParserStats GetParserStats();
+    TxQueueStats GetTxStats();
+    bool LinkClosed();
   private:
-    int FmuFileDesc_;
-    void OpenPort();
-    void WritePort(size_t BufferSize,uint8_t* Buffer);    
-    void CalcChecksum(size_t ArraySize, uint8_t *ByteArray, uint8_t *Checksum);
-    void ChecksumIteration(uint8_t Data, uint8_t *Checksum);
-    void BuildBfsMessage(BfsMessage MessageId,uint16_t PayloadSize,uint8_t *Payload,uint16_t *TxBufferSize,uint8_t *TxBuffer);
-    bool ParseBfsMessage(uint8_t RxBuffer,BfsMessage *MessageId,uint16_t *PayloadSize,uint8_t *Payload);
+    static const size_t RxBufferSize_ = 8192;   // must be a power of 2
+    static const int TxRetry_ms_ = 1;           // recheck a throttled transmit queue this often
+    FmuTransport *Link_;
+    uint8_t RxBuffer_[RxBufferSize_];
+    size_t RxHead_ = 0;
+    size_t RxTail_ = 0;
+    int RxTimeout_ms_ = 0;
+    int WakeDesc_ = -1;
+    uint64_t RxTime_us_ = 0;
+    bool LinkClosed_ = false;
+    FmuLinkStats LinkStats_ = {0,0,0};
+    BfsCodec Parser_;
+    TxQueue Tx_;
+    FmuDataLayout DataLayout_ = {};
+    std::vector<uint8_t> DataPayload_;
+    std::vector<uint8_t> DataUpdated_;
+    bool WaitForData();
+    static int64_t GetTime_ms();
+    size_t FillRxBuffer();
+    bool ReceiveMessage();
+    bool ParseRxBuffer();
+    void WaitForWrite();
 };
 
 #endif
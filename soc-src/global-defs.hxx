@@ -22,6 +22,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #define GLOBAL_DEFS_HXX_
 
 #include <stdint.h>
+#include <string>
 #include <vector>
 #include <Eigen/Dense>
 
@@ -30,7 +31,13 @@ enum BfsMessage {
   kConfig,
   kEffectorAngleCmd,
   kEffectorDirectCmd,
-  kData
+  kData,
+  kDataPacked,
+  kDataSparse,
+  kConfigAck,         // FMU to SOC: acknowledged message ID, its 2 checksum bytes, status (0 if applied)
+  kConfigQuery,       // SOC to FMU: asks for the stored kConfigHash, empty payload
+  kConfigHash,        // either way: 8 byte config hash, 2 byte item count, 8 byte hash per config item
+  kConfigItem         // SOC to FMU: 2 byte item index, then the kConfig JSON that replaces that item
 };
 
 enum BfsMode {
@@ -39,8 +46,58 @@ enum BfsMode {
 };
 
 /* Config */
+struct RealTimeConfig {
+  bool Enabled;               // lock memory, pin and run the flight loop under SCHED_FIFO
+  int Priority;               // SCHED_FIFO priority, 1 to 99
+  int Cpu;                    // CPU the flight loop is pinned to, -1 to leave it free
+  size_t PrefaultStack_kB;    // stack touched up front so the loop never faults it in
+  size_t PrefaultHeap_kB;     // heap touched up front and kept, so later allocations never fault
+};
+
+/* What the scheduler does when a task finishes past its deadline */
+enum OverrunPolicy {
+  kSkipOnOverrun,             // skip the task's next release so the loop catches up
+  kDegradeOnOverrun,          // halve the task's rate until it keeps its deadline again
+  kLogOnOverrun               // keep running it, only report the overrun
+};
+
+struct TaskConfig {
+  std::string Name;           // Navigation, Control or Housekeeping
+  double Rate_hz;             // releases per second of FMU time, 0 for every frame
+  uint64_t Deadline_us;       // from the frame being received to the task finishing, 0 for none
+  OverrunPolicy Overrun;
+  bool Slack;                 // run only in time left over before the next frame is due
+};
+
+/* One channel of FmuData, or any other signal source, sent with the telemetry */
+struct TelemetryChannel {
+  std::string Name;           // signal source, such as "Mpu9250/Gyro_rads/2"
+  float Scale;                // sent as a 16 bit integer of value times Scale, or as a half float if 0
+};
+
+/* Telemetry downlink to, and command uplink from, a ground station over UDP */
+struct TelemetryConfig {
+  bool Enabled;
+  std::string GroundAddress;  // IPv4 address telemetry is sent to
+  uint16_t GroundPort;        // UDP port telemetry is sent to
+  uint16_t Port;              // local UDP port commands are received on
+  std::vector<TelemetryChannel> Channels;
+};
+
+/* How the navigation filter runs, by default the dense time update and batch GPS update it always ran */
+struct NavigationConfig {
+  int TuDecimation;           // covariance propagated every TuDecimation IMU frames, 1 for every frame
+  bool SequentialMu;          // GPS update as six scalar updates rather than the batch with the 6x6 inverse
+  bool StructuredTu;          // time update on the packed P using its block sparsity rather than dense
+};
+
 struct AircraftConfig {
   size_t NumberEffectors;
+  RealTimeConfig RealTime;
+  std::vector<TaskConfig> Tasks;
+  TelemetryConfig Telemetry;
+  NavigationConfig Navigation;
+  std::string ControlLaws;    // ControlLaws JSON, empty if none are configured
 };
 
 /* Data */
@@ -102,8 +159,27 @@ struct Voltage {
   float Voltage_V;                          // Measured voltage, V
 };
 
+/* Which records the latest data frame carried, records that were not sent keep their
+last value in FmuData */
+struct FmuDataUpdated {
+  bool InputVoltage;
+  bool RegulatedVoltage;
+  bool Mpu9250;
+  bool Bme280;
+  std::vector<bool> Mpu9250Ext;
+  std::vector<bool> Bme280Ext;
+  std::vector<bool> SbusRx;
+  std::vector<bool> Gps;
+  std::vector<bool> Pitot;
+  std::vector<bool> PressureTransducer;
+  std::vector<bool> Analog;
+  std::vector<bool> SbusVoltage;
+  std::vector<bool> PwmVoltage;
+};
+
 struct FmuData {
   uint64_t Time_us;
+  uint64_t ReceiveTime_us;                  // SOC monotonic time the frame arrived, us
   Voltage InputVoltage;
   Voltage RegulatedVoltage;
   Mpu9250Data Mpu9250;
@@ -117,6 +193,7 @@ struct FmuData {
   std::vector<AnalogData> Analog; 
   std::vector<Voltage> SbusVoltage;
   std::vector<Voltage> PwmVoltage;
+  FmuDataUpdated Updated;                   // Records received in the latest frame
 };
 
 struct NavigationData {
@@ -0,0 +1,76 @@
+
+#include "imu-integrator.hxx"
+
+const uint64_t ImuIntegrator::MaxGap_us;
+
+ImuIntegrator::ImuIntegrator() {
+  Reset();
+}
+
+/* Adds one sample. The first, and the first after a discontinuity, starts an interval
+rather than being integrated from the last. */
+void ImuIntegrator::AddSample(uint64_t Time_us,const Eigen::Vector3d &Gyro_rads,const Eigen::Vector3d &Accel_mss) {
+  if (Started_&&((Time_us < LastTime_us_)||(Time_us - LastTime_us_ > MaxGap_us))) {
+    Reset();
+  }
+  if (!Started_) {
+    Started_ = true;
+    StartTime_us_ = LastTime_us_ = Time_us;
+    LastGyro_rads_ = Gyro_rads;
+    LastAccel_mss_ = Accel_mss;
+    return;
+  }
+  if (Time_us == LastTime_us_) {
+    return;
+  }
+  double Dt_s = (Time_us - LastTime_us_)*1e-6;
+  Eigen::Vector3d DeltaAlpha = 0.5*(LastGyro_rads_ + Gyro_rads)*Dt_s;
+  Eigen::Vector3d DeltaUpsilon = 0.5*(LastAccel_mss_ + Accel_mss)*Dt_s;
+  Eigen::Vector3d AlphaTerm = Alpha_ + LastDeltaAlpha_/6.0;
+  Beta_ += 0.5*AlphaTerm.cross(DeltaAlpha);
+  Sculling_ += 0.5*(AlphaTerm.cross(DeltaUpsilon) + (Upsilon_ + LastDeltaUpsilon_/6.0).cross(DeltaAlpha));
+  Alpha_ += DeltaAlpha;
+  Upsilon_ += DeltaUpsilon;
+  LastDeltaAlpha_ = DeltaAlpha;
+  LastDeltaUpsilon_ = DeltaUpsilon;
+  LastTime_us_ = Time_us;
+  LastGyro_rads_ = Gyro_rads;
+  LastAccel_mss_ = Accel_mss;
+  Samples_++;
+}
+
+/* Returns the increments since the last call, or the first sample, and starts the
+next interval at the last sample. False, with nothing returned, if no sample has
+been added since. */
+bool ImuIntegrator::GetIncrement(ImuIncrement *ImuIncrementPtr) {
+  if (Samples_ == 0) {
+    return false;
+  }
+  ImuIncrementPtr->StartTime_us = StartTime_us_;
+  ImuIncrementPtr->EndTime_us = LastTime_us_;
+  ImuIncrementPtr->Dt_s = (LastTime_us_ - StartTime_us_)*1e-6;
+  ImuIncrementPtr->DeltaAngle_rad = Alpha_ + Beta_;
+  ImuIncrementPtr->DeltaVelocity_ms = Upsilon_ + 0.5*Alpha_.cross(Upsilon_) + Sculling_;
+  ImuIncrementPtr->Samples = Samples_;
+  Restart();
+  return true;
+}
+
+/* Forgets every sample, the next one starts a new interval. */
+void ImuIntegrator::Reset() {
+  Started_ = false;
+  LastDeltaAlpha_.setZero();
+  LastDeltaUpsilon_.setZero();
+  Restart();
+}
+
+/* Starts a new interval at the last sample. The last sample interval's increments
+are kept, the corrections use them across the boundary. */
+void ImuIntegrator::Restart() {
+  StartTime_us_ = LastTime_us_;
+  Samples_ = 0;
+  Alpha_.setZero();
+  Beta_.setZero();
+  Upsilon_.setZero();
+  Sculling_.setZero();
+}
@@ -0,0 +1,49 @@
+
+#ifndef IMU_INTEGRATOR_HXX_
+#define IMU_INTEGRATOR_HXX_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+/* Delta angle and delta velocity over an interval, in the body frame at its start */
+struct ImuIncrement {
+  uint64_t StartTime_us;
+  uint64_t EndTime_us;
+  double Dt_s;
+  Eigen::Vector3d DeltaAngle_rad;           // rotation vector, coning compensated
+  Eigen::Vector3d DeltaVelocity_ms;         // velocity change, rotation and sculling compensated
+  size_t Samples;                           // samples integrated
+};
+
+/* Pre-integrates every IMU sample into delta angle and delta velocity, so the
+navigation filter can run at its own rate and a dropped or late frame only
+lengthens an interval instead of stretching one sample over it. Each sample
+interval is integrated by the trapezoid rule, then the increments are summed with
+the recursive coning and sculling corrections, the rotation vector as alpha plus
+beta, beta += 1/2 (alpha + dalpha_last/6) x dalpha, and the velocity as upsilon
+plus the rotation 1/2 alpha x upsilon and the sculling terms. A sample with the
+same time as the last, a frame received twice, is ignored. One older than the last,
+after an FMU reset, or more than MaxGap_us after it is a discontinuity: the samples
+since the last increment are forgotten and a new interval starts at it. */
+class ImuIntegrator {
+  public:
+    static const uint64_t MaxGap_us = 100000;
+    ImuIntegrator();
+    void AddSample(uint64_t Time_us,const Eigen::Vector3d &Gyro_rads,const Eigen::Vector3d &Accel_mss);
+    bool GetIncrement(ImuIncrement *ImuIncrementPtr);
+    void Reset();
+  private:
+    bool Started_ = false;
+    uint64_t StartTime_us_ = 0;
+    uint64_t LastTime_us_ = 0;
+    size_t Samples_ = 0;
+    Eigen::Vector3d LastGyro_rads_, LastAccel_mss_;
+    Eigen::Vector3d Alpha_, Beta_;            // summed delta angle and coning
+    Eigen::Vector3d Upsilon_, Sculling_;      // summed delta velocity and sculling
+    Eigen::Vector3d LastDeltaAlpha_, LastDeltaUpsilon_;
+    void Restart();
+};
+
+#endif
@@ -0,0 +1,185 @@
+
+#include "loop-stats.hxx"
+
+const size_t LatencyHistogram::SubBuckets;
+const size_t LatencyHistogram::Buckets;
+volatile sig_atomic_t LoopStats::Requested_ = 0;
+
+LatencyHistogram::LatencyHistogram() {
+  Reset();
+}
+
+/* Adds one duration, us. */
+void LatencyHistogram::Record(uint64_t Duration_us) {
+  Counts_[GetBucket(Duration_us)]++;
+  Count_++;
+  Sum_ += Duration_us;
+  if (Duration_us > Max_) {
+    Max_ = Duration_us;
+  }
+}
+
+/* Empties the histogram. */
+void LatencyHistogram::Reset() {
+  for (size_t i=0; i < Buckets; i++) {
+    Counts_[i] = 0;
+  }
+  Count_ = 0;
+  Sum_ = 0;
+  Max_ = 0;
+}
+
+/* Returns the number of durations recorded. */
+uint64_t LatencyHistogram::GetCount() const {
+  return Count_;
+}
+
+/* Returns the longest duration recorded, us. */
+uint64_t LatencyHistogram::GetMax() const {
+  return Max_;
+}
+
+/* Returns the mean duration, us. */
+double LatencyHistogram::GetMean() const {
+  return (Count_ > 0) ? (double)Sum_/Count_ : 0.0;
+}
+
+/* Returns the duration, us, that Percent of the recorded durations are at or under,
+rounded up to the top of its bucket. */
+uint64_t LatencyHistogram::GetPercentile(double Percent) const {
+  uint64_t Target = (uint64_t)(Percent/100.0*Count_ + 0.999999);
+  if (Target == 0) {
+    Target = 1;
+  }
+  uint64_t Count = 0;
+  for (size_t i=0; i < Buckets; i++) {
+    Count += Counts_[i];
+    if (Count >= Target) {
+      uint64_t Limit = GetBucketLimit(i);
+      return (Limit < Max_) ? Limit : Max_;
+    }
+  }
+  return Max_;
+}
+
+/* Returns the bucket a duration falls in. */
+size_t LatencyHistogram::GetBucket(uint64_t Duration_us) {
+  if (Duration_us < SubBuckets) {
+    return Duration_us;
+  }
+  size_t Shift = 63 - __builtin_clzll(Duration_us) - 3;
+  size_t Bucket = (Shift + 1)*SubBuckets + ((Duration_us >> Shift) & (SubBuckets - 1));
+  return (Bucket < Buckets) ? Bucket : Buckets - 1;
+}
+
+/* Returns the largest duration in a bucket, us. */
+uint64_t LatencyHistogram::GetBucketLimit(size_t Bucket) {
+  if (Bucket < SubBuckets) {
+    return Bucket;
+  }
+  size_t Shift = Bucket/SubBuckets - 1;
+  return ((SubBuckets + Bucket % SubBuckets + 1) << Shift) - 1;
+}
+
+LoopStats::LoopStats() {}
+
+/* Starts timing a frame whose last byte was read at ReceiveTime_us. */
+void LoopStats::StartFrame(uint64_t ReceiveTime_us) {
+  if (Frames_ > 0) {
+    Period_.Record(ReceiveTime_us - ReceiveTime_us_);
+    if (ReceiveTime_us < EndTime_us_) {
+      Overruns_++;
+    }
+  }
+  Frames_++;
+  ReceiveTime_us_ = ReceiveTime_us;
+  StageTime_us_ = ReceiveTime_us;
+}
+
+/* Starts timing a stage now rather than from when the previous one ended. */
+void LoopStats::StartStage() {
+  StageTime_us_ = GetTime_us();
+}
+
+/* Records the time since the previous stage ended, or since the frame was received. */
+void LoopStats::EndStage(LoopStage Stage) {
+  EndStage(Stage,GetTime_us());
+}
+
+/* Records the time from the previous stage ending to Time_us, when this one ended. */
+void LoopStats::EndStage(LoopStage Stage,uint64_t Time_us) {
+  Stages_[Stage].Record(Time_us - StageTime_us_);
+  StageTime_us_ = Time_us;
+}
+
+/* Records the time from receiving the frame to finishing with it. */
+void LoopStats::EndFrame() {
+  EndTime_us_ = GetTime_us();
+  EndToEnd_.Record(EndTime_us_ - ReceiveTime_us_);
+}
+
+/* Returns the number of frames that were received before the loop finished the one before. */
+uint64_t LoopStats::GetOverruns() {
+  return Overruns_;
+}
+
+/* Prints a table of the histograms. */
+void LoopStats::Print(FILE *File) {
+  static const char *StageNames[kLoopStages] = {"receive","decode","queue","navigation","control"};
+  fprintf(File,"frames: %llu  overruns: %llu\n",(unsigned long long)Frames_,(unsigned long long)Overruns_);
+  fprintf(File,"%-12s %10s %10s %10s %10s %10s %10s\n","stage, us","count","mean","p50","p99","p99.9","max");
+  for (size_t i=0; i < kLoopStages; i++) {
+    PrintHistogram(File,StageNames[i],Stages_[i]);
+  }
+  PrintHistogram(File,"end to end",EndToEnd_);
+  PrintHistogram(File,"period",Period_);
+}
+
+/* Empties all the histograms. */
+void LoopStats::Reset() {
+  for (size_t i=0; i < kLoopStages; i++) {
+    Stages_[i].Reset();
+  }
+  EndToEnd_.Reset();
+  Period_.Reset();
+  Frames_ = 0;
+  Overruns_ = 0;
+}
+
+/* Makes Signal, such as SIGUSR1, request the stats from the loop. */
+void LoopStats::RequestOnSignal(int Signal) {
+  struct sigaction Action;
+  memset(&Action,0,sizeof(Action));
+  Action.sa_handler = SignalHandler;
+  Action.sa_flags = SA_RESTART;
+  sigemptyset(&Action.sa_mask);
+  sigaction(Signal,&Action,NULL);
+}
+
+/* Returns true once for each time the stats were requested. */
+bool LoopStats::Requested() {
+  if (Requested_) {
+    Requested_ = 0;
+    return true;
+  }
+  return false;
+}
+
+/* Returns the monotonic time, us, on the same clock as Fmu::GetReceiveTime_us. */
+uint64_t LoopStats::GetTime_us() {
+  struct timespec Time;
+  clock_gettime(CLOCK_MONOTONIC,&Time);
+  return (uint64_t)Time.tv_sec*1000000 + Time.tv_nsec/1000;
+}
+
+/* Notes the request for the loop, whichever signal it came on. */
+void LoopStats::SignalHandler(int) {
+  Requested_ = 1;
+}
+
+/* Prints one row of the table. */
+void LoopStats::PrintHistogram(FILE *File,const char *Name,const LatencyHistogram &Histogram) {
+  fprintf(File,"%-12s %10llu %10.1f %10llu %10llu %10llu %10llu\n",Name,(unsigned long long)Histogram.GetCount(),Histogram.GetMean(),
+    (unsigned long long)Histogram.GetPercentile(50),(unsigned long long)Histogram.GetPercentile(99),
+    (unsigned long long)Histogram.GetPercentile(99.9),(unsigned long long)Histogram.GetMax());
+}
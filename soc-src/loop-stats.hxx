@@ -0,0 +1,80 @@
+
+#ifndef LOOP_STATS_HXX_
+#define LOOP_STATS_HXX_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+
+/* Histogram of durations in fixed buckets: exact below 8 us, then 8 buckets per
+power of two, so any value is within 12.5% of its bucket. Recording is a few
+integer operations and never allocates. Anything over about 2 hours lands in
+the last bucket, the maximum is kept exactly. */
+class LatencyHistogram {
+  public:
+    static const size_t SubBuckets = 8;
+    static const size_t Buckets = 31*SubBuckets;
+    LatencyHistogram();
+    void Record(uint64_t Duration_us);
+    void Reset();
+    uint64_t GetCount() const;
+    uint64_t GetMax() const;
+    double GetMean() const;
+    uint64_t GetPercentile(double Percent) const;
+  private:
+    uint64_t Counts_[Buckets];
+    uint64_t Count_;
+    uint64_t Sum_;
+    uint64_t Max_;
+    static size_t GetBucket(uint64_t Duration_us);
+    static uint64_t GetBucketLimit(size_t Bucket);
+};
+
+/* Stages of the flight loop, timed one after the other */
+enum LoopStage {
+  kReceiveStage,                            // last byte of the frame read to GetSensorData returning
+  kDecodeStage,                             // FmuDataView::Decode
+  kQueueStage,                              // waiting for the navigation and control thread
+  kNavigationStage,                         // navigation filter
+  kControlStage,                            // control laws and effector commands
+  kLoopStages
+};
+
+/* Times each stage of every frame and the whole frame from the moment its last
+byte was read, into latency histograms. Stages that ran on another thread are
+ended at the time that thread recorded. A stage run by a scheduled task, which is
+not released every frame, is started when its task starts, so only the frames it
+ran on are timed and nothing else done on the frame is booked to it. A frame overruns when the next one was
+already received before the loop finished with it. The histograms can be written
+out at any time, requested from outside with a signal, without stopping the loop. */
+class LoopStats {
+  public:
+    LoopStats();
+    void StartFrame(uint64_t ReceiveTime_us);
+    void StartStage();
+    void EndStage(LoopStage Stage);
+    void EndStage(LoopStage Stage,uint64_t Time_us);
+    void EndFrame();
+    uint64_t GetOverruns();
+    void Print(FILE *File);
+    void Reset();
+    static void RequestOnSignal(int Signal);
+    static bool Requested();
+    static uint64_t GetTime_us();
+    static void PrintHistogram(FILE *File,const char *Name,const LatencyHistogram &Histogram);
+  private:
+    LatencyHistogram Stages_[kLoopStages];
+    LatencyHistogram EndToEnd_;
+    LatencyHistogram Period_;
+    uint64_t Frames_ = 0;
+    uint64_t Overruns_ = 0;
+    uint64_t ReceiveTime_us_ = 0;
+    uint64_t StageTime_us_ = 0;
+    uint64_t EndTime_us_ = 0;
+    static volatile sig_atomic_t Requested_;
+    static void SignalHandler(int Signal);
+};
+
+#endif
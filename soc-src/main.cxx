@@ -22,58 +22,94 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "datalogger.hxx"
 #include "config.hxx"
 #include "fmu.hxx"
+#include "loop-stats.hxx"
+#include "realtime.hxx"
+#include "pipeline.hxx"
+#include "control-laws.hxx"
+#include "telemetry.hxx"
 #include "hardware-defs.hxx"
 #include "global-defs.hxx"
 #include <iostream>
 
 int main(int argc, char* argv[]) {
-  if (argc!=2) {
+  if ((argc!=2)&&(argc!=3)) {
     std::cerr << "ERROR: Incorrect number of input arguments." << std::endl;
+    std::cerr << "Usage: output <config> [transport]" << std::endl;
+    std::cerr << "  transport is uart:PORT, pty[:LINK], unix:PATH, unix-listen:PATH or file:PATH" << std::endl;
     return -1;
   }
 
-  /* initialize classes */
-  Fmu Sensors;
+  /* initialize classes, the FMU link is the UART unless a transport is given */
+  Fmu Sensors((argc == 3) ? argv[2] : FmuPort);
   Datalogger Log;
   Navigation NavFilter;
+  ControlLaws Laws;
+  Telemetry Link;
 
   /* initialize structures */
   AircraftConfig Config;
   FmuData Data;
-  NavigationData NavData;
+  FmuDataLayout DataLayout;
 
   std::cout << sizeof(NavigationData) << std::endl;
 
   /* load configuration file */
-  LoadConfigFile(argv[1],Sensors,&Config,&Data);
-
-  /* main loop */
-  while (1) {
-    if (Sensors.GetSensorData(&Data)) {
+  LoadConfigFile(argv[1],Sensors,&Config,&Data,&DataLayout);
+  Sensors.SetDataLayout(DataLayout);
+  NavFilter.Configure(Config.Navigation);
+  if (!Config.ControlLaws.empty()) {
+    Laws.Compile(Config.ControlLaws,Data,Config.NumberEffectors);
+    std::cout << "Control laws: " << Laws.GetBlocks() << " blocks compiled to " << Laws.GetInstructions() << " instructions over " << Laws.GetSignals() << " signals" << std::endl;
+  }
+  if (Config.Telemetry.Enabled) {
+    Link.Open(Config.Telemetry,Data);
+    std::cout << "Telemetry: " << Config.Telemetry.Channels.size() << " channels to " << Config.Telemetry.GroundAddress << ":" << Config.Telemetry.GroundPort << ", commands on port " << Config.Telemetry.Port << std::endl;
+  }
 
-      // run navigation filter
-      if (Data.Gps.size() > 0) {
-        if (!NavFilter.Initialized) {
-          NavFilter.InitializeNavigation(Data);
-        } else {
-          NavFilter.RunNavigation(Data,&NavData);
-        }
-      }
+  /* sleep until the FMU sends data rather than spinning on the port */
+  Sensors.SetReceiveTimeout(-1);
 
-      // control laws
+  /* time every stage of the loop, kill -USR1 writes the latency histograms and task stats to LoopStatsFile */
+  const std::string LoopStatsFile = "loop-stats.txt";
+  LoopStats Stats;
+  LoopStats::RequestOnSignal(SIGUSR1);
 
-      // // send control surface commands
-      // std::vector<float> EffectorCmd;
-      // EffectorCmd.resize(Config.NumberEffectors);
-      // std::vector<uint8_t> EffectorBuffer;
-      // EffectorBuffer.resize(EffectorCmd.size()*sizeof(float));
-      // EffectorCmd[0] = -0.3;
-      // memcpy(EffectorBuffer.data(),EffectorCmd.data(),EffectorBuffer.size());
-      // Sensors.WriteMessage(kEffectorAngleCmd,EffectorBuffer.size(),EffectorBuffer.data());
+  /* flight loop stages and the queues between them */
+  FlightPipeline Pipeline(Sensors,NavFilter,Laws,Link,Log,Stats,Data,DataLayout,Config.Tasks);
 
-      // data logging
-      Log.LogFmuData(Data);
+  /* real-time mode, once everything the loop uses is allocated */
+  if (Config.RealTime.Enabled) {
+    EnterRealTime(Config.RealTime);
+    std::cout << "Real-time mode: SCHED_FIFO priority " << Config.RealTime.Priority;
+    if (Config.RealTime.Cpu >= 0) {
+      std::cout << " on CPU " << Config.RealTime.Cpu;
     }
+    std::cout << ", memory locked" << std::endl;
+  }
+
+  /* flight loop, runs until the FMU link closes, which only a replay does */
+  Pipeline.Run(LoopStatsFile);
+
+  /* frame rate the whole pipeline kept up with */
+  uint64_t Frames = Pipeline.GetFrames();
+  double Elapsed_s = Pipeline.GetElapsed_s();
+  std::cout << "FMU link closed after " << Frames << " frames";
+  if (Elapsed_s > 0) {
+    std::cout << " in " << Elapsed_s << " s, " << (Frames-1)/Elapsed_s << " frames/s";
+  }
+  std::cout << std::endl;
+  TxQueueStats TxStats = Sensors.GetTxStats();
+  if (TxStats.Commands > 0) {
+    std::cout << "Effector commands: " << TxStats.Commands << " sent, " << TxStats.Coalesced << " replaced before sending, ";
+    std::cout << "queue to link " << TxStats.CommandLatencySum_us/TxStats.Commands << " us mean, " << TxStats.CommandLatencyMax_us << " us max" << std::endl;
+  }
+  if (Link.Opened()) {
+    Link.Print(stdout);
+  }
+  Stats.Print(stdout);
+  Pipeline.Print(stdout);
+  if (!Pipeline.WriteStatsFile(LoopStatsFile)) {
+    std::cerr << "ERROR: Loop stats file " << LoopStatsFile << " could not be written." << std::endl;
   }
 
 	return 0;
@@ -199,6 +199,17 @@ Matrix3d sk(Vector3d w) {
     return C;
 }
 
+// Single precision sk, for the float filter
+Matrix3f sk(Vector3f w) {
+    Matrix3f C;
+
+    C(0,0) = 0.0f;	C(0,1) = -w(2,0);	C(0,2) = w(1,0);
+    C(1,0) = w(2,0);	C(1,1) = 0.0f;		C(1,2) = -w(0,0);
+    C(2,0) = -w(1,0);	C(2,1) = w(0,0);	C(2,2) = 0.0f;
+	
+    return C;
+}
+
 // Quaternion to euler angle: returns phi, the, psi as a vector
 Vector3d quat2eul(Quaterniond q) {
     double q0, q1, q2, q3;
@@ -81,6 +81,7 @@ Quaterniond lla2quat(double lon_rad, double lat_rad);
 
 // This function gives a skew symmetric matrix from a given vector w
 Matrix3d sk(Vector3d w);
+Matrix3f sk(Vector3f w);
 
 // Quaternion to euler angle: returns phi, the, psi as a vector
 Vector3d quat2eul(Quaterniond q);
@@ -5,7 +5,15 @@ Navigation::Navigation() {
   ekf_ = new EKF15();
 }
 
-void Navigation::InitializeNavigation(const FmuData FmuDataRef) {
+/* Applies the configured filter options. Call after loading the config, before
+the filter is initialized. */
+void Navigation::Configure(const NavigationConfig &ConfigRef) {
+  ekf_->set_structured_tu(ConfigRef.StructuredTu);
+  ekf_->set_sequential_mu(ConfigRef.SequentialMu);
+  ekf_->set_tu_decimation(ConfigRef.TuDecimation);
+}
+
+void Navigation::InitializeNavigation(const FmuData &FmuDataRef) {
   GlobalDefsToImu(FmuDataRef,&imu_);
   GlobalDefsToGps(FmuDataRef,&gps_);
 
@@ -13,20 +21,63 @@ void Navigation::InitializeNavigation(const FmuData FmuDataRef) {
     if (FmuDataRef.Gps[0].Fix) {
       nav_ = ekf_->init(imu_,gps_);
       Initialized = true;
+      Integrator_.Reset();
+      AddImuSample(FmuDataRef);
+      GpsUpdated_ = false;
     } else {
       Initialized = false;
     }
   }
 }
 
-void Navigation::RunNavigation(const FmuData FmuDataRef, NavigationData *NavigationDataPtr) {
-  GlobalDefsToImu(FmuDataRef,&imu_);
-  GlobalDefsToGps(FmuDataRef,&gps_);
-  nav_ = ekf_->update(imu_,gps_);
+/* Integrates the IMU sample of a frame, if the frame carried one, and notes a GPS
+update, so that the filter sees every sample and every fix however often it runs.
+Call on every frame. */
+void Navigation::AddImuSample(const FmuData &FmuDataRef) {
+  if (FmuDataRef.Updated.Mpu9250) {
+    AddImuSample(FmuDataRef.Time_us,FmuDataRef.Mpu9250);
+  }
+  if ((FmuDataRef.Updated.Gps.size() > 0)&&FmuDataRef.Updated.Gps[0]) {
+    GpsUpdated_ = true;
+  }
+}
+
+/* Integrates an IMU sample taken at Time_us that came without its frame, one dropped
+on the way to navigation. */
+void Navigation::AddImuSample(uint64_t Time_us, const Mpu9250Data &Mpu9250Ref) {
+  Integrator_.AddSample(Time_us,Mpu9250Ref.Gyro_rads.cast<double>(),Mpu9250Ref.Accel_mss.cast<double>());
+}
+
+/* Runs the filter on the IMU increments since it last ran and on the latest GPS
+fix, if there was one since. Does nothing if no IMU sample has been added since. */
+void Navigation::RunNavigation(const FmuData &FmuDataRef, NavigationData *NavigationDataPtr) {
+  if (!GetFilterInputs(FmuDataRef,&imuIncrement_,&gps_)) {
+    return;
+  }
+  nav_ = ekf_->update(imuIncrement_,gps_);
   NavToGlobalDefs(nav_,NavigationDataPtr);
 }
 
-void Navigation::GlobalDefsToImu(const FmuData FmuDataRef, IMUdata *ImuDataPtr) {
+/* Takes the IMU increments added since the filter last ran and the latest GPS fix,
+flagged new if one has arrived since, as RunNavigation gives them to the filter.
+Returns false, taking nothing, if no IMU sample has been added since. */
+bool Navigation::GetFilterInputs(const FmuData &FmuDataRef, IMUincrement *ImuIncrementPtr, GPSdata *GpsDataPtr) {
+  if (!Integrator_.GetIncrement(&Increment_)) {
+    return false;
+  }
+  ImuIncrementPtr->time = Increment_.EndTime_us/1000000.0L;
+  ImuIncrementPtr->dt = Increment_.Dt_s;
+  for (size_t i=0; i < 3; i++) {
+    ImuIncrementPtr->dtheta[i] = Increment_.DeltaAngle_rad(i);
+    ImuIncrementPtr->dvel[i] = Increment_.DeltaVelocity_ms(i);
+  }
+  GlobalDefsToGps(FmuDataRef,GpsDataPtr);
+  GpsDataPtr->newData = GpsUpdated_;
+  GpsUpdated_ = false;
+  return true;
+}
+
+void Navigation::GlobalDefsToImu(const FmuData &FmuDataRef, IMUdata *ImuDataPtr) {
   ImuDataPtr->time = FmuDataRef.Time_us/1000000.0L;
 
   ImuDataPtr->p = FmuDataRef.Mpu9250.Gyro_rads[0];
@@ -44,7 +95,7 @@ void Navigation::GlobalDefsToImu(const FmuData FmuDataRef, IMUdata *ImuDataPtr)
   ImuDataPtr->temp = FmuDataRef.Mpu9250.Temp_C;
 }
 
-void Navigation::GlobalDefsToGps(const FmuData FmuDataRef, GPSdata *GpsDataPtr) {
+void Navigation::GlobalDefsToGps(const FmuData &FmuDataRef, GPSdata *GpsDataPtr) {
   GpsDataPtr->time = FmuDataRef.Gps[0].Sec;
   
   GpsDataPtr->lat = FmuDataRef.Gps[0].LLA[0];
@@ -57,15 +108,10 @@ void Navigation::GlobalDefsToGps(const FmuData FmuDataRef, GPSdata *GpsDataPtr)
 
   GpsDataPtr->sats = FmuDataRef.Gps[0].NumberSatellites;
   
-  if (GpsDataPtr->time != PrevTime_) {
-    GpsDataPtr->newData = true;
-    PrevTime_ = GpsDataPtr->time;
-  } else {
-    GpsDataPtr->newData = false;
-  }
+  GpsDataPtr->newData = FmuDataRef.Updated.Gps[0];
 }
 
-void Navigation::NavToGlobalDefs(const NAVdata NavDataRef, NavigationData *NavigationDataPtr) {
+void Navigation::NavToGlobalDefs(const NAVdata &NavDataRef, NavigationData *NavigationDataPtr) {
   NavigationDataPtr->Time_s = NavDataRef.time;
   
   NavigationDataPtr->LLA[0] = NavDataRef.lat;
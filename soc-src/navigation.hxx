@@ -4,6 +4,7 @@
 
 #include "global-defs.hxx"
 #include "EKF_15state.hxx"
+#include "imu-integrator.hxx"
 
 #include <stdio.h>
 #include <fcntl.h>
@@ -19,8 +20,14 @@
 class Navigation {
   public:
     Navigation();
-    void InitializeNavigation(const FmuData FmuDataRef);
-    void RunNavigation(const FmuData FmuDataRef, NavigationData *NavigationDataPtr);
+    void Configure(const NavigationConfig &ConfigRef);
+    void AddImuSample(const FmuData &FmuDataRef);
+    void AddImuSample(uint64_t Time_us, const Mpu9250Data &Mpu9250Ref);
+    void InitializeNavigation(const FmuData &FmuDataRef);
+    void RunNavigation(const FmuData &FmuDataRef, NavigationData *NavigationDataPtr);
+    bool GetFilterInputs(const FmuData &FmuDataRef, IMUincrement *ImuIncrementPtr, GPSdata *GpsDataPtr);
+    void GlobalDefsToImu(const FmuData &FmuDataRef, IMUdata *ImuDataPtr);
+    void GlobalDefsToGps(const FmuData &FmuDataRef, GPSdata *GpsDataPtr);
     bool Initialized = false;
   private:
     EKF15 *ekf_;
@@ -28,14 +35,14 @@ class Navigation {
     NAVdata nav_;
     GPSdata gps_;
     IMUdata imu_;
-
-    double PrevTime_;
+    ImuIntegrator Integrator_;
+    ImuIncrement Increment_;
+    IMUincrement imuIncrement_;
+    bool GpsUpdated_ = false;
 
     const float uT2G_ = 0.01f;
 
-    void GlobalDefsToImu(const FmuData FmuDataRef, IMUdata *ImuDataPtr);
-    void GlobalDefsToGps(const FmuData FmuDataRef, GPSdata *GpsDataPtr);
-    void NavToGlobalDefs(const NAVdata NavDataRef, NavigationData *NavigationDataPtr);
+    void NavToGlobalDefs(const NAVdata &NavDataRef, NavigationData *NavigationDataPtr);
 };
 
 #endif
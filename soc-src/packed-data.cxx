@@ -0,0 +1,516 @@
+
+#include "packed-data.hxx"
+
+/* Quantization steps. The IMU steps are one LSB of the MPU-9250 and AK8963 at their
+widest range, so a sample read at that range is sent exactly. At a narrower range
+the sensor resolves finer than the step, 8 times finer at 2g or 250 deg/s, and the
+extra resolution is lost; configure the Packed encoding to keep it. */
+static const double AccelScale_mss = 16.0*9.80665/32768.0;     // +/-157 m/s/s, 16g
+static const double GyroScale_rads = 2000.0/32768.0*M_PI/180.0; // +/-34.9 rad/s, 2000 deg/s
+static const double MagScale_uT = 0.15;                         // +/-4915 uT, 16 bit output
+static const double TempScale_C = 0.01;            // +/-327 C
+static const double HumidityScale_RH = 0.01;       // 0 to 655 %
+static const double NormalizedScale = 1.0/16384.0; // +/-2, inceptors are normalized to +/-1
+static const double AngleScale_rad = 2.0e-9;       // +/-4.29 rad, about 13 mm on the ground
+static const double AltitudeScale_m = 0.001;       // +/-2147 km
+static const double SpeedScale_ms = 0.01;          // +/-327 m/s
+static const double AccuracyScale = 0.01;          // 0 to 655 m or m/s
+static const double DopScale = 0.01;               // 0 to 655
+static const double DiffPressureScale_Pa = 0.25;   // +/-8191 Pa, about 115 m/s airspeed
+static const double AnalogScale_V = 0.0001;        // 0 to 6.5 V
+static const double VoltageScale_V = 0.001;        // 0 to 65 V
+
+/* Rounds Value/Scale to the nearest integer, saturating at the given range. */
+static int64_t Quantize(double Value,double Scale,int64_t Min,int64_t Max) {
+  double Counts = Value/Scale;
+  if (Counts != Counts) {
+    return 0;
+  }
+  if (Counts <= (double)Min) {
+    return Min;
+  }
+  if (Counts >= (double)Max) {
+    return Max;
+  }
+  return (int64_t) floor(Counts + 0.5);
+}
+
+/* Writes little endian fields one after another */
+class PackedWriter {
+  public:
+    PackedWriter(uint8_t *Buffer) : Buffer_(Buffer) {}
+    void U8(uint8_t Value) {
+      *Buffer_++ = Value;
+    }
+    void U16(uint16_t Value) {
+      U8(Value & 0xff);
+      U8(Value >> 8);
+    }
+    void U32(uint32_t Value) {
+      U16(Value & 0xffff);
+      U16(Value >> 16);
+    }
+    void U64(uint64_t Value) {
+      U32(Value & 0xffffffff);
+      U32(Value >> 32);
+    }
+    void Float(float Value) {
+      uint32_t Bits;
+      memcpy(&Bits,&Value,sizeof(Bits));
+      U32(Bits);
+    }
+    void Double(double Value) {
+      uint64_t Bits;
+      memcpy(&Bits,&Value,sizeof(Bits));
+      U64(Bits);
+    }
+    void I16(double Value,double Scale) {
+      U16((uint16_t)(int16_t) Quantize(Value,Scale,INT16_MIN,INT16_MAX));
+    }
+    void UI16(double Value,double Scale) {
+      U16((uint16_t) Quantize(Value,Scale,0,UINT16_MAX));
+    }
+    void I32(double Value,double Scale) {
+      U32((uint32_t)(int32_t) Quantize(Value,Scale,INT32_MIN,INT32_MAX));
+    }
+  private:
+    uint8_t *Buffer_;
+};
+
+/* Reads the fields written by PackedWriter */
+class PackedReader {
+  public:
+    PackedReader(const uint8_t *Buffer) : Buffer_(Buffer) {}
+    uint8_t U8() {
+      return *Buffer_++;
+    }
+    uint16_t U16() {
+      uint16_t Value = U8();
+      return Value | ((uint16_t)U8() << 8);
+    }
+    uint32_t U32() {
+      uint32_t Value = U16();
+      return Value | ((uint32_t)U16() << 16);
+    }
+    uint64_t U64() {
+      uint64_t Value = U32();
+      return Value | ((uint64_t)U32() << 32);
+    }
+    float Float() {
+      uint32_t Bits = U32();
+      float Value;
+      memcpy(&Value,&Bits,sizeof(Value));
+      return Value;
+    }
+    double Double() {
+      uint64_t Bits = U64();
+      double Value;
+      memcpy(&Value,&Bits,sizeof(Value));
+      return Value;
+    }
+    double I16(double Scale) {
+      return (int16_t) U16() * Scale;
+    }
+    double UI16(double Scale) {
+      return U16() * Scale;
+    }
+    double I32(double Scale) {
+      return (int32_t) U32() * Scale;
+    }
+  private:
+    const uint8_t *Buffer_;
+};
+
+/* Returns the encoding given its configuration name: Raw, Packed or Quantized. */
+DataEncoding GetDataEncoding(const std::string &Name) {
+  if (Name == "Raw") {
+    return kRawEncoding;
+  }
+  if (Name == "Packed") {
+    return kPackedEncoding;
+  }
+  if (Name == "Quantized") {
+    return kQuantizedEncoding;
+  }
+  throw std::runtime_error("Unknown data encoding " + Name + ".");
+}
+
+/* Returns the configuration name of an encoding. */
+const char *GetDataEncodingName(DataEncoding Encoding) {
+  switch (Encoding) {
+    case kPackedEncoding: return "Packed";
+    case kQuantizedEncoding: return "Quantized";
+    default: return "Raw";
+  }
+}
+
+/* Writes the packed payload header, returns the number of bytes written. */
+size_t PackDataHeader(DataEncoding Encoding,uint8_t *Buffer) {
+  Buffer[0] = PackedDataVersion;
+  Buffer[1] = (uint8_t) Encoding;
+  return PackedDataHeaderSize;
+}
+
+/* Returns true if a packed payload header matches the expected version and encoding. */
+bool CheckPackedDataHeader(DataEncoding Encoding,const uint8_t *Buffer) {
+  return (Buffer[0] == PackedDataVersion)&&(Buffer[1] == (uint8_t) Encoding);
+}
+
+/* The FMU time is 8 bytes in every encoding. */
+template <> size_t PackedSize<uint64_t>(DataEncoding) {
+  return sizeof(uint64_t);
+}
+
+template <> size_t PackedSize<Voltage>(DataEncoding Encoding) {
+  switch (Encoding) {
+    case kPackedEncoding: return 4;
+    case kQuantizedEncoding: return 2;
+    default: return sizeof(Voltage);
+  }
+}
+
+template <> size_t PackedSize<Mpu9250Data>(DataEncoding Encoding) {
+  switch (Encoding) {
+    case kPackedEncoding: return 40;
+    case kQuantizedEncoding: return 20;
+    default: return sizeof(Mpu9250Data);
+  }
+}
+
+template <> size_t PackedSize<Bme280Data>(DataEncoding Encoding) {
+  switch (Encoding) {
+    case kPackedEncoding: return 12;
+    case kQuantizedEncoding: return 8;
+    default: return sizeof(Bme280Data);
+  }
+}
+
+template <> size_t PackedSize<SbusRxData>(DataEncoding Encoding) {
+  switch (Encoding) {
+    case kPackedEncoding: return 47;
+    case kQuantizedEncoding: return 27;
+    default: return sizeof(SbusRxData);
+  }
+}
+
+template <> size_t PackedSize<GpsData>(DataEncoding Encoding) {
+  switch (Encoding) {
+    case kPackedEncoding: return 93;
+    case kQuantizedEncoding: return 39;
+    default: return sizeof(GpsData);
+  }
+}
+
+template <> size_t PackedSize<PressureData>(DataEncoding Encoding) {
+  switch (Encoding) {
+    case kPackedEncoding: return 8;
+    case kQuantizedEncoding: return 6;
+    default: return sizeof(PressureData);
+  }
+}
+
+template <> size_t PackedSize<PitotData>(DataEncoding Encoding) {
+  switch (Encoding) {
+    case kPackedEncoding: return 16;
+    case kQuantizedEncoding: return 10;
+    default: return sizeof(PitotData);
+  }
+}
+
+template <> size_t PackedSize<AnalogData>(DataEncoding Encoding) {
+  switch (Encoding) {
+    case kPackedEncoding: return 8;
+    case kQuantizedEncoding: return 6;
+    default: return sizeof(AnalogData);
+  }
+}
+
+/* FMU time, us, the same in every encoding. */
+void PackRecord(const uint64_t &Record,DataEncoding,uint8_t *Buffer) {
+  PackedWriter Writer(Buffer);
+  Writer.U64(Record);
+}
+
+void UnpackRecord(const uint8_t *Buffer,DataEncoding,uint64_t *RecordPtr) {
+  PackedReader Reader(Buffer);
+  *RecordPtr = Reader.U64();
+}
+
+/* Voltage: float, or unsigned 1 mV counts. */
+void PackRecord(const Voltage &Record,DataEncoding Encoding,uint8_t *Buffer) {
+  PackedWriter Writer(Buffer);
+  if (Encoding == kQuantizedEncoding) {
+    Writer.UI16(Record.Voltage_V,VoltageScale_V);
+  } else {
+    Writer.Float(Record.Voltage_V);
+  }
+}
+
+void UnpackRecord(const uint8_t *Buffer,DataEncoding Encoding,Voltage *RecordPtr) {
+  PackedReader Reader(Buffer);
+  if (Encoding == kQuantizedEncoding) {
+    RecordPtr->Voltage_V = Reader.UI16(VoltageScale_V);
+  } else {
+    RecordPtr->Voltage_V = Reader.Float();
+  }
+}
+
+/* MPU-9250: accel, gyro, mag and temperature as floats, or all as 16 bit counts. */
+void PackRecord(const Mpu9250Data &Record,DataEncoding Encoding,uint8_t *Buffer) {
+  PackedWriter Writer(Buffer);
+  if (Encoding == kQuantizedEncoding) {
+    for (size_t i=0; i < 3; i++) {
+      Writer.I16(Record.Accel_mss(i,0),AccelScale_mss);
+    }
+    for (size_t i=0; i < 3; i++) {
+      Writer.I16(Record.Gyro_rads(i,0),GyroScale_rads);
+    }
+    for (size_t i=0; i < 3; i++) {
+      Writer.I16(Record.Mag_uT(i,0),MagScale_uT);
+    }
+    Writer.I16(Record.Temp_C,TempScale_C);
+  } else {
+    for (size_t i=0; i < 3; i++) {
+      Writer.Float(Record.Accel_mss(i,0));
+    }
+    for (size_t i=0; i < 3; i++) {
+      Writer.Float(Record.Gyro_rads(i,0));
+    }
+    for (size_t i=0; i < 3; i++) {
+      Writer.Float(Record.Mag_uT(i,0));
+    }
+    Writer.Float(Record.Temp_C);
+  }
+}
+
+void UnpackRecord(const uint8_t *Buffer,DataEncoding Encoding,Mpu9250Data *RecordPtr) {
+  PackedReader Reader(Buffer);
+  if (Encoding == kQuantizedEncoding) {
+    for (size_t i=0; i < 3; i++) {
+      RecordPtr->Accel_mss(i,0) = Reader.I16(AccelScale_mss);
+    }
+    for (size_t i=0; i < 3; i++) {
+      RecordPtr->Gyro_rads(i,0) = Reader.I16(GyroScale_rads);
+    }
+    for (size_t i=0; i < 3; i++) {
+      RecordPtr->Mag_uT(i,0) = Reader.I16(MagScale_uT);
+    }
+    RecordPtr->Temp_C = Reader.I16(TempScale_C);
+  } else {
+    for (size_t i=0; i < 3; i++) {
+      RecordPtr->Accel_mss(i,0) = Reader.Float();
+    }
+    for (size_t i=0; i < 3; i++) {
+      RecordPtr->Gyro_rads(i,0) = Reader.Float();
+    }
+    for (size_t i=0; i < 3; i++) {
+      RecordPtr->Mag_uT(i,0) = Reader.Float();
+    }
+    RecordPtr->Temp_C = Reader.Float();
+  }
+}
+
+/* BME-280: pressure stays a float, temperature and humidity are quantized. */
+void PackRecord(const Bme280Data &Record,DataEncoding Encoding,uint8_t *Buffer) {
+  PackedWriter Writer(Buffer);
+  Writer.Float(Record.Pressure_Pa);
+  if (Encoding == kQuantizedEncoding) {
+    Writer.I16(Record.Temp_C,TempScale_C);
+    Writer.UI16(Record.Humidity_RH,HumidityScale_RH);
+  } else {
+    Writer.Float(Record.Temp_C);
+    Writer.Float(Record.Humidity_RH);
+  }
+}
+
+void UnpackRecord(const uint8_t *Buffer,DataEncoding Encoding,Bme280Data *RecordPtr) {
+  PackedReader Reader(Buffer);
+  RecordPtr->Pressure_Pa = Reader.Float();
+  if (Encoding == kQuantizedEncoding) {
+    RecordPtr->Temp_C = Reader.I16(TempScale_C);
+    RecordPtr->Humidity_RH = Reader.UI16(HumidityScale_RH);
+  } else {
+    RecordPtr->Temp_C = Reader.Float();
+    RecordPtr->Humidity_RH = Reader.Float();
+  }
+}
+
+/* SBUS receiver: the three flags share a byte, inceptors and aux inputs are quantized. */
+void PackRecord(const SbusRxData &Record,DataEncoding Encoding,uint8_t *Buffer) {
+  PackedWriter Writer(Buffer);
+  Writer.U8((Record.Failsafe ? 0x01 : 0)|(Record.AutoEnabled ? 0x02 : 0)|(Record.ThrottleEnabled ? 0x04 : 0));
+  Writer.U16(Record.LostFrames);
+  Writer.Float(Record.RSSI);
+  for (size_t i=0; i < 5; i++) {
+    if (Encoding == kQuantizedEncoding) {
+      Writer.I16(Record.Inceptors(i,0),NormalizedScale);
+    } else {
+      Writer.Float(Record.Inceptors(i,0));
+    }
+  }
+  for (size_t i=0; i < 5; i++) {
+    if (Encoding == kQuantizedEncoding) {
+      Writer.I16(Record.AuxInputs(i,0),NormalizedScale);
+    } else {
+      Writer.Float(Record.AuxInputs(i,0));
+    }
+  }
+}
+
+void UnpackRecord(const uint8_t *Buffer,DataEncoding Encoding,SbusRxData *RecordPtr) {
+  PackedReader Reader(Buffer);
+  uint8_t Flags = Reader.U8();
+  RecordPtr->Failsafe = Flags & 0x01;
+  RecordPtr->AutoEnabled = Flags & 0x02;
+  RecordPtr->ThrottleEnabled = Flags & 0x04;
+  RecordPtr->LostFrames = Reader.U16();
+  RecordPtr->RSSI = Reader.Float();
+  for (size_t i=0; i < 5; i++) {
+    RecordPtr->Inceptors(i,0) = (Encoding == kQuantizedEncoding) ? Reader.I16(NormalizedScale) : Reader.Float();
+  }
+  for (size_t i=0; i < 5; i++) {
+    RecordPtr->AuxInputs(i,0) = (Encoding == kQuantizedEncoding) ? Reader.I16(NormalizedScale) : Reader.Float();
+  }
+}
+
+/* GPS: status and time fields at their natural width, then the solution as doubles or
+as scaled integers. */
+void PackRecord(const GpsData &Record,DataEncoding Encoding,uint8_t *Buffer) {
+  PackedWriter Writer(Buffer);
+  Writer.U8(Record.Fix);
+  Writer.U8(Record.NumberSatellites);
+  Writer.U32(Record.TOW);
+  Writer.U16(Record.Year);
+  Writer.U8(Record.Month);
+  Writer.U8(Record.Day);
+  Writer.U8(Record.Hour);
+  Writer.U8(Record.Min);
+  Writer.U8(Record.Sec);
+  if (Encoding == kQuantizedEncoding) {
+    Writer.I32(Record.LLA(0,0),AngleScale_rad);
+    Writer.I32(Record.LLA(1,0),AngleScale_rad);
+    Writer.I32(Record.LLA(2,0),AltitudeScale_m);
+    for (size_t i=0; i < 3; i++) {
+      Writer.I16(Record.NEDVelocity_ms(i,0),SpeedScale_ms);
+    }
+    for (size_t i=0; i < 3; i++) {
+      Writer.UI16(Record.Accuracy(i,0),AccuracyScale);
+    }
+    Writer.UI16(Record.pDOP,DopScale);
+  } else {
+    for (size_t i=0; i < 3; i++) {
+      Writer.Double(Record.LLA(i,0));
+    }
+    for (size_t i=0; i < 3; i++) {
+      Writer.Double(Record.NEDVelocity_ms(i,0));
+    }
+    for (size_t i=0; i < 3; i++) {
+      Writer.Double(Record.Accuracy(i,0));
+    }
+    Writer.Double(Record.pDOP);
+  }
+}
+
+void UnpackRecord(const uint8_t *Buffer,DataEncoding Encoding,GpsData *RecordPtr) {
+  PackedReader Reader(Buffer);
+  RecordPtr->Fix = Reader.U8();
+  RecordPtr->NumberSatellites = Reader.U8();
+  RecordPtr->TOW = Reader.U32();
+  RecordPtr->Year = Reader.U16();
+  RecordPtr->Month = Reader.U8();
+  RecordPtr->Day = Reader.U8();
+  RecordPtr->Hour = Reader.U8();
+  RecordPtr->Min = Reader.U8();
+  RecordPtr->Sec = Reader.U8();
+  if (Encoding == kQuantizedEncoding) {
+    RecordPtr->LLA(0,0) = Reader.I32(AngleScale_rad);
+    RecordPtr->LLA(1,0) = Reader.I32(AngleScale_rad);
+    RecordPtr->LLA(2,0) = Reader.I32(AltitudeScale_m);
+    for (size_t i=0; i < 3; i++) {
+      RecordPtr->NEDVelocity_ms(i,0) = Reader.I16(SpeedScale_ms);
+    }
+    for (size_t i=0; i < 3; i++) {
+      RecordPtr->Accuracy(i,0) = Reader.UI16(AccuracyScale);
+    }
+    RecordPtr->pDOP = Reader.UI16(DopScale);
+  } else {
+    for (size_t i=0; i < 3; i++) {
+      RecordPtr->LLA(i,0) = Reader.Double();
+    }
+    for (size_t i=0; i < 3; i++) {
+      RecordPtr->NEDVelocity_ms(i,0) = Reader.Double();
+    }
+    for (size_t i=0; i < 3; i++) {
+      RecordPtr->Accuracy(i,0) = Reader.Double();
+    }
+    RecordPtr->pDOP = Reader.Double();
+  }
+}
+
+/* Pressure transducer: pressure stays a float, temperature is quantized. */
+void PackRecord(const PressureData &Record,DataEncoding Encoding,uint8_t *Buffer) {
+  PackedWriter Writer(Buffer);
+  Writer.Float(Record.Pressure_Pa);
+  if (Encoding == kQuantizedEncoding) {
+    Writer.I16(Record.Temp_C,TempScale_C);
+  } else {
+    Writer.Float(Record.Temp_C);
+  }
+}
+
+void UnpackRecord(const uint8_t *Buffer,DataEncoding Encoding,PressureData *RecordPtr) {
+  PackedReader Reader(Buffer);
+  RecordPtr->Pressure_Pa = Reader.Float();
+  if (Encoding == kQuantizedEncoding) {
+    RecordPtr->Temp_C = Reader.I16(TempScale_C);
+  } else {
+    RecordPtr->Temp_C = Reader.Float();
+  }
+}
+
+/* Pitot: the static side as a pressure transducer, the differential pressure is small
+enough to quantize. */
+void PackRecord(const PitotData &Record,DataEncoding Encoding,uint8_t *Buffer) {
+  PackRecord(Record.Static,Encoding,Buffer);
+  PackedWriter Writer(Buffer + PackedSize<PressureData>(Encoding));
+  if (Encoding == kQuantizedEncoding) {
+    Writer.I16(Record.Diff.Pressure_Pa,DiffPressureScale_Pa);
+    Writer.I16(Record.Diff.Temp_C,TempScale_C);
+  } else {
+    Writer.Float(Record.Diff.Pressure_Pa);
+    Writer.Float(Record.Diff.Temp_C);
+  }
+}
+
+void UnpackRecord(const uint8_t *Buffer,DataEncoding Encoding,PitotData *RecordPtr) {
+  UnpackRecord(Buffer,Encoding,&RecordPtr->Static);
+  PackedReader Reader(Buffer + PackedSize<PressureData>(Encoding));
+  if (Encoding == kQuantizedEncoding) {
+    RecordPtr->Diff.Pressure_Pa = Reader.I16(DiffPressureScale_Pa);
+    RecordPtr->Diff.Temp_C = Reader.I16(TempScale_C);
+  } else {
+    RecordPtr->Diff.Pressure_Pa = Reader.Float();
+    RecordPtr->Diff.Temp_C = Reader.Float();
+  }
+}
+
+/* Analog: the measured voltage is quantized, the calibrated value has no known range. */
+void PackRecord(const AnalogData &Record,DataEncoding Encoding,uint8_t *Buffer) {
+  PackedWriter Writer(Buffer);
+  if (Encoding == kQuantizedEncoding) {
+    Writer.UI16(Record.Voltage_V,AnalogScale_V);
+  } else {
+    Writer.Float(Record.Voltage_V);
+  }
+  Writer.Float(Record.CalValue);
+}
+
+void UnpackRecord(const uint8_t *Buffer,DataEncoding Encoding,AnalogData *RecordPtr) {
+  PackedReader Reader(Buffer);
+  if (Encoding == kQuantizedEncoding) {
+    RecordPtr->Voltage_V = Reader.UI16(AnalogScale_V);
+  } else {
+    RecordPtr->Voltage_V = Reader.Float();
+  }
+  RecordPtr->CalValue = Reader.Float();
+}
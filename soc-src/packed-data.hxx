@@ -0,0 +1,70 @@
+
+#ifndef PACKED_DATA_HXX_
+#define PACKED_DATA_HXX_
+
+#include "global-defs.hxx"
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <stdexcept>
+
+/* How sensor records are laid out in a data payload. Raw is the in-memory struct, as
+sent in kData. Packed and quantized are sent in kDataPacked: fields are little endian
+with no padding, and quantized also stores most fields as scaled integers. */
+enum DataEncoding {
+  kRawEncoding,
+  kPackedEncoding,
+  kQuantizedEncoding
+};
+
+/* Names used for the encoding in the aircraft configuration */
+DataEncoding GetDataEncoding(const std::string &Name);
+const char *GetDataEncodingName(DataEncoding Encoding);
+
+/* A kDataPacked payload starts with the format version and the encoding used, so a
+mismatched FMU or log is rejected rather than decoded into garbage. */
+const uint8_t PackedDataVersion = 2;
+const size_t PackedDataHeaderSize = 2;
+
+/* Writes the packed payload header, returns the number of bytes written. */
+size_t PackDataHeader(DataEncoding Encoding,uint8_t *Buffer);
+bool CheckPackedDataHeader(DataEncoding Encoding,const uint8_t *Buffer);
+
+/* Size of one record of type T in the given encoding. */
+template <typename T>
+size_t PackedSize(DataEncoding Encoding);
+template <> size_t PackedSize<uint64_t>(DataEncoding Encoding);
+template <> size_t PackedSize<Voltage>(DataEncoding Encoding);
+template <> size_t PackedSize<Mpu9250Data>(DataEncoding Encoding);
+template <> size_t PackedSize<Bme280Data>(DataEncoding Encoding);
+template <> size_t PackedSize<SbusRxData>(DataEncoding Encoding);
+template <> size_t PackedSize<GpsData>(DataEncoding Encoding);
+template <> size_t PackedSize<PressureData>(DataEncoding Encoding);
+template <> size_t PackedSize<PitotData>(DataEncoding Encoding);
+template <> size_t PackedSize<AnalogData>(DataEncoding Encoding);
+
+/* Writes one record in the packed or quantized encoding. */
+void PackRecord(const uint64_t &Record,DataEncoding Encoding,uint8_t *Buffer);
+void PackRecord(const Voltage &Record,DataEncoding Encoding,uint8_t *Buffer);
+void PackRecord(const Mpu9250Data &Record,DataEncoding Encoding,uint8_t *Buffer);
+void PackRecord(const Bme280Data &Record,DataEncoding Encoding,uint8_t *Buffer);
+void PackRecord(const SbusRxData &Record,DataEncoding Encoding,uint8_t *Buffer);
+void PackRecord(const GpsData &Record,DataEncoding Encoding,uint8_t *Buffer);
+void PackRecord(const PressureData &Record,DataEncoding Encoding,uint8_t *Buffer);
+void PackRecord(const PitotData &Record,DataEncoding Encoding,uint8_t *Buffer);
+void PackRecord(const AnalogData &Record,DataEncoding Encoding,uint8_t *Buffer);
+
+/* Reads one record written by PackRecord. */
+void UnpackRecord(const uint8_t *Buffer,DataEncoding Encoding,uint64_t *RecordPtr);
+void UnpackRecord(const uint8_t *Buffer,DataEncoding Encoding,Voltage *RecordPtr);
+void UnpackRecord(const uint8_t *Buffer,DataEncoding Encoding,Mpu9250Data *RecordPtr);
+void UnpackRecord(const uint8_t *Buffer,DataEncoding Encoding,Bme280Data *RecordPtr);
+void UnpackRecord(const uint8_t *Buffer,DataEncoding Encoding,SbusRxData *RecordPtr);
+void UnpackRecord(const uint8_t *Buffer,DataEncoding Encoding,GpsData *RecordPtr);
+void UnpackRecord(const uint8_t *Buffer,DataEncoding Encoding,PressureData *RecordPtr);
+void UnpackRecord(const uint8_t *Buffer,DataEncoding Encoding,PitotData *RecordPtr);
+void UnpackRecord(const uint8_t *Buffer,DataEncoding Encoding,AnalogData *RecordPtr);
+
+#endif
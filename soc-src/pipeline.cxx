@@ -0,0 +1,362 @@
+
+#include "pipeline.hxx"
+
+const size_t CommandFrame::MaxPayloadSize;
+const size_t FlightPipeline::NavDepth;
+const size_t FlightPipeline::LogDepth;
+const size_t FlightPipeline::CommandDepth;
+const size_t NavFrame::MaxHeldSamples;
+
+/* Opens the eventfd, nonblocking so Clear never sleeps. */
+Doorbell::Doorbell() {
+  if ((FileDesc_ = eventfd(0,EFD_NONBLOCK|EFD_CLOEXEC)) < 0) {
+    throw std::runtime_error("Doorbell eventfd failed to open.");
+  }
+}
+
+Doorbell::~Doorbell() {
+  close(FileDesc_);
+}
+
+/* Wakes the thread waiting, or the next one to wait. */
+void Doorbell::Ring() {
+  uint64_t Count = 1;
+  while ((write(FileDesc_,&Count,sizeof(Count)) < 0)&&(errno == EINTR)) {}
+}
+
+/* Sleeps until the doorbell has rung since it was last cleared, then clears it. */
+void Doorbell::Wait() {
+  struct pollfd Fds = {FileDesc_,POLLIN,0};
+  while ((poll(&Fds,1,-1) < 0)&&(errno == EINTR)) {}
+  Clear();
+}
+
+/* Forgets any rings so far. */
+void Doorbell::Clear() {
+  uint64_t Count;
+  while ((read(FileDesc_,&Count,sizeof(Count)) < 0)&&(errno == EINTR)) {}
+}
+
+/* Returns the eventfd, readable while the doorbell has rung. */
+int Doorbell::GetFileDesc() {
+  return FileDesc_;
+}
+
+/* Allocates every queue slot up front, sized from the configured data and its layout,
+and adds the configured tasks to the scheduler. */
+FlightPipeline::FlightPipeline(Fmu &FmuRef,Navigation &NavigationRef,ControlLaws &ControlLawsRef,Telemetry &TelemetryRef,Datalogger &DataloggerRef,LoopStats &LoopStatsRef,const FmuData &FmuDataRef,const FmuDataLayout &LayoutRef,const std::vector<TaskConfig> &TasksRef) :
+  Fmu_(FmuRef), Navigation_(NavigationRef), ControlLaws_(ControlLawsRef), Telemetry_(TelemetryRef), Datalogger_(DataloggerRef), LoopStats_(LoopStatsRef), Layout_(LayoutRef),
+  NavQueue_(NavDepth,NavFrame{FmuDataRef,0,0,0,{}}),
+  LogQueue_(LogDepth,LogFrame{std::vector<uint8_t>(LayoutRef.PayloadSize)}),
+  CommandQueue_(CommandDepth,CommandFrame()),
+  Stop_(false), StatsReady_(false), StatsWritten_(0), StatsFailed_(0) {
+  ClearUpdated(LayoutRef,&HeldUpdated_);
+  for (size_t i=0; i < TasksRef.size(); i++) {
+    const std::string &Name = TasksRef[i].Name;
+    if (Name == "Navigation") {
+      Scheduler_.AddTask(TasksRef[i],[this]() {NavigationTask();});
+    } else if (Name == "Control") {
+      Scheduler_.AddTask(TasksRef[i],[this]() {ControlTask();});
+    } else if (Name == "Telemetry") {
+      Scheduler_.AddTask(TasksRef[i],[this]() {TelemetryTask();});
+    } else if (Name == "Housekeeping") {
+      Scheduler_.AddTask(TasksRef[i],[this]() {HousekeepingTask();});
+    } else {
+      throw std::runtime_error("Unknown scheduler task " + Name + ".");
+    }
+  }
+  Scheduler_.GetStats(&TaskStatsCopy_);
+}
+
+/* Runs the flight loop until the FMU link closes, which only a replay does: the
+receive stage on this thread, navigation and control and logging on their own.
+Returns once the other stages have finished the frames they were given. kill -USR1
+has the logging thread write the loop stats to LoopStatsFile. */
+void FlightPipeline::Run(const std::string &LoopStatsFile) {
+  LoopStatsFile_ = LoopStatsFile;
+  LoopStatsTempFile_ = LoopStatsFile + ".tmp";
+  Stop_ = false;
+  std::thread NavigationThread(&FlightPipeline::NavigationStage,this);
+  std::thread LoggingThread(&FlightPipeline::LoggingStage,this);
+  ReceiveStage();
+  Stop_ = true;
+  NavBell_.Ring();
+  LogBell_.Ring();
+  NavigationThread.join();
+  LoggingThread.join();
+}
+
+/* Queues an effector command for the FMU, returns false if the queue to the receive
+thread is full. Navigation and control thread only. */
+bool FlightPipeline::QueueCommand(BfsMessage MessageId,uint16_t PayloadSize,const uint8_t *Payload) {
+  if (PayloadSize > CommandFrame::MaxPayloadSize) {
+    throw std::runtime_error("Effector command is too large for the command queue.");
+  }
+  CommandFrame *Command = CommandQueue_.BeginPush();
+  if (Command == NULL) {
+    return false;
+  }
+  Command->MessageId = MessageId;
+  Command->PayloadSize = PayloadSize;
+  memcpy(Command->Payload,Payload,PayloadSize);
+  CommandQueue_.CommitPush();
+  CommandBell_.Ring();
+  return true;
+}
+
+/* Returns the number of data frames received. */
+uint64_t FlightPipeline::GetFrames() {
+  return Frames_;
+}
+
+/* Returns the time from the first data frame received to the last, s. */
+double FlightPipeline::GetElapsed_s() {
+  return (LastReceiveTime_us_ - FirstReceiveTime_us_)/1e6;
+}
+
+/* Prints the task and queue counters, the time taken by log writes and the heap
+allocations each stage made after startup, once Run has returned. */
+void FlightPipeline::Print(FILE *File) {
+  Scheduler_.Print(File);
+  PrintQueues(File);
+  fprintf(File,"%-12s %10s %10s %10s %10s %10s %10s\n","thread, us","count","mean","p50","p99","p99.9","max");
+  LoopStats::PrintHistogram(File,"log write",LogWrite_);
+  fprintf(File,"%-12s %10s %10s %10s %10s\n","allocations","frames","allocating","count","bytes");
+  AllocationTracer::Print(File,"receive",ReceiveAllocations_.GetStats());
+  AllocationTracer::Print(File,"navigation",NavigationAllocations_.GetStats());
+  AllocationTracer::Print(File,"logging",LoggingAllocations_.GetStats());
+  fprintf(File,"imu samples of dropped frames: %llu carried, %llu lost\n",(unsigned long long)ImuSamplesHeld_,(unsigned long long)ImuSamplesLost_);
+  fprintf(File,"stats file: %llu written, %llu failed\n",(unsigned long long)StatsWritten_.load(),(unsigned long long)StatsFailed_.load());
+}
+
+/* Returns true if no stage allocated after startup, once Run has returned. */
+bool FlightPipeline::AllocationFree() {
+  return (ReceiveAllocations_.GetStats().Allocations == 0)&&(NavigationAllocations_.GetStats().Allocations == 0)&&(LoggingAllocations_.GetStats().Allocations == 0);
+}
+
+/* Writes the loop, task and queue tables to a file once Run has returned, returns
+false if it could not be written. */
+bool FlightPipeline::WriteStatsFile(const std::string &FileName) {
+  LoopStatsCopy_ = LoopStats_;
+  Scheduler_.GetStats(&TaskStatsCopy_);
+  return WriteStats(FileName,FileName + ".tmp");
+}
+
+/* Writes the copied loop and task tables, and the queue table, to TempName and then
+renames it over FileName, so a reader never sees part of the file. A write that
+fails is counted and the old file, if any, left as it was; it never throws, it runs
+on the logging thread. */
+bool FlightPipeline::WriteStats(const std::string &FileName,const std::string &TempName) {
+  FILE *File = fopen(TempName.c_str(),"w");
+  if (File == NULL) {
+    StatsFailed_++;
+    return false;
+  }
+  LoopStatsCopy_.Print(File);
+  Scheduler_.Print(File,TaskStatsCopy_);
+  PrintQueues(File);
+  bool Written = !ferror(File);
+  Written = (fclose(File) == 0) && Written;
+  if (!Written||(rename(TempName.c_str(),FileName.c_str()) < 0)) {
+    unlink(TempName.c_str());
+    StatsFailed_++;
+    return false;
+  }
+  StatsWritten_++;
+  return true;
+}
+
+/* Reads data frames from the FMU and hands them on decoded to navigation and as
+received to logging, and passes effector commands the other way, until the link
+closes. When the navigation queue is full the frame is dropped, counted by the
+queue, and its update flags and IMU sample are held for the next frame queued. A
+command wakes the wait on the FMU so it goes out straight away. */
+void FlightPipeline::ReceiveStage() {
+  Fmu_.SetWakeDesc(CommandBell_.GetFileDesc());
+  FmuDataView DataView;
+  while (!Fmu_.LinkClosed()) {
+    SendCommands();
+    if (!Fmu_.GetSensorData(&DataView)) {
+      continue;
+    }
+    uint64_t ReceivedTime_us = LoopStats::GetTime_us();
+    LastReceiveTime_us_ = Fmu_.GetReceiveTime_us();
+    if (Frames_++ == 0) {
+      FirstReceiveTime_us_ = LastReceiveTime_us_;
+    }
+    NavFrame *Frame = NavQueue_.BeginPush();
+    if (Frame == NULL) {
+      DataView.AddUpdated(&HeldUpdated_);
+      UpdatesHeld_ = true;
+      HoldImuSample(DataView);
+    } else {
+      DataView.Decode(&Frame->Data);
+      if (UpdatesHeld_) {
+        DataView.AddUpdated(&HeldUpdated_);
+        HeldUpdated_.Mpu9250 = DataView.Mpu9250Updated();
+        Frame->Data.Updated = HeldUpdated_;
+        ClearUpdated(Layout_,&HeldUpdated_);
+        UpdatesHeld_ = false;
+      }
+      Frame->HeldSamples = HeldSampleCount_;
+      std::copy(HeldSamples_,HeldSamples_ + HeldSampleCount_,Frame->Held);
+      HeldSampleCount_ = 0;
+      Frame->Data.ReceiveTime_us = LastReceiveTime_us_;
+      Frame->ReceivedTime_us = ReceivedTime_us;
+      Frame->DecodedTime_us = LoopStats::GetTime_us();
+      NavQueue_.CommitPush();
+      NavBell_.Ring();
+    }
+    LogFrame *Record = LogQueue_.BeginPush();
+    if (Record != NULL) {
+      memcpy(Record->Payload.data(),DataView.Payload(),DataView.PayloadSize());
+      LogQueue_.CommitPush();
+      LogBell_.Ring();
+    }
+    ReceiveAllocations_.EndFrame();
+  }
+  Fmu_.SetWakeDesc(-1);
+}
+
+/* Holds the IMU sample of a frame dropped for navigation, if it carried one, for
+the next frame queued. Past MaxHeldSamples the sample is lost, and counted. */
+void FlightPipeline::HoldImuSample(const FmuDataView &DataViewRef) {
+  if (!DataViewRef.Mpu9250Updated()) {
+    return;
+  }
+  if (HeldSampleCount_ == NavFrame::MaxHeldSamples) {
+    ImuSamplesLost_++;
+    return;
+  }
+  HeldSamples_[HeldSampleCount_].Time_us = DataViewRef.Time_us();
+  HeldSamples_[HeldSampleCount_].Mpu9250 = DataViewRef.Mpu9250();
+  HeldSampleCount_++;
+  ImuSamplesHeld_++;
+}
+
+/* Runs the scheduled tasks on each decoded frame, timing the frame from its last
+byte being read to the rate tasks finishing, slack tasks run after. */
+void FlightPipeline::NavigationStage() {
+  while (true) {
+    bool Stopping = Stop_;
+    NavFrame *Frame = NavQueue_.Front();
+    if (Frame == NULL) {
+      if (Stopping) {
+        return;
+      }
+      NavBell_.Wait();
+      continue;
+    }
+    LoopStats_.StartFrame(Frame->Data.ReceiveTime_us);
+    LoopStats_.EndStage(kReceiveStage,Frame->ReceivedTime_us);
+    LoopStats_.EndStage(kDecodeStage,Frame->DecodedTime_us);
+    LoopStats_.EndStage(kQueueStage);
+    Frame_ = Frame;
+    for (size_t i=0; i < Frame->HeldSamples; i++) {
+      Navigation_.AddImuSample(Frame->Held[i].Time_us,Frame->Held[i].Mpu9250);
+    }
+    Navigation_.AddImuSample(Frame->Data);
+    Scheduler_.RunTasks(Frame->Data.Time_us,Frame->Data.ReceiveTime_us);
+    LoopStats_.EndFrame();
+    Scheduler_.RunSlackTasks();
+    Frame_ = NULL;
+    NavQueue_.Pop();
+    NavigationAllocations_.EndFrame();
+  }
+}
+
+/* Runs the navigation filter on the current frame. */
+void FlightPipeline::NavigationTask() {
+  LoopStats_.StartStage();
+  FmuData &Data = Frame_->Data;
+  if (Data.Gps.size() > 0) {
+    if (!Navigation_.Initialized) {
+      Navigation_.InitializeNavigation(Data);
+    } else {
+      Navigation_.RunNavigation(Data,&NavData_);
+    }
+  }
+  LoopStats_.EndStage(kNavigationStage);
+}
+
+/* Runs the control laws, if any are configured, and queues the effector commands. */
+void FlightPipeline::ControlTask() {
+  LoopStats_.StartStage();
+  if (ControlLaws_.Compiled()) {
+    ControlLaws_.Step(Frame_->Data,NavData_,Telemetry_.GetUplinkValues());
+    const std::vector<float> &Commands = ControlLaws_.GetCommands();
+    QueueCommand(kEffectorAngleCmd,Commands.size()*sizeof(float),(const uint8_t *)Commands.data());
+  }
+  LoopStats_.EndStage(kControlStage);
+}
+
+/* Carries out the commands from the ground station and sends it a telemetry
+sample, if telemetry is configured. */
+void FlightPipeline::TelemetryTask() {
+  if (Telemetry_.Opened()) {
+    Telemetry_.ReceiveCommands();
+    Telemetry_.Send(Frame_->Data,NavData_,Navigation_.Initialized);
+  }
+}
+
+/* Copies the loop and task stats when they have been asked for with a signal and
+hands them to the logging thread to write out, unless it has yet to write the last
+copy. The copy does not allocate; the file is never touched from this thread. */
+void FlightPipeline::HousekeepingTask() {
+  if (!StatsReady_.load(std::memory_order_acquire)&&LoopStats::Requested()) {
+    LoopStatsCopy_ = LoopStats_;
+    Scheduler_.GetStats(&TaskStatsCopy_);
+    StatsReady_.store(true,std::memory_order_release);
+    LogBell_.Ring();
+  }
+}
+
+/* Writes each data payload to the log, and the stats housekeeping copied, time-shared
+so it never holds off the flight loop. */
+void FlightPipeline::LoggingStage() {
+  LeaveRealTime();
+  while (true) {
+    if (StatsReady_.load(std::memory_order_acquire)) {
+      WriteStats(LoopStatsFile_,LoopStatsTempFile_);
+      StatsReady_.store(false,std::memory_order_release);
+    }
+    bool Stopping = Stop_;
+    LogFrame *Record = LogQueue_.Front();
+    if (Record == NULL) {
+      if (Stopping) {
+        return;
+      }
+      LogBell_.Wait();
+      continue;
+    }
+    uint64_t Start_us = LoopStats::GetTime_us();
+    Datalogger_.LogFmuData(FmuDataView(Layout_,Record->Payload.data()));
+    LogWrite_.Record(LoopStats::GetTime_us() - Start_us);
+    LogQueue_.Pop();
+    LoggingAllocations_.EndFrame();
+  }
+}
+
+/* Moves effector commands from the control laws into the FMU transmit queue. */
+void FlightPipeline::SendCommands() {
+  CommandBell_.Clear();
+  CommandFrame *Command;
+  while ((Command = CommandQueue_.Front()) != NULL) {
+    Fmu_.QueueMessage(Command->MessageId,Command->PayloadSize,Command->Payload);
+    CommandQueue_.Pop();
+  }
+}
+
+/* Prints the queue table. */
+void FlightPipeline::PrintQueues(FILE *File) {
+  fprintf(File,"%-12s %10s %10s %10s %10s %10s\n","queue","capacity","pushed","dropped","depth","max depth");
+  PrintQueue(File,"navigation",NavQueue_.GetStats());
+  PrintQueue(File,"logging",LogQueue_.GetStats());
+  PrintQueue(File,"command",CommandQueue_.GetStats());
+}
+
+/* Prints one row of the queue table. */
+void FlightPipeline::PrintQueue(FILE *File,const char *Name,const SpscQueueStats &Stats) {
+  fprintf(File,"%-12s %10zu %10llu %10llu %10zu %10zu\n",Name,Stats.Capacity,(unsigned long long)Stats.Pushed,
+    (unsigned long long)Stats.Dropped,Stats.Depth,Stats.MaxDepth);
+}
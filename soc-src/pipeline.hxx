@@ -0,0 +1,157 @@
+
+#ifndef PIPELINE_HXX_
+#define PIPELINE_HXX_
+
+#include "global-defs.hxx"
+#include "fmu.hxx"
+#include "data-layout.hxx"
+#include "navigation.hxx"
+#include "datalogger.hxx"
+#include "loop-stats.hxx"
+#include "realtime.hxx"
+#include "spsc-queue.hxx"
+#include "scheduler.hxx"
+#include "control-laws.hxx"
+#include "telemetry.hxx"
+#include "alloc-trace.hxx"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <vector>
+#include <exception>
+#include <stdexcept>
+
+/* Wakes a thread sleeping on a queue, an eventfd so the FMU receive wait can poll it */
+class Doorbell {
+  public:
+    Doorbell();
+    ~Doorbell();
+    void Ring();
+    void Wait();
+    void Clear();
+    int GetFileDesc();
+  private:
+    int FileDesc_;
+};
+
+/* IMU sample of a frame dropped on the way to navigation */
+struct HeldImuSample {
+  uint64_t Time_us;
+  Mpu9250Data Mpu9250;
+};
+
+/* Decoded frame from the receive thread to the navigation and control thread, with
+the IMU samples of the frames dropped since the last one, so navigation integrates
+every sample the FMU delivers. Data.Updated.Mpu9250 is set only if this frame
+carried one. */
+struct NavFrame {
+  static const size_t MaxHeldSamples = 32;  // 32 ms of samples at 1 kHz, far more than NavDepth frames
+  FmuData Data;
+  uint64_t ReceivedTime_us;                 // GetSensorData returned
+  uint64_t DecodedTime_us;                  // FmuDataView::Decode returned
+  size_t HeldSamples;
+  HeldImuSample Held[MaxHeldSamples];       // oldest first, all before Data
+};
+
+/* Data payload, as received, from the receive thread to the logging thread */
+struct LogFrame {
+  std::vector<uint8_t> Payload;
+};
+
+/* Effector command from the control laws back to the receive thread, which owns the FMU link */
+struct CommandFrame {
+  static const size_t MaxPayloadSize = 256;
+  BfsMessage MessageId;
+  uint16_t PayloadSize;
+  uint8_t Payload[MaxPayloadSize];
+};
+
+/* The flight loop as three stages on their own threads: receive and decode, which
+owns the FMU link; navigation and control; and logging. Stages hand frames on
+through lock-free queues of preallocated frames and never wait on each other, a
+stage that falls behind has frames dropped, and counted, at its queue instead of
+holding up the ones before it. A slow write to the SD card costs log records, not
+navigation updates. A frame dropped on the way to navigation still has its values
+merged into the FMU data, and its update flags and IMU sample are carried on to the
+next frame that gets through, so a GPS fix it brought is not missed and navigation
+integrates across it sample by sample. The receive thread is the one Run is called on and, with the
+navigation thread, keeps its scheduling, real-time if it was entered; the logging
+thread runs time-shared. On the navigation thread a frame scheduler runs the
+navigation, control, telemetry and housekeeping tasks at their configured rates.
+Every frame slot is allocated up front and, after startup, no stage should touch
+the heap: each counts the allocations it makes per frame. */
+class FlightPipeline {
+  public:
+    static const size_t NavDepth = 4;         // frames, navigation should never be more than a frame behind
+    static const size_t LogDepth = 256;       // frames, about half a second of SD card stall at 500 Hz
+    static const size_t CommandDepth = 4;     // commands, the transmit queue coalesces them anyway
+    FlightPipeline(Fmu &FmuRef,Navigation &NavigationRef,ControlLaws &ControlLawsRef,Telemetry &TelemetryRef,Datalogger &DataloggerRef,LoopStats &LoopStatsRef,const FmuData &FmuDataRef,const FmuDataLayout &LayoutRef,const std::vector<TaskConfig> &TasksRef);
+    void Run(const std::string &LoopStatsFile);
+    bool QueueCommand(BfsMessage MessageId,uint16_t PayloadSize,const uint8_t *Payload);
+    uint64_t GetFrames();
+    double GetElapsed_s();
+    void Print(FILE *File);
+    bool AllocationFree();
+    bool WriteStatsFile(const std::string &FileName);
+  private:
+    Fmu &Fmu_;
+    Navigation &Navigation_;
+    ControlLaws &ControlLaws_;
+    Telemetry &Telemetry_;
+    Datalogger &Datalogger_;
+    LoopStats &LoopStats_;
+    const FmuDataLayout &Layout_;
+    SpscQueue<NavFrame> NavQueue_;
+    SpscQueue<LogFrame> LogQueue_;
+    SpscQueue<CommandFrame> CommandQueue_;
+    Doorbell NavBell_;
+    Doorbell LogBell_;
+    Doorbell CommandBell_;
+    std::atomic<bool> Stop_;
+    FrameScheduler Scheduler_;
+    NavFrame *Frame_ = NULL;
+    FmuDataUpdated HeldUpdated_;              // update flags of the frames dropped for navigation since the last one queued
+    bool UpdatesHeld_ = false;
+    HeldImuSample HeldSamples_[NavFrame::MaxHeldSamples];  // IMU samples of the frames dropped for navigation since the last one queued
+    size_t HeldSampleCount_ = 0;
+    uint64_t ImuSamplesHeld_ = 0;
+    uint64_t ImuSamplesLost_ = 0;             // dropped with their frame, more than MaxHeldSamples in a row
+    NavigationData NavData_;
+    LatencyHistogram LogWrite_;
+    AllocationTracer ReceiveAllocations_;
+    AllocationTracer NavigationAllocations_;
+    AllocationTracer LoggingAllocations_;
+    uint64_t Frames_ = 0;
+    uint64_t FirstReceiveTime_us_ = 0;
+    uint64_t LastReceiveTime_us_ = 0;
+    std::string LoopStatsFile_;
+    std::string LoopStatsTempFile_;
+    // stats copied by housekeeping for the logging thread to write, handed over by StatsReady_
+    LoopStats LoopStatsCopy_;
+    std::vector<TaskStats> TaskStatsCopy_;
+    std::atomic<bool> StatsReady_;
+    std::atomic<uint64_t> StatsWritten_;
+    std::atomic<uint64_t> StatsFailed_;
+    void ReceiveStage();
+    void NavigationStage();
+    void LoggingStage();
+    void HoldImuSample(const FmuDataView &DataViewRef);
+    void SendCommands();
+    void NavigationTask();
+    void ControlTask();
+    void TelemetryTask();
+    void HousekeepingTask();
+    bool WriteStats(const std::string &FileName,const std::string &TempName);
+    void PrintQueues(FILE *File);
+    static void PrintQueue(FILE *File,const char *Name,const SpscQueueStats &Stats);
+};
+
+#endif
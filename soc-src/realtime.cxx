@@ -0,0 +1,78 @@
+
+#include "realtime.hxx"
+
+static const size_t PageSize = 4096;
+
+/* Throws the failed step with the reason the kernel gave. */
+static void ThrowErrno(const std::string &Step) {
+  throw std::runtime_error("Real-time mode: " + Step + " failed, " + strerror(errno) + ".");
+}
+
+/* Touches Bytes of stack below the caller, so the pages are mapped, and locked by
+mlockall, before the flight loop needs them. */
+static void PrefaultStack(size_t Bytes) {
+  volatile uint8_t *Stack = (volatile uint8_t *)alloca(Bytes);
+  for (size_t i=0; i < Bytes; i+=PageSize) {
+    Stack[i] = 0;
+  }
+}
+
+/* Grows the heap by Bytes and touches every page, then frees it with trimming and
+mmap turned off, so malloc keeps the pages and hands them out again without faulting. */
+static void PrefaultHeap(size_t Bytes) {
+  if (mallopt(M_TRIM_THRESHOLD,-1) == 0) {
+    throw std::runtime_error("Real-time mode: mallopt(M_TRIM_THRESHOLD) failed.");
+  }
+  if (mallopt(M_MMAP_MAX,0) == 0) {
+    throw std::runtime_error("Real-time mode: mallopt(M_MMAP_MAX) failed.");
+  }
+  volatile uint8_t *Heap = (volatile uint8_t *)malloc(Bytes);
+  if (Heap == NULL) {
+    ThrowErrno("prefaulting the heap");
+  }
+  for (size_t i=0; i < Bytes; i+=PageSize) {
+    Heap[i] = 0;
+  }
+  free((void *)Heap);
+}
+
+/* Locks memory, prefaults the stack and heap, pins the calling thread and makes it SCHED_FIFO. */
+void EnterRealTime(const RealTimeConfig &RealTimeRef) {
+  if (mlockall(MCL_CURRENT|MCL_FUTURE) < 0) {
+    ThrowErrno("mlockall");
+  }
+  PrefaultStack(RealTimeRef.PrefaultStack_kB*1024);
+  PrefaultHeap(RealTimeRef.PrefaultHeap_kB*1024);
+  if (RealTimeRef.Cpu >= 0) {
+    cpu_set_t Cpus;
+    CPU_ZERO(&Cpus);
+    CPU_SET(RealTimeRef.Cpu,&Cpus);
+    if (sched_setaffinity(0,sizeof(Cpus),&Cpus) < 0) {
+      ThrowErrno("pinning to CPU " + std::to_string(RealTimeRef.Cpu));
+    }
+  }
+  struct sched_param Param;
+  memset(&Param,0,sizeof(Param));
+  Param.sched_priority = RealTimeRef.Priority;
+  if (sched_setscheduler(0,SCHED_FIFO,&Param) < 0) {
+    ThrowErrno("SCHED_FIFO at priority " + std::to_string(RealTimeRef.Priority));
+  }
+}
+
+/* Makes the calling thread SCHED_OTHER and lets it run on any CPU, neither of which
+needs privileges. The kernel leaves out any CPU that is not online. */
+void LeaveRealTime() {
+  struct sched_param Param;
+  memset(&Param,0,sizeof(Param));
+  if (sched_setscheduler(0,SCHED_OTHER,&Param) < 0) {
+    ThrowErrno("SCHED_OTHER");
+  }
+  cpu_set_t Cpus;
+  CPU_ZERO(&Cpus);
+  for (int i=0; i < CPU_SETSIZE; i++) {
+    CPU_SET(i,&Cpus);
+  }
+  if (sched_setaffinity(0,sizeof(Cpus),&Cpus) < 0) {
+    ThrowErrno("unpinning from the flight loop CPU");
+  }
+}
@@ -0,0 +1,31 @@
+
+#ifndef REALTIME_HXX_
+#define REALTIME_HXX_
+
+#include "global-defs.hxx"
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <alloca.h>
+#include <malloc.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <string>
+#include <exception>
+#include <stdexcept>
+
+/* Puts the calling thread into real-time execution: all memory locked, current and
+future, so nothing is paged out; the stack and PrefaultHeap_kB of heap touched so
+the flight loop never takes a page fault growing them, with the heap kept rather
+than handed back to the kernel; the thread pinned to Cpu and run under SCHED_FIFO
+at Priority, so only higher priority real-time threads and interrupts preempt it.
+Throws if any step is refused, which without root or CAP_SYS_NICE and
+CAP_IPC_LOCK it is, rather than flying without the mode that was asked for. */
+void EnterRealTime(const RealTimeConfig &RealTimeRef);
+
+/* Returns the calling thread to time-shared scheduling, for threads such as logging
+that must never hold off the flight loop, and unpins it from the flight loop's CPU
+so it can use any other. Memory stays locked. */
+void LeaveRealTime();
+
+#endif
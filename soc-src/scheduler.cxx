@@ -0,0 +1,226 @@
+
+#include "scheduler.hxx"
+
+const size_t FrameScheduler::MaxDivisor;
+const uint64_t FrameScheduler::RecoverRuns;
+const uint64_t FrameScheduler::SlackMargin_us;
+const uint64_t FrameScheduler::LogInterval_us;
+
+FrameScheduler::FrameScheduler() {}
+
+/* Adds a task, tasks run in the order they were added. */
+void FrameScheduler::AddTask(const TaskConfig &Config,const std::function<void()> &Run) {
+  Task NewTask;
+  NewTask.Config = Config;
+  NewTask.Run = Run;
+  NewTask.NextRelease_us = 0;
+  NewTask.Started = false;
+  NewTask.SkipNext = false;
+  NewTask.CleanRuns = 0;
+  NewTask.LastLog_us = 0;
+  NewTask.Pending = 0;
+  NewTask.Stats.Releases = 0;
+  NewTask.Stats.Runs = 0;
+  NewTask.Stats.Skipped = 0;
+  NewTask.Stats.Deferred = 0;
+  NewTask.Stats.Overruns = 0;
+  NewTask.Stats.Divisor = 1;
+  Tasks_.push_back(NewTask);
+}
+
+/* Runs the rate tasks due at Time_us, the FMU time of the frame, which arrived at
+ReceiveTime_us on the monotonic clock. Slack tasks that fall due are left for
+RunSlackTasks. FMU time going backwards, after an FMU reset or a replayed log
+starting over, restarts every task's releases, and the frame period, from the new
+time base as at startup. */
+void FrameScheduler::RunTasks(uint64_t Time_us,uint64_t ReceiveTime_us) {
+  if (Time_us < Time_us_) {
+    for (size_t i=0; i < Tasks_.size(); i++) {
+      Tasks_[i].Started = false;
+    }
+    FramePeriod_us_ = 0;
+  } else if ((Time_us_ > 0)&&(Time_us > Time_us_)) {
+    FramePeriod_us_ = Time_us - Time_us_;
+  }
+  Time_us_ = Time_us;
+  ReceiveTime_us_ = ReceiveTime_us;
+  for (size_t i=0; i < Tasks_.size(); i++) {
+    Task &Current = Tasks_[i];
+    if (!Release(&Current)) {
+      continue;
+    }
+    if (Current.Config.Slack) {
+      Current.Pending++;
+      continue;
+    }
+    if (Current.SkipNext) {
+      Current.SkipNext = false;
+      Current.Stats.Skipped++;
+      continue;
+    }
+    Execute(&Current);
+  }
+}
+
+/* Runs the slack tasks that are due and fit, by the longest each has taken, before
+the next frame is due. A slack task released again while still waiting has been
+put off a whole period, and runs whatever the slack. */
+void FrameScheduler::RunSlackTasks() {
+  if (FramePeriod_us_ == 0) {
+    return;
+  }
+  uint64_t NextFrame_us = ReceiveTime_us_ + FramePeriod_us_;
+  for (size_t i=0; i < Tasks_.size(); i++) {
+    Task &Current = Tasks_[i];
+    if (Current.Pending == 0) {
+      continue;
+    }
+    bool Overdue = Current.Pending > 1;
+    uint64_t Finish_us = LoopStats::GetTime_us() + Current.Stats.Duration.GetMax() + SlackMargin_us;
+    if (!Overdue && (Finish_us > NextFrame_us)) {
+      Current.Stats.Deferred++;
+      continue;
+    }
+    Current.Pending = 0;
+    Execute(&Current);
+  }
+}
+
+/* Returns the counters and timing for the task called Name. */
+TaskStats FrameScheduler::GetStats(const std::string &Name) {
+  for (size_t i=0; i < Tasks_.size(); i++) {
+    if (Tasks_[i].Config.Name == Name) {
+      return Tasks_[i].Stats;
+    }
+  }
+  throw std::runtime_error("Unknown scheduler task " + Name + ".");
+}
+
+/* Copies the counters and timing of every task, in the order they were added, into
+Stats, which allocates only the first time. */
+void FrameScheduler::GetStats(std::vector<TaskStats> *StatsPtr) {
+  StatsPtr->resize(Tasks_.size());
+  for (size_t i=0; i < Tasks_.size(); i++) {
+    (*StatsPtr)[i] = Tasks_[i].Stats;
+  }
+}
+
+/* Prints the task counters and timing tables. */
+void FrameScheduler::Print(FILE *File) {
+  std::vector<TaskStats> Stats;
+  GetStats(&Stats);
+  Print(File,Stats);
+}
+
+/* Prints the tables from counters and timing GetStats copied, so they can be printed
+on another thread while the tasks run. The task configs never change once added. */
+void FrameScheduler::Print(FILE *File,const std::vector<TaskStats> &StatsRef) {
+  fprintf(File,"%-12s %10s %10s %10s %10s %10s %10s %10s\n","task","rate, Hz","releases","runs","skipped","deferred","overruns","divisor");
+  for (size_t i=0; i < StatsRef.size(); i++) {
+    const TaskStats &Stats = StatsRef[i];
+    fprintf(File,"%-12s %10.1f %10llu %10llu %10llu %10llu %10llu %10zu\n",Tasks_[i].Config.Name.c_str(),Tasks_[i].Config.Rate_hz,
+      (unsigned long long)Stats.Releases,(unsigned long long)Stats.Runs,(unsigned long long)Stats.Skipped,
+      (unsigned long long)Stats.Deferred,(unsigned long long)Stats.Overruns,Stats.Divisor);
+  }
+  fprintf(File,"%-12s %10s %10s %10s %10s %10s %10s\n","task run, us","count","mean","p50","p99","p99.9","max");
+  for (size_t i=0; i < StatsRef.size(); i++) {
+    LoopStats::PrintHistogram(File,Tasks_[i].Config.Name.c_str(),StatsRef[i].Duration);
+  }
+  fprintf(File,"%-12s %10s %10s %10s %10s %10s %10s\n","finish, us","count","mean","p50","p99","p99.9","max");
+  for (size_t i=0; i < StatsRef.size(); i++) {
+    LoopStats::PrintHistogram(File,Tasks_[i].Config.Name.c_str(),StatsRef[i].Finish);
+  }
+}
+
+/* Returns true if the task falls due on this frame. Its period is its rate, or the
+frame period for a task run every frame, times the divisor while it is degraded.
+A release within half a frame counts, so FMU time jitter does not slip a task a
+frame, and a task that has fallen a whole period behind, over a gap in the data,
+starts again from now rather than running to catch up. */
+bool FrameScheduler::Release(Task *TaskPtr) {
+  double Period_us = (TaskPtr->Config.Rate_hz > 0) ? 1e6/TaskPtr->Config.Rate_hz : FramePeriod_us_;
+  uint64_t Period = (uint64_t)(Period_us*TaskPtr->Stats.Divisor);
+  if (!TaskPtr->Started) {
+    TaskPtr->Started = true;
+    TaskPtr->NextRelease_us = Time_us_ + Period;
+  } else if (Time_us_ + FramePeriod_us_/2 >= TaskPtr->NextRelease_us) {
+    TaskPtr->NextRelease_us += Period;
+    if (TaskPtr->NextRelease_us + FramePeriod_us_/2 <= Time_us_) {
+      TaskPtr->NextRelease_us = Time_us_ + Period;
+    }
+  } else {
+    return false;
+  }
+  TaskPtr->Stats.Releases++;
+  return true;
+}
+
+/* Runs a task, times it and applies its overrun policy. */
+void FrameScheduler::Execute(Task *TaskPtr) {
+  uint64_t Start_us = LoopStats::GetTime_us();
+  TaskPtr->Run();
+  uint64_t End_us = LoopStats::GetTime_us();
+  TaskStats &Stats = TaskPtr->Stats;
+  Stats.Runs++;
+  Stats.Duration.Record(End_us - Start_us);
+  Stats.Finish.Record(End_us - ReceiveTime_us_);
+  if (TaskPtr->Config.Deadline_us == 0) {
+    return;
+  }
+  if (End_us - ReceiveTime_us_ <= TaskPtr->Config.Deadline_us) {
+    if ((Stats.Divisor > 1)&&(++TaskPtr->CleanRuns >= RecoverRuns)) {
+      Stats.Divisor /= 2;
+      TaskPtr->CleanRuns = 0;
+    }
+    return;
+  }
+  Stats.Overruns++;
+  TaskPtr->CleanRuns = 0;
+  switch (TaskPtr->Config.Overrun) {
+    case kSkipOnOverrun:
+      TaskPtr->SkipNext = true;
+      break;
+    case kDegradeOnOverrun:
+      if (Stats.Divisor < MaxDivisor) {
+        Stats.Divisor *= 2;
+      }
+      break;
+    case kLogOnOverrun:
+      if ((Stats.Overruns == 1)||(Time_us_ - TaskPtr->LastLog_us >= LogInterval_us)) {
+        fprintf(stderr,"%s finished %llu us after the frame, deadline %llu us, %llu overruns\n",TaskPtr->Config.Name.c_str(),
+          (unsigned long long)(End_us - ReceiveTime_us_),(unsigned long long)TaskPtr->Config.Deadline_us,(unsigned long long)Stats.Overruns);
+        TaskPtr->LastLog_us = Time_us_;
+      }
+      break;
+  }
+}
+
+/* Returns the overrun policy given its name in the configuration: Skip, Degrade or Log. */
+OverrunPolicy GetOverrunPolicy(const std::string &Name) {
+  if (Name == "Skip") {
+    return kSkipOnOverrun;
+  }
+  if (Name == "Degrade") {
+    return kDegradeOnOverrun;
+  }
+  if (Name == "Log") {
+    return kLogOnOverrun;
+  }
+  throw std::runtime_error("Unknown overrun policy " + Name + ".");
+}
+
+/* Returns the tasks the flight loop runs when the configuration does not say:
+navigation and control every frame with no deadline, telemetry at 10 Hz and
+housekeeping once a second, both in slack. */
+std::vector<TaskConfig> GetDefaultTasks() {
+  std::vector<TaskConfig> Tasks;
+  TaskConfig Navigation = {"Navigation",0.0,0,kLogOnOverrun,false};
+  TaskConfig Control = {"Control",0.0,0,kLogOnOverrun,false};
+  TaskConfig Telemetry = {"Telemetry",10.0,0,kLogOnOverrun,true};
+  TaskConfig Housekeeping = {"Housekeeping",1.0,0,kLogOnOverrun,true};
+  Tasks.push_back(Navigation);
+  Tasks.push_back(Control);
+  Tasks.push_back(Telemetry);
+  Tasks.push_back(Housekeeping);
+  return Tasks;
+}
@@ -0,0 +1,72 @@
+
+#ifndef SCHEDULER_HXX_
+#define SCHEDULER_HXX_
+
+#include "global-defs.hxx"
+#include "loop-stats.hxx"
+#include <stdio.h>
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include <exception>
+#include <stdexcept>
+
+/* Counters and timing for one task */
+struct TaskStats {
+  uint64_t Releases;                        // Number of times the task fell due
+  uint64_t Runs;                            // Number of times it ran
+  uint64_t Skipped;                         // Releases skipped after an overrun
+  uint64_t Deferred;                        // Frames a due slack task waited for lack of slack
+  uint64_t Overruns;                        // Runs that finished past the deadline
+  size_t Divisor;                           // Rate divisor, over 1 while degraded
+  LatencyHistogram Duration;                // Time the task ran, us
+  LatencyHistogram Finish;                  // Time from the frame being received to the task finishing, us
+};
+
+/* Runs the flight loop's tasks at fixed rates of FMU time. Every frame the rate
+tasks that are due run in order, each released on the FMU Time_us so their rates
+hold however the frames arrive, then the slack tasks that are due run if the
+longest each has taken still fits before the next frame is due; otherwise they
+wait for a frame with more slack. A task with a deadline that finishes past it,
+counted from the frame being received, has its overrun policy applied: skip its
+next release, halve its rate until it has kept its deadline RecoverRuns times in
+a row, or just log it. */
+class FrameScheduler {
+  public:
+    static const size_t MaxDivisor = 8;
+    static const uint64_t RecoverRuns = 100;
+    static const uint64_t SlackMargin_us = 100;
+    static const uint64_t LogInterval_us = 1000000;
+    FrameScheduler();
+    void AddTask(const TaskConfig &Config,const std::function<void()> &Run);
+    void RunTasks(uint64_t Time_us,uint64_t ReceiveTime_us);
+    void RunSlackTasks();
+    TaskStats GetStats(const std::string &Name);
+    void GetStats(std::vector<TaskStats> *StatsPtr);
+    void Print(FILE *File);
+    void Print(FILE *File,const std::vector<TaskStats> &StatsRef);
+  private:
+    struct Task {
+      TaskConfig Config;
+      std::function<void()> Run;
+      uint64_t NextRelease_us;
+      bool Started;
+      bool SkipNext;
+      uint64_t CleanRuns;
+      uint64_t LastLog_us;
+      uint64_t Pending;                     // releases of a slack task since it last ran
+      TaskStats Stats;
+    };
+    std::vector<Task> Tasks_;
+    uint64_t Time_us_ = 0;
+    uint64_t ReceiveTime_us_ = 0;
+    uint64_t FramePeriod_us_ = 0;
+    bool Release(Task *TaskPtr);
+    void Execute(Task *TaskPtr);
+};
+
+OverrunPolicy GetOverrunPolicy(const std::string &Name);
+std::vector<TaskConfig> GetDefaultTasks();
+
+#endif
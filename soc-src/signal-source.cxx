@@ -0,0 +1,161 @@
+
+#include "signal-source.hxx"
+
+/* Where a signal source is read from */
+enum SignalSourceType {
+  kAccelSource,
+  kGyroSource,
+  kMagSource,
+  kBme280PressureSource,
+  kInceptorSource,
+  kAuxInputSource,
+  kAutoEnabledSource,
+  kThrottleEnabledSource,
+  kFailsafeSource,
+  kStaticPressureSource,
+  kDiffPressureSource,
+  kAnalogSource,
+  kEulerSource,
+  kNedVelocitySource,
+  kLlaSource,
+  kGyroBiasSource,
+  kUplinkSource
+};
+
+/* Returns true if Text is a whole number below Limit, which it stores in IndexPtr. */
+static bool ParseIndex(const std::string &Text,size_t Limit,uint16_t *IndexPtr) {
+  char *End;
+  unsigned long Index = strtoul(Text.c_str(),&End,10);
+  if ((Text.size() == 0)||(*End != '\0')||(Index >= Limit)) {
+    return false;
+  }
+  *IndexPtr = (uint16_t)Index;
+  return true;
+}
+
+/* Resolves a signal source name, returns false if it names no source in this
+configuration. */
+bool ParseSignalSource(const std::string &Name,const FmuData &FmuDataRef,SignalSource *SignalSourcePtr) {
+  std::vector<std::string> Path;
+  size_t Begin = 0;
+  size_t End;
+  while ((End = Name.find('/',Begin)) != std::string::npos) {
+    Path.push_back(Name.substr(Begin,End-Begin));
+    Begin = End + 1;
+  }
+  Path.push_back(Name.substr(Begin));
+  uint16_t In[3] = {0,0,0};
+  bool Valid = false;
+  if ((Path[0] == "Mpu9250")&&(Path.size() == 3)&&ParseIndex(Path[2],3,&In[2])) {
+    Valid = true;
+    if (Path[1] == "Accel_mss") {
+      In[0] = kAccelSource;
+    } else if (Path[1] == "Gyro_rads") {
+      In[0] = kGyroSource;
+    } else if (Path[1] == "Mag_uT") {
+      In[0] = kMagSource;
+    } else {
+      Valid = false;
+    }
+  } else if ((Path[0] == "Bme280")&&(Path.size() == 2)&&(Path[1] == "Pressure_Pa")) {
+    In[0] = kBme280PressureSource;
+    Valid = true;
+  } else if ((Path[0] == "SbusRx")&&(Path.size() >= 3)&&ParseIndex(Path[1],FmuDataRef.SbusRx.size(),&In[1])) {
+    if (Path.size() == 4) {
+      Valid = ParseIndex(Path[3],5,&In[2]);
+      if (Path[2] == "Inceptors") {
+        In[0] = kInceptorSource;
+      } else if (Path[2] == "AuxInputs") {
+        In[0] = kAuxInputSource;
+      } else {
+        Valid = false;
+      }
+    } else if (Path.size() == 3) {
+      Valid = true;
+      if (Path[2] == "AutoEnabled") {
+        In[0] = kAutoEnabledSource;
+      } else if (Path[2] == "ThrottleEnabled") {
+        In[0] = kThrottleEnabledSource;
+      } else if (Path[2] == "Failsafe") {
+        In[0] = kFailsafeSource;
+      } else {
+        Valid = false;
+      }
+    }
+  } else if ((Path[0] == "Pitot")&&(Path.size() == 4)&&ParseIndex(Path[1],FmuDataRef.Pitot.size(),&In[1])&&(Path[3] == "Pressure_Pa")) {
+    Valid = true;
+    if (Path[2] == "Static") {
+      In[0] = kStaticPressureSource;
+    } else if (Path[2] == "Diff") {
+      In[0] = kDiffPressureSource;
+    } else {
+      Valid = false;
+    }
+  } else if ((Path[0] == "Analog")&&(Path.size() == 3)&&ParseIndex(Path[1],FmuDataRef.Analog.size(),&In[1])&&(Path[2] == "CalValue")) {
+    In[0] = kAnalogSource;
+    Valid = true;
+  } else if ((Path[0] == "Nav")&&(Path.size() == 3)&&ParseIndex(Path[2],3,&In[2])) {
+    Valid = true;
+    if (Path[1] == "Euler_rad") {
+      In[0] = kEulerSource;
+    } else if (Path[1] == "NEDVelocity_ms") {
+      In[0] = kNedVelocitySource;
+    } else if (Path[1] == "LLA") {
+      In[0] = kLlaSource;
+    } else if (Path[1] == "GyroBias_rads") {
+      In[0] = kGyroBiasSource;
+    } else {
+      Valid = false;
+    }
+  } else if ((Path[0] == "Uplink")&&(Path.size() == 2)&&ParseIndex(Path[1],MaxUplinkValues,&In[2])) {
+    In[0] = kUplinkSource;
+    Valid = true;
+  }
+  SignalSourcePtr->Source = In[0];
+  SignalSourcePtr->Sensor = In[1];
+  SignalSourcePtr->Component = In[2];
+  return Valid;
+}
+
+/* Reads a signal source. Uplink holds the values set by the ground station, or is
+NULL when there is no ground station and they read as zero. */
+float ReadSignalSource(const SignalSource &SignalSourceRef,const FmuData &FmuDataRef,const NavigationData &NavigationDataRef,const float *Uplink) {
+  const uint16_t In[3] = {SignalSourceRef.Source,SignalSourceRef.Sensor,SignalSourceRef.Component};
+  switch (In[0]) {
+    case kAccelSource:
+      return FmuDataRef.Mpu9250.Accel_mss(In[2]);
+    case kGyroSource:
+      return FmuDataRef.Mpu9250.Gyro_rads(In[2]);
+    case kMagSource:
+      return FmuDataRef.Mpu9250.Mag_uT(In[2]);
+    case kBme280PressureSource:
+      return FmuDataRef.Bme280.Pressure_Pa;
+    case kInceptorSource:
+      return FmuDataRef.SbusRx[In[1]].Inceptors(In[2]);
+    case kAuxInputSource:
+      return FmuDataRef.SbusRx[In[1]].AuxInputs(In[2]);
+    case kAutoEnabledSource:
+      return FmuDataRef.SbusRx[In[1]].AutoEnabled ? 1.0f : 0.0f;
+    case kThrottleEnabledSource:
+      return FmuDataRef.SbusRx[In[1]].ThrottleEnabled ? 1.0f : 0.0f;
+    case kFailsafeSource:
+      return FmuDataRef.SbusRx[In[1]].Failsafe ? 1.0f : 0.0f;
+    case kStaticPressureSource:
+      return FmuDataRef.Pitot[In[1]].Static.Pressure_Pa;
+    case kDiffPressureSource:
+      return FmuDataRef.Pitot[In[1]].Diff.Pressure_Pa;
+    case kAnalogSource:
+      return FmuDataRef.Analog[In[1]].CalValue;
+    case kEulerSource:
+      return NavigationDataRef.Euler_rad[In[2]];
+    case kNedVelocitySource:
+      return NavigationDataRef.NEDVelocity_ms[In[2]];
+    case kLlaSource:
+      return NavigationDataRef.LLA[In[2]];
+    case kGyroBiasSource:
+      return NavigationDataRef.GyroBias_rads[In[2]];
+    case kUplinkSource:
+      return (Uplink != NULL) ? Uplink[In[2]] : 0.0f;
+  }
+  return 0.0f;
+}
@@ -0,0 +1,25 @@
+
+#ifndef SIGNAL_SOURCE_HXX_
+#define SIGNAL_SOURCE_HXX_
+
+#include "global-defs.hxx"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+static const size_t MaxUplinkValues = 8;    // values the ground station can set, Uplink/0 to Uplink/7
+
+/* A value read from the FMU data, the navigation solution or the ground station by
+name, such as "Mpu9250/Gyro_rads/0", "SbusRx/0/AutoEnabled", "Nav/Euler_rad/1" or
+"Uplink/0". Names are resolved once, reading is a switch on Source. */
+struct SignalSource {
+  uint16_t Source;
+  uint16_t Sensor;                          // which of several sensors of the type
+  uint16_t Component;                       // which axis or element
+};
+
+bool ParseSignalSource(const std::string &Name,const FmuData &FmuDataRef,SignalSource *SignalSourcePtr);
+float ReadSignalSource(const SignalSource &SignalSourceRef,const FmuData &FmuDataRef,const NavigationData &NavigationDataRef,const float *Uplink);
+
+#endif
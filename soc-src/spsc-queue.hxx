@@ -0,0 +1,89 @@
+
+#ifndef SPSC_QUEUE_HXX_
+#define SPSC_QUEUE_HXX_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include <exception>
+#include <stdexcept>
+
+/* Counters from a queue, readable from any thread while it runs */
+struct SpscQueueStats {
+  size_t Capacity;                          // Number of slots
+  uint64_t Pushed;                          // Number of frames queued
+  uint64_t Dropped;                         // Number of frames dropped because the queue was full
+  size_t Depth;                             // Number of frames waiting now
+  size_t MaxDepth;                          // Most frames ever waiting at once
+};
+
+/* Bounded lock-free queue from one producer thread to one consumer thread. Every
+slot is allocated up front as a copy of a prototype, so its buffers are sized once,
+and the producer fills a slot in place rather than copying a finished frame in. A
+full queue never blocks the producer: the frame is dropped and counted. Head and
+tail only ever count up, the slot is the count masked by the capacity, which must
+be a power of 2. The two counts sit on their own cache lines so the threads do not
+contend for one. */
+template <typename T> class SpscQueue {
+  public:
+    SpscQueue(size_t Capacity,const T &Prototype) : Slots_(Capacity,Prototype), Mask_(Capacity-1), Head_(0), Tail_(0), Dropped_(0), MaxDepth_(0) {
+      if ((Capacity == 0)||((Capacity & Mask_) != 0)) {
+        throw std::runtime_error("Queue capacity must be a power of 2.");
+      }
+    }
+    /* Returns the slot to fill next, or NULL if the queue is full, counting a drop. Producer only. */
+    T *BeginPush() {
+      size_t Tail = Tail_.load(std::memory_order_relaxed);
+      if (Tail - Head_.load(std::memory_order_acquire) > Mask_) {
+        Dropped_.store(Dropped_.load(std::memory_order_relaxed)+1,std::memory_order_relaxed);
+        return NULL;
+      }
+      return &Slots_[Tail & Mask_];
+    }
+    /* Hands the slot BeginPush returned to the consumer. Producer only. */
+    void CommitPush() {
+      size_t Tail = Tail_.load(std::memory_order_relaxed) + 1;
+      Tail_.store(Tail,std::memory_order_release);
+      size_t Depth = Tail - Head_.load(std::memory_order_acquire);
+      if (Depth > MaxDepth_.load(std::memory_order_relaxed)) {
+        MaxDepth_.store(Depth,std::memory_order_relaxed);
+      }
+    }
+    /* Returns the oldest frame, or NULL if the queue is empty. Consumer only. */
+    T *Front() {
+      size_t Head = Head_.load(std::memory_order_relaxed);
+      if (Head == Tail_.load(std::memory_order_acquire)) {
+        return NULL;
+      }
+      return &Slots_[Head & Mask_];
+    }
+    /* Hands the slot Front returned back to the producer. Consumer only. */
+    void Pop() {
+      Head_.store(Head_.load(std::memory_order_relaxed)+1,std::memory_order_release);
+    }
+    /* Returns the counters. */
+    SpscQueueStats GetStats() const {
+      SpscQueueStats Stats;
+      size_t Tail = Tail_.load(std::memory_order_acquire);
+      Stats.Capacity = Slots_.size();
+      Stats.Pushed = Tail;
+      Stats.Dropped = Dropped_.load(std::memory_order_relaxed);
+      Stats.Depth = Tail - Head_.load(std::memory_order_acquire);
+      Stats.MaxDepth = MaxDepth_.load(std::memory_order_relaxed);
+      return Stats;
+    }
+  private:
+    static const size_t CacheLine_ = 64;
+    std::vector<T> Slots_;
+    const size_t Mask_;
+    char HeadPad_[CacheLine_];
+    std::atomic<size_t> Head_;              // next slot the consumer reads, consumer writes
+    char TailPad_[CacheLine_];
+    std::atomic<size_t> Tail_;              // next slot the producer fills, producer writes
+    std::atomic<uint64_t> Dropped_;         // producer writes
+    std::atomic<size_t> MaxDepth_;          // producer writes
+    char EndPad_[CacheLine_];
+};
+
+#endif
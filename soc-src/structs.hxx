@@ -22,6 +22,14 @@ struct IMUdata {
     double temp;		// C
 };
 
+/// IMU increments over an interval, pre-integrated from every sample in it
+struct IMUincrement {
+    double time;		// seconds, end of the interval
+    double dt;			// seconds
+    double dtheta[3];		// rad, rotation vector over the interval, coning compensated
+    double dvel[3];		// m/sec, velocity change over the interval, sculling compensated
+};
+
 struct GPSdata {
     double time;		// seconds
     double lat, lon, alt;	// rad, meter
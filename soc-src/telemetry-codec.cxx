@@ -0,0 +1,246 @@
+
+#include "telemetry-codec.hxx"
+
+/* Little endian writes and reads, packets are laid out byte by byte whatever the host */
+static void Put16(uint8_t *Bytes,uint16_t Value) {
+  Bytes[0] = Value & 0xff;
+  Bytes[1] = Value >> 8;
+}
+
+static void Put32(uint8_t *Bytes,uint32_t Value) {
+  Put16(Bytes,Value & 0xffff);
+  Put16(Bytes+2,Value >> 16);
+}
+
+static uint16_t Get16(const uint8_t *Bytes) {
+  return Bytes[0] | (Bytes[1] << 8);
+}
+
+static uint32_t Get32(const uint8_t *Bytes) {
+  return Get16(Bytes) | ((uint32_t)Get16(Bytes+2) << 16);
+}
+
+/* Returns Value rounded to the nearest integer and held to the range of an int16,
+NaN is sent as the otherwise unused -32768. */
+static int16_t ToInt16(double Value) {
+  if (Value != Value) {
+    return -32768;
+  }
+  return (int16_t)lround(std::max(-32767.0,std::min(32767.0,Value)));
+}
+
+/* Returns a value sent by ToInt16 divided by Scale. */
+static float FromInt16(int16_t Value,float Scale) {
+  return (Value == -32768) ? NAN : Value/Scale;
+}
+
+/* Parses the "Telemetry" object of the aircraft configuration. Channels are signal
+sources, by name or as {"Name","Scale"} to send them as 16 bit integers of value
+times Scale rather than as half floats. */
+void ParseTelemetryConfig(const rapidjson::Value &TelemetryNode,TelemetryConfig *TelemetryConfigPtr) {
+  assert(TelemetryNode.IsObject());
+  TelemetryConfigPtr->Enabled = true;
+  if (TelemetryNode.HasMember("Enable")) {
+    TelemetryConfigPtr->Enabled = TelemetryNode["Enable"].GetBool();
+  }
+  if (TelemetryNode.HasMember("GroundAddress")) {
+    TelemetryConfigPtr->GroundAddress = TelemetryNode["GroundAddress"].GetString();
+  }
+  if (TelemetryNode.HasMember("GroundPort")) {
+    TelemetryConfigPtr->GroundPort = TelemetryNode["GroundPort"].GetUint();
+  }
+  if (TelemetryNode.HasMember("Port")) {
+    TelemetryConfigPtr->Port = TelemetryNode["Port"].GetUint();
+  }
+  TelemetryConfigPtr->Channels.clear();
+  if (TelemetryNode.HasMember("Channels")) {
+    const rapidjson::Value& Channels = TelemetryNode["Channels"];
+    assert(Channels.IsArray());
+    for (size_t i=0; i < Channels.Size(); i++) {
+      TelemetryChannel Channel = {"",0.0f};
+      if (Channels[i].IsString()) {
+        Channel.Name = Channels[i].GetString();
+      } else {
+        assert(Channels[i].HasMember("Name"));
+        Channel.Name = Channels[i]["Name"].GetString();
+        if (Channels[i].HasMember("Scale")) {
+          Channel.Scale = Channels[i]["Scale"].GetDouble();
+        }
+      }
+      TelemetryConfigPtr->Channels.push_back(Channel);
+    }
+  }
+  if (TelemetryConfigPtr->Channels.size() > MaxTelemetryChannels) {
+    throw std::runtime_error("Too many telemetry channels, at most " + std::to_string(MaxTelemetryChannels) + " fit in a packet.");
+  }
+}
+
+/* Packs a sample into Packet, which must hold MaxTelemetryPacketSize bytes, and
+returns its size. */
+size_t EncodeTelemetrySample(const TelemetrySample &SampleRef,const std::vector<TelemetryChannel> &ChannelsRef,uint8_t *Packet) {
+  Packet[0] = TelemetryMagic;
+  Packet[1] = kTelemetrySample;
+  Put16(Packet+2,SampleRef.Sequence);
+  Put32(Packet+4,SampleRef.Time_ms);
+  Packet[8] = SampleRef.NavValid ? NavValidFlag : 0;
+  Packet[9] = SampleRef.NumberChannels;
+  uint8_t *Bytes = Packet + TelemetryHeaderSize;
+  if (SampleRef.NavValid) {
+    Put32(Bytes,(uint32_t)(int32_t)llround(SampleRef.LLA[0]*180.0/M_PI*1e7));
+    Put32(Bytes+4,(uint32_t)(int32_t)llround(SampleRef.LLA[1]*180.0/M_PI*1e7));
+    Put16(Bytes+8,(uint16_t)lround(std::max(0.0,std::min(65535.0,(SampleRef.LLA[2] + 1000.0)*10.0))));
+    for (size_t i=0; i < 3; i++) {
+      Put16(Bytes+10+2*i,ToInt16(SampleRef.NEDVelocity_ms[i]*100.0));
+      Put16(Bytes+16+2*i,ToInt16(SampleRef.Euler_rad[i]*1e4));
+    }
+    Bytes += TelemetryNavSize;
+  }
+  for (size_t i=0; i < SampleRef.NumberChannels; i++) {
+    if (ChannelsRef[i].Scale != 0.0f) {
+      Put16(Bytes,ToInt16((double)SampleRef.Channels[i]*ChannelsRef[i].Scale));
+    } else {
+      Put16(Bytes,FloatToHalf(SampleRef.Channels[i]));
+    }
+    Bytes += 2;
+  }
+  return Bytes - Packet;
+}
+
+/* Unpacks a sample, returns false if the packet is not a sample of the configured channels. */
+bool DecodeTelemetrySample(const uint8_t *Packet,size_t PacketSize,const std::vector<TelemetryChannel> &ChannelsRef,TelemetrySample *SamplePtr) {
+  if ((PacketSize < TelemetryHeaderSize)||(Packet[0] != TelemetryMagic)||(Packet[1] != kTelemetrySample)) {
+    return false;
+  }
+  SamplePtr->Sequence = Get16(Packet+2);
+  SamplePtr->Time_ms = Get32(Packet+4);
+  SamplePtr->NavValid = (Packet[8] & NavValidFlag) != 0;
+  SamplePtr->NumberChannels = Packet[9];
+  size_t Expected = TelemetryHeaderSize + (SamplePtr->NavValid ? TelemetryNavSize : 0) + 2*SamplePtr->NumberChannels;
+  if ((PacketSize != Expected)||(SamplePtr->NumberChannels != ChannelsRef.size())) {
+    return false;
+  }
+  const uint8_t *Bytes = Packet + TelemetryHeaderSize;
+  if (SamplePtr->NavValid) {
+    SamplePtr->LLA[0] = (int32_t)Get32(Bytes)*1e-7*M_PI/180.0;
+    SamplePtr->LLA[1] = (int32_t)Get32(Bytes+4)*1e-7*M_PI/180.0;
+    SamplePtr->LLA[2] = Get16(Bytes+8)*0.1 - 1000.0;
+    for (size_t i=0; i < 3; i++) {
+      SamplePtr->NEDVelocity_ms[i] = FromInt16(Get16(Bytes+10+2*i),100.0f);
+      SamplePtr->Euler_rad[i] = FromInt16(Get16(Bytes+16+2*i),1e4f);
+    }
+    Bytes += TelemetryNavSize;
+  }
+  for (size_t i=0; i < SamplePtr->NumberChannels; i++) {
+    if (ChannelsRef[i].Scale != 0.0f) {
+      SamplePtr->Channels[i] = FromInt16(Get16(Bytes),ChannelsRef[i].Scale);
+    } else {
+      SamplePtr->Channels[i] = HalfToFloat(Get16(Bytes));
+    }
+    Bytes += 2;
+  }
+  return true;
+}
+
+/* Packs an uplink command, returns its size. */
+size_t EncodeUplinkCommand(const UplinkCommand &CommandRef,uint8_t *Packet) {
+  Packet[0] = TelemetryMagic;
+  Packet[1] = CommandRef.Type;
+  Put16(Packet+2,CommandRef.Sequence);
+  Packet[4] = CommandRef.Index;
+  uint32_t Value;
+  memcpy(&Value,&CommandRef.Value,sizeof(Value));
+  Put32(Packet+5,Value);
+  return UplinkCommandSize;
+}
+
+/* Unpacks an uplink command, returns false if the packet is not one. */
+bool DecodeUplinkCommand(const uint8_t *Packet,size_t PacketSize,UplinkCommand *CommandPtr) {
+  if ((PacketSize != UplinkCommandSize)||(Packet[0] != TelemetryMagic)) {
+    return false;
+  }
+  if ((Packet[1] != kUplinkPing)&&(Packet[1] != kUplinkSetValue)) {
+    return false;
+  }
+  CommandPtr->Type = Packet[1];
+  CommandPtr->Sequence = Get16(Packet+2);
+  CommandPtr->Index = Packet[4];
+  uint32_t Value = Get32(Packet+5);
+  memcpy(&CommandPtr->Value,&Value,sizeof(Value));
+  return true;
+}
+
+/* Packs an acknowledgement, returns its size. */
+size_t EncodeTelemetryAck(const TelemetryAck &AckRef,uint8_t *Packet) {
+  Packet[0] = TelemetryMagic;
+  Packet[1] = kTelemetryAck;
+  Put16(Packet+2,AckRef.Sequence);
+  Packet[4] = AckRef.Status;
+  return TelemetryAckSize;
+}
+
+/* Unpacks an acknowledgement, returns false if the packet is not one. */
+bool DecodeTelemetryAck(const uint8_t *Packet,size_t PacketSize,TelemetryAck *AckPtr) {
+  if ((PacketSize != TelemetryAckSize)||(Packet[0] != TelemetryMagic)||(Packet[1] != kTelemetryAck)) {
+    return false;
+  }
+  AckPtr->Sequence = Get16(Packet+2);
+  AckPtr->Status = Packet[4];
+  return true;
+}
+
+/* Returns Value as an IEEE 754 half float, rounded to nearest even. Values too
+large for a half become infinite, ones too small become zero or subnormal. */
+uint16_t FloatToHalf(float Value) {
+  uint32_t Bits;
+  memcpy(&Bits,&Value,sizeof(Bits));
+  uint16_t Sign = (Bits >> 16) & 0x8000;
+  uint32_t FloatExponent = (Bits >> 23) & 0xff;
+  uint32_t Mantissa = Bits & 0x7fffff;
+  if (FloatExponent == 0xff) {
+    return Sign | 0x7c00 | ((Mantissa != 0) ? 0x200 : 0);
+  }
+  int32_t Exponent = (int32_t)FloatExponent - 127 + 15;
+  if (Exponent >= 31) {
+    return Sign | 0x7c00;
+  }
+  if (Exponent <= 0) {
+    if (Exponent < -10) {
+      return Sign;
+    }
+    Mantissa |= 0x800000;
+    uint32_t Shift = 14 - Exponent;
+    uint32_t Half = Mantissa >> Shift;
+    uint32_t Rest = Mantissa & ((1u << Shift) - 1);
+    uint32_t Midpoint = 1u << (Shift - 1);
+    if ((Rest > Midpoint)||((Rest == Midpoint)&&(Half & 1))) {
+      Half++;
+    }
+    return Sign | Half;
+  }
+  // a carry out of the mantissa rounds up into the exponent, and on to infinity, as it should
+  uint32_t Half = ((uint32_t)Exponent << 10) | (Mantissa >> 13);
+  uint32_t Rest = Mantissa & 0x1fff;
+  if ((Rest > 0x1000)||((Rest == 0x1000)&&(Half & 1))) {
+    Half++;
+  }
+  return Sign | Half;
+}
+
+/* Returns an IEEE 754 half float as a float, exactly. */
+float HalfToFloat(uint16_t Half) {
+  uint32_t Sign = (uint32_t)(Half & 0x8000) << 16;
+  uint32_t Exponent = (Half >> 10) & 0x1f;
+  uint32_t Mantissa = Half & 0x3ff;
+  uint32_t Bits;
+  if (Exponent == 0) {
+    float Value = ldexpf((float)Mantissa,-24);
+    return Sign ? -Value : Value;
+  } else if (Exponent == 31) {
+    Bits = Sign | 0x7f800000 | (Mantissa << 13);
+  } else {
+    Bits = Sign | ((Exponent + 112) << 23) | (Mantissa << 13);
+  }
+  float Value;
+  memcpy(&Value,&Bits,sizeof(Value));
+  return Value;
+}
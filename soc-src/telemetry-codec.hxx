@@ -0,0 +1,74 @@
+
+#ifndef TELEMETRY_CODEC_HXX_
+#define TELEMETRY_CODEC_HXX_
+
+#include "global-defs.hxx"
+#include "signal-source.hxx"
+#include "../soc-includes/rapidjson/document.h"
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+/* Telemetry and uplink message types, the second byte of every packet */
+enum TelemetryMessage {
+  kTelemetrySample = 1,                     // aircraft to ground, navigation solution and channels
+  kTelemetryAck = 2,                        // aircraft to ground, answer to an uplink command
+  kUplinkPing = 3,                          // ground to aircraft, acknowledged and nothing else
+  kUplinkSetValue = 4                       // ground to aircraft, sets one of the Uplink/i signal sources
+};
+
+static const uint8_t TelemetryMagic = 0xb7;
+static const size_t TelemetryHeaderSize = 10;       // magic, type, sequence, time, flags, channels
+static const size_t TelemetryNavSize = 22;          // latitude, longitude, altitude, velocity, attitude
+static const size_t MaxTelemetryChannels = 64;
+static const size_t MaxTelemetryPacketSize = TelemetryHeaderSize + TelemetryNavSize + 2*MaxTelemetryChannels;
+static const size_t UplinkCommandSize = 9;          // magic, type, sequence, index, value
+static const size_t TelemetryAckSize = 5;           // magic, type, sequence of the command, status
+static const uint8_t NavValidFlag = 0x01;
+
+/* One telemetry sample, as sent: the navigation solution only once it is valid, at
+the resolution it is sent with, and the configured channels in order. Latitude and
+longitude go as 1e-7 deg, altitude as 0.1 m from -1000 m, velocity as cm/s and the
+Euler angles as 1e-4 rad. */
+struct TelemetrySample {
+  uint16_t Sequence;
+  uint32_t Time_ms;                         // FMU time, wraps after 49 days
+  bool NavValid;
+  double LLA[3];                            // Latitude (rad), Longitude (rad), Altitude (m)
+  float NEDVelocity_ms[3];
+  float Euler_rad[3];
+  size_t NumberChannels;
+  float Channels[MaxTelemetryChannels];
+};
+
+/* Command from the ground station, Index and Value are only used by kUplinkSetValue */
+struct UplinkCommand {
+  uint8_t Type;
+  uint16_t Sequence;
+  uint8_t Index;
+  float Value;
+};
+
+/* Answer to an uplink command, Status is 0 if it was carried out */
+struct TelemetryAck {
+  uint16_t Sequence;
+  uint8_t Status;
+};
+
+void ParseTelemetryConfig(const rapidjson::Value &TelemetryNode,TelemetryConfig *TelemetryConfigPtr);
+size_t EncodeTelemetrySample(const TelemetrySample &SampleRef,const std::vector<TelemetryChannel> &ChannelsRef,uint8_t *Packet);
+bool DecodeTelemetrySample(const uint8_t *Packet,size_t PacketSize,const std::vector<TelemetryChannel> &ChannelsRef,TelemetrySample *SamplePtr);
+size_t EncodeUplinkCommand(const UplinkCommand &CommandRef,uint8_t *Packet);
+bool DecodeUplinkCommand(const uint8_t *Packet,size_t PacketSize,UplinkCommand *CommandPtr);
+size_t EncodeTelemetryAck(const TelemetryAck &AckRef,uint8_t *Packet);
+bool DecodeTelemetryAck(const uint8_t *Packet,size_t PacketSize,TelemetryAck *AckPtr);
+uint16_t FloatToHalf(float Value);
+float HalfToFloat(uint16_t Half);
+
+#endif
@@ -0,0 +1,128 @@
+
+#include "telemetry.hxx"
+
+const size_t Telemetry::MaxCommandsPerRun;
+
+Telemetry::Telemetry() {
+  memset(&Sample_,0,sizeof(Sample_));
+  memset(Uplink_,0,sizeof(Uplink_));
+}
+
+Telemetry::~Telemetry() {
+  if (FileDesc_ >= 0) {
+    close(FileDesc_);
+  }
+}
+
+/* Resolves the channels against the configured sensors and opens a non-blocking
+socket on the uplink port. */
+void Telemetry::Open(const TelemetryConfig &ConfigRef,const FmuData &FmuDataRef) {
+  Channels_ = ConfigRef.Channels;
+  Sources_.resize(Channels_.size());
+  for (size_t i=0; i < Channels_.size(); i++) {
+    if (!ParseSignalSource(Channels_[i].Name,FmuDataRef,&Sources_[i])) {
+      throw std::runtime_error("Unknown telemetry channel " + Channels_[i].Name + ".");
+    }
+  }
+  Sample_.NumberChannels = Channels_.size();
+  memset(&Ground_,0,sizeof(Ground_));
+  Ground_.sin_family = AF_INET;
+  Ground_.sin_port = htons(ConfigRef.GroundPort);
+  if (inet_pton(AF_INET,ConfigRef.GroundAddress.c_str(),&Ground_.sin_addr) != 1) {
+    throw std::runtime_error("Telemetry ground address " + ConfigRef.GroundAddress + " is not an IPv4 address.");
+  }
+  FileDesc_ = socket(AF_INET,SOCK_DGRAM|SOCK_NONBLOCK|SOCK_CLOEXEC,0);
+  if (FileDesc_ < 0) {
+    throw std::runtime_error(std::string("Telemetry socket failed, ") + strerror(errno) + ".");
+  }
+  struct sockaddr_in Local;
+  memset(&Local,0,sizeof(Local));
+  Local.sin_family = AF_INET;
+  Local.sin_addr.s_addr = htonl(INADDR_ANY);
+  Local.sin_port = htons(ConfigRef.Port);
+  if (bind(FileDesc_,(struct sockaddr *)&Local,sizeof(Local)) < 0) {
+    throw std::runtime_error("Telemetry could not bind port " + std::to_string(ConfigRef.Port) + ", " + strerror(errno) + ".");
+  }
+}
+
+/* Returns true once the socket is open. */
+bool Telemetry::Opened() {
+  return FileDesc_ >= 0;
+}
+
+/* Sends one sample of the navigation solution, if it is valid, and the channels.
+Never waits, a sample that cannot be sent right away is dropped. */
+void Telemetry::Send(const FmuData &FmuDataRef,const NavigationData &NavigationDataRef,bool NavValid) {
+  Sample_.Time_ms = (uint32_t)(FmuDataRef.Time_us/1000);
+  Sample_.NavValid = NavValid;
+  for (size_t i=0; i < 3; i++) {
+    Sample_.LLA[i] = NavigationDataRef.LLA[i];
+    Sample_.NEDVelocity_ms[i] = NavigationDataRef.NEDVelocity_ms[i];
+    Sample_.Euler_rad[i] = NavigationDataRef.Euler_rad[i];
+  }
+  for (size_t i=0; i < Sources_.size(); i++) {
+    Sample_.Channels[i] = ReadSignalSource(Sources_[i],FmuDataRef,NavigationDataRef,Uplink_);
+  }
+  size_t PacketSize = EncodeTelemetrySample(Sample_,Channels_,Packet_);
+  Sample_.Sequence++;
+  if (sendto(FileDesc_,Packet_,PacketSize,MSG_DONTWAIT,(struct sockaddr *)&Ground_,sizeof(Ground_)) == (ssize_t)PacketSize) {
+    Stats_.Samples++;
+    Stats_.Bytes += PacketSize;
+  } else {
+    Stats_.Dropped++;
+  }
+}
+
+/* Carries out the commands that have arrived, up to MaxCommandsPerRun, and
+acknowledges each to whoever sent it. */
+void Telemetry::ReceiveCommands() {
+  for (size_t i=0; i < MaxCommandsPerRun; i++) {
+    uint8_t Packet[UplinkCommandSize+1];
+    struct sockaddr_in Sender;
+    socklen_t SenderSize = sizeof(Sender);
+    ssize_t PacketSize = recvfrom(FileDesc_,Packet,sizeof(Packet),MSG_DONTWAIT,(struct sockaddr *)&Sender,&SenderSize);
+    if (PacketSize < 0) {
+      return;
+    }
+    UplinkCommand Command;
+    if (!DecodeUplinkCommand(Packet,PacketSize,&Command)) {
+      Stats_.Rejected++;
+      continue;
+    }
+    TelemetryAck Ack = {Command.Sequence,0};
+    if (Command.Type == kUplinkSetValue) {
+      if (Command.Index < MaxUplinkValues) {
+        Uplink_[Command.Index] = Command.Value;
+      } else {
+        Ack.Status = 1;
+      }
+    }
+    if (Ack.Status == 0) {
+      Stats_.Commands++;
+    } else {
+      Stats_.Rejected++;
+    }
+    uint8_t AckPacket[TelemetryAckSize];
+    EncodeTelemetryAck(Ack,AckPacket);
+    sendto(FileDesc_,AckPacket,sizeof(AckPacket),MSG_DONTWAIT,(struct sockaddr *)&Sender,SenderSize);
+  }
+}
+
+/* Returns the values set from the ground, Uplink/0 to Uplink/7, zero until set. */
+const float *Telemetry::GetUplinkValues() {
+  return Uplink_;
+}
+
+/* Returns the telemetry counters. */
+TelemetryStats Telemetry::GetStats() {
+  return Stats_;
+}
+
+/* Prints the telemetry counters and the size of a sample against the raw data. */
+void Telemetry::Print(FILE *File) {
+  size_t SampleSize = TelemetryHeaderSize + TelemetryNavSize + 2*Channels_.size();
+  size_t RawSize = sizeof(NavigationData) + sizeof(float)*Channels_.size();
+  fprintf(File,"Telemetry: %llu samples sent, %llu dropped, %llu bytes, %zu bytes a sample against %zu raw\n",
+    (unsigned long long)Stats_.Samples,(unsigned long long)Stats_.Dropped,(unsigned long long)Stats_.Bytes,SampleSize,RawSize);
+  fprintf(File,"Uplink: %llu commands carried out, %llu rejected\n",(unsigned long long)Stats_.Commands,(unsigned long long)Stats_.Rejected);
+}
@@ -0,0 +1,62 @@
+
+#ifndef TELEMETRY_HXX_
+#define TELEMETRY_HXX_
+
+#include "global-defs.hxx"
+#include "signal-source.hxx"
+#include "telemetry-codec.hxx"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <string>
+#include <vector>
+#include <exception>
+#include <stdexcept>
+
+/* Telemetry counters */
+struct TelemetryStats {
+  uint64_t Samples;                         // samples sent
+  uint64_t Bytes;                           // bytes sent in samples, UDP and IP headers not included
+  uint64_t Dropped;                         // samples the socket had no room for, or could not send
+  uint64_t Commands;                        // uplink commands carried out
+  uint64_t Rejected;                        // uplink packets that were not a valid command
+};
+
+/* Telemetry downlink and command uplink with a ground station over UDP. Each call
+to Send packs the navigation solution and the configured channels into one small
+datagram, see telemetry-codec, and hands it to the socket without waiting: if the
+socket has no room the sample is dropped and counted, it is stale by the next one
+anyway. ReceiveCommands reads whatever commands have arrived, a bounded number per
+call, and never waits for more. Commands ping, or set the values the control laws
+read as Uplink/0 to Uplink/7, and each is acknowledged to its sender. Send and
+ReceiveCommands are run by the Telemetry task, at its rate, on the flight loop's
+thread, which also reads the uplink values, so they need no locking. */
+class Telemetry {
+  public:
+    static const size_t MaxCommandsPerRun = 8;
+    Telemetry();
+    ~Telemetry();
+    void Open(const TelemetryConfig &ConfigRef,const FmuData &FmuDataRef);
+    bool Opened();
+    void Send(const FmuData &FmuDataRef,const NavigationData &NavigationDataRef,bool NavValid);
+    void ReceiveCommands();
+    const float *GetUplinkValues();
+    TelemetryStats GetStats();
+    void Print(FILE *File);
+  private:
+    int FileDesc_ = -1;
+    struct sockaddr_in Ground_;
+    std::vector<TelemetryChannel> Channels_;
+    std::vector<SignalSource> Sources_;
+    TelemetrySample Sample_;
+    uint8_t Packet_[MaxTelemetryPacketSize];
+    float Uplink_[MaxUplinkValues];
+    TelemetryStats Stats_ = {0,0,0,0,0};
+};
+
+#endif
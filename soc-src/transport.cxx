@@ -0,0 +1,196 @@
+
+#include "transport.hxx"
+
+/* Uses an already open descriptor, such as a pipe, set to nonblocking. */
+FmuTransport::FmuTransport(int FileDesc) {
+  FileDesc_ = FileDesc;
+  fcntl(FileDesc_,F_SETFL,O_NONBLOCK);
+}
+
+FmuTransport::FmuTransport() {}
+
+FmuTransport::~FmuTransport() {
+  if (FileDesc_ >= 0) {
+    close(FileDesc_);
+  }
+}
+
+/* Returns the descriptor to poll for data. */
+int FmuTransport::GetFileDesc() {
+  return FileDesc_;
+}
+
+/* Reads into the given buffers without blocking. */
+ssize_t FmuTransport::Read(const struct iovec *Iov,int IovCount) {
+  return readv(FileDesc_,Iov,IovCount);
+}
+
+/* Writes the given buffers without blocking, returns the number of bytes accepted. */
+ssize_t FmuTransport::Write(const struct iovec *Iov,int IovCount) {
+  return writev(FileDesc_,Iov,IovCount);
+}
+
+/* Returns the number of bytes written but still waiting in the kernel to go out,
+-1 if the descriptor cannot tell. Works for ttys and sockets. */
+int FmuTransport::GetOutputQueued() {
+  int Queued;
+  if (ioctl(FileDesc_,TIOCOUTQ,&Queued)<0) {
+    return -1;
+  }
+  return Queued;
+}
+
+/* Opens a tty at the given baud in raw mode. */
+UartTransport::UartTransport(const std::string &Port,speed_t Baud) {
+  if ((FileDesc_=open(Port.c_str(),O_RDWR|O_NOCTTY|O_NONBLOCK))<0) {
+    throw std::runtime_error("UART failed to open.");
+  }
+  struct termios Options;
+  tcgetattr(FileDesc_,&Options);
+  Options.c_cflag = Baud | CS8 | CREAD | CLOCAL;
+  Options.c_iflag = IGNPAR;
+  Options.c_oflag = 0;
+  Options.c_lflag = 0;
+  Options.c_cc[VTIME] = 0;
+  Options.c_cc[VMIN] = 0;
+  tcflush(FileDesc_,TCIFLUSH);
+  tcsetattr(FileDesc_,TCSANOW,&Options);
+  fcntl(FileDesc_,F_SETFL,O_NONBLOCK);
+}
+
+/* Opens a raw pseudo-terminal master and links its slave at LinkPath. */
+PtyTransport::PtyTransport(const std::string &LinkPath) {
+  if ((FileDesc_=posix_openpt(O_RDWR|O_NOCTTY))<0) {
+    throw std::runtime_error("Pseudo-terminal failed to open.");
+  }
+  if ((grantpt(FileDesc_)<0)||(unlockpt(FileDesc_)<0)) {
+    throw std::runtime_error("Pseudo-terminal failed to unlock.");
+  }
+  SlavePath_ = ptsname(FileDesc_);
+  if ((SlaveDesc_=open(SlavePath_.c_str(),O_RDWR|O_NOCTTY))<0) {
+    throw std::runtime_error("Pseudo-terminal failed to open.");
+  }
+  struct termios Options;
+  tcgetattr(FileDesc_,&Options);
+  cfmakeraw(&Options);
+  tcsetattr(FileDesc_,TCSANOW,&Options);
+  fcntl(FileDesc_,F_SETFL,O_NONBLOCK);
+  if (LinkPath.size() > 0) {
+    unlink(LinkPath.c_str());
+    if (symlink(SlavePath_.c_str(),LinkPath.c_str())<0) {
+      throw std::runtime_error("Pseudo-terminal failed to link.");
+    }
+    LinkPath_ = LinkPath;
+  }
+}
+
+PtyTransport::~PtyTransport() {
+  close(SlaveDesc_);
+  if (LinkPath_.size() > 0) {
+    unlink(LinkPath_.c_str());
+  }
+}
+
+/* Returns the path of the slave side, for the FMU stand-in to open. */
+std::string PtyTransport::GetSlavePath() {
+  return SlavePath_;
+}
+
+/* Connects to, or listens at and accepts one peer on, a Unix stream socket. */
+SocketTransport::SocketTransport(const std::string &Path,bool Listen) {
+  struct sockaddr_un Address;
+  memset(&Address,0,sizeof(Address));
+  Address.sun_family = AF_UNIX;
+  if (Path.size() >= sizeof(Address.sun_path)) {
+    throw std::runtime_error("Socket path is too long.");
+  }
+  strncpy(Address.sun_path,Path.c_str(),sizeof(Address.sun_path)-1);
+  int SocketDesc;
+  if ((SocketDesc=socket(AF_UNIX,SOCK_STREAM,0))<0) {
+    throw std::runtime_error("Socket failed to open.");
+  }
+  if (Listen) {
+    unlink(Path.c_str());
+    if ((bind(SocketDesc,(struct sockaddr *)&Address,sizeof(Address))<0)||(listen(SocketDesc,1)<0)) {
+      close(SocketDesc);
+      throw std::runtime_error("Socket failed to listen.");
+    }
+    ListenPath_ = Path;
+    std::cout << "Waiting for connection on " << Path << "...";
+    std::cout.flush();
+    FileDesc_ = accept(SocketDesc,NULL,NULL);
+    close(SocketDesc);
+    if (FileDesc_ < 0) {
+      throw std::runtime_error("Socket failed to accept.");
+    }
+    std::cout << "done!" << std::endl;
+  } else {
+    if (connect(SocketDesc,(struct sockaddr *)&Address,sizeof(Address))<0) {
+      close(SocketDesc);
+      throw std::runtime_error("Socket failed to connect.");
+    }
+    FileDesc_ = SocketDesc;
+  }
+  fcntl(FileDesc_,F_SETFL,O_NONBLOCK);
+}
+
+SocketTransport::~SocketTransport() {
+  if (ListenPath_.size() > 0) {
+    unlink(ListenPath_.c_str());
+  }
+}
+
+/* Opens a recorded byte stream for reading. */
+FileTransport::FileTransport(const std::string &Path) {
+  if ((FileDesc_=open(Path.c_str(),O_RDONLY|O_NONBLOCK))<0) {
+    throw std::runtime_error("Capture file failed to open.");
+  }
+}
+
+/* There is no FMU to write to, so everything is accepted and dropped. */
+ssize_t FileTransport::Write(const struct iovec *Iov,int IovCount) {
+  size_t BufferSize = 0;
+  for (int i=0; i < IovCount; i++) {
+    BufferSize += Iov[i].iov_len;
+  }
+  return BufferSize;
+}
+
+/* Nothing is ever left waiting. */
+int FileTransport::GetOutputQueued() {
+  return 0;
+}
+
+/* Opens a transport from a spec string:
+  uart:PORT          serial port, at FmuBaud
+  pty[:LINK]         new pseudo-terminal, slave linked at LINK
+  unix:PATH          connect to a Unix socket
+  unix-listen:PATH   listen on a Unix socket and accept one peer
+  file:PATH          read a recorded BFS byte stream
+A spec without a type is taken as a serial port. */
+FmuTransport *OpenFmuTransport(const std::string &Spec) {
+  size_t Split = Spec.find(':');
+  std::string Type = Spec.substr(0,Split);
+  std::string Path = (Split != std::string::npos) ? Spec.substr(Split+1) : "";
+  if (Type == "uart") {
+    return new UartTransport(Path,FmuBaud);
+  }
+  if (Type == "pty") {
+    PtyTransport *Pty = new PtyTransport(Path);
+    std::cout << "FMU pseudo-terminal at " << Pty->GetSlavePath() << std::endl;
+    return Pty;
+  }
+  if (Type == "unix") {
+    return new SocketTransport(Path,false);
+  }
+  if (Type == "unix-listen") {
+    return new SocketTransport(Path,true);
+  }
+  if (Type == "file") {
+    return new FileTransport(Path);
+  }
+  if (Split == std::string::npos) {
+    return new UartTransport(Spec,FmuBaud);
+  }
+  throw std::runtime_error("Unknown FMU transport " + Type + ".");
+}
@@ -0,0 +1,80 @@
+
+#ifndef TRANSPORT_HXX_
+#define TRANSPORT_HXX_
+
+#include "hardware-defs.hxx"
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <string>
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+
+/* A byte stream to the FMU. Every backend is a file descriptor, so the receive path
+can poll and readv it the same way whatever is on the other end. A read returning 0
+means the other end has gone away. */
+class FmuTransport {
+  public:
+    FmuTransport(int FileDesc);
+    virtual ~FmuTransport();
+    int GetFileDesc();
+    virtual ssize_t Read(const struct iovec *Iov,int IovCount);
+    virtual ssize_t Write(const struct iovec *Iov,int IovCount);
+    virtual int GetOutputQueued();
+  protected:
+    FmuTransport();
+    int FileDesc_ = -1;
+};
+
+/* The serial port to the FMU, or any tty such as the slave side of a pseudo-terminal */
+class UartTransport : public FmuTransport {
+  public:
+    UartTransport(const std::string &Port,speed_t Baud);
+};
+
+/* A pseudo-terminal standing in for the UART. The slave side is linked at LinkPath,
+if given, for an FMU stand-in to open as its serial port. A slave descriptor is held
+open so the master does not report a hang up while no stand-in is attached. */
+class PtyTransport : public FmuTransport {
+  public:
+    PtyTransport(const std::string &LinkPath);
+    ~PtyTransport();
+    std::string GetSlavePath();
+  private:
+    std::string SlavePath_;
+    std::string LinkPath_;
+    int SlaveDesc_ = -1;
+};
+
+/* A Unix stream socket, either connecting to a listening peer or listening for one
+peer and accepting it */
+class SocketTransport : public FmuTransport {
+  public:
+    SocketTransport(const std::string &Path,bool Listen);
+    ~SocketTransport();
+  private:
+    std::string ListenPath_;
+};
+
+/* Reads a recorded BFS byte stream from a file, anything written is dropped */
+class FileTransport : public FmuTransport {
+  public:
+    FileTransport(const std::string &Path);
+    ssize_t Write(const struct iovec *Iov,int IovCount);
+    int GetOutputQueued();
+};
+
+FmuTransport *OpenFmuTransport(const std::string &Spec);
+
+#endif
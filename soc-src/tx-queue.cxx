@@ -0,0 +1,216 @@
+
+#include "tx-queue.hxx"
+
+const size_t TxQueue::BulkDepth;
+const size_t TxQueue::DefaultBulkLimit;
+const size_t TxQueue::CommandTypes_;
+
+TxQueue::TxQueue() {
+  Active_.Buffer.resize(BfsCodec::MaxMessageSize);
+  Active_.Size = 0;
+  Active_.Sent = 0;
+  for (size_t i=0; i < CommandTypes_; i++) {
+    Commands_[i].Buffer.resize(BfsCodec::MaxMessageSize);
+    Commands_[i].Size = 0;
+    Commands_[i].Sent = 0;
+  }
+  for (size_t i=0; i < BulkDepth; i++) {
+    Bulk_[i].Buffer.resize(BfsCodec::MaxMessageSize);
+    Bulk_[i].Size = 0;
+    Bulk_[i].Sent = 0;
+  }
+}
+
+/* Sets how many bytes may be waiting in the kernel before bulk frames are held
+back, 0 for no limit. Links that cannot report their output queue are not limited. */
+void TxQueue::SetBulkLimit(size_t BulkLimit) {
+  BulkLimit_ = BulkLimit;
+}
+
+/* Queues a message, returns false if it is bulk traffic and the queue is full. An
+effector command replaces any command of the same type that has not started to go out. */
+bool TxQueue::Push(BfsMessage MessageId,uint16_t PayloadSize,const uint8_t *Payload) {
+  if (PayloadSize > BfsCodec::MaxPayloadSize) {
+    throw std::runtime_error("BFS message payload is too large.");
+  }
+  int Slot = GetCommandSlot(MessageId);
+  if (Slot >= 0) {
+    if (Commands_[Slot].Size > 0) {
+      Stats_.Coalesced++;
+    }
+    BuildFrame(&Commands_[Slot],MessageId,PayloadSize,Payload);
+    return true;
+  }
+  if (BulkFull()) {
+    Stats_.Dropped++;
+    return false;
+  }
+  BuildFrame(&Bulk_[BulkTail_ % BulkDepth],MessageId,PayloadSize,Payload);
+  BulkTail_++;
+  return true;
+}
+
+/* Writes as much of the queue as the link accepts without blocking, in order: the
+rest of a partly written frame, effector commands, then bulk frames up to the bulk
+limit. Returns true once the queue is empty. */
+bool TxQueue::Flush(FmuTransport *Link) {
+  while (!Empty()) {
+    TxFrame *Frames[1 + CommandTypes_ + BulkDepth];
+    struct iovec Iov[1 + CommandTypes_ + BulkDepth];
+    size_t FrameCount = 0;
+    size_t Budget = SIZE_MAX;
+    int Queued;
+    if ((BulkLimit_ > 0)&&((Queued=Link->GetOutputQueued()) >= 0)) {
+      Budget = ((size_t)Queued < BulkLimit_) ? BulkLimit_ - Queued : 0;
+    }
+    Throttled_ = false;
+    if (Active_.Size > 0) {
+      Frames[FrameCount++] = &Active_;
+    }
+    for (size_t i=0; i < CommandTypes_; i++) {
+      if (Commands_[i].Size > 0) {
+        Frames[FrameCount++] = &Commands_[i];
+      }
+    }
+    for (size_t i=BulkHead_; i != BulkTail_; i++) {
+      Frames[FrameCount++] = &Bulk_[i % BulkDepth];
+    }
+    for (size_t i=0; i < FrameCount; i++) {
+      size_t Remaining = Frames[i]->Size - Frames[i]->Sent;
+      if (!Frames[i]->Command) {
+        if (Remaining > Budget) {
+          // anything after a cut short frame would interleave with it
+          Remaining = Budget;
+          FrameCount = i + (Remaining > 0 ? 1 : 0);
+          Throttled_ = true;
+        }
+        Budget -= Remaining;
+      }
+      Iov[i].iov_base = Frames[i]->Buffer.data() + Frames[i]->Sent;
+      Iov[i].iov_len = Remaining;
+    }
+    if (FrameCount == 0) {
+      return false;
+    }
+    Stats_.WriteCalls++;
+    ssize_t count;
+    if ((count=Link->Write(Iov,FrameCount))<0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN) {
+        return false;
+      }
+      throw std::runtime_error("FMU link failed to write.");
+    }
+    Stats_.Bytes += count;
+    uint64_t Time_us = GetTime_us();
+    size_t Written = count;
+    for (size_t i=0; i < FrameCount; i++) {
+      size_t Remaining = Frames[i]->Size - Frames[i]->Sent;
+      if (Written >= Remaining) {
+        Written -= Remaining;
+        FrameSent(Frames[i],Time_us);
+        continue;
+      }
+      if (Written > 0) {
+        // stopped inside this frame, move it to the front so nothing jumps ahead of it
+        if (Written < Iov[i].iov_len) {
+          Stats_.PartialWrites++;
+        }
+        Frames[i]->Sent += Written;
+        if (Frames[i] != &Active_) {
+          std::swap(Active_.Buffer,Frames[i]->Buffer);
+          Active_.Size = Frames[i]->Size;
+          Active_.Sent = Frames[i]->Sent;
+          Active_.Command = Frames[i]->Command;
+          Active_.QueueTime_us = Frames[i]->QueueTime_us;
+          ReleaseFrame(Frames[i]);
+        }
+      }
+      break;
+    }
+    if (count == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Returns true if nothing is waiting to be written. */
+bool TxQueue::Empty() {
+  if (Active_.Size > 0) {
+    return false;
+  }
+  for (size_t i=0; i < CommandTypes_; i++) {
+    if (Commands_[i].Size > 0) {
+      return false;
+    }
+  }
+  return BulkHead_ == BulkTail_;
+}
+
+/* Returns true if there is no room for another bulk frame. */
+bool TxQueue::BulkFull() {
+  return (BulkTail_ - BulkHead_) == BulkDepth;
+}
+
+/* Returns true if the last flush held bulk frames back for the bulk limit, the link
+has room for them but the kernel will not report when to try again. */
+bool TxQueue::Throttled() {
+  return Throttled_;
+}
+
+/* Returns the transmit counters. */
+TxQueueStats TxQueue::GetStats() {
+  return Stats_;
+}
+
+/* Returns the command slot for effector commands, -1 for bulk traffic. */
+int TxQueue::GetCommandSlot(BfsMessage MessageId) {
+  if (MessageId == kEffectorAngleCmd) {
+    return 0;
+  }
+  if (MessageId == kEffectorDirectCmd) {
+    return 1;
+  }
+  return -1;
+}
+
+/* Returns the monotonic time, us. */
+uint64_t TxQueue::GetTime_us() {
+  struct timespec Time;
+  clock_gettime(CLOCK_MONOTONIC,&Time);
+  return (uint64_t)Time.tv_sec*1000000 + Time.tv_nsec/1000;
+}
+
+/* Frames a message into a queue entry. */
+void TxQueue::BuildFrame(TxFrame *Frame,BfsMessage MessageId,uint16_t PayloadSize,const uint8_t *Payload) {
+  Frame->Size = BfsCodec::BuildMessage(MessageId,PayloadSize,Payload,Frame->Buffer.data());
+  Frame->Sent = 0;
+  Frame->Command = GetCommandSlot(MessageId) >= 0;
+  Frame->QueueTime_us = GetTime_us();
+}
+
+/* Records a frame whose last byte has been written and frees its queue entry. */
+void TxQueue::FrameSent(TxFrame *Frame,uint64_t Time_us) {
+  Stats_.Frames++;
+  if (Frame->Command) {
+    uint64_t Latency_us = Time_us - Frame->QueueTime_us;
+    Stats_.Commands++;
+    Stats_.CommandLatencySum_us += Latency_us;
+    if (Latency_us > Stats_.CommandLatencyMax_us) {
+      Stats_.CommandLatencyMax_us = Latency_us;
+    }
+  }
+  ReleaseFrame(Frame);
+}
+
+/* Frees a queue entry. */
+void TxQueue::ReleaseFrame(TxFrame *Frame) {
+  Frame->Size = 0;
+  Frame->Sent = 0;
+  if ((Frame >= &Bulk_[0]) && (Frame < &Bulk_[BulkDepth])) {
+    BulkHead_++;
+  }
+}
@@ -0,0 +1,76 @@
+
+#ifndef TX_QUEUE_HXX_
+#define TX_QUEUE_HXX_
+
+#include "global-defs.hxx"
+#include "bfs.hxx"
+#include "transport.hxx"
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+/* Transmit side counters */
+struct TxQueueStats {
+  uint64_t Frames;                          // Number of frames completely written
+  uint64_t Bytes;                           // Number of bytes written
+  uint64_t WriteCalls;                      // Number of writev system calls
+  uint64_t PartialWrites;                   // Number of writes that ended part way through a frame
+  uint64_t Coalesced;                       // Number of effector commands replaced by a newer one before being sent
+  uint64_t Dropped;                         // Number of bulk frames refused because the queue was full
+  uint64_t Commands;                        // Number of effector commands written
+  uint64_t CommandLatencySum_us;            // Sum of the times effector commands waited before the link took them, us
+  uint64_t CommandLatencyMax_us;            // Longest an effector command waited before the link took it, us
+};
+
+/* Queue of BFS Bus frames waiting to go to the FMU. Nothing in here blocks: Flush
+writes as much as the link accepts with one writev over all the queued frames and
+keeps the rest for the next call. Effector commands are sent ahead of everything
+else and only the newest command of each type is kept, since an older command
+still waiting is stale. A frame that is part way out on the wire is always finished
+first so frames are never interleaved. Bytes already handed to the kernel cannot be
+overtaken, so bulk frames are only written while less than the bulk limit is waiting
+in the kernel to go out, which bounds how long a new command waits behind them. Every
+frame buffer is sized when the queue is built, so pushing and flushing never allocate. */
+class TxQueue {
+  public:
+    static const size_t BulkDepth = 16;
+    static const size_t DefaultBulkLimit = 512;
+    TxQueue();
+    void SetBulkLimit(size_t BulkLimit);
+    bool Push(BfsMessage MessageId,uint16_t PayloadSize,const uint8_t *Payload);
+    bool Flush(FmuTransport *Link);
+    bool Empty();
+    bool BulkFull();
+    bool Throttled();
+    TxQueueStats GetStats();
+  private:
+    struct TxFrame {
+      std::vector<uint8_t> Buffer;
+      size_t Size;
+      size_t Sent;
+      bool Command;
+      uint64_t QueueTime_us;
+    };
+    static const size_t CommandTypes_ = 2;
+    TxFrame Active_;
+    TxFrame Commands_[CommandTypes_];
+    TxFrame Bulk_[BulkDepth];
+    size_t BulkHead_ = 0;
+    size_t BulkTail_ = 0;
+    size_t BulkLimit_ = DefaultBulkLimit;
+    bool Throttled_ = false;
+    TxQueueStats Stats_ = {0,0,0,0,0,0,0,0,0};
+    static int GetCommandSlot(BfsMessage MessageId);
+    static uint64_t GetTime_us();
+    void BuildFrame(TxFrame *Frame,BfsMessage MessageId,uint16_t PayloadSize,const uint8_t *Payload);
+    void FrameSent(TxFrame *Frame,uint64_t Time_us);
+    void ReleaseFrame(TxFrame *Frame);
+};
+
+#endif